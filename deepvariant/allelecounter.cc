@@ -253,7 +253,7 @@ void AlleleCounter::Init() {
     const int64_t pos = interval_.start() + i;
     *(allele_count.mutable_position()) =
         nucleus::MakePosition(interval_.reference_name(), pos);
-    allele_count.set_ref_base(ref_bases_.substr(i + full_interval_offset, 1));
+    allele_count.set_ref_base(ref_bases_.data() + i + full_interval_offset, 1);
     allele_count.set_track_ref_reads(options_.track_ref_reads());
     counts_.push_back(allele_count);
   }
@@ -282,7 +282,8 @@ AlleleCounter::AlleleCounter(const GenomeReference* const ref,
       reads_interval_(full_range),
       candidate_positions_(candidate_positions),
       options_(options),
-      ref_bases_(ref_->GetBases(full_range).ValueOrDie()) {
+      ref_bases_holder_(ref_->GetBasesView(full_range).ValueOrDie()),
+      ref_bases_(ref_bases_holder_.bases()) {
   Init();
 }
 
@@ -295,13 +296,20 @@ AlleleCounter::AlleleCounter(const GenomeReference* const ref,
       reads_interval_(range),
       candidate_positions_(candidate_positions),
       options_(options),
-      ref_bases_(ref_->GetBases(range).ValueOrDie()) {
+      ref_bases_holder_(ref_->GetBasesView(range).ValueOrDie()),
+      ref_bases_(ref_bases_holder_.bases()) {
   Init();
 }
 
 string AlleleCounter::RefBases(const int64_t rel_start, const int64_t len) {
   CHECK_GT(len, 0) << "Length must be >= 1";
 
+  // Most lookups fall within the bases we already hold for reads_interval_.
+  if (rel_start >= 0 &&
+      rel_start + len <= static_cast<int64_t>(ref_bases_.size())) {
+    return string(ref_bases_.substr(rel_start, len));
+  }
+
   // If our region isn't valid (e.g., it is off the end of the chromosome),
   // return an empty string, otherwise get the actual bases from reference.
   const int abs_start = reads_interval_.start() + rel_start;
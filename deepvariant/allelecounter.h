@@ -450,8 +450,10 @@ class AlleleCounter {
   // Our AlleleCount objects, one for each base in our interval, in order.
   std::vector<AlleleCount> counts_;
 
-  // The reference bases covering our interval;
-  const string ref_bases_;
+  // The reference bases covering our interval, viewed without copying them
+  // out of the GenomeReference, and ref_bases_'s view of them.
+  const nucleus::ReferenceBases ref_bases_holder_;
+  const absl::string_view ref_bases_;
 
   // Following tests call protected method NormalizeCigar.
   FRIEND_TEST(AlleleCounterTest, NormalizeCigarDel);
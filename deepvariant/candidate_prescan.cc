@@ -0,0 +1,266 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "deepvariant/candidate_prescan.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "deepvariant/protos/deepvariant.pb.h"
+#include "absl/strings/string_view.h"
+#include "htslib/sam.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+#include "third_party/nucleus/io/reference.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/io/sam_utils.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+
+namespace learning {
+namespace genomics {
+namespace deepvariant {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::SamReaderOptions;
+
+namespace {
+
+// What a read was tallied as at a position. Values 0..3 are substitutions to
+// the base with that PreScanBaseIndex().
+constexpr int kNotTallied = -1;
+constexpr int kReference = 4;
+constexpr int kInsertion = 5;
+constexpr int kDeletion = 6;
+
+void Tally(int kind, int delta, PreScanCounts* counts) {
+  counts->depth += delta;
+  if (kind == kInsertion) {
+    counts->insertions += delta;
+  } else if (kind == kDeletion) {
+    counts->deletions += delta;
+  } else if (kind != kReference) {
+    counts->substitutions[kind] += delta;
+  }
+}
+
+}  // namespace
+
+CandidatePreScanner::CandidatePreScanner(
+    const nucleus::GenomeReference* ref,
+    std::vector<std::unique_ptr<nucleus::SamReader>> readers,
+    bool use_original_base_quality_scores,
+    const AlleleCounterOptions& allele_counter_options,
+    const VariantCallerOptions& variant_caller_options)
+    : ref_(ref),
+      readers_(std::move(readers)),
+      min_base_quality_(
+          allele_counter_options.read_requirements().min_base_quality()),
+      keep_legacy_behavior_(allele_counter_options.keep_legacy_behavior()),
+      use_original_base_quality_scores_(use_original_base_quality_scores),
+      options_(variant_caller_options) {}
+
+nucleus::StatusOr<std::unique_ptr<CandidatePreScanner>>
+CandidatePreScanner::Create(
+    const nucleus::GenomeReference* ref,
+    const std::vector<std::string>& reads_paths,
+    const std::string& cram_ref_path, const SamReaderOptions& reader_options,
+    const AlleleCounterOptions& allele_counter_options,
+    const VariantCallerOptions& variant_caller_options) {
+  if (ref == nullptr) {
+    return nucleus::InvalidArgument("ref must not be null");
+  }
+  std::vector<std::unique_ptr<nucleus::SamReader>> readers;
+  readers.reserve(reads_paths.size());
+  for (const std::string& reads_path : reads_paths) {
+    nucleus::StatusOr<std::unique_ptr<nucleus::SamReader>> reader =
+        nucleus::SamReader::FromFile(reads_path, cram_ref_path,
+                                     reader_options);
+    NUCLEUS_RETURN_IF_ERROR(reader.status());
+    readers.push_back(std::move(reader.ValueOrDie()));
+  }
+  return std::unique_ptr<CandidatePreScanner>(new CandidatePreScanner(
+      ref, std::move(readers),
+      reader_options.use_original_base_quality_scores(),
+      allele_counter_options, variant_caller_options));
+}
+
+nucleus::StatusOr<std::vector<int>> CandidatePreScanner::CandidatePositions(
+    const Range& region) {
+  nucleus::StatusOr<nucleus::ReferenceBases> ref_bases_or =
+      ref_->GetBasesView(region);
+  NUCLEUS_RETURN_IF_ERROR(ref_bases_or.status());
+  const absl::string_view ref_bases = ref_bases_or.ValueOrDie().bases();
+
+  std::vector<PreScanCounts> counts(ref_bases.size());
+  for (const auto& reader : readers_) {
+    NUCLEUS_RETURN_IF_ERROR(reader->VisitRecords(
+        region, [&](const bam1_t& record) {
+          AddRecord(record, region.start(), ref_bases, &counts);
+        }));
+  }
+
+  std::vector<int> positions;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    // Like the VariantCaller, only consider sites with a canonical ref base.
+    if (PreScanBaseIndex(seq_nt16_table[static_cast<unsigned char>(
+            ref_bases[i])]) >= 0 &&
+        IsCandidate(counts[i])) {
+      positions.push_back(static_cast<int>(region.start() + i));
+    }
+  }
+  return positions;
+}
+
+void CandidatePreScanner::AddRecord(const bam1_t& record,
+                                    int64_t region_start,
+                                    absl::string_view ref_bases,
+                                    std::vector<PreScanCounts>* counts) const {
+  const bam1_core_t& core = record.core;
+  if ((core.flag & BAM_FUNMAP) || core.tid < 0) return;
+
+  const uint32_t* cigar = bam_get_cigar(&record);
+  const uint8_t* seq = bam_get_seq(&record);
+  const uint8_t* qual = bam_get_qual(&record);
+  // Original qualities are phred+33 encoded; reads without them fall back to
+  // their regular qualities, as they would when converted to a Read.
+  absl::string_view original_qual;
+  const bool has_original_qual =
+      use_original_base_quality_scores_ &&
+      nucleus::GetOriginalQualityTag(&record, &original_qual);
+  auto base_quality = [&](int offset) {
+    return has_original_qual ? original_qual[offset] - 33
+                             : static_cast<int>(qual[offset]);
+  };
+
+  const int64_t region_end = region_start + ref_bases.size();
+  auto in_region = [&](int64_t pos) {
+    return pos >= region_start && pos < region_end;
+  };
+
+  // The last position this read was tallied at, and as what. An indel is
+  // anchored on the aligned base before it and replaces that base's tally, so
+  // that each read contributes one allele per position, as in AlleleCounter.
+  int64_t last_pos = -1;
+  int last_kind = kNotTallied;
+  auto tally_anchor = [&](int64_t anchor, int kind) {
+    if (!in_region(anchor)) return;
+    PreScanCounts& at = (*counts)[anchor - region_start];
+    if (last_pos == anchor && last_kind != kNotTallied) {
+      Tally(last_kind, -1, &at);
+    }
+    Tally(kind, 1, &at);
+    last_pos = anchor;
+    last_kind = kind;
+  };
+
+  int64_t ref_pos = core.pos;
+  int read_offset = 0;
+  for (uint32_t i = 0; i < core.n_cigar; ++i) {
+    const int op = bam_cigar_op(cigar[i]);
+    const int len = bam_cigar_oplen(cigar[i]);
+    switch (op) {
+      case BAM_CMATCH:
+      case BAM_CEQUAL:
+      case BAM_CDIFF:
+        for (int j = 0; j < len; ++j) {
+          const int64_t pos = ref_pos + j;
+          if (!in_region(pos)) continue;
+          const int base = PreScanBaseIndex(bam_seqi(seq, read_offset + j));
+          last_pos = pos;
+          if (base < 0 || base_quality(read_offset + j) < min_base_quality_) {
+            // Unusable bases don't count towards the depth.
+            last_kind = kNotTallied;
+            continue;
+          }
+          const int ref_base = PreScanBaseIndex(seq_nt16_table[
+              static_cast<unsigned char>(ref_bases[pos - region_start])]);
+          last_kind = base == ref_base ? kReference : base;
+          Tally(last_kind, 1, &(*counts)[pos - region_start]);
+        }
+        ref_pos += len;
+        read_offset += len;
+        break;
+      case BAM_CINS: {
+        bool usable = true;
+        int quality_sum = 0;
+        for (int j = 0; j < len && usable; ++j) {
+          const int quality = base_quality(read_offset + j);
+          quality_sum += quality;
+          usable = PreScanBaseIndex(bam_seqi(seq, read_offset + j)) >= 0 &&
+                   (!keep_legacy_behavior_ || quality >= min_base_quality_);
+        }
+        if (usable && quality_sum >= min_base_quality_ * len) {
+          tally_anchor(ref_pos - 1, kInsertion);
+        }
+        read_offset += len;
+        break;
+      }
+      case BAM_CDEL:
+        tally_anchor(ref_pos - 1, kDeletion);
+        ref_pos += len;
+        break;
+      case BAM_CREF_SKIP:
+        ref_pos += len;
+        break;
+      case BAM_CSOFT_CLIP:
+        read_offset += len;
+        break;
+      default:
+        // Hard clips and padding consume neither the read nor the reference.
+        break;
+    }
+  }
+}
+
+bool CandidatePreScanner::IsCandidate(const PreScanCounts& counts) const {
+  if (counts.depth == 0) return false;
+  auto passes = [&counts](int count, int min_count, float min_fraction) {
+    return count > 0 && count >= min_count &&
+           count >= min_fraction * counts.depth;
+  };
+  for (int count : counts.substitutions) {
+    if (passes(count, options_.min_count_snps(), options_.min_fraction_snps()))
+      return true;
+  }
+  return passes(counts.insertions, options_.min_count_indels(),
+                options_.min_fraction_indels()) ||
+         passes(counts.deletions, options_.min_count_indels(),
+                options_.min_fraction_indels());
+}
+
+}  // namespace deepvariant
+}  // namespace genomics
+}  // namespace learning
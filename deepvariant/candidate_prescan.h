@@ -0,0 +1,151 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Finds candidate positions over an interval of the genome straight from the
+// raw htslib records of the reads that overlap it.
+//
+// This is a fast, approximate alternative to running an AlleleCounter over the
+// interval and asking a VariantCaller for the positions of its candidates,
+// which is what the first pass of the candidate sweep workflow does. Reads are
+// never converted to protos and no per-read alleles are recorded: every
+// aligned base is compared to the reference in its 4-bit htslib encoding and
+// only per-position tallies are kept.
+//
+#ifndef LEARNING_GENOMICS_DEEPVARIANT_CANDIDATE_PRESCAN_H_
+#define LEARNING_GENOMICS_DEEPVARIANT_CANDIDATE_PRESCAN_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "deepvariant/protos/deepvariant.pb.h"
+#include "absl/strings/string_view.h"
+#include "htslib/sam.h"
+#include "third_party/nucleus/core/statusor.h"
+#include "third_party/nucleus/io/reference.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+
+namespace learning {
+namespace genomics {
+namespace deepvariant {
+
+// Per-position tallies of the reads overlapping one reference base.
+struct PreScanCounts {
+  // Number of reads with a usable base or indel anchored here.
+  int depth = 0;
+  // Number of reads with each non-reference base here, indexed by
+  // PreScanBaseIndex().
+  int substitutions[4] = {0, 0, 0, 0};
+  // Number of reads with an insertion or a deletion anchored here, of any
+  // length or sequence.
+  int insertions = 0;
+  int deletions = 0;
+};
+
+// Returns the index of the canonical base with the 4-bit htslib encoding code
+// (A=1, C=2, G=4, T=8) in 0..3, or -1 if code isn't a canonical base.
+inline int PreScanBaseIndex(int code) {
+  switch (code) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 4:
+      return 2;
+    case 8:
+      return 3;
+    default:
+      return -1;
+  }
+}
+
+class CandidatePreScanner {
+ public:
+  // Creates a scanner for the reads in reads_paths, each opened with
+  // reader_options (and cram_ref_path, for CRAM files). Base quality
+  // thresholds are taken from allele_counter_options and candidate thresholds
+  // from variant_caller_options, as the AlleleCounter and VariantCaller would.
+  // ref must outlive the scanner.
+  static nucleus::StatusOr<std::unique_ptr<CandidatePreScanner>> Create(
+      const nucleus::GenomeReference* ref,
+      const std::vector<std::string>& reads_paths,
+      const std::string& cram_ref_path,
+      const nucleus::genomics::v1::SamReaderOptions& reader_options,
+      const AlleleCounterOptions& allele_counter_options,
+      const VariantCallerOptions& variant_caller_options);
+
+  // Returns, in increasing order, the positions within region where the reads
+  // carry a substitution or indel frequent enough to pass the candidate
+  // thresholds.
+  //
+  // The tallies merge all insertions (and all deletions) anchored at a
+  // position, regardless of their length or sequence, so the result is a
+  // superset of the positions an AlleleCounter followed by
+  // VariantCaller::CallPositionsFromAlleleCounts would return.
+  //
+  // Not thread-safe: the underlying readers support one query at a time.
+  nucleus::StatusOr<std::vector<int>> CandidatePositions(
+      const nucleus::genomics::v1::Range& region);
+
+  // Adds the evidence of record to counts, which covers the reference bases
+  // ref_bases starting at region_start. Exposed for testing.
+  void AddRecord(const bam1_t& record, int64_t region_start,
+                 absl::string_view ref_bases,
+                 std::vector<PreScanCounts>* counts) const;
+
+  // Returns true if counts passes the candidate thresholds. Exposed for
+  // testing.
+  bool IsCandidate(const PreScanCounts& counts) const;
+
+ private:
+  CandidatePreScanner(
+      const nucleus::GenomeReference* ref,
+      std::vector<std::unique_ptr<nucleus::SamReader>> readers,
+      bool use_original_base_quality_scores,
+      const AlleleCounterOptions& allele_counter_options,
+      const VariantCallerOptions& variant_caller_options);
+
+  const nucleus::GenomeReference* const ref_;
+  const std::vector<std::unique_ptr<nucleus::SamReader>> readers_;
+  const int min_base_quality_;
+  const bool keep_legacy_behavior_;
+  const bool use_original_base_quality_scores_;
+  const VariantCallerOptions options_;
+};
+
+}  // namespace deepvariant
+}  // namespace genomics
+}  // namespace learning
+
+#endif  // LEARNING_GENOMICS_DEEPVARIANT_CANDIDATE_PRESCAN_H_
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// UnitTests for candidate_prescan.{h,cc}.
+#include "deepvariant/candidate_prescan.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "deepvariant/allelecounter.h"
+#include "deepvariant/protos/deepvariant.pb.h"
+#include "deepvariant/variant_calling_multisample.h"
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/test.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "htslib/sam.h"
+#include "third_party/nucleus/io/reference.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace learning {
+namespace genomics {
+namespace deepvariant {
+
+using nucleus::GenomeReference;
+using nucleus::MakeRange;
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+using nucleus::genomics::v1::SamReaderOptions;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::IsSubsetOf;
+using ::testing::Not;
+
+constexpr char kChr20Fasta[] = "ucsc.hg19.chr20.unittest.fasta.gz";
+constexpr char kChr20Bam[] = "NA12878_S1.chr20.10_10p1mb.bam";
+constexpr char kDeepVariantTestData[] = "deepvariant/testdata/input";
+
+class CandidatePreScannerTest : public ::testing::Test {
+ protected:
+  CandidatePreScannerTest() {
+    const std::string fasta = nucleus::GetTestData("test.fasta");
+    ref_ = std::move(nucleus::IndexedFastaReader::FromFile(
+                         fasta, absl::StrCat(fasta, ".fai"))
+                         .ValueOrDie());
+    allele_counter_options_.mutable_read_requirements()->set_min_base_quality(
+        10);
+    options_.set_min_count_snps(1);
+    options_.set_min_count_indels(1);
+    options_.set_min_fraction_snps(0.5);
+    options_.set_min_fraction_indels(0.5);
+    scanner_ = std::move(
+        CandidatePreScanner::Create(ref_.get(), {}, "", SamReaderOptions(),
+                                    allele_counter_options_, options_)
+            .ValueOrDie());
+    header_ = sam_hdr_parse(kHeader.size(), kHeader.data());
+  }
+
+  ~CandidatePreScannerTest() override { sam_hdr_destroy(header_); }
+
+  // Returns the tallies over chr1:0-20 of the SAM records in sam_lines.
+  std::vector<PreScanCounts> Scan(const std::vector<std::string>& sam_lines) {
+    const std::string ref_bases =
+        ref_->GetBases(MakeRange("chr1", 0, 20)).ValueOrDie();
+    std::vector<PreScanCounts> counts(ref_bases.size());
+    bam1_t* record = bam_init1();
+    for (const std::string& line : sam_lines) {
+      kstring_t text = {line.size(), line.size() + 1,
+                        const_cast<char*>(line.c_str())};
+      EXPECT_GE(sam_parse1(&text, header_, record), 0) << line;
+      scanner_->AddRecord(*record, 0, ref_bases, &counts);
+    }
+    bam_destroy1(record);
+    return counts;
+  }
+
+  static constexpr absl::string_view kHeader = "@SQ\tSN:chr1\tLN:76\n";
+  std::unique_ptr<const GenomeReference> ref_;
+  AlleleCounterOptions allele_counter_options_;
+  VariantCallerOptions options_;
+  std::unique_ptr<CandidatePreScanner> scanner_;
+  sam_hdr_t* header_;
+};
+
+// chr1 starts with ACCACCATCC.
+TEST_F(CandidatePreScannerTest, CountsSubstitutions) {
+  const std::vector<PreScanCounts> counts = Scan(
+      {"snp\t0\tchr1\t1\t60\t6M\t*\t0\t0\tACCTCC\tIIIIII",
+       "low_quality\t0\tchr1\t1\t60\t6M\t*\t0\t0\tACCTCC\tIII#II",
+       "ref\t0\tchr1\t1\t60\t6M\t*\t0\t0\tACCACC\tIIIIII"});
+  // The low quality T at offset 3 isn't counted at all.
+  EXPECT_EQ(counts[3].depth, 2);
+  EXPECT_THAT(counts[3].substitutions, ElementsAre(0, 0, 0, 1));
+  EXPECT_EQ(counts[2].depth, 3);
+  EXPECT_THAT(counts[2].substitutions, ElementsAre(0, 0, 0, 0));
+  EXPECT_EQ(counts[6].depth, 0);
+}
+
+TEST_F(CandidatePreScannerTest, IndelsReplaceTheirAnchorBase) {
+  const std::vector<PreScanCounts> counts = Scan(
+      {"ins\t0\tchr1\t1\t60\t4M2I2M\t*\t0\t0\tACCAGGCC\tIIIIIIII",
+       "del\t0\tchr1\t1\t60\t4M2D2M\t*\t0\t0\tACCAAT\tIIIIII"});
+  EXPECT_EQ(counts[3].depth, 2);
+  EXPECT_EQ(counts[3].insertions, 1);
+  EXPECT_EQ(counts[3].deletions, 1);
+  // The deleted bases aren't covered by the deletion read.
+  EXPECT_EQ(counts[4].depth, 1);
+  EXPECT_EQ(counts[5].depth, 1);
+  EXPECT_EQ(counts[6].depth, 1);
+  EXPECT_EQ(counts[7].depth, 1);
+}
+
+TEST_F(CandidatePreScannerTest, IsCandidate) {
+  PreScanCounts counts;
+  EXPECT_FALSE(scanner_->IsCandidate(counts));
+  counts.depth = 4;
+  EXPECT_FALSE(scanner_->IsCandidate(counts));
+  counts.substitutions[2] = 1;
+  EXPECT_FALSE(scanner_->IsCandidate(counts));
+  counts.substitutions[2] = 2;
+  EXPECT_TRUE(scanner_->IsCandidate(counts));
+  counts.substitutions[2] = 0;
+  counts.deletions = 2;
+  EXPECT_TRUE(scanner_->IsCandidate(counts));
+}
+
+// The pre-scan must find at least every position that the AlleleCounter and
+// VariantCaller find.
+TEST(CandidatePreScannerChr20Test, FindsAllAlleleCounterCandidates) {
+  const std::string fasta =
+      nucleus::GetTestData(kChr20Fasta, kDeepVariantTestData);
+  const std::string bam = nucleus::GetTestData(kChr20Bam, kDeepVariantTestData);
+  std::unique_ptr<GenomeReference> ref =
+      std::move(nucleus::IndexedFastaReader::FromFile(
+                    fasta, absl::StrCat(fasta, ".fai"))
+                    .ValueOrDie());
+  SamReaderOptions reader_options;
+  reader_options.mutable_read_requirements()->set_min_mapping_quality(10);
+  AlleleCounterOptions allele_counter_options;
+  allele_counter_options.mutable_read_requirements()->set_min_base_quality(10);
+  VariantCallerOptions options;
+  options.set_min_count_snps(2);
+  options.set_min_count_indels(2);
+  options.set_min_fraction_snps(0.12);
+  options.set_min_fraction_indels(0.06);
+  options.set_sample_name("NA12878");
+  const Range region = MakeRange("chr20", 10000000, 10010000);
+
+  std::unique_ptr<nucleus::SamReader> reader = std::move(
+      nucleus::SamReader::FromFile(bam, reader_options).ValueOrDie());
+  AlleleCounter allele_counter(ref.get(), region, {}, allele_counter_options);
+  for (const Read& read : nucleus::as_vector(reader->Query(region))) {
+    allele_counter.Add(read, "NA12878");
+  }
+  const multi_sample::VariantCaller caller(options);
+  const std::vector<int> expected = caller.CallPositionsFromAlleleCounts(
+      {{"NA12878", &allele_counter}}, "NA12878");
+  ASSERT_THAT(expected, Not(IsEmpty()));
+
+  std::unique_ptr<CandidatePreScanner> scanner = std::move(
+      CandidatePreScanner::Create(ref.get(), {bam}, "", reader_options,
+                                  allele_counter_options, options)
+          .ValueOrDie());
+  const std::vector<int> positions =
+      scanner->CandidatePositions(region).ValueOrDie();
+  EXPECT_THAT(expected, IsSubsetOf(positions));
+  EXPECT_TRUE(std::is_sorted(positions.begin(), positions.end()));
+}
+
+}  // namespace deepvariant
+}  // namespace genomics
+}  // namespace learning
@@ -28,12 +28,19 @@
 # POSSIBILITY OF SUCH DAMAGE.
 """Core functionality for step one of DeepVariant: Making examples."""
 
+import bisect
 import collections
+from concurrent import futures
+import fcntl
+import functools
+import heapq
 import itertools
 import json
 import os
+import queue
+import threading
 import time
-from typing import Any, Dict, Iterable, Iterator, List, Optional, Sequence, Tuple, Union
+from typing import Any, Callable, Dict, Iterable, Iterator, List, Optional, Sequence, Tuple, Union
 
 
 
@@ -60,6 +67,7 @@ from deepvariant.labeler import positional_labeler
 from deepvariant.labeler import variant_labeler
 from deepvariant.protos import deepvariant_pb2
 from deepvariant.python import allelecounter
+from deepvariant.python import candidate_prescan
 from deepvariant.python import direct_phasing
 from deepvariant.realigner import realigner
 from deepvariant.vendor import timer
@@ -77,21 +85,43 @@ from third_party.nucleus.util import ranges
 from third_party.nucleus.util import struct_utils
 from third_party.nucleus.util import utils
 from third_party.nucleus.util import variant_utils
+from third_party.nucleus.util.python import range_index
+from third_party.nucleus.util.python import tracing
 # pylint: disable=g-direct-tensorflow-import
 from tensorflow.core.example import example_pb2
 from tensorflow.python.lib.io import tf_record
 # pylint: enable=g-direct-tensorflow-import
 
+# Timers (in seconds) and counters recorded by the native tracing library
+# inside the stages above. They break the stages down, so they are not part of
+# any stage total.
+NATIVE_TRACE_TIMERS = (
+    'debruijn build',
+    'fast pass align reads',
+)
+NATIVE_TRACE_COUNTERS = (
+    'debruijn k tried',
+    'fast pass reads',
+    'ssw fallback reads',
+    'encoded read rows',
+    'reference cache hits',
+    'reference cache misses',
+)
+
 # For --runtime_by_region, these columns will be written out in this order.
 RUNTIME_BY_REGION_COLUMNS = (
-    'region',
-    'get reads',
-    'find candidates',
-    'make pileup images',
-    'write outputs',
-    'num reads',
-    'num candidates',
-    'num examples',
+    (
+        'region',
+        'get reads',
+        'find candidates',
+        'make pileup images',
+        'write outputs',
+        'num reads',
+        'num candidates',
+        'num examples',
+    )
+    + NATIVE_TRACE_TIMERS
+    + NATIVE_TRACE_COUNTERS
 )
 
 # For --read_phases_output, these columns will be written out in this order.
@@ -115,6 +145,27 @@ MAX_PARTITION_LEN = 1000000
 # Non DNA regions larger than this value are excluded from processing.
 MIN_NON_DNA_REGION = 300000
 
+# Columns of a --runtime_by_region file that add up to the runtime of a region.
+RUNTIME_STAGE_COLUMNS = (
+    'get reads',
+    'find candidates',
+    'make pileup images',
+    'write outputs',
+)
+
+# With cost balancing, regions estimated to cost more than this many times the
+# mean are split into equal pieces, so that no single region holds up a shard.
+MAX_REGION_COST_OVER_MEAN = 4.0
+
+# Heavy regions are not split into pieces smaller than this many bases.
+MIN_SPLIT_REGION_SIZE = 100
+
+# Examples are created and written in batches of the examples of whole
+# candidates, each holding at least this many examples unless it is the last
+# one of its region. With --output_queue_size, this is also how many records
+# are handed to the background writer at a time.
+OUTPUT_QUEUE_BATCH_SIZE = 128
+
 # ---------------------------------------------------------------------------
 # Selecting variants of specific types (e.g., SNPs)
 # ---------------------------------------------------------------------------
@@ -369,6 +420,17 @@ def trim_runtime(seconds: float) -> float:
   return round(seconds, 3)
 
 
+def native_runtimes(totals: Dict[str, float]) -> Dict[str, Any]:
+  """Formats the totals of a native trace region for --runtime_by_region."""
+  runtimes = {}
+  for name, value in totals.items():
+    if name in NATIVE_TRACE_COUNTERS:
+      runtimes[name] = int(value)
+    else:
+      runtimes[name] = trim_runtime(value)
+  return runtimes
+
+
 # ---------------------------------------------------------------------------
 # Utilities for working with labeling metrics
 #
@@ -531,6 +593,52 @@ def validate_reference_contig_coverage(
     )
 
 
+def attach_packed_reference(
+    fasta_path: str, packed_path: str
+) -> fasta.PackedFastaReader:
+  """Maps the packed reference at packed_path, packing fasta_path if needed.
+
+  Concurrent processes given the same packed_path pack the reference only once
+  between them: an exclusive lock on packed_path + '.lock' makes the others
+  wait for the first one, and the packed file only appears under packed_path
+  once it is complete. Every process then maps the same file, so they share
+  its pages instead of each holding and warming up its own reference.
+
+  Args:
+    fasta_path: Path to the indexed FASTA to pack.
+    packed_path: Local path of the packed reference, ending in
+      fasta.PACKED_REFERENCE_SUFFIX.
+
+  Returns:
+    A PackedFastaReader mapping packed_path.
+  """
+  if not os.path.exists(packed_path):
+    with open(packed_path + '.lock', 'w') as lock:
+      fcntl.flock(lock, fcntl.LOCK_EX)
+      if not os.path.exists(packed_path):
+        logging.info('Packing %s into %s', fasta_path, packed_path)
+        tmp_path = '{}.tmp-{}'.format(packed_path, os.getpid())
+        try:
+          fasta.PackedFastaReader(fasta_path).write(tmp_path)
+          os.replace(tmp_path, packed_path)
+        finally:
+          # Only left behind if packing failed.
+          if os.path.exists(tmp_path):
+            os.remove(tmp_path)
+  return fasta.PackedFastaReader(packed_path)
+
+
+def make_ref_reader(
+    options: deepvariant_pb2.MakeExamplesOptions,
+) -> genomics_reader.GenomicsReader:
+  """Opens the reference of options, through its packed copy if there is one."""
+  if options.packed_reference_filename:
+    return attach_packed_reference(
+        options.reference_filename, options.packed_reference_filename
+    )
+  return fasta.IndexedFastaReader(options.reference_filename)
+
+
 def find_ref_n_regions(
     ref_reader: genomics_reader.GenomicsReader, min_region_len: int
 ) -> List[range_pb2.Range]:
@@ -595,8 +703,12 @@ def build_calling_regions(
   Returns:
     A RangeSet.
   """
-  # Initially we are going to call everything in the reference.
-  regions = ranges.RangeSet.from_contigs(contigs)
+  # Initially we are going to call everything in the reference. The set
+  # operations run on RangeIndex, which reads BED files without building an
+  # intervaltree per interval.
+  regions = range_index.RangeIndex.from_ranges([
+      ranges.make_range(contig.name, 0, contig.n_bases) for contig in contigs
+  ])
 
   # If we provided a regions to include, intersect it with all of the regions,
   # producing a common set of regions between the reference and the provided
@@ -604,21 +716,22 @@ def build_calling_regions(
   contig_dict = ranges.contigs_dict(contigs)
   if regions_to_include:
     regions = regions.intersection(
-        ranges.RangeSet.from_regions(regions_to_include, contig_dict)
+        ranges.index_from_regions(regions_to_include, contig_dict)
     )
 
   if ref_n_regions:
-    regions.exclude_regions(ranges.RangeSet(ref_n_regions))
+    regions = regions.difference(
+        range_index.RangeIndex.from_ranges(list(ref_n_regions))
+    )
 
   # If we provided regions to exclude, intersect those with the existing calling
   # regions to further refine our set of contigs to process.
   if regions_to_exclude:
-    # exclude_regions mutates regions.
-    regions.exclude_regions(
-        ranges.RangeSet.from_regions(regions_to_exclude, contig_dict)
+    regions = regions.difference(
+        ranges.index_from_regions(regions_to_exclude, contig_dict)
     )
 
-  return regions
+  return ranges.RangeSet(regions.to_ranges(), contigs)
 
 
 def partition_by_candidates(
@@ -706,6 +819,178 @@ def partition_by_candidates(
   return partitioned
 
 
+def load_prior_runtimes(
+    filespec: str,
+) -> Dict[str, Tuple[List[int], List[int], List[float]]]:
+  """Loads the runtime of each region from --runtime_by_region files.
+
+  Args:
+    filespec: Path, possibly sharded (e.g. runtime@N.tsv), of the TSV files
+      written by an earlier run with --runtime_by_region.
+
+  Returns:
+    A dict from contig name to the (starts, ends, seconds) of its regions,
+    sorted by start. Regions from all shards are combined.
+  """
+  by_contig = collections.defaultdict(list)
+  for path in sharded_file_utils.maybe_generate_sharded_filenames(filespec):
+    with epath.Path(path).open('r') as f:
+      columns = f.readline().rstrip('\n').split('\t')
+      for line in f:
+        row = dict(zip(columns, line.rstrip('\n').split('\t')))
+        region = ranges.parse_literal(row['region'])
+        seconds = sum(
+            float(row[c])
+            for c in RUNTIME_STAGE_COLUMNS
+            if row.get(c, 'NA') != 'NA'
+        )
+        by_contig[region.reference_name].append(
+            (region.start, region.end, seconds)
+        )
+  prior_runtimes = {}
+  for contig, rows in by_contig.items():
+    rows.sort()
+    prior_runtimes[contig] = tuple(list(column) for column in zip(*rows))
+  return prior_runtimes
+
+
+def _prior_runtime_of_region(
+    region: range_pb2.Range,
+    prior_runtimes: Dict[str, Tuple[List[int], List[int], List[float]]],
+) -> Optional[float]:
+  """Returns the prior seconds overlapping region, or None if there are none.
+
+  The seconds of a prior region are attributed to region in proportion to how
+  many of its bases region overlaps.
+  """
+  if region.reference_name not in prior_runtimes:
+    return None
+  starts, ends, seconds = prior_runtimes[region.reference_name]
+  total = None
+  # Prior regions don't overlap each other, so their ends are sorted as well.
+  i = bisect.bisect_right(ends, region.start)
+  while i < len(starts) and starts[i] < region.end:
+    overlap = min(ends[i], region.end) - max(starts[i], region.start)
+    if overlap > 0:
+      total = (total or 0.0) + seconds[i] * overlap / (ends[i] - starts[i])
+    i += 1
+  return total
+
+
+def estimate_region_costs(
+    regions: List[range_pb2.Range],
+    reads_filenames: Sequence[str],
+    prior_runtimes: Optional[
+        Dict[str, Tuple[List[int], List[int], List[float]]]
+    ] = None,
+) -> List[float]:
+  """Estimates the relative cost of processing each of regions.
+
+  With prior_runtimes, the cost of a region is the runtime it took in that
+  earlier run; regions the earlier run didn't cover are charged its median
+  runtime per base. Otherwise the cost is the number of compressed bytes of
+  reads in the region according to the BAM indices, which tracks read depth.
+  If no index can be used (e.g. CRAM inputs), the cost is the region length.
+
+  Args:
+    regions: The regions to estimate.
+    reads_filenames: The reads files that will be processed for each region.
+    prior_runtimes: None or the result of load_prior_runtimes().
+
+  Returns:
+    A list of costs >= 0, one per region.
+  """
+  if prior_runtimes:
+    costs = [_prior_runtime_of_region(r, prior_runtimes) for r in regions]
+    rates = [
+        c / ranges.length(r)
+        for r, c in zip(regions, costs)
+        if c is not None and ranges.length(r) > 0
+    ]
+    rate = float(np.median(rates)) if rates else 0.0
+    return [
+        c if c is not None else rate * ranges.length(r)
+        for r, c in zip(regions, costs)
+    ]
+
+  costs = np.zeros(len(regions))
+  for reads_filename in reads_filenames:
+    try:
+      with sam.SamReader(reads_filename) as reader:
+        costs += np.array(reader.estimate_bytes(regions), dtype=np.float64)
+    except (AttributeError, ValueError) as e:
+      logging.warning(
+          'Cannot estimate region costs from the index of %s, using region '
+          'lengths instead: %s',
+          reads_filename,
+          e,
+      )
+      return [float(ranges.length(r)) for r in regions]
+  return costs.tolist()
+
+
+def split_heavy_regions(
+    regions: List[range_pb2.Range], costs: List[float]
+) -> Tuple[List[range_pb2.Range], List[float]]:
+  """Splits regions much costlier than the mean into equal pieces.
+
+  A region costing more than MAX_REGION_COST_OVER_MEAN times the mean cost is
+  split into as many equal pieces (of at least MIN_SPLIT_REGION_SIZE bases) as
+  needed to bring each piece under that limit, assuming its cost is spread
+  evenly over its bases.
+
+  Args:
+    regions: Regions in genomic order.
+    costs: The cost of each region.
+
+  Returns:
+    The split regions, still in genomic order, and their costs.
+  """
+  if not regions:
+    return regions, costs
+  max_cost = MAX_REGION_COST_OVER_MEAN * sum(costs) / len(regions)
+  split_regions = []
+  split_costs = []
+  for region, cost in zip(regions, costs):
+    n_pieces = 1
+    if max_cost > 0 and cost > max_cost:
+      n_pieces = min(
+          int(np.ceil(cost / max_cost)),
+          max(ranges.length(region) // MIN_SPLIT_REGION_SIZE, 1),
+      )
+    step = -(-ranges.length(region) // n_pieces)
+    for start in range(region.start, region.end, step):
+      end = min(start + step, region.end)
+      split_regions.append(
+          ranges.make_range(region.reference_name, start, end)
+      )
+      split_costs.append(cost * (end - start) / ranges.length(region))
+  return split_regions, split_costs
+
+
+def assign_regions_by_cost(costs: List[float], num_shards: int) -> List[int]:
+  """Assigns each region to a shard so that shard costs are balanced.
+
+  Regions are taken from the costliest down, each going to the shard with the
+  lowest total cost so far (ties go to the lowest shard). The result only
+  depends on costs, so every task computes the same assignment.
+
+  Args:
+    costs: The cost of each region.
+    num_shards: int > 0. The number of shards.
+
+  Returns:
+    The shard of each region.
+  """
+  shards = [0] * len(costs)
+  loads = [(0.0, shard) for shard in range(num_shards)]
+  for i in sorted(range(len(costs)), key=lambda i: (-costs[i], i)):
+    load, shard = heapq.heappop(loads)
+    shards[i] = shard
+    heapq.heappush(loads, (load + costs[i], shard))
+  return shards
+
+
 def regions_to_process(
     contigs: Sequence[reference_pb2.ContigInfo],
     partition_size: int,
@@ -713,6 +998,9 @@ def regions_to_process(
     task_id: Optional[int] = None,
     num_shards: Optional[int] = None,
     candidates: Optional[List[int]] = None,
+    region_costs: Optional[
+        Callable[[List[range_pb2.Range]], List[float]]
+    ] = None,
 ) -> Iterable[range_pb2.Range]:
   """Determines the regions to process and partitions them into pieces.
 
@@ -748,6 +1036,10 @@ def regions_to_process(
       subset of regions we want to process.
     candidates: numpy array of int32 containing candidate positions. If
       candidate is provided then partition_by_candidates logic is used.
+    region_costs: None or a function returning the estimated cost of each of
+      a list of regions. If provided, regions much costlier than the mean are
+      split further, and regions are assigned to shards so that the total cost
+      of every shard is about the same, rather than round-robin.
 
   Returns:
     An iterable of nucleus.genomics.v1.Range objects.
@@ -782,6 +1074,16 @@ def regions_to_process(
   else:
     partitioned = regions.partition(partition_size)
 
+  if region_costs is not None:
+    # Costing and shard assignment need to see the regions more than once.
+    partitioned = list(partitioned)
+    partitioned, costs = split_heavy_regions(
+        partitioned, region_costs(partitioned)
+    )
+    if num_shards:
+      shards = assign_regions_by_cost(costs, num_shards)
+      return (r for r, shard in zip(partitioned, shards) if shard == task_id)
+
   if num_shards:
     return (r for i, r in enumerate(partitioned) if i % num_shards == task_id)
   else:
@@ -880,7 +1182,7 @@ def filter_regions_by_vcf(
 
 def read_confident_regions(options):
   if options.confident_regions_filename:
-    return ranges.RangeSet.from_bed(options.confident_regions_filename)
+    return ranges.IndexedRangeSet.from_bed(options.confident_regions_filename)
   else:
     return None
 
@@ -1064,7 +1366,18 @@ class DiagnosticLogger:
 
 
 class OutputsWriter:
-  """Manages all of the outputs of make_examples in a single place."""
+  """Manages all of the outputs of make_examples in a single place.
+
+  If options.output_queue_size > 0, records are serialized and written by a
+  background thread. TFRecord writers compress without holding the GIL, so
+  compressing one batch of examples overlaps with creating the next one;
+  serialization still holds it. Records are passed to the thread in batches of
+  about OUTPUT_QUEUE_BATCH_SIZE through a queue of at most output_queue_size
+  batches, which blocks the caller when full and so bounds the memory held by
+  pending records. A single thread writes them, in the order the write_*
+  methods were called, so the outputs are identical to unqueued ones. Records
+  must not be modified after they are written.
+  """
 
   def __init__(self, options, suffix=None):
     outputs = [
@@ -1125,6 +1438,17 @@ class OutputsWriter:
       self._add_writer('sitelist', epath.Path(sitelist_fname).open('w'))
       writer = self._writers['sitelist']
 
+    self._queue = None
+    self._pending = []
+    self._n_pending_records = 0
+    self._background_error = None
+    if options.output_queue_size > 0:
+      self._queue = queue.Queue(maxsize=options.output_queue_size)
+      self._background_writer = threading.Thread(
+          target=self._write_in_background, daemon=True
+      )
+      self._background_writer.start()
+
   def _add_suffix(self, file_path, suffix):
     """Adds suffix to file name if a suffix is given."""
     if not suffix:
@@ -1171,14 +1495,15 @@ class OutputsWriter:
 
   def write_runtime(self, stats_dict: Dict[str, Any]):
     columns = [str(stats_dict.get(k, 'NA')) for k in RUNTIME_BY_REGION_COLUMNS]
-    writer = self._writers['runtime']
-    writer.write('\t'.join(columns) + '\n')
+    self._write_text('runtime', '\t'.join(columns) + '\n')
 
   def write_read_phase(self, read, phase, region_n):
-    writer = self._writers['read_phases']
-    if writer is not None:
+    if self._writers['read_phases'] is not None:
       read_key = read.fragment_name + '/' + str(read.read_number)
-      writer.write('\t'.join([read_key, str(phase), str(region_n)]) + '\n')
+      self._write_text(
+          'read_phases',
+          '\t'.join([read_key, str(phase), str(region_n)]) + '\n',
+      )
 
   def _add_writer(self, name: str, writer: tf_record.TFRecordWriter):
     if name not in self._writers:
@@ -1207,18 +1532,68 @@ class OutputsWriter:
   def _write(self, writer_name: str, *protos):
     writer = self._writers[writer_name]
     if writer:
-      for proto in protos:
-        writer.write(proto.SerializeToString())
+      if self._queue is None:
+        for proto in protos:
+          writer.write(proto.SerializeToString())
+      else:
+        self._enqueue(writer, protos, serialize=True)
 
   def _write_text(self, writer_name: str, line: str):
     writer = self._writers[writer_name]
     if writer:
-      writer.write(line)
+      if self._queue is None:
+        writer.write(line)
+      else:
+        self._enqueue(writer, (line,), serialize=False)
+
+  def _enqueue(self, writer, records, serialize: bool):
+    """Adds records to the pending batch, handing it over once it is full."""
+    self._pending.append((writer, records, serialize))
+    self._n_pending_records += len(records)
+    if self._n_pending_records >= OUTPUT_QUEUE_BATCH_SIZE:
+      self._flush()
+
+  def _flush(self):
+    """Hands the pending batch to the background writer."""
+    self._raise_background_error()
+    if self._pending:
+      self._queue.put(self._pending)
+      self._pending = []
+      self._n_pending_records = 0
+
+  def _raise_background_error(self):
+    if self._background_error is not None:
+      raise self._background_error
+
+  def _write_in_background(self):
+    """Writes batches from the queue until it gets None."""
+    while True:
+      batch = self._queue.get()
+      if batch is None:
+        return
+      # After a failure keep draining the queue, so the caller never blocks.
+      if self._background_error is not None:
+        continue
+      try:
+        for writer, records, serialize in batch:
+          for record in records:
+            writer.write(record.SerializeToString() if serialize else record)
+      except Exception as e:  # pylint: disable=broad-except
+        self._background_error = e
 
   def close_all(self):
+    if self._queue is not None:
+      if self._pending:
+        self._queue.put(self._pending)
+        self._pending = []
+        self._n_pending_records = 0
+      self._queue.put(None)
+      self._background_writer.join()
+      self._queue = None
     for writer in self._writers.values():
       if writer is not None:
         writer.close()
+    self._raise_background_error()
 
 
 class RegionProcessor:
@@ -1259,6 +1634,7 @@ class RegionProcessor:
     self.pic = None
     self.labeler = None
     self.population_vcf_readers = None
+    self.candidate_prescanner = None
     if self.options.phase_reads:
       # One instance of DirectPhasing per lifetime of make_examples.
       self.direct_phasing_cpp = self._make_direct_phasing_obj()
@@ -1333,6 +1709,10 @@ class RegionProcessor:
                 parse_aux_fields=self.options.parse_sam_aux_fields,
                 aux_fields_to_keep=self.options.aux_fields_to_keep,
                 hts_block_size=self.options.hts_block_size,
+                num_decompression_threads=self.options.hts_decompression_threads,
+                max_depth=self.options.reads_max_depth,
+                share_cram_reference=self.options.share_cram_reference,
+                read_cache_dir=self.options.reads_cache_dir,
                 downsample_fraction=downsample_fraction,
                 random_seed=self.options.random_seed,
                 use_original_base_quality_scores=self.options.use_original_quality_scores,
@@ -1340,12 +1720,46 @@ class RegionProcessor:
         )
     return readers
 
+  def _make_candidate_prescanner(
+      self,
+  ) -> candidate_prescan.CandidatePreScanner:
+    """Creates the native scanner of the main sample's reads.
+
+    The scanner opens its own readers with the same options as
+    _make_sam_readers, so that it sees exactly the same reads.
+
+    Returns:
+      A CandidatePreScanner over all reads of the main sample.
+    """
+    main_sample = self.samples[self.options.main_sample_index]
+    reader_options = reads_pb2.SamReaderOptions(
+        read_requirements=self.options.read_requirements,
+        hts_block_size=self.options.hts_block_size,
+        num_decompression_threads=self.options.hts_decompression_threads,
+        max_depth=self.options.reads_max_depth,
+        share_cram_reference=self.options.share_cram_reference,
+        downsample_fraction=main_sample.options.downsample_fraction,
+        random_seed=self.options.random_seed,
+        use_original_base_quality_scores=self.options.use_original_quality_scores,
+    )
+    cram_ref_path = (
+        self.options.reference_filename if self.options.use_ref_for_cram else ''
+    )
+    return candidate_prescan.CandidatePreScanner.create(
+        self.ref_reader.c_reader,
+        [f for f in main_sample.options.reads_filenames if f],
+        cram_ref_path,
+        reader_options,
+        self.options.allele_counter_options,
+        main_sample.options.variant_caller_options,
+    )
+
   def _initialize(self):
     """Initialize the resources needed for this work in the current env."""
     if self.initialized:
       raise ValueError('Cannot initialize this object twice')
 
-    self.ref_reader = fasta.IndexedFastaReader(self.options.reference_filename)
+    self.ref_reader = make_ref_reader(self.options)
 
     for sample in self.samples:
       sample.sam_readers = self._make_sam_readers(
@@ -1358,6 +1772,9 @@ class RegionProcessor:
           sample.options.proposed_variants_filename,
       )
 
+    if self.options.fast_candidate_prescan:
+      self.candidate_prescanner = self._make_candidate_prescanner()
+
     if self.options.use_allele_frequency:
       population_vcf_readers = allele_frequency.make_population_vcf_readers(
           self.options.population_vcf_filenames
@@ -1396,6 +1813,24 @@ class RegionProcessor:
     if not self.initialized:
       self._initialize()
 
+  def prefetch_reads(self, regions: Sequence[range_pb2.Range]):
+    """Starts loading reads for regions ahead of their processing.
+
+    Args:
+      regions: The regions this processor will process, in processing order.
+    """
+    for sample in self.samples:
+      if sample.sam_readers is None:
+        continue
+      sample.sam_readers = [
+          sam_reader.prefetch(
+              regions,
+              max_regions_ahead=self.options.reads_prefetch_regions,
+              max_buffered_bytes=self.options.reads_prefetch_max_bytes,
+          )
+          for sam_reader in sample.sam_readers
+      ]
+
   def _make_labeler_from_options(self):
     """Creates the labeler from options."""
     truth_vcf_reader = vcf.VcfReader(
@@ -1507,6 +1942,9 @@ class RegionProcessor:
     """
     before_make_pileup_images = time.time()
     example_shape = None
+    # Examples are written a batch of candidates at a time, so at most one
+    # batch of them is held here however many candidates the region has.
+    examples = []
     # Create A tf.Example proto, which includes the candidate variant, the
     # pileup image, and, if in training mode, the truth variants and labels
     # needed for training.
@@ -1535,15 +1973,15 @@ class RegionProcessor:
           self.add_label_to_example(
               example, label, denovo_label, denovo_enabled
           )
-          _write_example_and_update_stats(
+          _update_example_stats(
               example,
-              writer,
               runtimes,
               labels,
               labels_denovo,
               types,
               denovo_enabled,
           )
+          examples.append(example)
           n_stats['n_examples'] += 1
 
           if self.options.output_sitelist:
@@ -1551,6 +1989,9 @@ class RegionProcessor:
 
           if example_shape is None:
             example_shape = dv_utils.example_image_shape(example)
+        if len(examples) >= OUTPUT_QUEUE_BATCH_SIZE:
+          writer.write_examples(*examples)
+          examples = []
       if self.options.run_info_filename:
         n_stats['n_class_0'] += labels[0]
         n_stats['n_class_1'] += labels[1]
@@ -1566,7 +2007,8 @@ class RegionProcessor:
         for example in self.create_pileup_examples(
             candidate, sample_order=sample_order
         ):
-          _write_example_and_update_stats(example, writer, runtimes)
+          _update_example_stats(example, runtimes)
+          examples.append(example)
           n_stats['n_examples'] += 1
 
           if self.options.output_sitelist:
@@ -1574,6 +2016,11 @@ class RegionProcessor:
 
           if example_shape is None:
             example_shape = dv_utils.example_image_shape(example)
+        if len(examples) >= OUTPUT_QUEUE_BATCH_SIZE:
+          writer.write_examples(*examples)
+          examples = []
+    if examples:
+      writer.write_examples(*examples)
     runtimes['make pileup images'] = trim_runtime(
         time.time() - before_make_pileup_images
     )
@@ -1581,12 +2028,18 @@ class RegionProcessor:
 
   def find_candidate_positions(self, region: range_pb2.Range) -> Iterator[int]:
     """Finds all candidate positions within a given region."""
+    if self.candidate_prescanner is not None:
+      for pos in self.candidate_prescanner.candidate_positions(region):
+        yield pos
+      yield END_OF_PARTITION
+      return
+
     main_sample = self.samples[self.options.main_sample_index]
     for sample in self.samples:
       # TODO: Refactor this loop. It is used in other places.
-      reads = itertools.chain()
-      for _, sam_reader in enumerate(sample.sam_readers):
-        reads = itertools.chain(reads, sam_reader.query(region))
+      reads = itertools.chain.from_iterable(
+          sam_reader.query_batch([region]) for sam_reader in sample.sam_readers
+      )
       try:
         sample.in_memory_sam_reader.replace_reads(reads)
         sample.reads = sample.in_memory_sam_reader.query(region)
@@ -1719,11 +2172,7 @@ class RegionProcessor:
     # is only needed when phase_reads flag is on.
     region_padding_percent = self.options.phase_reads_region_padding_pct
     if self.options.phase_reads and region_padding_percent > 0:
-      contig_dict = ranges.contigs_dict(
-          fasta.IndexedFastaReader(
-              self.options.reference_filename
-          ).header.contigs
-      )
+      contig_dict = ranges.contigs_dict(self.ref_reader.header.contigs)
       # When candidate partitioning is used region size is variable. Therefore
       # we need to calculate the padding for each region.
       padding_fraction = int(
@@ -1800,10 +2249,12 @@ class RegionProcessor:
     if sam_readers is None:
       return []
 
-    # reads = itertools.chain([reader.query(region) for reader in sam_readers])
-    reads = itertools.chain()
-    for sam_reader in sam_readers:
-      reads = itertools.chain(reads, sam_reader.query(region))
+    # Each reader fetches and converts all of its reads for the region in a
+    # single native call. The generator keeps this lazy so that parsing errors
+    # surface inside the try block below.
+    reads = itertools.chain.from_iterable(
+        sam_reader.query_batch([region]) for sam_reader in sam_readers
+    )
 
     try:
       max_bases_to_cover = 0
@@ -2597,15 +3048,12 @@ def processing_regions_from_options(
         main_sample_options.candidate_positions
     )
 
-  ref_contigs = fasta.IndexedFastaReader(
-      options.reference_filename
-  ).header.contigs
+  ref_reader = make_ref_reader(options)
+  ref_contigs = ref_reader.header.contigs
 
   ref_n_regions = None
   if options.discard_non_dna_regions and not options.calling_regions:
-    ref_n_regions = find_ref_n_regions(
-        fasta.IndexedFastaReader(options.reference_filename), MIN_NON_DNA_REGION
-    )
+    ref_n_regions = find_ref_n_regions(ref_reader, MIN_NON_DNA_REGION)
 
   # Add in confident regions and vcf_contigs if in training mode.
   vcf_contigs = None
@@ -2652,6 +3100,21 @@ def processing_regions_from_options(
         'happens if you use "chr20" for a BAM where contig names '
         'don\'t have "chr"s (or vice versa).'
     )
+  region_costs = None
+  if options.balance_shards_by_cost:
+    prior_runtimes = None
+    if options.prior_runtime_by_region:
+      prior_runtimes = load_prior_runtimes(options.prior_runtime_by_region)
+    reads_filenames = [
+        reads_filename
+        for sample_options in options.sample_options
+        for reads_filename in sample_options.reads_filenames
+    ]
+    region_costs = functools.partial(
+        estimate_region_costs,
+        reads_filenames=reads_filenames,
+        prior_runtimes=prior_runtimes,
+    )
   regions = regions_to_process(
       contigs=contigs,
       partition_size=options.allele_counter_options.partition_size,
@@ -2659,6 +3122,7 @@ def processing_regions_from_options(
       task_id=options.task_id,
       num_shards=options.num_shards,
       candidates=candidate_positions,
+      region_costs=region_costs,
   )
 
   region_list = list(regions)
@@ -2700,17 +3164,15 @@ def processing_regions_from_options(
   return region_list, calling_regions
 
 
-def _write_example_and_update_stats(
+def _update_example_stats(
     example: example_pb2.Example,
-    writer: OutputsWriter,
     runtimes: Dict[str, float],
     labels: Optional[Dict[Union[int, None], int]] = None,
     labels_denovo: Optional[Dict[Union[int, None], int]] = None,
     types: Optional[Dict[dv_utils_using_clif.EncodedVariantType, int]] = None,
     denovo_enabled: bool = False,
 ):
-  """Writes out the example using writer; updates labels and types as needed."""
-  writer.write_examples(example)
+  """Counts the example in runtimes; updates labels and types as needed."""
   if runtimes:
     if 'num examples' not in runtimes:
       runtimes['num examples'] = 0
@@ -2730,14 +3192,185 @@ def _write_example_and_update_stats(
     types[example_type] += 1
 
 
+class SharedRegionQueue:
+  """Hands out regions, in order, to the workers of a single process.
+
+  Each worker takes the next region as soon as it is done with its previous
+  one, so the regions are balanced between workers by how long they actually
+  take rather than by their index. Every worker still sees its regions in
+  increasing order, which keeps each output shard sorted.
+  """
+
+  def __init__(self, regions: Iterable[range_pb2.Range]):
+    self._regions = iter(regions)
+    self._lock = threading.Lock()
+    self._closed = False
+
+  def __iter__(self):
+    return self
+
+  def __next__(self) -> range_pb2.Range:
+    with self._lock:
+      if self._closed:
+        raise StopIteration
+      return next(self._regions)
+
+  def close(self):
+    """Stops handing out regions, e.g. after one of the workers failed."""
+    with self._lock:
+      self._closed = True
+
+
+def worker_options(
+    options: deepvariant_pb2.MakeExamplesOptions, worker_id: int
+) -> deepvariant_pb2.MakeExamplesOptions:
+  """Returns the options of the worker writing shard worker_id of our outputs.
+
+  Args:
+    options: MakeExamplesOptions with num_workers > 0, whose output filenames
+      are unresolved filespecs such as foo@N.
+    worker_id: int in [0, num_workers).
+
+  Returns:
+    A copy of options that looks like the options of task worker_id of a
+    num_shards-way sharded run, with every output resolved to that shard.
+  """
+  worker = deepvariant_pb2.MakeExamplesOptions()
+  worker.CopyFrom(options)
+  worker.task_id = worker_id
+  (
+      _,
+      worker.examples_filename,
+      worker.candidates_filename,
+      worker.gvcf_filename,
+      worker.runtime_by_region,
+      worker.read_phases_output,
+      worker.trace_events_output,
+      worker.run_info_filename,
+  ) = sharded_file_utils.resolve_filespecs(
+      worker_id,
+      options.examples_filename,
+      options.candidates_filename,
+      options.gvcf_filename,
+      options.runtime_by_region,
+      options.read_phases_output,
+      options.trace_events_output,
+      options.run_info_filename,
+  )
+  return worker
+
+
 def make_examples_runner(options: deepvariant_pb2.MakeExamplesOptions):
   """Runs examples creation stage of deepvariant."""
   resource_monitor = resources.ResourceMonitor().start()
   before_initializing_inputs = time.time()
 
   logging_with_options(options, 'Preparing inputs')
-  regions, calling_regions = processing_regions_from_options(options)
+  if options.runtime_by_region or options.trace_events_output:
+    tracing.enable(bool(options.trace_events_output))
+
+  if options.num_workers > 0:
+    _make_examples_in_workers(
+        options, resource_monitor, before_initializing_inputs
+    )
+  else:
+    regions, calling_regions = processing_regions_from_options(options)
+    make_examples_in_regions(
+        options,
+        regions,
+        calling_regions,
+        resource_monitor,
+        before_initializing_inputs,
+    )
+    if options.trace_events_output:
+      tracing.write_chrome_trace(options.trace_events_output)
+  tracing.disable()
+
+
+def _make_examples_in_workers(
+    options: deepvariant_pb2.MakeExamplesOptions,
+    resource_monitor: resources.ResourceMonitor,
+    before_initializing_inputs: float,
+) -> None:
+  """Writes all num_workers shards of our outputs from worker threads.
+
+  The regions of all shards are computed once and handed out through a
+  SharedRegionQueue. Each worker has its own RegionProcessor (readers, allele
+  counters, realigner, pileup encoder) and its own OutputsWriter for its
+  shard. The native stages release the GIL, so workers overlap there.
 
+  Trace events are tagged with the id of the worker that recorded them, so a
+  sharded trace_events_output gets one trace per worker. An unsharded one gets
+  the events of all workers in one file.
+
+  Args:
+    options: MakeExamplesOptions with num_workers > 0.
+    resource_monitor: The started ResourceMonitor of this process.
+    before_initializing_inputs: time.time() when this run started.
+  """
+  all_regions_options = deepvariant_pb2.MakeExamplesOptions()
+  all_regions_options.CopyFrom(options)
+  all_regions_options.num_shards = 0
+  regions, calling_regions = processing_regions_from_options(
+      all_regions_options
+  )
+  logging_with_options(
+      options,
+      'Processing %d regions with %d workers'
+      % (len(regions), options.num_workers),
+  )
+  region_queue = SharedRegionQueue(regions)
+  workers = [worker_options(options, i) for i in range(options.num_workers)]
+
+  def run_worker(worker: deepvariant_pb2.MakeExamplesOptions):
+    # Trace thread ids are 1-based; 0 selects every thread.
+    tracing.set_thread_id(worker.task_id + 1)
+    try:
+      make_examples_in_regions(
+          worker,
+          region_queue,
+          calling_regions,
+          resource_monitor,
+          before_initializing_inputs,
+      )
+    except Exception:
+      # Don't let the other workers run to completion for nothing.
+      region_queue.close()
+      raise
+
+  with futures.ThreadPoolExecutor(max_workers=options.num_workers) as pool:
+    results = [pool.submit(run_worker, worker) for worker in workers]
+  for result in results:
+    result.result()
+
+  if not options.trace_events_output:
+    return
+  if sharded_file_utils.is_sharded_file_spec(options.trace_events_output):
+    for worker in workers:
+      tracing.write_chrome_trace(
+          worker.trace_events_output, thread_id=worker.task_id + 1
+      )
+  else:
+    tracing.write_chrome_trace(options.trace_events_output)
+
+
+def make_examples_in_regions(
+    options: deepvariant_pb2.MakeExamplesOptions,
+    regions: Iterable[range_pb2.Range],
+    calling_regions: Optional[ranges.RangeSet],
+    resource_monitor: resources.ResourceMonitor,
+    before_initializing_inputs: float,
+):
+  """Creates the examples of regions and writes all outputs of one shard.
+
+  Args:
+    options: MakeExamplesOptions whose outputs are resolved to a single shard.
+    regions: The regions to process, in increasing order.
+    calling_regions: The calling regions returned along with regions by
+      processing_regions_from_options.
+    resource_monitor: The started ResourceMonitor of this process.
+    before_initializing_inputs: time.time() when this run started.
+  """
   main_sample = options.sample_options[options.main_sample_index]
   mode_candidate_sweep = deepvariant_pb2.MakeExamplesOptions.CANDIDATE_SWEEP
   candidates_writer = None
@@ -2750,6 +3383,9 @@ def make_examples_runner(options: deepvariant_pb2.MakeExamplesOptions):
   # Create a processor to create candidates and examples for each region.
   region_processor = RegionProcessor(options)
   region_processor.initialize()
+  # Workers of a single process don't know their regions ahead of time.
+  if options.reads_prefetch_regions > 0 and options.num_workers == 0:
+    region_processor.prefetch_reads(regions)
 
   if options.candidates_filename:
     logging_with_options(
@@ -2834,6 +3470,7 @@ def make_examples_runner(options: deepvariant_pb2.MakeExamplesOptions):
           )
       continue
 
+    tracing.begin_region(ranges.to_literal(region))
     (candidates_by_sample, gvcfs_by_sample, runtimes) = (
         region_processor.process(region, region_n)
     )
@@ -2894,7 +3531,9 @@ def make_examples_runner(options: deepvariant_pb2.MakeExamplesOptions):
             ),
         )
         running_timer = timer.TimerStart()
+    native_totals = tracing.end_region()
     if options.runtime_by_region:
+      runtimes.update(native_runtimes(native_totals))
       # Runtimes are for all samples, so write this only once.
       writers_dict[options.sample_role_to_train].write_runtime(
           stats_dict=runtimes
@@ -30,6 +30,7 @@
 
 import copy
 import os
+import threading
 from unittest import mock
 
 
@@ -227,6 +228,19 @@ class MakeExamplesCoreUnitTest(parameterized.TestCase):
     # Our confident regions should be exactly those found in the BED file.
     self.assertCountEqual(expected, list(confident_regions))
 
+  def test_confident_regions_match_range_set(self):
+    options = deepvariant_pb2.MakeExamplesOptions(
+        confident_regions_filename=testdata.CONFIDENT_REGIONS_BED
+    )
+    confident_regions = make_examples_core.read_confident_regions(options)
+    range_set = ranges.RangeSet.from_bed(testdata.CONFIDENT_REGIONS_BED)
+    self.assertEqual(list(range_set), list(confident_regions))
+    for pos in range(10000800, 10010600, 7):
+      self.assertEqual(
+          range_set.overlaps('chr20', pos),
+          confident_regions.overlaps('chr20', pos),
+      )
+
   @flagsaver.flagsaver
   def test_gvcf_output_enabled_is_false_without_gvcf_flag(self):
     FLAGS.mode = 'training'
@@ -638,6 +652,25 @@ class MakeExamplesCoreUnitTest(parameterized.TestCase):
     )
     self.assertCountEqual(actual, _from_literals_list(expected))
 
+  def test_build_calling_regions_matches_range_set(self):
+    contigs = fasta.IndexedFastaReader(testdata.CHR20_FASTA).header.contigs
+    includes = [testdata.CONFIDENT_REGIONS_BED, 'chr20:10020001-10030000']
+    excludes = ['chr20:10001001-10003000', 'chr20:10025001-10026000']
+    ref_n_regions = _from_literals_list(['chr20:10009001-10009100'])
+    actual = make_examples_core.build_calling_regions(
+        contigs, includes, excludes, ref_n_regions
+    )
+
+    contig_dict = ranges.contigs_dict(contigs)
+    expected = ranges.RangeSet.from_contigs(contigs).intersection(
+        ranges.RangeSet.from_regions(includes, contig_dict)
+    )
+    expected.exclude_regions(ranges.RangeSet(ref_n_regions))
+    expected.exclude_regions(
+        ranges.RangeSet.from_regions(excludes, contig_dict)
+    )
+    self.assertEqual(list(expected), list(actual))
+
   def test_regions_to_process_sorted_within_contig(self):
     # These regions are out of order but within a single contig.
     contigs = _make_contigs([('z', 100)])
@@ -708,6 +741,254 @@ class MakeExamplesCoreUnitTest(parameterized.TestCase):
           num_shards=num_shards,
       )
 
+  def test_split_heavy_regions(self):
+    regions = [
+        ranges.make_range('1', i * 1000, (i + 1) * 1000) for i in range(10)
+    ]
+    costs = [1.0] * 9 + [100.0]
+    split_regions, split_costs = make_examples_core.split_heavy_regions(
+        regions, costs
+    )
+    # The mean cost is 10.9, so the last region is split into 3 pieces.
+    self.assertEqual(split_regions[:9], regions[:9])
+    self.assertEqual(
+        split_regions[9:],
+        [
+            ranges.make_range('1', 9000, 9334),
+            ranges.make_range('1', 9334, 9668),
+            ranges.make_range('1', 9668, 10000),
+        ],
+    )
+    self.assertAlmostEqual(sum(split_costs), sum(costs))
+
+  def test_assign_regions_by_cost(self):
+    costs = [5.0, 1.0, 1.0, 1.0, 1.0, 1.0, 4.0, 2.0]
+    shards = make_examples_core.assign_regions_by_cost(costs, 2)
+    loads = [0.0, 0.0]
+    for cost, shard in zip(costs, shards):
+      loads[shard] += cost
+    self.assertEqual(loads, [8.0, 8.0])
+    # Round-robin would have given shard 0 a cost of 11 and shard 1 of 5.
+    self.assertEqual(shards, make_examples_core.assign_regions_by_cost(costs, 2))
+
+  @parameterized.parameters(1, 2, 3, 4)
+  def test_regions_to_process_sharding_by_cost(self, num_shards):
+    def region_costs(regions):
+      # The first half of contig 'a' is 100 times deeper than the rest.
+      return [
+          100.0 if r.reference_name == 'a' and r.start == 0 else 1.0
+          for r in regions
+      ]
+
+    def get_regions(task_id, num_shards):
+      return list(
+          make_examples_core.regions_to_process(
+              contigs=_make_contigs([('z', 1000), ('a', 1000), ('n', 1000)]),
+              partition_size=500,
+              task_id=task_id,
+              num_shards=num_shards,
+              region_costs=region_costs,
+          )
+      )
+
+    unsharded_regions = get_regions(0, 0)
+    # The mean cost is 17.5, so the deep region is split in two.
+    self.assertLen(unsharded_regions, 7)
+    self.assertIn(ranges.make_range('a', 0, 250), unsharded_regions)
+    self.assertIn(ranges.make_range('a', 250, 500), unsharded_regions)
+    sharded_regions = []
+    for task_id in range(num_shards):
+      task_regions = get_regions(task_id, num_shards)
+      # Each shard is still in genomic order.
+      self.assertEqual(
+          task_regions,
+          [r for r in unsharded_regions if r in task_regions],
+      )
+      sharded_regions.extend(task_regions)
+    self.assertCountEqual(unsharded_regions, sharded_regions)
+
+  def test_estimate_region_costs_from_prior_runtimes(self):
+    runtimes = self.create_tempfile(
+        'runtime.tsv',
+        content=(
+            '\t'.join(make_examples_core.RUNTIME_BY_REGION_COLUMNS[:5])
+            + '\n1:1-1000\t0.5\t0.25\t0.25\tNA'
+            + '\n1:1001-2000\t1\t1\t1\t1\n'
+        ),
+    )
+    prior_runtimes = make_examples_core.load_prior_runtimes(
+        runtimes.full_path
+    )
+    costs = make_examples_core.estimate_region_costs(
+        [
+            ranges.make_range('1', 500, 1500),
+            ranges.make_range('1', 1000, 2000),
+            ranges.make_range('2', 0, 1000),
+        ],
+        reads_filenames=[],
+        prior_runtimes=prior_runtimes,
+    )
+    # Regions without a prior runtime are charged the median rate per base.
+    self.assertSequenceAlmostEqual(costs, [2.5, 4.0, 3.25])
+
+  def test_shared_region_queue_hands_out_each_region_once(self):
+    regions = list(
+        make_examples_core.regions_to_process(
+            contigs=_make_contigs([('z', 100), ('a', 100), ('n', 100)]),
+            partition_size=5,
+        )
+    )
+    queue = make_examples_core.SharedRegionQueue(regions)
+    taken = [[], [], []]
+
+    def take(worker_regions):
+      for region in queue:
+        worker_regions.append(region)
+
+    threads = [threading.Thread(target=take, args=(t,)) for t in taken]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+
+    self.assertCountEqual(regions, [r for t in taken for r in t])
+    # Each worker sees its regions in processing order.
+    for worker_regions in taken:
+      indices = [regions.index(r) for r in worker_regions]
+      self.assertEqual(indices, sorted(indices))
+
+  def test_shared_region_queue_close(self):
+    queue = make_examples_core.SharedRegionQueue(
+        [ranges.make_range('1', 0, 10), ranges.make_range('1', 10, 20)]
+    )
+    self.assertEqual(next(queue), ranges.make_range('1', 0, 10))
+    queue.close()
+    self.assertEqual(list(queue), [])
+
+  def test_worker_options(self):
+    options = deepvariant_pb2.MakeExamplesOptions(
+        examples_filename='/tmp/examples.tfrecord@3.gz',
+        gvcf_filename='/tmp/gvcf.tfrecord@3.gz',
+        runtime_by_region='/tmp/runtime@3.tsv',
+        run_info_filename='/tmp/examples.tfrecord@3.gz.run_info.pbtxt',
+        num_shards=3,
+        num_workers=3,
+    )
+    worker = make_examples_core.worker_options(options, 1)
+    self.assertEqual(worker.task_id, 1)
+    self.assertEqual(worker.num_shards, 3)
+    self.assertEqual(
+        worker.examples_filename, '/tmp/examples.tfrecord-00001-of-00003.gz'
+    )
+    self.assertEqual(
+        worker.gvcf_filename, '/tmp/gvcf.tfrecord-00001-of-00003.gz'
+    )
+    self.assertEqual(worker.runtime_by_region, '/tmp/runtime-00001-of-00003.tsv')
+    self.assertEqual(
+        worker.run_info_filename,
+        '/tmp/examples.tfrecord-00001-of-00003.gz.run_info.pbtxt',
+    )
+    self.assertEqual(worker.candidates_filename, '')
+    # The original options are left unresolved for the other workers.
+    self.assertEqual(options.examples_filename, '/tmp/examples.tfrecord@3.gz')
+
+  def _write_outputs(self, name, output_queue_size):
+    """Writes a fixed set of records with an OutputsWriter, returns paths."""
+    tmp_dir = self.create_tempdir(name).full_path
+    options = deepvariant_pb2.MakeExamplesOptions(
+        examples_filename=os.path.join(tmp_dir, 'examples.tfrecord'),
+        candidates_filename=os.path.join(tmp_dir, 'candidates.tfrecord'),
+        runtime_by_region=os.path.join(tmp_dir, 'runtime.tsv'),
+        output_queue_size=output_queue_size,
+    )
+    writer = make_examples_core.OutputsWriter(options)
+    n_records = 2 * make_examples_core.OUTPUT_QUEUE_BATCH_SIZE + 3
+    for i in range(n_records):
+      writer.write_examples(
+          variants_pb2.Variant(reference_name='chr1', start=i),
+          variants_pb2.Variant(reference_name='chr2', start=i),
+      )
+      writer.write_candidates(
+          deepvariant_pb2.DeepVariantCall(
+              variant=variants_pb2.Variant(start=i)
+          )
+      )
+      writer.write_runtime({'region': 'chr1:{}'.format(i)})
+    writer.close_all()
+    return [
+        options.examples_filename,
+        options.candidates_filename,
+        options.runtime_by_region,
+    ]
+
+  def test_outputs_writer_with_queue_writes_the_same_outputs(self):
+    expected = self._write_outputs('unqueued', output_queue_size=0)
+    actual = self._write_outputs('queued', output_queue_size=2)
+    for expected_path, actual_path in zip(expected, actual):
+      with open(expected_path, 'rb') as f:
+        expected_bytes = f.read()
+      with open(actual_path, 'rb') as f:
+        self.assertEqual(f.read(), expected_bytes)
+
+  def test_outputs_writer_with_queue_raises_write_errors(self):
+    options = deepvariant_pb2.MakeExamplesOptions(
+        examples_filename=test_utils.test_tmpfile('failing.tfrecord'),
+        output_queue_size=1,
+    )
+    writer = make_examples_core.OutputsWriter(options)
+    failing = mock.MagicMock()
+    failing.write.side_effect = IOError('disk full')
+    writer._writers['examples'] = failing
+    for i in range(3 * make_examples_core.OUTPUT_QUEUE_BATCH_SIZE):
+      try:
+        writer.write_examples(variants_pb2.Variant(start=i))
+      except IOError:
+        break
+    with self.assertRaisesRegex(IOError, 'disk full'):
+      writer.close_all()
+
+  def test_make_ref_reader_attaches_to_packed_reference(self):
+    packed_path = test_utils.test_tmpfile('attach.nucpack')
+    options = deepvariant_pb2.MakeExamplesOptions(
+        reference_filename=testdata.CHR20_FASTA,
+        packed_reference_filename=packed_path,
+    )
+    region = ranges.parse_literal('chr20:10,000,000-10,000,100')
+    expected = fasta.IndexedFastaReader(testdata.CHR20_FASTA).query(region)
+
+    # The first reader packs the reference.
+    self.assertFalse(os.path.exists(packed_path))
+    first = make_examples_core.make_ref_reader(options)
+    self.assertTrue(os.path.exists(packed_path))
+    self.assertEqual(first.query(region), expected)
+
+    # Later ones only map it.
+    with mock.patch.object(fasta.PackedFastaReader, 'write') as mock_write:
+      second = make_examples_core.make_ref_reader(options)
+      mock_write.assert_not_called()
+    self.assertEqual(second.query(region), expected)
+    self.assertEqual(second.header.contigs, first.header.contigs)
+
+  def test_attach_packed_reference_removes_partial_file_on_error(self):
+    packed_path = test_utils.test_tmpfile('failed.nucpack')
+
+    def write_partially(tmp_path):
+      with open(tmp_path, 'wb') as f:
+        f.write(b'partial')
+      raise IOError('disk full')
+
+    with mock.patch.object(
+        fasta.PackedFastaReader, 'write', side_effect=write_partially
+    ):
+      with self.assertRaisesRegex(IOError, 'disk full'):
+        make_examples_core.attach_packed_reference(
+            testdata.CHR20_FASTA, packed_path
+        )
+    self.assertFalse(os.path.exists(packed_path))
+    self.assertFalse(
+        os.path.exists('{}.tmp-{}'.format(packed_path, os.getpid()))
+    )
+
   @parameterized.parameters(
       # Fetch all positions
       (['chr20:1-20000000'], 221),
@@ -1102,7 +1383,7 @@ class RegionProcessorTest(parameterized.TestCase):
 
     main_sample = self.processor.samples[0]
     main_sample.sam_readers = [mock.Mock()]
-    main_sample.sam_readers[0].query.return_value = []
+    main_sample.sam_readers[0].query_batch.return_value = []
 
     c1, c2 = mock.Mock(), mock.Mock()
     self.add_mock(
@@ -1114,7 +1395,9 @@ class RegionProcessorTest(parameterized.TestCase):
     self.assertEqual(candidates['main_sample'], [c1, c2])
     self.assertEmpty(gvcfs['main_sample'])
     self.assertIsInstance(runtimes, dict)
-    main_sample.sam_readers[0].query.assert_called_once_with(self.region)
+    main_sample.sam_readers[0].query_batch.assert_called_once_with(
+        [self.region]
+    )
     self.processor.realigner.realign_reads.assert_called_once_with(
         [], self.region
     )
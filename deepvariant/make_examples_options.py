@@ -40,6 +40,7 @@ from deepvariant import pileup_image
 from deepvariant.protos import deepvariant_pb2
 from deepvariant.realigner import realigner
 from tensorflow.python.platform import gfile
+from third_party.nucleus.io import fasta
 from third_party.nucleus.io import sharded_file_utils
 from third_party.nucleus.io.python import hts_verbose
 from third_party.nucleus.protos import reads_pb2
@@ -76,6 +77,17 @@ flags.DEFINE_string(
         ' reference used to align the BAM file provided to --reads.'
     ),
 )
+flags.DEFINE_string(
+    'packed_reference',
+    None,
+    (
+        'Optional. Local path, ending in .nucpack, of a 2-bit packed copy of'
+        ' --ref shared by all make_examples processes on this machine. The'
+        ' first process to start packs --ref into it and the others wait for'
+        ' it; every process then maps the file instead of opening --ref, so'
+        ' they share one copy of the reference in memory.'
+    ),
+)
 flags.DEFINE_bool(
     'use_ref_for_cram',
     True,
@@ -110,6 +122,18 @@ flags.DEFINE_string(
         '         with the mode set to calling.'
     ),
 )
+flags.DEFINE_bool(
+    'fast_candidate_prescan',
+    False,
+    (
+        'If True, --mode=candidate_sweep finds candidate positions by comparing'
+        ' the raw reads to the reference natively instead of counting alleles.'
+        ' This is several times faster and finds a superset of the positions,'
+        ' since indels are only counted by position, not by sequence. Only'
+        ' supported for a single sample, without --normalize_reads and'
+        ' without --vsc_fraction_reference_sites_to_emit.'
+    ),
+)
 flags.DEFINE_string(
     'regions',
     '',
@@ -181,6 +205,50 @@ flags.DEFINE_string(
     ),
 )
 flags.DEFINE_integer('task', 0, 'Task ID of this task')
+flags.DEFINE_bool(
+    'balance_shards_by_cost',
+    False,
+    (
+        'If True, regions are assigned to shards so that every shard gets about'
+        ' the same estimated work, instead of round-robin, and regions that'
+        ' look much costlier than average (e.g. high-depth repeats) are split'
+        ' further. Costs are estimated from the BAM indices, or from'
+        ' --prior_runtime_by_region if set. Not supported with'
+        ' --mode=candidate_sweep.'
+    ),
+)
+flags.DEFINE_string(
+    'prior_runtime_by_region',
+    None,
+    (
+        '[optional] Path, possibly sharded, to the --runtime_by_region output'
+        ' of an earlier run over the same inputs. With'
+        ' --balance_shards_by_cost, region costs are taken from its runtimes.'
+    ),
+)
+flags.DEFINE_integer(
+    'output_queue_size',
+    0,
+    (
+        'If > 0, examples, candidates and the other outputs are serialized and'
+        ' written on a background thread, which receives them in batches'
+        ' through a queue holding at most this many batches. This overlaps'
+        ' compressing and writing outputs with creating the next examples'
+        ' while bounding the memory held by pending outputs. The outputs are'
+        ' identical either way.'
+    ),
+)
+flags.DEFINE_integer(
+    'num_workers',
+    0,
+    (
+        'If > 0, this one process writes all shards of the sharded outputs'
+        ' (e.g. --examples=foo@N) with this many worker threads, instead of'
+        ' running N processes with --task=0..N-1. Workers pull regions from a'
+        ' shared queue, so a slow region does not hold up the whole shard.'
+        ' Must equal the number of shards N. --task is ignored.'
+    ),
+)
 flags.DEFINE_integer(
     'partition_size',
     1000,
@@ -197,6 +265,16 @@ flags.DEFINE_integer(
         'following processing such as sampling and realigner.'
     ),
 )
+flags.DEFINE_integer(
+    'reads_max_depth',
+    0,
+    (
+        'If > 0, reads are downsampled as they are read from disk so that'
+        ' the average depth of any 100bp window does not exceed this value.'
+        ' The sampling is deterministic and avoids loading all reads of'
+        ' extremely deep regions. 0 disables the cap.'
+    ),
+)
 _MAX_READS_FOR_DYNAMIC_BASES_PER_REGION = flags.DEFINE_integer(
     'max_reads_for_dynamic_bases_per_region',
     0,
@@ -263,6 +341,54 @@ flags.DEFINE_integer(
         ' files. Currently only applies to SAM/BAM reading.'
     ),
 )
+flags.DEFINE_integer(
+    'hts_decompression_threads',
+    0,
+    (
+        'Number of htslib threads used to decompress BAM and decode CRAM'
+        ' inputs. A single pool of this size is shared by all input files.'
+        ' Zero or negative decodes on the main thread.'
+    ),
+)
+flags.DEFINE_bool(
+    'share_cram_reference',
+    False,
+    (
+        'If True, all CRAM inputs decoded with --ref share a single in-memory'
+        ' copy of the reference sequences, instead of each input loading'
+        ' its own. Only has an effect with --use_ref_for_cram.'
+    ),
+)
+flags.DEFINE_string(
+    'reads_cache_dir',
+    '',
+    (
+        'If set, an existing local directory in which the filtered reads are'
+        ' cached in fixed genomic bins. Later runs over the same reads files'
+        ' with the same read options load reads from this cache instead of'
+        ' decoding them again, even if they partition the regions'
+        ' differently. Not used with --downsample_fraction or'
+        ' --reads_max_depth.'
+    ),
+)
+flags.DEFINE_integer(
+    'reads_prefetch_regions',
+    0,
+    (
+        'If > 0, reads for up to this many upcoming regions are loaded in a'
+        ' background thread while the current region is processed. This hides'
+        ' read I/O latency and does not change the output. Not used with'
+        ' --downsample_fraction.'
+    ),
+)
+flags.DEFINE_integer(
+    'reads_prefetch_max_mb',
+    0,
+    (
+        'Soft cap, in megabytes, on the memory used by prefetched reads. Zero'
+        ' or negative means only --reads_prefetch_regions limits prefetching.'
+    ),
+)
 flags.DEFINE_integer(
     'min_base_quality',
     10,
@@ -518,6 +644,19 @@ flags.DEFINE_string(
         ' same number of shards as the examples.'
     ),
 )
+flags.DEFINE_string(
+    'trace_events_output',
+    None,
+    (
+        '[optional] Output filename for a Chrome trace-event JSON file of the'
+        ' native stages (realignment, pileup encoding, reference reads) timed'
+        ' in each region. Open it in chrome://tracing or Perfetto. If examples'
+        ' are sharded, this should be sharded into the same number of shards'
+        ' as the examples. With --num_workers, each shard holds the events of'
+        ' the worker that wrote the matching examples shard; an unsharded'
+        ' filename gets the events of all workers, one track per worker.'
+    ),
+)
 flags.DEFINE_bool(
     'track_ref_reads',
     False,
@@ -659,6 +798,8 @@ def shared_flags_to_options(
 
     if flags_obj.ref:
       options.reference_filename = flags_obj.ref
+    if flags_obj.packed_reference:
+      options.packed_reference_filename = flags_obj.packed_reference
     if flags_obj.confident_regions:
       options.confident_regions_filename = flags_obj.confident_regions
     if flags_obj.denovo_regions:
@@ -727,6 +868,14 @@ def shared_flags_to_options(
               errors.CommandLineError,
           )
 
+    output_filespecs = (
+        flags_obj.examples or '',
+        flags_obj.candidates or '',
+        flags_obj.gvcf or '',
+        flags_obj.runtime_by_region or '',
+        flags_obj.output_local_read_phasing or '',
+        flags_obj.trace_events_output or '',
+    )
     (
         num_shards,
         examples,
@@ -734,21 +883,34 @@ def shared_flags_to_options(
         gvcf,
         runtime_by_region,
         read_phases_output,
+        trace_events_output,
     ) = sharded_file_utils.resolve_filespecs(
-        flags_obj.task,
-        flags_obj.examples or '',
-        flags_obj.candidates or '',
-        flags_obj.gvcf or '',
-        flags_obj.runtime_by_region or '',
-        flags_obj.output_local_read_phasing or '',
+        0 if flags_obj.num_workers > 0 else flags_obj.task, *output_filespecs
     )
+    if flags_obj.num_workers > 0:
+      # Each worker resolves the filespecs for the shard it writes.
+      (
+          examples,
+          candidates,
+          gvcf,
+          runtime_by_region,
+          read_phases_output,
+          trace_events_output,
+      ) = output_filespecs
     options.examples_filename = examples
     options.candidates_filename = candidates
     options.gvcf_filename = gvcf
     options.include_med_dp = flags_obj.include_med_dp
-    options.task_id = flags_obj.task
+    options.task_id = 0 if flags_obj.num_workers > 0 else flags_obj.task
     options.num_shards = num_shards
+    options.num_workers = max(flags_obj.num_workers, 0)
+    options.balance_shards_by_cost = flags_obj.balance_shards_by_cost
+    options.fast_candidate_prescan = flags_obj.fast_candidate_prescan
+    options.output_queue_size = max(flags_obj.output_queue_size, 0)
+    if flags_obj.prior_runtime_by_region:
+      options.prior_runtime_by_region = flags_obj.prior_runtime_by_region
     options.runtime_by_region = runtime_by_region
+    options.trace_events_output = trace_events_output
     options.read_phases_output = read_phases_output
 
     options.parse_sam_aux_fields = make_examples_core.resolve_sam_aux_fields(
@@ -832,6 +994,14 @@ def shared_flags_to_options(
     )
     options.use_ref_for_cram = flags_obj.use_ref_for_cram
     options.hts_block_size = flags_obj.hts_block_size
+    options.hts_decompression_threads = flags_obj.hts_decompression_threads
+    options.share_cram_reference = flags_obj.share_cram_reference
+    options.reads_cache_dir = flags_obj.reads_cache_dir
+    options.reads_max_depth = flags_obj.reads_max_depth
+    options.reads_prefetch_regions = flags_obj.reads_prefetch_regions
+    options.reads_prefetch_max_bytes = flags_obj.reads_prefetch_max_mb * (
+        1024 * 1024
+    )
     options.logging_every_n_candidates = flags_obj.logging_every_n_candidates
     options.customized_classes_labeler_classes_list = (
         flags_obj.customized_classes_labeler_classes_list
@@ -870,6 +1040,67 @@ def check_options_are_valid(
   if not main_sample.reads_filenames:
     errors.log_and_raise('reads argument is required.', errors.CommandLineError)
 
+  if options.num_workers > 0:
+    if options.num_workers != options.num_shards:
+      errors.log_and_raise(
+          '--num_workers={} must equal the number of shards in --examples, '
+          'got {}.'.format(options.num_workers, options.num_shards),
+          errors.CommandLineError,
+      )
+    if make_examples_core.in_candidate_sweep_mode(options):
+      errors.log_and_raise(
+          '--num_workers is not supported in candidate_sweep mode, which '
+          'needs each shard to cover a fixed set of regions.',
+          errors.CommandLineError,
+      )
+
+  if options.balance_shards_by_cost and (
+      make_examples_core.in_candidate_sweep_mode(options)
+  ):
+    errors.log_and_raise(
+        '--balance_shards_by_cost is not supported in candidate_sweep mode, '
+        'whose outputs are merged assuming round-robin shards.',
+        errors.CommandLineError,
+    )
+  if options.prior_runtime_by_region and not options.balance_shards_by_cost:
+    errors.log_and_raise(
+        '--prior_runtime_by_region requires --balance_shards_by_cost.',
+        errors.CommandLineError,
+    )
+
+  if options.packed_reference_filename and not (
+      options.packed_reference_filename.endswith(fasta.PACKED_REFERENCE_SUFFIX)
+  ):
+    errors.log_and_raise(
+        '--packed_reference must end with {}, got {}.'.format(
+            fasta.PACKED_REFERENCE_SUFFIX, options.packed_reference_filename
+        ),
+        errors.CommandLineError,
+    )
+
+  if options.fast_candidate_prescan:
+    if not make_examples_core.in_candidate_sweep_mode(options):
+      errors.log_and_raise(
+          '--fast_candidate_prescan requires --mode=candidate_sweep.',
+          errors.CommandLineError,
+      )
+    if len(options.sample_options) != 1:
+      errors.log_and_raise(
+          '--fast_candidate_prescan only supports a single sample.',
+          errors.CommandLineError,
+      )
+    if options.allele_counter_options.normalize_reads:
+      errors.log_and_raise(
+          '--fast_candidate_prescan is incompatible with --normalize_reads.',
+          errors.CommandLineError,
+      )
+    if main_sample.variant_caller_options.fraction_reference_sites_to_emit > 0:
+      errors.log_and_raise(
+          '--fast_candidate_prescan is incompatible with '
+          '--vsc_fraction_reference_sites_to_emit.',
+          errors.CommandLineError,
+      )
+
   if make_examples_core.in_candidate_sweep_mode(options):
     # In candidate_sweep mode there is nothing to check here.
     pass
@@ -305,6 +305,34 @@ class MakeExamplesEnd2EndTest(parameterized.TestCase):
       )
       self.assertLen(examples2, expected_len_examples2)
 
+  @flagsaver.flagsaver
+  def test_make_examples_fast_candidate_prescan(self):
+    region = ranges.parse_literal('chr20:10,000,000-10,010,000')
+    FLAGS.ref = testdata.CHR20_FASTA
+    FLAGS.reads = testdata.CHR20_BAM
+    FLAGS.examples = test_utils.test_tmpfile('prescan.examples.tfrecord')
+    FLAGS.candidate_positions = test_utils.test_tmpfile(
+        'prescan.candidate_positions'
+    )
+    FLAGS.regions = [ranges.to_literal(region)]
+    FLAGS.partition_size = 1000
+    FLAGS.mode = 'candidate_sweep'
+    FLAGS.fast_candidate_prescan = True
+    options = make_examples.default_options(add_flags=True)
+    make_examples_core.make_examples_runner(options)
+
+    with epath.Path(FLAGS.candidate_positions).open('rb') as f:
+      positions = np.frombuffer(f.read(), dtype=np.int32)
+    with epath.Path(testdata.GOLDEN_CANDIDATE_POSITIONS).open('rb') as f:
+      golden = np.frombuffer(f.read(), dtype=np.int32)
+    # The pre-scan finds a superset of the allele counter's positions, in the
+    # same partitions.
+    self.assertContainsSubset(golden[golden >= 0], positions[positions >= 0])
+    self.assertEqual(
+        np.count_nonzero(positions == make_examples_core.END_OF_PARTITION),
+        np.count_nonzero(golden == make_examples_core.END_OF_PARTITION),
+    )
+
   # Golden sets are created with learning/genomics/internal/create_golden.sh
   @parameterized.parameters(
       # All tests are run with fast_pass_aligner enabled. There are no
@@ -793,6 +821,14 @@ class MakeExamplesEnd2EndTest(parameterized.TestCase):
         'num reads',
         'num candidates',
         'num examples',
+        'debruijn build',
+        'fast pass align reads',
+        'debruijn k tried',
+        'fast pass reads',
+        'ssw fallback reads',
+        'encoded read rows',
+        'reference cache hits',
+        'reference cache misses',
     ]
 
     with gfile.Open(expected_output_path, 'r') as fin:
@@ -806,6 +842,40 @@ class MakeExamplesEnd2EndTest(parameterized.TestCase):
       self.assertGreater(int(one_row[5]), 0, msg='num reads > 0')
       self.assertGreater(int(one_row[6]), 0, msg='num candidates > 0')
       self.assertGreater(int(one_row[7]), 0, msg='num examples > 0')
+      # Every example encodes at least one read row natively.
+      self.assertGreater(
+          int(one_row[column_names.index('encoded read rows')]),
+          0,
+          msg='encoded read rows > 0',
+      )
+
+  @flagsaver.flagsaver
+  def test_make_examples_trace_events_per_worker(self):
+    region = ranges.parse_literal('chr20:10,000,000-10,010,000')
+    FLAGS.ref = testdata.CHR20_FASTA
+    FLAGS.reads = testdata.CHR20_BAM
+    FLAGS.regions = [ranges.to_literal(region)]
+    FLAGS.mode = 'calling'
+    num_workers = 2
+    FLAGS.examples = test_utils.test_tmpfile(
+        _sharded('worker_examples.tfrecord', num_workers)
+    )
+    FLAGS.trace_events_output = test_utils.test_tmpfile(
+        _sharded('trace.json', num_workers)
+    )
+    FLAGS.num_workers = num_workers
+    options = make_examples.default_options(add_flags=True)
+    make_examples_core.make_examples_runner(options)
+
+    # Each worker's shard holds only the events of that worker, whose trace
+    # thread id is its task id + 1.
+    paths = sharded_file_utils.generate_sharded_filenames(
+        FLAGS.trace_events_output
+    )
+    for task_id, path in enumerate(paths):
+      with gfile.Open(path, 'r') as fin:
+        events = json.load(fin)['traceEvents']
+      self.assertLessEqual({event['tid'] for event in events}, {task_id + 1})
 
   @parameterized.parameters(
       dict(select_types=None, expected_count=78),
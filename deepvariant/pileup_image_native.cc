@@ -46,6 +46,7 @@
 #include "third_party/nucleus/protos/reads.pb.h"
 #include "third_party/nucleus/protos/struct.pb.h"
 #include "third_party/nucleus/protos/variants.pb.h"
+#include "third_party/nucleus/util/tracing.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 
@@ -468,6 +469,7 @@ std::unique_ptr<ImageRow> PileupImageEncoderNative::EncodeRead(
     }
   }
 
+  nucleus::TraceCount("encoded read rows");
   return std::make_unique<ImageRow>(img_row);
 }
 
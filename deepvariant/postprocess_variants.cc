@@ -39,12 +39,13 @@
 #include <vector>
 
 #include "deepvariant/protos/deepvariant.pb.h"
+#include "absl/strings/string_view.h"
+#include "third_party/nucleus/io/tfrecord_reader.h"
 #include "third_party/nucleus/protos/reference.pb.h"
 #include "third_party/nucleus/protos/variants.pb.h"
 #include "third_party/nucleus/util/utils.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/io/compression.h"
-#include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/record_writer.h"
 
 namespace learning {
@@ -53,6 +54,9 @@ namespace deepvariant {
 
 namespace {
 
+// Number of CallVariantsOutput records read from a TFRecord at a time.
+constexpr int kReadBatchSize = 1024;
+
 void SortSingleSiteCalls(
     const std::vector<nucleus::genomics::v1::ContigInfo>& contigs,
     std::vector<CallVariantsOutput>* calls) {
@@ -78,27 +82,27 @@ std::uint64_t ProcessSingleSiteCallTfRecords(
     const std::vector<std::string>& tfrecord_paths,
     const string& output_tfrecord_path) {
   std::vector<CallVariantsOutput> single_site_calls;
-  tensorflow::Env* env = tensorflow::Env::Default();
   for (const string& tfrecord_path : tfrecord_paths) {
-    std::unique_ptr<tensorflow::RandomAccessFile> read_file;
-    TF_CHECK_OK(env->NewRandomAccessFile(tfrecord_path, &read_file));
     const char* const option = nucleus::EndsWith(tfrecord_path, ".gz")
                                    ? tensorflow::io::compression::kGzip
                                    : tensorflow::io::compression::kNone;
-    tensorflow::io::RecordReader reader(
-        read_file.get(),
-        tensorflow::io::RecordReaderOptions::CreateRecordReaderOptions(option));
+    std::unique_ptr<nucleus::TFRecordReader> reader =
+        nucleus::TFRecordReader::New(tfrecord_path, option);
+    QCHECK(reader != nullptr) << "Failed to open " << tfrecord_path;
 
-    std::uint64_t offset = 0;
-    tensorflow::tstring data;
     LOG(INFO) << "Read from: " << tfrecord_path;
-    while (reader.ReadRecord(&offset, &data).ok()) {
-      CallVariantsOutput single_site_call;
-      QCHECK(single_site_call.ParseFromArray(data.data(), data.length()))
-          << "Failed to parse CallVariantsOutput";
-      // Here we assume each variant has only 1 call.
-      QCHECK_EQ(single_site_call.variant().calls_size(), 1);
-      single_site_calls.push_back(single_site_call);
+    // Parse straight out of the reader's buffers, a batch at a time.
+    for (std::vector<absl::string_view> batch =
+             reader->ReadBatch(kReadBatchSize);
+         !batch.empty(); batch = reader->ReadBatch(kReadBatchSize)) {
+      for (absl::string_view data : batch) {
+        CallVariantsOutput& single_site_call =
+            single_site_calls.emplace_back();
+        QCHECK(single_site_call.ParseFromArray(data.data(), data.length()))
+            << "Failed to parse CallVariantsOutput";
+        // Here we assume each variant has only 1 call.
+        QCHECK_EQ(single_site_call.variant().calls_size(), 1);
+      }
     }
     if (tfrecord_paths.size() > 1) {
       LOG(INFO) << "Done reading: " << tfrecord_path
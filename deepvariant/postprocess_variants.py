@@ -962,17 +962,44 @@ def merge_predictions(
     return canonical_variant, normalized_predictions
 
 
-def write_variants_to_vcf(variant_iterable, output_vcf_path, header):
+def _vcf_writer_options(use_csi):
+  """Returns VcfWriterOptions that compress and index outputs while writing.
+
+  Args:
+    use_csi: bool. If true, index using the CSI format rather than tabix.
+
+  Returns:
+    A VcfWriterOptions proto. write_index only takes effect for .gz outputs.
+  """
+  return variants_pb2.VcfWriterOptions(
+      num_compression_threads=max(_CPUS.value, 0),
+      write_index=True,
+      index_min_shift=14 if use_csi else 0,
+  )
+
+
+def write_variants_to_vcf(
+    variant_iterable, output_vcf_path, header, use_csi=False
+):
   """Writes Variant protos to a VCF file.
 
+  If output_vcf_path ends in .gz, the output is indexed while it is written.
+
   Args:
     variant_iterable: iterable. An iterable of sorted Variant protos.
     output_vcf_path: str. Output file in VCF format.
     header: VcfHeader proto. The VCF header to use for writing the variants.
+    use_csi: bool. If true, index using the CSI format rather than tabix.
   """
   logging.info('Writing output to VCF file: %s', output_vcf_path)
+  writer_options = _vcf_writer_options(use_csi)
   with vcf.VcfWriter(
-      output_vcf_path, header=header, round_qualities=True
+      output_vcf_path,
+      header=header,
+      round_qualities=True,
+      num_compression_threads=writer_options.num_compression_threads,
+      write_index=output_vcf_path.endswith('.gz'),
+      index_min_shift=writer_options.index_min_shift,
   ) as writer:
     count = 0
     for variant in variant_iterable:
@@ -1367,9 +1394,8 @@ def main(argv=()):
           variant_iterable=variant_generator,
           output_vcf_path=FLAGS.outfile,
           header=header,
+          use_csi=use_csi,
       )
-      if FLAGS.outfile.endswith('.gz'):
-        build_index(FLAGS.outfile, use_csi)
       logging.info(
           'VCF creation took %s minutes', (time.time() - start_time) / 60
       )
@@ -1399,11 +1425,8 @@ def main(argv=()):
           FLAGS.gvcf_outfile,
           header,
           _PROCESS_SOMATIC.value,
+          _vcf_writer_options(use_csi),
       )
-      if FLAGS.outfile.endswith('.gz'):
-        build_index(FLAGS.outfile, use_csi)
-      if FLAGS.gvcf_outfile.endswith('.gz'):
-        build_index(FLAGS.gvcf_outfile, use_csi)
       logging.info(
           'Finished writing VCF and gVCF in %s minutes.',
           (time.time() - start_time) / 60,
@@ -55,6 +55,7 @@
 #include "boost/graph/graphviz.hpp"
 #include "boost/graph/reverse_graph.hpp"
 #include "third_party/nucleus/protos/reads.pb.h"
+#include "third_party/nucleus/util/tracing.h"
 #include "third_party/nucleus/util/utils.h"
 
 namespace learning {
@@ -242,10 +243,12 @@ std::unique_ptr<DeBruijnGraph> DeBruijnGraph::Build(
     const string& ref,
     const std::vector<nucleus::ConstProtoPtr<const Read>>& reads,
     const DeBruijnGraph::Options& options) {
+  nucleus::ScopedTraceTimer timer("debruijn build");
   KBounds bounds = KMinMaxFromReference(ref, options);
   if (bounds.min_k == kBoundsNoWorkingK) return nullptr;
 
   for (int k = bounds.min_k; k <= bounds.max_k; k += options.step_k()) {
+    nucleus::TraceCount("debruijn k tried");
     std::unique_ptr<DeBruijnGraph> graph = std::unique_ptr<DeBruijnGraph>(
         new DeBruijnGraph(ref, reads, options, k));
     if (graph->HasCycle()) {
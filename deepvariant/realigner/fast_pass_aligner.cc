@@ -50,6 +50,7 @@
 #include "absl/strings/string_view.h"
 #include "third_party/nucleus/protos/cigar.pb.h"
 #include "third_party/nucleus/protos/position.pb.h"
+#include "third_party/nucleus/util/tracing.h"
 #include "re2/re2.h"
 
 namespace learning {
@@ -129,6 +130,8 @@ void FastPassAligner::CalculateSswAlignmentScoreThreshold() {
 std::unique_ptr<std::vector<nucleus::genomics::v1::Read>>
 FastPassAligner::AlignReads(
     const std::vector<nucleus::genomics::v1::Read>& reads_param) {
+  nucleus::ScopedTraceTimer timer("fast pass align reads");
+  nucleus::TraceCount("fast pass reads", reads_param.size());
 
   // Copy reads
   for (const auto& read : reads_param) {
@@ -413,6 +416,7 @@ void FastPassAligner::SswAlignReadsToHaplotypes(uint16_t score_threshold) {
     }
     // If this read is not aligned to any of the haplotypes we try SSW.
     if (!has_at_least_one_alignment) {
+      nucleus::TraceCount("ssw fallback reads");
       for (auto& hap_alignment : read_to_haplotype_alignments_) {
         // Skip haplotypes with no read support (score=0), except if
         // force_alignment, then compute an alignment against the reference no
@@ -46,6 +46,8 @@
 #include "absl/container/btree_map.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "third_party/nucleus/io/vcf_conversion.h"
 #include "third_party/nucleus/io/vcf_reader.h"
 #include "third_party/nucleus/protos/variants.pb.h"
 #include "third_party/nucleus/util/math.h"
@@ -375,51 +377,44 @@ std::vector<DeepVariantCall> VariantCaller::CallsFromAlleleCounts(
   return variants;
 }
 
-bool is_uncalled_genotype(const Variant& variant) {
-  if (variant.calls_size() >= 1) {
-    VariantCall call = variant.calls().Get(0);
-    if (call.genotype().size() >= 2) {
-      return call.genotype().Get(0) == -1 && call.genotype().Get(1) == -1;
+bool is_uncalled_genotype(const nucleus::VcfRecordView& record) {
+  if (record.NumSamples() >= 1) {
+    nucleus::StatusOr<absl::Span<const int>> genotype = record.Genotype(0);
+    if (genotype.ok() && genotype.ValueOrDie().size() >= 2) {
+      return genotype.ValueOrDie()[0] == -1 && genotype.ValueOrDie()[1] == -1;
     }
   }
   return false;
 }
 
-std::vector<DeepVariantCall> VariantCaller::CallsFromVcf(
-    const std::vector<AlleleCount>& allele_counts,
-    const Range& range,
-    nucleus::VcfReader* vcf_reader_ptr) const {
-  std::vector<Variant> variants_in_region;
-  nucleus::StatusOr<std::shared_ptr<nucleus::VariantIterable>> status =
-      vcf_reader_ptr->Query(range);
-  if (status.ok()) {
-    std::shared_ptr<nucleus::VariantIterable> variants = status.ValueOrDie();
-    bool warn_missing = false;
-    for (const auto& v : variants) {
-      const Variant* variant = v.ValueOrDie();
-      // This ensures we only keep variants that start in this region.
-      // By default, vcf_reader->Query() returns all variants that overlap a
-      // region, which can incorrectly cause the same variant to be processed
-      // multiple times.
-      if (variant->start() >= range.start()) {
-        if (options_.skip_uncalled_genotypes() &&
-            is_uncalled_genotype(*variant)) {
+// Calls visit with each record of the VCF that starts in range, skipping the
+// ones with uncalled genotypes (./.) if skip_uncalled_genotypes. Records are
+// read as lightweight views, so only the fields visit uses get decoded.
+void VisitVcfRecordsInRange(
+    const Range& range, bool skip_uncalled_genotypes,
+    nucleus::VcfReader* vcf_reader_ptr,
+    const std::function<void(const nucleus::VcfRecordView&)>& visit) {
+  bool warn_missing = false;
+  nucleus::Status status = vcf_reader_ptr->QueryViews(
+      range, [&](const nucleus::VcfRecordView& record) {
+        // This ensures we only keep variants that start in this region.
+        // By default, vcf_reader->Query() returns all variants that overlap a
+        // region, which can incorrectly cause the same variant to be processed
+        // multiple times.
+        if (record.Start() < range.start()) return true;
+        if (skip_uncalled_genotypes && is_uncalled_genotype(record)) {
           if (!warn_missing) {
             LOG(WARNING) << "Uncalled genotypes (./.) present in VCF. These "
                             "are skipped.";
             warn_missing = true;
           }
-          continue;
+          return true;
         }
-        Variant clean_variant;
-        FillVariant(variant->reference_name(), variant->start(),
-                    variant->reference_bases(), options_.sample_name(),
-                    AsVector<std::string>(variant->alternate_bases()),
-                    &clean_variant);
-        variants_in_region.push_back(clean_variant);
-      }
-    }
-  } else if (status.error_message() == "Cannot query without an index") {
+        visit(record);
+        return true;
+      });
+  if (status.ok()) return;
+  if (status.error_message() == "Cannot query without an index") {
     LOG(FATAL) << "Error in VariantCaller::CallsFromVcf: "
                << status.error_message();
   } else {
@@ -427,47 +422,40 @@ std::vector<DeepVariantCall> VariantCaller::CallsFromVcf(
         << nucleus::MakeIntervalStr(range)
         << " cannot be found in proposed VCF header. Skip this region.";
   }
+}
+
+std::vector<DeepVariantCall> VariantCaller::CallsFromVcf(
+    const std::vector<AlleleCount>& allele_counts,
+    const Range& range,
+    nucleus::VcfReader* vcf_reader_ptr) const {
+  std::vector<Variant> variants_in_region;
+  std::vector<std::string> alternate_bases;
+  VisitVcfRecordsInRange(
+      range, options_.skip_uncalled_genotypes(), vcf_reader_ptr,
+      [&](const nucleus::VcfRecordView& record) {
+        alternate_bases.clear();
+        for (int i = 0; i < record.NumAlternateBases(); ++i) {
+          alternate_bases.emplace_back(record.AlternateBases(i));
+        }
+        Variant clean_variant;
+        FillVariant(string(record.ReferenceName()), record.Start(),
+                    string(record.ReferenceBases()), options_.sample_name(),
+                    alternate_bases, &clean_variant);
+        variants_in_region.push_back(std::move(clean_variant));
+      });
   return CallsFromVariantsInRegion(allele_counts, variants_in_region);
 }
 
 std::vector<int> VariantCaller::CallPositionsFromVcf(
     const std::vector<AlleleCount>& allele_counts, const Range& range,
     nucleus::VcfReader* vcf_reader_ptr) const {
-  std::vector<Variant> variants_in_region;
   std::vector<int> positions;
-  nucleus::StatusOr<std::shared_ptr<nucleus::VariantIterable>> status =
-      vcf_reader_ptr->Query(range);
-  if (status.ok()) {
-    std::shared_ptr<nucleus::VariantIterable> variants = status.ValueOrDie();
-    bool warn_missing = false;
-    for (const auto& v : variants) {
-      const Variant* variant = v.ValueOrDie();
-      // This ensures we only keep variants that start in this region.
-      // By default, vcf_reader->Query() returns all variants that overlap a
-      // region, which can incorrectly cause the same variant to be processed
-      // multiple times.
-      if (variant->start() >= range.start()) {
-        if (options_.skip_uncalled_genotypes() &&
-            is_uncalled_genotype(*variant)) {
-          if (!warn_missing) {
-            LOG(WARNING) << "Uncalled genotypes (./.) present in VCF. These "
-                            "are skipped.";
-            warn_missing = true;
-          }
-          continue;
-        }
+  VisitVcfRecordsInRange(
+      range, options_.skip_uncalled_genotypes(), vcf_reader_ptr,
+      [&](const nucleus::VcfRecordView& record) {
         // This is a good variant, save the position.
-        positions.push_back(variant->start());
-      }
-    }
-  } else if (status.error_message() == "Cannot query without an index") {
-    LOG(FATAL) << "Error in VariantCaller::CallsFromVcf: "
-               << status.error_message();
-  } else {
-    LOG(WARNING)
-        << nucleus::MakeIntervalStr(range)
-        << " cannot be found in proposed VCF header. Skip this region.";
-  }
+        positions.push_back(record.Start());
+      });
   return positions;
 }
 
@@ -166,6 +166,24 @@ _CUSTOMIZED_MODEL = flags.DEFINE_string(
 _NUM_SHARDS = flags.DEFINE_integer(
     'num_shards', 1, 'Optional. Number of shards for make_examples step.'
 )
+_MAKE_EXAMPLES_SINGLE_PROCESS = flags.DEFINE_boolean(
+    'make_examples_single_process',
+    False,
+    (
+        'Optional. If True, make_examples runs as one process with --num_shards'
+        ' worker threads that write the same sharded outputs, instead of'
+        ' --num_shards processes launched with GNU parallel.'
+    ),
+)
+_MAKE_EXAMPLES_PACKED_REFERENCE = flags.DEFINE_boolean(
+    'make_examples_packed_reference',
+    False,
+    (
+        'Optional. If True, the make_examples shards share one 2-bit packed'
+        ' copy of --ref, written once to --intermediate_results_dir and mapped'
+        ' by every shard, instead of each opening --ref on its own.'
+    ),
+)
 _REGIONS = flags.DEFINE_string(
     'regions',
     None,
@@ -348,12 +366,15 @@ def make_examples_command(
   Returns:
     (string, string) A command to run, and a log file to output to.
   """
-  command = [
-      'time',
-      'seq 0 {} |'.format(_NUM_SHARDS.value - 1),
-      'parallel -q --halt 2 --line-buffer',
-      '/opt/deepvariant/bin/make_examples',
-  ]
+  if _MAKE_EXAMPLES_SINGLE_PROCESS.value:
+    command = ['time', '/opt/deepvariant/bin/make_examples']
+  else:
+    command = [
+        'time',
+        'seq 0 {} |'.format(_NUM_SHARDS.value - 1),
+        'parallel -q --halt 2 --line-buffer',
+        '/opt/deepvariant/bin/make_examples',
+    ]
   command.extend(['--mode', 'calling'])
   command.extend(['--ref', '"{}"'.format(ref)])
   command.extend(['--reads', '"{}"'.format(reads)])
@@ -403,7 +424,10 @@ def make_examples_command(
   kwargs = _update_kwargs_with_warning(kwargs, _extra_args_to_dict(extra_args))
   command = _extend_command_by_args_dict(command, kwargs)
 
-  command.extend(['--task {}'])
+  if _MAKE_EXAMPLES_SINGLE_PROCESS.value:
+    command.extend(['--num_workers', str(_NUM_SHARDS.value)])
+  else:
+    command.extend(['--task {}'])
   logfile = None
   if _LOGGING_DIR.value:
     logfile = '{}/make_examples.log'.format(_LOGGING_DIR.value)
@@ -602,6 +626,13 @@ def create_all_commands_and_logfiles(intermediate_results_dir):
   else:
     runtime_by_region_path = None
 
+  packed_reference = None
+  if _MAKE_EXAMPLES_PACKED_REFERENCE.value:
+    packed_reference = os.path.join(
+        intermediate_results_dir,
+        os.path.basename(_REF.value) + '.nucpack',
+    )
+
   commands.append(
       make_examples_command(
           ref=_REF.value,
@@ -611,6 +642,7 @@ def create_all_commands_and_logfiles(intermediate_results_dir):
           extra_args=_MAKE_EXAMPLES_EXTRA_ARGS.value,
           # kwargs:
           gvcf=nonvariant_site_tfrecord_path,
+          packed_reference=packed_reference,
           regions=_REGIONS.value,
           sample_name=_SAMPLE_NAME.value,
       )
@@ -37,9 +37,11 @@
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/bed.pb.h"
 #include "third_party/nucleus/util/utils.h"
@@ -64,27 +66,27 @@ bool ValidNumBedFields(const int fields) {
           fields == 8 || fields == 9 || fields == 12);
 }
 
-// Read the next non-comment line.
-::nucleus::Status NextNonCommentLine(TextReader& text_reader, string* line) {
+// Read the next non-comment line. *line is only valid until the next read from
+// text_reader.
+::nucleus::Status NextNonCommentLine(TextReader& text_reader,
+                                     absl::string_view* line) {
   CHECK(line != nullptr);
-  string tmp;
   do {
-    StatusOr<string> line_or = text_reader.ReadLine();
+    StatusOr<absl::string_view> line_or = text_reader.ReadLineView();
     NUCLEUS_RETURN_IF_ERROR(line_or.status());
-    tmp = line_or.ValueOrDie();
-  } while (absl::StartsWith(tmp, BED_COMMENT_PREFIX));
+    *line = line_or.ValueOrDie();
+  } while (absl::StartsWith(*line, BED_COMMENT_PREFIX));
 
-  *line = tmp;
   return ::nucleus::Status();
 }
 
-::nucleus::Status ConvertToPb(const string& line, const int desiredNumFields,
-                              int* numTokensSeen,
+::nucleus::Status ConvertToPb(absl::string_view line,
+                              const int desiredNumFields, int* numTokensSeen,
                               nucleus::genomics::v1::BedRecord* record) {
   CHECK(record != nullptr) << "BED record cannot be null";
   record->Clear();
 
-  std::vector<string> tokens = absl::StrSplit(line, '\t');
+  std::vector<absl::string_view> tokens = absl::StrSplit(line, '\t');
   int numTokens = static_cast<int>(tokens.size());
   *numTokensSeen = numTokens;
   if (!ValidNumBedFields(numTokens)) {
@@ -93,15 +95,15 @@ bool ValidNumBedFields(const int fields) {
   int numFields =
       desiredNumFields == 0 ? numTokens : std::min(numTokens, desiredNumFields);
   int64 int64Value;
-  record->set_reference_name(tokens[0]);
+  record->set_reference_name(string(tokens[0]));
   CHECK(absl::SimpleAtoi(tokens[1], &int64Value));
   record->set_start(int64Value);
   CHECK(absl::SimpleAtoi(tokens[2], &int64Value));
   record->set_end(int64Value);
-  if (numFields > 3) record->set_name(tokens[3]);
+  if (numFields > 3) record->set_name(string(tokens[3]));
   if (numFields > 4) {
     double value;
-    CHECK(absl::SimpleAtod(tokens[4].c_str(), &value));
+    CHECK(absl::SimpleAtod(tokens[4], &value));
     record->set_score(value);
   }
   if (numFields > 5) {
@@ -120,13 +122,13 @@ bool ValidNumBedFields(const int fields) {
     CHECK(absl::SimpleAtoi(tokens[7], &int64Value));
     record->set_thick_end(int64Value);
   }
-  if (numFields > 8) record->set_item_rgb(tokens[8]);
+  if (numFields > 8) record->set_item_rgb(string(tokens[8]));
   if (numFields >= 12) {
     int32 int32Value;
     CHECK(absl::SimpleAtoi(tokens[9], &int32Value));
     record->set_block_count(int32Value);
-    record->set_block_sizes(tokens[10]);
-    record->set_block_starts(tokens[11]);
+    record->set_block_sizes(string(tokens[10]));
+    record->set_block_starts(string(tokens[11]));
   }
 
   return ::nucleus::Status();
@@ -138,15 +140,13 @@ bool ValidNumBedFields(const int fields) {
 // then rewinding the stream to 0 would be a nicer solution.
 ::nucleus::Status GetNumFields(const string& path, int* numFields) {
   CHECK(numFields != nullptr);
-  string line;
+  absl::string_view line;
   StatusOr<std::unique_ptr<TextReader>> status_or = TextReader::FromFile(path);
   NUCLEUS_RETURN_IF_ERROR(status_or.status());
   std::unique_ptr<TextReader> text_reader = std::move(status_or.ValueOrDie());
   NUCLEUS_RETURN_IF_ERROR(NextNonCommentLine(*text_reader, &line));
-  NUCLEUS_RETURN_IF_ERROR(text_reader->Close());
-  std::vector<string> tokens = absl::StrSplit(line, '\t');
-  *numFields = static_cast<int>(tokens.size());
-  return ::nucleus::Status();
+  *numFields = static_cast<int>(absl::c_count(line, '\t')) + 1;
+  return text_reader->Close();
 }
 }  // namespace
 
@@ -175,7 +175,7 @@ StatusOr<std::unique_ptr<BedReader>> BedReader::FromFile(
         "Invalid requested number of fields to parse");
   }
   StatusOr<std::unique_ptr<TextReader>> status_or =
-      TextReader::FromFile(bed_path);
+      TextReader::FromFile(bed_path, options.num_decompression_threads());
   NUCLEUS_RETURN_IF_ERROR(status_or.status());
   return std::unique_ptr<BedReader>(
       new BedReader(std::move(status_or.ValueOrDie()), options, header));
@@ -224,7 +224,7 @@ StatusOr<bool> BedFullFileIterable::Next(
     nucleus::genomics::v1::BedRecord* out) {
   NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
   const BedReader* bed_reader = static_cast<const BedReader*>(reader_);
-  string line;
+  absl::string_view line;
   ::nucleus::Status status =
       NextNonCommentLine(*bed_reader->text_reader_, &line);
   if (::nucleus::IsOutOfRange(status)) {
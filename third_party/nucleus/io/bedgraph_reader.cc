@@ -55,16 +55,16 @@ constexpr char BED_COMMENT_PREFIX[] = "#";
 
 namespace {
 
-::nucleus::Status ConvertToPb(const string& line,
+::nucleus::Status ConvertToPb(absl::string_view line,
                               nucleus::genomics::v1::BedGraphRecord* record) {
   DCHECK_NE(nullptr, record) << "BedGraph record cannot be null";
   record->Clear();
 
-  std::vector<string> tokens = absl::StrSplit(line, '\t');
+  std::vector<absl::string_view> tokens = absl::StrSplit(line, '\t');
   if (tokens.size() != 4) {
     return ::nucleus::Unknown("BedGraph record has invalid number of fields");
   }
-  record->set_reference_name(tokens[0]);
+  record->set_reference_name(string(tokens[0]));
   int64 start, end = 0;
   if (!absl::SimpleAtoi(tokens[1], &start) ||
       !absl::SimpleAtoi(tokens[2], &end)) {
@@ -74,7 +74,7 @@ namespace {
   record->set_start(start);
   record->set_end(end);
   double value = 0;
-  if (!absl::SimpleAtod(tokens[3].c_str(), &value)) {
+  if (!absl::SimpleAtod(tokens[3], &value)) {
     return ::nucleus::Unknown("Unable to parse data value in BedGraph");
   }
   record->set_data_value(value);
@@ -140,9 +140,10 @@ StatusOr<bool> BedGraphFullFileIterable::Next(
   NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
   const BedGraphReader* bedgraph_reader =
       static_cast<const BedGraphReader*>(reader_);
-  string line;
+  absl::string_view line;
   do {
-    StatusOr<string> line_or = bedgraph_reader->text_reader_->ReadLine();
+    StatusOr<absl::string_view> line_or =
+        bedgraph_reader->text_reader_->ReadLineView();
     if (!line_or.ok()) {
       if (::nucleus::IsOutOfRange(line_or.status())) {
         return false;
@@ -98,6 +98,9 @@ def _lookup_filetype(filename):
 
 LOG_EVERY = 100000
 
+# Number of records copied at a time between native FASTQ files.
+FASTQ_BATCH_SIZE = 4096
+
 
 class ConversionError(Exception):
   """An exception used to signal file conversion error."""
@@ -169,6 +172,10 @@ def convert(in_filename, out_filename):
     ConversionError, if the conversion could not be executed.
   """
   reader_class, writer_class = _reader_writer_classes(in_filename, out_filename)
+  if (writer_class is fastq.FastqWriter and _is_native_file(in_filename) and
+      _is_native_file(out_filename)):
+    _convert_native_fastq(in_filename, out_filename)
+    return
   reader = reader_class(in_filename)
 
   with reader_class(in_filename) as reader:
@@ -183,6 +190,25 @@ def convert(in_filename, out_filename):
       logging.info("Done, processed %d records in %0.2f seconds.", i, elapsed)
 
 
+def _convert_native_fastq(in_filename, out_filename):
+  """Copies FASTQ records in columnar batches, without a proto per record."""
+  with fastq.NativeFastqReader(in_filename) as reader:
+    with fastq.NativeFastqWriter(out_filename) as writer:
+      start = time.time()
+      batch = fastq.FastqBatch()
+      i = 0
+      while True:
+        reader.read_batch(batch, FASTQ_BATCH_SIZE)
+        writer.write_batch(batch)
+        i += batch.size()
+        logging.log_every_n(logging.INFO, "Progress: %d records",
+                            max(LOG_EVERY // FASTQ_BATCH_SIZE, 1), i)
+        if batch.size() < FASTQ_BATCH_SIZE:
+          break
+      elapsed = time.time() - start
+      logging.info("Done, processed %d records in %0.2f seconds.", i, elapsed)
+
+
 def main(argv):
   if len(argv) not in (2, 3):
     print("Usage: %s <input_filename> [<output_filename>]" % argv[0])
@@ -45,6 +45,7 @@ from absl import logging
 from absl.testing import absltest
 from absl.testing import parameterized
 from third_party.nucleus.io import converter
+from third_party.nucleus.io import fastq
 from third_party.nucleus.testing import test_utils
 
 basename = os.path.basename
@@ -96,6 +97,19 @@ class ConvertGenomicsFileTest(parameterized.TestCase):
     else:
       self._convert(tfrecord_output_path, native_output_path)
 
+  @parameterized.parameters("test_reads.fastq", "test_reads.fastq.gz")
+  def test_native_fastq_conversion(self, original_input_file):
+    """Test that native FASTQ files are copied record for record."""
+    input_path = test_utils.genomics_core_testdata(original_input_file)
+    output_path = test_utils.test_tmpfile(
+        original_input_file.replace("test_reads", "copied_reads"))
+    self._convert(input_path, output_path)
+
+    with fastq.FastqReader(input_path) as reader:
+      expected = list(reader)
+    with fastq.FastqReader(output_path) as reader:
+      self.assertEqual(list(reader), expected)
+
 
 if __name__ == "__main__":
   absltest.main()
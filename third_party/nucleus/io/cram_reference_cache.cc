@@ -0,0 +1,144 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of cram_reference_cache.h
+#include "third_party/nucleus/io/cram_reference_cache.h"
+
+#include <map>
+#include <memory>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "htslib/cram.h"
+#include "htslib/hts.h"
+#include "htslib/sam.h"
+#include "third_party/nucleus/io/hts_path.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace nucleus {
+
+namespace {
+
+// Registry of live process-wide caches, keyed by CacheKey(). Holds weak
+// references so that caches are torn down when their last user goes away.
+absl::Mutex shared_caches_mutex(absl::kConstInit);
+std::map<string, std::weak_ptr<CramReferenceCache>>* shared_caches = nullptr;
+
+// Caches can only be shared between files with identical @SQ lines, because
+// htslib stores the contig id mapping inside the shared refs_t.
+string CacheKey(const string& ref_path, const bam_hdr_t* header) {
+  string key = ref_path;
+  for (int i = 0; i < header->n_targets; ++i) {
+    absl::StrAppend(&key, "\t", header->target_name[i], ":",
+                    header->target_len[i]);
+  }
+  return key;
+}
+
+}  // namespace
+
+StatusOr<std::shared_ptr<CramReferenceCache>> CramReferenceCache::Create(
+    const string& cram_path, const string& ref_path) {
+  if (ref_path.empty()) {
+    return ::nucleus::InvalidArgument(
+        "A reference path is required to share CRAM reference sequences");
+  }
+  htsFile* anchor = hts_open_x(cram_path, "r");
+  if (anchor == nullptr) {
+    return ::nucleus::NotFound(absl::StrCat("Could not open ", cram_path));
+  }
+  if (anchor->format.format != cram) {
+    hts_close(anchor);
+    return ::nucleus::InvalidArgument(
+        absl::StrCat(cram_path, " is not a CRAM file"));
+  }
+  if (cram_set_option(anchor->fp.cram, CRAM_OPT_REFERENCE, ref_path.c_str()) ||
+      cram_fd_get_refs(anchor->fp.cram) == nullptr) {
+    hts_close(anchor);
+    return ::nucleus::Unknown(
+        absl::StrCat("Failed to load CRAM reference ", ref_path));
+  }
+  return std::shared_ptr<CramReferenceCache>(
+      new CramReferenceCache(anchor, ref_path));
+}
+
+StatusOr<std::shared_ptr<CramReferenceCache>> CramReferenceCache::Shared(
+    const string& cram_path, const string& ref_path,
+    const bam_hdr_t* header) {
+  const string key = CacheKey(ref_path, header);
+  absl::MutexLock lock(&shared_caches_mutex);
+  if (shared_caches == nullptr) {
+    shared_caches = new std::map<string, std::weak_ptr<CramReferenceCache>>();
+  }
+  std::shared_ptr<CramReferenceCache> cache = (*shared_caches)[key].lock();
+  if (cache == nullptr) {
+    StatusOr<std::shared_ptr<CramReferenceCache>> cache_or =
+        Create(cram_path, ref_path);
+    NUCLEUS_RETURN_IF_ERROR(cache_or.status());
+    cache = cache_or.ValueOrDie();
+    (*shared_caches)[key] = cache;
+  }
+  return cache;
+}
+
+CramReferenceCache::CramReferenceCache(htsFile* anchor, const string& ref_path)
+    : anchor_(anchor),
+      refs_(cram_fd_get_refs(anchor->fp.cram)),
+      ref_path_(ref_path) {}
+
+CramReferenceCache::~CramReferenceCache() {
+  // htslib frees refs_ once the last CRAM file using it has been closed.
+  if (anchor_ != nullptr && hts_close(anchor_) < 0) {
+    LOG(WARNING) << "hts_close() failed for CRAM reference cache of "
+                 << ref_path_;
+  }
+  anchor_ = nullptr;
+  refs_ = nullptr;
+}
+
+::nucleus::Status CramReferenceCache::AttachTo(htsFile* fp) {
+  if (fp->format.format != cram) {
+    return ::nucleus::InvalidArgument(absl::StrCat(
+        "Cannot share a CRAM reference with non-CRAM file ",
+        fp->fn ? fp->fn : ""));
+  }
+  if (cram_set_option(fp->fp.cram, CRAM_OPT_SHARED_REF, refs_)) {
+    return ::nucleus::Unknown(absl::StrCat(
+        "Failed to share CRAM reference ", ref_path_, " with ",
+        fp->fn ? fp->fn : "file"));
+  }
+  return ::nucleus::Status();
+}
+
+}  // namespace nucleus
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_CRAM_REFERENCE_CACHE_H_
+#define THIRD_PARTY_NUCLEUS_IO_CRAM_REFERENCE_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "htslib/cram.h"
+#include "htslib/hts.h"
+#include "htslib/sam.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace nucleus {
+
+// A reference sequence cache shared by CRAM decoders.
+//
+// Every CRAM htsFile normally owns its own htslib refs_t: it opens the
+// reference FASTA and its index and loads (and eventually frees) whole contig
+// sequences as slices need them. With several CRAM readers in one process,
+// e.g. one per sample in a trio, the same contigs are read from disk and held
+// in memory once per reader.
+//
+// A CramReferenceCache owns one refs_t, loaded from a reference FASTA, and
+// attaches it to any number of CRAM htsFiles with htslib's
+// CRAM_OPT_SHARED_REF, so that each contig is loaded once per process and
+// decoded sequence is reused by all of them. The refs_t is reference counted
+// by htslib; like HtsThreadPool, holders must keep their
+// std::shared_ptr<CramReferenceCache> until after closing their file.
+//
+// The refs_t also records the mapping from the CRAM header's contig ids to
+// reference sequences, so a cache is only valid for CRAM files whose @SQ lines
+// match those of the file it was created from. Shared() enforces this by
+// keying caches on both the FASTA path and the header contigs.
+class CramReferenceCache {
+ public:
+  // Creates a new cache decoding against the FASTA at ref_path, for CRAM files
+  // with the same contigs as the CRAM at cram_path. Returns a non-OK status if
+  // cram_path is not a CRAM file or the reference cannot be loaded.
+  static StatusOr<std::shared_ptr<CramReferenceCache>> Create(
+      const string& cram_path, const string& ref_path);
+
+  // Returns the process-wide cache for ref_path and the contigs of header,
+  // creating it from cram_path if no live cache exists. The cache is
+  // destroyed once the last holder releases it.
+  static StatusOr<std::shared_ptr<CramReferenceCache>> Shared(
+      const string& cram_path, const string& ref_path,
+      const bam_hdr_t* header);
+
+  ~CramReferenceCache();
+
+  // Disable assignment/copy operations
+  CramReferenceCache(const CramReferenceCache& other) = delete;
+  CramReferenceCache& operator=(const CramReferenceCache&) = delete;
+
+  // Makes fp decode against this cache's reference sequences. fp must be a
+  // CRAM file whose header has the same contigs as the one this cache was
+  // created for.
+  ::nucleus::Status AttachTo(htsFile* fp);
+
+  const string& ref_path() const { return ref_path_; }
+
+ private:
+  CramReferenceCache(htsFile* anchor, const string& ref_path);
+
+  // A CRAM file kept open only to hold a reference on refs_, so the shared
+  // sequences outlive any individual reader.
+  htsFile* anchor_;
+  // The shared htslib reference sequence table, owned by anchor_.
+  refs_t* refs_;
+  const string ref_path_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_CRAM_REFERENCE_CACHE_H_
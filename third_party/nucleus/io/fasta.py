@@ -63,6 +63,9 @@ from third_party.nucleus.protos import fasta_pb2
 from third_party.nucleus.protos import reference_pb2
 from third_party.nucleus.util import ranges
 
+# Suffix of the files written by PackedFastaReader.write().
+PACKED_REFERENCE_SUFFIX = '.nucpack'
+
 # TODO: Replace this with a real protocol buffer definition.
 RefFastaHeader = collections.namedtuple(
     'RefFastaHeader', ['contigs'])
@@ -85,19 +88,27 @@ class FastaReader(genomics_reader.DispatchingGenomicsReader):
 class IndexedFastaReader(genomics_reader.GenomicsReader):
   """Class for reading from FASTA files containing a reference genome."""
 
-  def __init__(self, input_path, keep_true_case=False, cache_size=None):
+  def __init__(self,
+               input_path,
+               keep_true_case=False,
+               cache_size=None,
+               cache_blocks=None):
     """Initializes an IndexedFastaReader.
 
     Args:
       input_path: string. A path to a resource containing FASTA records.
       keep_true_case: bool. If False, casts all bases to uppercase before
         returning them.
-      cache_size: integer. Number of bases to cache from previous queries.
-        Defaults to 64K.  The cache can be disabled using cache_size=0.
+      cache_size: integer. Size, in bases, of the blocks cached from previous
+        queries. Defaults to 64K.  The cache can be disabled using
+        cache_size=0.
+      cache_blocks: integer or None. Maximum number of blocks of cache_size
+        bases kept in the LRU cache. If None, defaults to 64.
     """
     super(IndexedFastaReader, self).__init__()
 
-    options = fasta_pb2.FastaReaderOptions(keep_true_case=keep_true_case)
+    options = fasta_pb2.FastaReaderOptions(
+        keep_true_case=keep_true_case, cache_blocks=cache_blocks or 0)
 
     fasta_path = input_path
     fai_path = fasta_path + '.fai'
@@ -128,6 +139,66 @@ class IndexedFastaReader(genomics_reader.GenomicsReader):
     """Returns a ContigInfo proto for contig_name."""
     return self._reader.contig(contig_name)
 
+  def cache_stats(self):
+    """Returns (hits, misses) counts of queries against the block cache."""
+    return self._reader.cache_hits(), self._reader.cache_misses()
+
+  @property
+  def c_reader(self):
+    """Returns the underlying C++ reader."""
+    return self._reader
+
+  def __exit__(self, exit_type, exit_value, exit_traceback):
+    self._reader.__exit__(exit_type, exit_value, exit_traceback)
+
+
+class PackedFastaReader(genomics_reader.GenomicsReader):
+  """Class for reading a reference genome held in memory at 2 bits per base.
+
+  Loading a whole FASTA this way is slower than opening an IndexedFastaReader,
+  but queries never touch the disk afterwards. Use write() to save the packed
+  reference to a PACKED_REFERENCE_SUFFIX file that later readers map directly.
+  """
+
+  def __init__(self, input_path, keep_true_case=False):
+    """Initializes a PackedFastaReader.
+
+    Args:
+      input_path: string. A path to an indexed FASTA file, or to a file ending
+        in PACKED_REFERENCE_SUFFIX written by write().
+      keep_true_case: bool. If False, casts all bases to uppercase before
+        returning them.
+    """
+    super(PackedFastaReader, self).__init__()
+
+    options = fasta_pb2.FastaReaderOptions(keep_true_case=keep_true_case)
+    if input_path.endswith(PACKED_REFERENCE_SUFFIX):
+      self._reader = reference.PackedFastaReader.from_file(input_path, options)
+    else:
+      self._reader = reference.PackedFastaReader.from_fasta(
+          input_path, input_path + '.fai', options)
+    self.header = RefFastaHeader(contigs=self._reader.contigs)
+
+  def iterate(self):
+    """Returns an iterable of (name, bases) tuples contained in this file."""
+    return self._reader.iterate()
+
+  def query(self, region):
+    """Returns the base pairs (as a string) in the given region."""
+    return self._reader.bases(region)
+
+  def is_valid(self, region):
+    """Returns whether the region is contained in this reference."""
+    return self._reader.is_valid_interval(region)
+
+  def contig(self, contig_name):
+    """Returns a ContigInfo proto for contig_name."""
+    return self._reader.contig(contig_name)
+
+  def write(self, output_path):
+    """Saves the packed reference to output_path."""
+    self._reader.write(output_path)
+
   @property
   def c_reader(self):
     """Returns the underlying C++ reader."""
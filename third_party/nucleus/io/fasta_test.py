@@ -78,6 +78,15 @@ class IndexedFastaReaderTests(parameterized.TestCase):
     with fasta.IndexedFastaReader(fasta_path, cache_size=10) as reader:
       self.assertEqual(reader.query(ranges.make_range('chrM', 1, 5)), 'ATCA')
 
+  def test_cache_stats(self):
+    fasta_path = test_utils.genomics_core_testdata('test.fasta')
+    with fasta.IndexedFastaReader(
+        fasta_path, cache_size=10, cache_blocks=16) as reader:
+      self.assertEqual(reader.query(ranges.make_range('chrM', 1, 5)), 'ATCA')
+      self.assertEqual(reader.query(ranges.make_range('chr1', 1, 5)), 'CCAC')
+      self.assertEqual(reader.query(ranges.make_range('chrM', 5, 9)), 'CAGG')
+      self.assertEqual(reader.cache_stats(), (1, 2))
+
   def test_c_reader(self):
     with fasta.IndexedFastaReader(
         test_utils.genomics_core_testdata('test.fasta')) as reader:
@@ -85,6 +94,32 @@ class IndexedFastaReaderTests(parameterized.TestCase):
                             reference.IndexedFastaReader)
 
 
+class PackedFastaReaderTests(parameterized.TestCase):
+
+  @parameterized.parameters(False, True)
+  def test_matches_indexed_reader(self, keep_true_case):
+    fasta_path = test_utils.genomics_core_testdata('test.fasta')
+    region = ranges.make_range('chrM', 20, 30)
+    with fasta.IndexedFastaReader(
+        fasta_path, keep_true_case=keep_true_case) as indexed:
+      expected = indexed.query(region)
+    with fasta.PackedFastaReader(
+        fasta_path, keep_true_case=keep_true_case) as packed:
+      self.assertEqual(packed.query(region), expected)
+      self.assertLen(packed.header.contigs, 3)
+
+  def test_write_and_load(self):
+    packed_path = test_utils.test_tmpfile('test' +
+                                          fasta.PACKED_REFERENCE_SUFFIX)
+    with fasta.PackedFastaReader(
+        test_utils.genomics_core_testdata('test.fasta')) as packed:
+      packed.write(packed_path)
+    with fasta.PackedFastaReader(packed_path) as packed:
+      self.assertEqual(packed.query(ranges.make_range('chr2', 0, 6)),
+                       'CGCTNC')
+      self.assertIsInstance(packed.c_reader, reference.PackedFastaReader)
+
+
 class UnindexedFastaReaderTests(parameterized.TestCase):
 
   def test_query(self):
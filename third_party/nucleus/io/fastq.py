@@ -74,6 +74,11 @@ from third_party.nucleus.io.python import fastq_reader
 from third_party.nucleus.io.python import fastq_writer
 from third_party.nucleus.protos import fastq_pb2
 
+# A batch of FASTQ records stored column by column, without a proto per record.
+# Filled by NativeFastqReader.read_batch() and written by
+# NativeFastqWriter.write_batch().
+FastqBatch = fastq_reader.FastqBatch
+
 
 class NativeFastqReader(genomics_reader.GenomicsReader):
   """Class for reading from native FASTQ files.
@@ -108,6 +113,18 @@ class NativeFastqReader(genomics_reader.GenomicsReader):
     """Returns an iterable of FastqRecord protos in the file."""
     return self._reader.iterate()
 
+  def read_batch(self, batch, max_records):
+    """Reads up to max_records records into batch, replacing its contents.
+
+    Reading continues from where the last read stopped. Fewer than max_records
+    records are read only at the end of the file.
+
+    Args:
+      batch: FastqBatch. The batch to fill.
+      max_records: int. The maximum number of records to read.
+    """
+    self._reader.read_batch(max_records, batch)
+
   def __exit__(self, exit_type, exit_value, exit_traceback):
     self._reader.__exit__(exit_type, exit_value, exit_traceback)
 
@@ -144,6 +161,10 @@ class NativeFastqWriter(genomics_writer.GenomicsWriter):
   def write(self, proto):
     self._writer.write(proto)
 
+  def write_batch(self, batch):
+    """Writes all records of a FastqBatch."""
+    self._writer.write_batch(batch)
+
   def __exit__(self, exit_type, exit_value, exit_traceback):
     self._writer.__exit__(exit_type, exit_value, exit_traceback)
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_FASTQ_BATCH_H_
+#define THIRD_PARTY_NUCLEUS_IO_FASTQ_BATCH_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/strings/string_view.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/fastq.pb.h"
+
+namespace nucleus {
+
+// A batch of FASTQ records stored column by column.
+//
+// The ids, descriptions, sequences and qualities of all records are each
+// concatenated into one string, with an offsets array marking where each
+// record's field starts, so filling a batch costs a few appends per record
+// instead of a FastqRecord proto with four heap-allocated strings. Clear()
+// keeps the allocated capacity, so a batch reused across reads stops
+// allocating once it has seen its largest batch.
+//
+// Fields are returned as string_views into the batch and are invalidated by
+// the next Add() or Clear().
+class FastqBatch {
+ public:
+  FastqBatch() = default;
+
+  // Number of records in the batch.
+  int size() const { return qualities_.size(); }
+  bool empty() const { return size() == 0; }
+
+  // Removes all records, keeping the allocated buffers.
+  void Clear() { Truncate(0); }
+
+  // Appends a record to the batch.
+  void Add(absl::string_view id, absl::string_view description,
+           absl::string_view sequence, absl::string_view quality) {
+    ids_.Append(id);
+    descriptions_.Append(description);
+    sequences_.Append(sequence);
+    qualities_.Append(quality);
+  }
+
+  absl::string_view id(int i) const { return ids_.Get(i); }
+  absl::string_view description(int i) const { return descriptions_.Get(i); }
+  absl::string_view sequence(int i) const { return sequences_.Get(i); }
+  absl::string_view quality(int i) const { return qualities_.Get(i); }
+
+  // The concatenated sequences of all records. Record i's sequence is
+  // sequences()[sequence_offsets()[i], sequence_offsets()[i + 1]).
+  const string& sequences() const { return sequences_.data; }
+  const std::vector<size_t>& sequence_offsets() const {
+    return sequences_.offsets;
+  }
+
+  // The concatenated qualities of all records, laid out like sequences().
+  const string& qualities() const { return qualities_.data; }
+  const std::vector<size_t>& quality_offsets() const {
+    return qualities_.offsets;
+  }
+
+  // Copies record i into record.
+  void ToRecord(int i, nucleus::genomics::v1::FastqRecord* record) const {
+    record->set_id(string(id(i)));
+    record->set_description(string(description(i)));
+    record->set_sequence(string(sequence(i)));
+    record->set_quality(string(quality(i)));
+  }
+
+ private:
+  // One field of every record, concatenated.
+  struct Column {
+    string data;
+    std::vector<size_t> offsets = {0};
+
+    int size() const { return offsets.size() - 1; }
+    void Append(absl::string_view value) {
+      data.append(value.data(), value.size());
+      offsets.push_back(data.size());
+    }
+    absl::string_view Get(int i) const {
+      DCHECK_GE(i, 0);
+      DCHECK_LT(i, size());
+      return absl::string_view(data).substr(offsets[i],
+                                            offsets[i + 1] - offsets[i]);
+    }
+    void Truncate(int n) {
+      if (n >= size()) return;
+      offsets.resize(n + 1);
+      data.resize(offsets.back());
+    }
+  };
+
+  // Drops every record, complete or partially added, from index n on.
+  void Truncate(int n) {
+    ids_.Truncate(n);
+    descriptions_.Truncate(n);
+    sequences_.Truncate(n);
+    qualities_.Truncate(n);
+  }
+
+  Column ids_;
+  Column descriptions_;
+  Column sequences_;
+  Column qualities_;
+
+  // FastqReader fills a batch one field at a time as it reads lines.
+  friend class FastqBatchFiller;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_FASTQ_BATCH_H_
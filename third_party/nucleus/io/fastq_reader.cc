@@ -37,6 +37,7 @@
 #include <utility>
 
 #include "absl/strings/string_view.h"
+#include "third_party/nucleus/io/fastq_batch.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/fastq.pb.h"
 #include "third_party/nucleus/util/utils.h"
@@ -61,33 +62,130 @@ constexpr char SEQUENCE_AND_QUALITY_SEPARATOR_SYMBOL = '+';
 
 namespace {
 
-// TODO: get rid of pessimizing string_view -> string conversions
-// once our OSS dependencies are updated.
-::nucleus::Status ConvertToPb(const string_view header,
-                              const string_view sequence, const string_view pad,
-                              const string_view quality,
-                              nucleus::genomics::v1::FastqRecord* record) {
-  CHECK(record != nullptr) << "FASTQ record cannot be null";
-  if (header.empty() || header[0] != HEADER_SYMBOL || pad.empty() ||
-      pad[0] != SEQUENCE_AND_QUALITY_SEPARATOR_SYMBOL || sequence.empty() ||
-      sequence.length() != quality.length()) {
-    return ::nucleus::DataLoss("Invalid FASTQ record");
+// Splits a FASTQ header line into its id and description. Returns false if
+// header is not a valid header line.
+bool ParseHeader(const string_view header, string_view* id,
+                 string_view* description) {
+  if (header.empty() || header[0] != HEADER_SYMBOL) {
+    return false;
   }
-  record->Clear();
   size_t spaceix = header.find(' ');
   if (spaceix == string::npos) {
     // No space found; ID is full string after delimiter.
-    record->set_id(string(header.substr(1)));
+    *id = header.substr(1);
+    *description = string_view();
   } else {
     // ID is the string from delimiter up to the first space.
-    record->set_id(string(header.substr(1, spaceix - 1)));
+    *id = header.substr(1, spaceix - 1);
     // Description is the string after the first space.
-    record->set_description(string(header.substr(spaceix + 1)));
+    *description = header.substr(spaceix + 1);
+  }
+  return true;
+}
+
+// Stores the fields of a record read by ReadRecord into a FastqRecord proto.
+class FastqRecordFiller {
+ public:
+  explicit FastqRecordFiller(FastqRecord* record) : record_(record) {}
+
+  void Begin() { record_->Clear(); }
+  void SetHeader(string_view id, string_view description) {
+    record_->set_id(string(id));
+    record_->set_description(string(description));
+  }
+  void SetSequence(string_view sequence) {
+    record_->set_sequence(string(sequence));
+  }
+  void SetQuality(string_view quality) {
+    record_->set_quality(string(quality));
+  }
+  void Discard() {}
+
+ private:
+  FastqRecord* record_;
+};
+
+}  // namespace
+
+// Appends the fields of a record read by ReadRecord to a FastqBatch.
+class FastqBatchFiller {
+ public:
+  explicit FastqBatchFiller(FastqBatch* batch) : batch_(batch) {}
+
+  void Begin() { size_ = batch_->size(); }
+  void SetHeader(string_view id, string_view description) {
+    batch_->ids_.Append(id);
+    batch_->descriptions_.Append(description);
+  }
+  void SetSequence(string_view sequence) {
+    batch_->sequences_.Append(sequence);
+  }
+  void SetQuality(string_view quality) { batch_->qualities_.Append(quality); }
+  // Drops the fields of the current record appended so far.
+  void Discard() { batch_->Truncate(size_); }
+
+ private:
+  FastqBatch* batch_;
+  int size_ = 0;
+};
+
+namespace {
+
+// Reads the next four lines of text_reader as a FASTQ record, handing each
+// field to filler as soon as its line is read, since a line is only valid until
+// the next one is read. Returns OUT_OF_RANGE at the end of the stream.
+template <typename Filler>
+::nucleus::Status ReadRecord(TextReader* text_reader, Filler* filler) {
+  StatusOr<string_view> header_or, sequence_or, pad_or, quality_or;
+  string_view id, description;
+  size_t sequence_length;
+  bool valid;
+
+  filler->Begin();
+  header_or = text_reader->ReadLineView();
+  if (!header_or.ok()) {
+    if (::nucleus::IsOutOfRange(header_or.status())) {
+      return header_or.status();
+    } else {
+      goto data_loss;
+    }
+  }
+  valid = ParseHeader(header_or.ValueOrDie(), &id, &description);
+  filler->SetHeader(id, description);
+
+  sequence_or = text_reader->ReadLineView();
+  if (!sequence_or.ok()) {
+    goto data_loss;
+  }
+  sequence_length = sequence_or.ValueOrDie().length();
+  valid = valid && sequence_length > 0;
+  filler->SetSequence(sequence_or.ValueOrDie());
+
+  pad_or = text_reader->ReadLineView();
+  if (!pad_or.ok()) {
+    goto data_loss;
+  }
+  valid = valid && !pad_or.ValueOrDie().empty() &&
+          pad_or.ValueOrDie()[0] == SEQUENCE_AND_QUALITY_SEPARATOR_SYMBOL;
+
+  quality_or = text_reader->ReadLineView();
+  if (!quality_or.ok()) {
+    goto data_loss;
+  }
+  valid = valid && quality_or.ValueOrDie().length() == sequence_length;
+  filler->SetQuality(quality_or.ValueOrDie());
+
+  if (!valid) {
+    filler->Discard();
+    return ::nucleus::DataLoss("Invalid FASTQ record");
   }
-  record->set_sequence(string(sequence));
-  record->set_quality(string(quality));
   return ::nucleus::Status();
+
+data_loss:
+  filler->Discard();
+  return ::nucleus::DataLoss("Failed to parse FASTQ record");
 }
+
 }  // namespace
 
 // Iterable class for traversing all FASTQ records in the file.
@@ -105,7 +203,7 @@ StatusOr<std::unique_ptr<FastqReader>> FastqReader::FromFile(
     const string& fastq_path,
     const nucleus::genomics::v1::FastqReaderOptions& options) {
   StatusOr<std::unique_ptr<TextReader>> textreader_or =
-      TextReader::FromFile(fastq_path);
+      TextReader::FromFile(fastq_path, options.num_decompression_threads());
   NUCLEUS_RETURN_IF_ERROR(textreader_or.status());
   return std::unique_ptr<FastqReader>(
       new FastqReader(std::move(textreader_or.ValueOrDie()), options));
@@ -131,43 +229,28 @@ FastqReader::~FastqReader() {
   return close_status;
 }
 
-::nucleus::Status FastqReader::Next(string* header, string* sequence,
-                                    string* pad, string* quality) const {
-  // Read the four lines, returning early if we are at the end of the stream or
-  // the record is truncated.
-  StatusOr<string> header_or, sequence_or, pad_or, quality_or;
-
-  header_or = text_reader_->ReadLine();
-  if (!header_or.ok()) {
-    if (::nucleus::IsOutOfRange(header_or.status())) {
-      return header_or.status();
-    } else {
-      goto data_loss;
-    }
-  }
-  sequence_or = text_reader_->ReadLine();
-  if (!sequence_or.ok()) {
-    goto data_loss;
-  }
+::nucleus::Status FastqReader::Next(FastqRecord* record) const {
+  CHECK(record != nullptr) << "FASTQ record cannot be null";
+  FastqRecordFiller filler(record);
+  return ReadRecord(text_reader_.get(), &filler);
+}
 
-  pad_or = text_reader_->ReadLine();
-  if (!pad_or.ok()) {
-    goto data_loss;
+::nucleus::Status FastqReader::ReadBatch(int max_records, FastqBatch* batch) {
+  CHECK(batch != nullptr) << "FASTQ batch cannot be null";
+  if (!text_reader_) {
+    return ::nucleus::FailedPrecondition(
+        "Cannot ReadBatch from a closed FastqReader.");
   }
-
-  quality_or = text_reader_->ReadLine();
-  if (!quality_or.ok()) {
-    goto data_loss;
+  batch->Clear();
+  FastqBatchFiller filler(batch);
+  while (batch->size() < max_records) {
+    ::nucleus::Status status = ReadRecord(text_reader_.get(), &filler);
+    if (::nucleus::IsOutOfRange(status)) {
+      break;
+    }
+    NUCLEUS_RETURN_IF_ERROR(status);
   }
-
-  *header = header_or.ValueOrDie();
-  *sequence = sequence_or.ValueOrDie();
-  *pad = pad_or.ValueOrDie();
-  *quality = quality_or.ValueOrDie();
   return ::nucleus::Status();
-
-data_loss:
-  return ::nucleus::DataLoss("Failed to parse FASTQ record");
 }
 
 StatusOr<std::shared_ptr<FastqIterable>> FastqReader::Iterate() const {
@@ -183,9 +266,7 @@ StatusOr<std::shared_ptr<FastqIterable>> FastqReader::Iterate() const {
 StatusOr<bool> FastqFullFileIterable::Next(FastqRecord* out) {
   NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
   const FastqReader* fastq_reader = static_cast<const FastqReader*>(reader_);
-  string header, sequence, pad, quality;
-  ::nucleus::Status status =
-      fastq_reader->Next(&header, &sequence, &pad, &quality);
+  ::nucleus::Status status = fastq_reader->Next(out);
   if (!status.ok()) {
     if (::nucleus::IsOutOfRange(status)) {
       return false;
@@ -193,7 +274,6 @@ StatusOr<bool> FastqFullFileIterable::Next(FastqRecord* out) {
       return status;
     }
   }
-  NUCLEUS_RETURN_IF_ERROR(ConvertToPb(header, sequence, pad, quality, out));
   return true;
 }
 
@@ -35,6 +35,7 @@
 #include <memory>
 #include <string>
 
+#include "third_party/nucleus/io/fastq_batch.h"
 #include "third_party/nucleus/io/reader_base.h"
 #include "third_party/nucleus/io/text_reader.h"
 #include "third_party/nucleus/platform/types.h"
@@ -84,6 +85,15 @@ class FastqReader : public Reader {
   // constructed, or not OK otherwise.
   StatusOr<std::shared_ptr<FastqIterable>> Iterate() const;
 
+  // Reads up to max_records records into batch, replacing its contents, and
+  // continuing from where the last read or iteration stopped. A batch with
+  // fewer than max_records records means the end of the file was reached.
+  //
+  // This skips building a FastqRecord proto per record, so it is the faster
+  // way to stream a whole file. Returns a DATA_LOSS status if a record is
+  // malformed; batch then holds the records before it.
+  ::nucleus::Status ReadBatch(int max_records, FastqBatch* batch);
+
   // Close the underlying resource descriptors. Returns a Status to indicate if
   // everything went OK with the close.
   ::nucleus::Status Close();
@@ -103,9 +113,8 @@ class FastqReader : public Reader {
   FastqReader(std::unique_ptr<TextReader> text_reader,
               const nucleus::genomics::v1::FastqReaderOptions& options);
 
-  // Populates the four string  pointers with values from the input file.
-  ::nucleus::Status Next(string* header, string* sequence, string* pad,
-                         string* quality) const;
+  // Parses the next four lines of the input file into record.
+  ::nucleus::Status Next(nucleus::genomics::v1::FastqRecord* record) const;
 
   // Our options that control the behavior of this class.
   const nucleus::genomics::v1::FastqReaderOptions options_;
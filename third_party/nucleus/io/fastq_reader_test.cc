@@ -109,4 +109,62 @@ TEST_F(FastqReaderTest, BgzippedIterationWorks) {
 
   EXPECT_THAT(as_vector(reader->Iterate()), Pointwise(EqualsProto(), golden_));
 }
+
+TEST_F(FastqReaderTest, ReadBatchWorks) {
+  auto opts = nucleus::genomics::v1::FastqReaderOptions();
+  opts.set_num_decompression_threads(2);
+  std::unique_ptr<FastqReader> reader =
+      std::move(FastqReader::FromFile(GetTestData(kBgzippedFastqFilename), opts)
+                    .ValueOrDie());
+
+  // Batches of 3 split the four records across two reads, and the batch is
+  // reused between them.
+  FastqBatch batch;
+  vector<nucleus::genomics::v1::FastqRecord> records;
+  for (int batch_size : {3, 1, 0}) {
+    ASSERT_TRUE(reader->ReadBatch(3, &batch).ok());
+    ASSERT_EQ(batch_size, batch.size());
+    for (int i = 0; i < batch.size(); ++i) {
+      batch.ToRecord(i, &records.emplace_back());
+    }
+  }
+  EXPECT_THAT(records, Pointwise(EqualsProto(), golden_));
+}
+
+TEST_F(FastqReaderTest, ReadBatchStoresColumns) {
+  std::unique_ptr<FastqReader> reader = std::move(
+      FastqReader::FromFile(GetTestData(kFastqFilename),
+                            nucleus::genomics::v1::FastqReaderOptions())
+          .ValueOrDie());
+
+  FastqBatch batch;
+  ASSERT_TRUE(reader->ReadBatch(100, &batch).ok());
+  ASSERT_EQ(static_cast<int>(golden_.size()), batch.size());
+  string sequences;
+  vector<size_t> offsets = {0};
+  for (const auto& record : golden_) {
+    sequences += record.sequence();
+    offsets.push_back(sequences.size());
+  }
+  EXPECT_EQ(sequences, batch.sequences());
+  EXPECT_EQ(offsets, batch.sequence_offsets());
+  EXPECT_EQ(offsets, batch.quality_offsets());
+  EXPECT_EQ("FASTQ", batch.id(2));
+  EXPECT_EQ("contains multiple spaces in description", batch.description(2));
+}
+
+TEST_F(FastqReaderTest, ReadBatchKeepsRecordsBeforeMalformedOne) {
+  std::unique_ptr<FastqReader> reader = std::move(
+      FastqReader::FromFile(GetTestData("malformed.fastq"),
+                            nucleus::genomics::v1::FastqReaderOptions())
+          .ValueOrDie());
+
+  FastqBatch batch;
+  ::nucleus::Status status = reader->ReadBatch(100, &batch);
+  EXPECT_EQ(absl::StatusCode::kDataLoss, status.code());
+  ASSERT_EQ(1, batch.size());
+  EXPECT_EQ("okayrecord", batch.id(0));
+  EXPECT_EQ("CGATGCATAC", batch.sequences());
+  EXPECT_EQ("AAAAAAAAAA", batch.qualities());
+}
 }  // namespace nucleus
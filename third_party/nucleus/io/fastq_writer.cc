@@ -52,11 +52,26 @@ constexpr int WRITER_BUFFER_SIZE = 256 * 1024;
 //
 // -----------------------------------------------------------------------------
 
+namespace {
+
+// Appends the four FASTQ lines of a record to out.
+void AppendFastq(absl::string_view id, absl::string_view description,
+                 absl::string_view sequence, absl::string_view quality,
+                 string* out) {
+  absl::StrAppend(out, "@", id);
+  if (!description.empty()) {
+    absl::StrAppend(out, " ", description);
+  }
+  absl::StrAppend(out, "\n", sequence, "\n+\n", quality, "\n");
+}
+
+}  // namespace
+
 StatusOr<std::unique_ptr<FastqWriter>> FastqWriter::ToFile(
     const string& fastq_path,
     const nucleus::genomics::v1::FastqWriterOptions& options) {
   StatusOr<std::unique_ptr<TextWriter>> text_writer =
-      TextWriter::ToFile(fastq_path);
+      TextWriter::ToFile(fastq_path, options.num_compression_threads());
   NUCLEUS_RETURN_IF_ERROR(text_writer.status());
   return absl::WrapUnique(
       new FastqWriter(text_writer.ConsumeValueOrDie(), options));
@@ -88,16 +103,24 @@ FastqWriter::~FastqWriter() {
   if (!text_writer_)
     return ::nucleus::FailedPrecondition(
         "Cannot write to closed FASTQ stream.");
-  string out = "@";
-  absl::StrAppend(&out, record.id());
-  if (!record.description().empty()) {
-    absl::StrAppend(&out, " ", record.description());
-  }
-  absl::StrAppend(&out, "\n", record.sequence(), "\n+\n", record.quality(),
-                  "\n");
+  string out;
+  AppendFastq(record.id(), record.description(), record.sequence(),
+              record.quality(), &out);
   NUCLEUS_RETURN_IF_ERROR(text_writer_->Write(out));
 
   return ::nucleus::Status();
 }
 
+::nucleus::Status FastqWriter::WriteBatch(const FastqBatch& batch) {
+  if (!text_writer_)
+    return ::nucleus::FailedPrecondition(
+        "Cannot write to closed FASTQ stream.");
+  batch_buffer_.clear();
+  for (int i = 0; i < batch.size(); ++i) {
+    AppendFastq(batch.id(i), batch.description(i), batch.sequence(i),
+                batch.quality(i), &batch_buffer_);
+  }
+  return text_writer_->Write(batch_buffer_);
+}
+
 }  // namespace nucleus
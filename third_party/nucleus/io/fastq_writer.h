@@ -35,6 +35,7 @@
 #include <memory>
 #include <string>
 
+#include "third_party/nucleus/io/fastq_batch.h"
 #include "third_party/nucleus/io/text_writer.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/fastq.pb.h"
@@ -74,6 +75,10 @@ class FastqWriter {
     return Write(*(wrapped.p_));
   }
 
+  // Writes all records of batch to the FASTQ file, formatted into a single
+  // buffer so the (possibly multi-threaded) compressor sees one large write.
+  ::nucleus::Status WriteBatch(const FastqBatch& batch);
+
   // Close the underlying resource descriptors. Returns Status::OK() if the
   // close was successful; otherwise the status provides information about what
   // error occurred.
@@ -93,6 +98,9 @@ class FastqWriter {
 
   // Underlying file writer.
   std::unique_ptr<TextWriter> text_writer_;
+
+  // Formatted text of the batch being written, kept to reuse its capacity.
+  string batch_buffer_;
 };
 
 }  // namespace nucleus
@@ -40,6 +40,8 @@
 #include <gmock/gmock-more-matchers.h>
 
 #include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/fastq_batch.h"
+#include "third_party/nucleus/io/fastq_reader.h"
 #include "third_party/nucleus/testing/test_utils.h"
 #include "third_party/nucleus/util/utils.h"
 #include "third_party/nucleus/core/status_matchers.h"
@@ -124,4 +126,68 @@ TEST_F(FastqWriterTest, WritesGzippedFiles) {
   EXPECT_THAT(IsGzipped(contents),
               "FASTQ writer should be able to writed gzipped output");
 }
+
+TEST_F(FastqWriterTest, WriteBatchMatchesWrite) {
+  const string record_filename = MakeTempFile("write_records.fastq");
+  const string batch_filename = MakeTempFile("write_batch.fastq");
+  std::unique_ptr<FastqWriter> record_writer =
+      std::move(FastqWriter::ToFile(record_filename,
+                                    nucleus::genomics::v1::FastqWriterOptions())
+                    .ValueOrDie());
+  std::unique_ptr<FastqWriter> batch_writer =
+      std::move(FastqWriter::ToFile(batch_filename,
+                                    nucleus::genomics::v1::FastqWriterOptions())
+                    .ValueOrDie());
+  FastqBatch batch;
+  for (const nucleus::genomics::v1::FastqRecord& record : golden_) {
+    ASSERT_THAT(record_writer->Write(record), IsOK());
+    batch.Add(record.id(), record.description(), record.sequence(),
+              record.quality());
+  }
+  ASSERT_THAT(batch_writer->WriteBatch(batch), IsOK());
+  ASSERT_THAT(record_writer->Close(), IsOK());
+  ASSERT_THAT(batch_writer->Close(), IsOK());
+
+  string record_contents, batch_contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                           record_filename, &record_contents));
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                           batch_filename, &batch_contents));
+  EXPECT_EQ(record_contents, batch_contents);
+}
+
+TEST_F(FastqWriterTest, WritesBatchesWithCompressionThreads) {
+  const string output_filename = MakeTempFile("write_batch.fastq.gz");
+  nucleus::genomics::v1::FastqWriterOptions options;
+  options.set_num_compression_threads(2);
+  std::unique_ptr<FastqWriter> writer = std::move(
+      FastqWriter::ToFile(output_filename, options).ValueOrDie());
+
+  // Write enough batches to fill many BGZF blocks.
+  FastqBatch batch;
+  for (const nucleus::genomics::v1::FastqRecord& record : golden_) {
+    batch.Add(record.id(), record.description(), record.sequence(),
+              record.quality());
+  }
+  constexpr int kNumBatches = 1000;
+  for (int i = 0; i < kNumBatches; ++i) {
+    ASSERT_THAT(writer->WriteBatch(batch), IsOK());
+  }
+  ASSERT_THAT(writer->Close(), IsOK());
+
+  std::unique_ptr<FastqReader> reader = std::move(
+      FastqReader::FromFile(output_filename,
+                            nucleus::genomics::v1::FastqReaderOptions())
+          .ValueOrDie());
+  FastqBatch read;
+  int num_read = 0;
+  do {
+    ASSERT_TRUE(reader->ReadBatch(1024, &read).ok());
+    for (int i = 0; i < read.size(); ++i, ++num_read) {
+      EXPECT_EQ(golden_[num_read % golden_.size()].sequence(),
+                read.sequence(i));
+    }
+  } while (!read.empty());
+  EXPECT_EQ(kNumBatches * static_cast<int>(golden_.size()), num_read);
+}
 }  // namespace nucleus
@@ -62,18 +62,19 @@ constexpr int32 kGffMissingInt32 = -1;
 
 namespace {
 
-::nucleus::Status ParseGffHeaderLine(const string& line, GffHeader* header) {
+::nucleus::Status ParseGffHeaderLine(absl::string_view line,
+                                     GffHeader* header) {
   if (absl::StartsWith(line, "##gff-version")) {
     // TODO: get rid of pessimizing string_view -> string
     // conversions
     header->set_gff_version(string(absl::StripPrefix(line, "##")));
   } else if (absl::StartsWith(line, "##sequence-region")) {
-    std::vector<string> tokens = absl::StrSplit(line, ' ');
+    std::vector<absl::string_view> tokens = absl::StrSplit(line, ' ');
     if (tokens.size() != 4) {
       return ::nucleus::DataLoss("Invalid sequence-region GFF header.");
     }
     // Parse seqid.
-    string seqid = tokens[1];
+    string seqid(tokens[1]);
     // Parse start, end.
     int64 start1, end1;
     if (!absl::SimpleAtoi(tokens[2], &start1)) {
@@ -107,9 +108,9 @@ namespace {
   NUCLEUS_RETURN_IF_ERROR(reader_or.status());
   std::unique_ptr<TextReader> text_reader = std::move(reader_or.ValueOrDie());
 
-  StatusOr<string> line_or;
-  string line;
-  while ((line_or = text_reader->ReadLine()).ok() &&
+  StatusOr<absl::string_view> line_or;
+  absl::string_view line;
+  while ((line_or = text_reader->ReadLineView()).ok() &&
          absl::StartsWith(line = line_or.ValueOrDie(), kGffCommentPrefix)) {
     NUCLEUS_RETURN_IF_ERROR(ParseGffHeaderLine(line, header));
   }
@@ -123,23 +124,23 @@ namespace {
   return ::nucleus::Status();
 }
 
-::nucleus::Status NextNonCommentLine(TextReader& text_reader, string* line) {
+// *line is only valid until the next read from text_reader.
+::nucleus::Status NextNonCommentLine(TextReader& text_reader,
+                                     absl::string_view* line) {
   CHECK(line != nullptr);
-  string tmp;
   do {
-    StatusOr<string> line_or = text_reader.ReadLine();
+    StatusOr<absl::string_view> line_or = text_reader.ReadLineView();
     NUCLEUS_RETURN_IF_ERROR(line_or.status());
-    tmp = line_or.ValueOrDie();
-  } while (absl::StartsWith(tmp, kGffCommentPrefix));
+    *line = line_or.ValueOrDie();
+  } while (absl::StartsWith(*line, kGffCommentPrefix));
 
-  *line = tmp;
   return ::nucleus::Status();
 }
 
 // Parses the text `attributes_string`, which is a ';'-delimited list
 // of string-to-string '=' assignments, into a proto string->string map.
 ::nucleus::Status ParseGffAttributes(
-    const string& attributes_string,
+    absl::string_view attributes_string,
     google::protobuf::Map<string, string>* attributes_map) {
   if (attributes_string == kGffMissingField || attributes_string.empty()) {
     attributes_map->clear();
@@ -154,34 +155,32 @@ namespace {
     if (tokens.size() != 2) {
       return ::nucleus::Unknown("Cannot parse GFF attributes string");
     }
-    // TODO: get rid of pessimizing string_view -> string
-    // conversions
-    string lhs = string(tokens[0]);
-    string rhs = string(tokens[1]);
-    tmp[lhs] = rhs;
+    tmp[string(tokens[0])] = string(tokens[1]);
   }
-  *attributes_map = tmp;
+  attributes_map->swap(tmp);
   return ::nucleus::Status();
 }
 
 // Converts a text GFF line into a GffRecord proto message, or returns an error
 // code if the line is malformed.  The record will only be modified if the call
 // succeeds.
-::nucleus::Status ConvertToPb(const string& line, GffRecord* record) {
+::nucleus::Status ConvertToPb(absl::string_view line, GffRecord* record) {
   CHECK(record != nullptr);
 
-  std::vector<string> fields = absl::StrSplit(line, '\t');
+  std::vector<absl::string_view> fields = absl::StrSplit(line, '\t');
   if (fields.size() != 9) {
     return ::nucleus::Unknown("Incorrect number of columns in a GFF record.");
   }
 
   // Parse line.
-  string seq_id = fields[0];
+  absl::string_view seq_id = fields[0];
   if (seq_id == kGffMissingField || seq_id.empty()) {
     return ::nucleus::Unknown("GFF mandatory seq_id field is missing");
   }
-  string source = (fields[1] == kGffMissingField ? "" : fields[1]);
-  string type = (fields[2] == kGffMissingField ? "" : fields[2]);
+  absl::string_view source =
+      fields[1] == kGffMissingField ? absl::string_view() : fields[1];
+  absl::string_view type =
+      fields[2] == kGffMissingField ? absl::string_view() : fields[2];
 
   int64 start1, end1;
   if (!absl::SimpleAtoi(fields[3], &start1)) {
@@ -206,7 +205,7 @@ namespace {
   }
   // Parse strand.
   GffRecord::Strand strand;
-  const string& strand_field = fields[6];
+  absl::string_view strand_field = fields[6];
   if (strand_field == kGffMissingField) {
     strand = GffRecord::UNSPECIFIED_STRAND;
   } else if (strand_field == "+") {
@@ -218,7 +217,7 @@ namespace {
   }
   // Parse phase.
   absl::optional<int> phase;
-  const string& phase_field = fields[7];
+  absl::string_view phase_field = fields[7];
   if (phase_field != kGffMissingField) {
     int value;
     if (!absl::SimpleAtoi(phase_field, &value) ||
@@ -233,15 +232,15 @@ namespace {
 
   // Write on the record.
   record->Clear();
-  record->mutable_range()->set_reference_name(seq_id);
+  record->mutable_range()->set_reference_name(string(seq_id));
   record->mutable_range()->set_start(start);
   record->mutable_range()->set_end(end);
-  record->set_source(source);
-  record->set_type(type);
+  record->set_source(string(source));
+  record->set_type(string(type));
   record->set_score(score.value_or(kGffMissingDouble));
   record->set_strand(strand);
   record->set_phase(phase.value_or(kGffMissingInt32));
-  *record->mutable_attributes() = attributes_map;
+  record->mutable_attributes()->swap(attributes_map);
 
   return ::nucleus::Status();
 }
@@ -266,7 +265,7 @@ StatusOr<bool> GffFullFileIterable::Next(
     nucleus::genomics::v1::GffRecord* out) {
   NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
   const GffReader* gff_reader = static_cast<const GffReader*>(reader_);
-  string line;
+  absl::string_view line;
   ::nucleus::Status status =
       NextNonCommentLine(*gff_reader->text_reader_, &line);
   if (::nucleus::IsOutOfRange(status)) {
@@ -289,7 +288,7 @@ StatusOr<std::unique_ptr<GffReader>> GffReader::FromFile(
     const string& gff_path,
     const nucleus::genomics::v1::GffReaderOptions& options) {
   StatusOr<std::unique_ptr<TextReader>> text_reader_or =
-      TextReader::FromFile(gff_path);
+      TextReader::FromFile(gff_path, options.num_decompression_threads());
   NUCLEUS_RETURN_IF_ERROR(text_reader_or.status());
 
   GffHeader header;
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of hts_thread_pool.h
+#include "third_party/nucleus/io/hts_thread_pool.h"
+
+#include <map>
+#include <memory>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "htslib/hts.h"
+#include "htslib/thread_pool.h"
+#include "third_party/nucleus/core/status.h"
+
+namespace nucleus {
+
+namespace {
+
+// Registry of live process-wide pools, keyed by number of threads. Holds weak
+// references so that pools are torn down when their last user goes away.
+absl::Mutex shared_pools_mutex(absl::kConstInit);
+std::map<int, std::weak_ptr<HtsThreadPool>>* shared_pools = nullptr;
+
+}  // namespace
+
+std::shared_ptr<HtsThreadPool> HtsThreadPool::Create(int num_threads) {
+  if (num_threads <= 0) return nullptr;
+  hts_tpool* pool = hts_tpool_init(num_threads);
+  if (pool == nullptr) {
+    LOG(WARNING) << "Failed to create htslib thread pool with " << num_threads
+                 << " threads";
+    return nullptr;
+  }
+  return std::shared_ptr<HtsThreadPool>(new HtsThreadPool(pool, num_threads));
+}
+
+std::shared_ptr<HtsThreadPool> HtsThreadPool::Shared(int num_threads) {
+  if (num_threads <= 0) return nullptr;
+  absl::MutexLock lock(&shared_pools_mutex);
+  if (shared_pools == nullptr) {
+    shared_pools = new std::map<int, std::weak_ptr<HtsThreadPool>>();
+  }
+  std::shared_ptr<HtsThreadPool> pool = (*shared_pools)[num_threads].lock();
+  if (pool == nullptr) {
+    pool = Create(num_threads);
+    (*shared_pools)[num_threads] = pool;
+  }
+  return pool;
+}
+
+HtsThreadPool::HtsThreadPool(hts_tpool* pool, int num_threads)
+    : num_threads_(num_threads) {
+  pool_.pool = pool;
+  pool_.qsize = 0;
+}
+
+HtsThreadPool::~HtsThreadPool() {
+  if (pool_.pool != nullptr) {
+    hts_tpool_destroy(pool_.pool);
+    pool_.pool = nullptr;
+  }
+}
+
+::nucleus::Status HtsThreadPool::AttachTo(htsFile* fp) {
+  if (hts_set_thread_pool(fp, &pool_) != 0) {
+    return ::nucleus::Unknown(
+        absl::StrCat("Failed to attach a ", num_threads_,
+                     "-thread htslib pool to ", fp->fn ? fp->fn : "file"));
+  }
+  return ::nucleus::Status();
+}
+
+}  // namespace nucleus
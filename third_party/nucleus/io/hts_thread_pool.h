@@ -0,0 +1,94 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_HTS_THREAD_POOL_H_
+#define THIRD_PARTY_NUCLEUS_IO_HTS_THREAD_POOL_H_
+
+#include <memory>
+
+#include "htslib/hts.h"
+#include "htslib/thread_pool.h"
+#include "third_party/nucleus/core/status.h"
+
+namespace nucleus {
+
+// A thin owning wrapper around an htslib hts_tpool.
+//
+// htslib can offload BGZF inflation/deflation and CRAM (de)coding onto a pool
+// of worker threads attached to an htsFile with hts_set_thread_pool(). The
+// pool must outlive every htsFile it is attached to, so readers and writers
+// hold a std::shared_ptr<HtsThreadPool> and release it only after closing
+// their file.
+//
+// A single pool can be attached to any number of htsFiles. Use Shared() to get
+// the process-wide pool for a given number of threads, so that e.g. all of the
+// SamReaders of a multi-sample run share one set of decompression threads
+// instead of each spinning up their own.
+class HtsThreadPool {
+ public:
+  // Creates a new pool with num_threads worker threads. Returns nullptr if
+  // num_threads <= 0 or htslib fails to create the pool.
+  static std::shared_ptr<HtsThreadPool> Create(int num_threads);
+
+  // Returns the process-wide pool with num_threads worker threads, creating it
+  // if no live pool of that size exists. Returns nullptr if num_threads <= 0.
+  // The pool is destroyed once the last holder releases it.
+  static std::shared_ptr<HtsThreadPool> Shared(int num_threads);
+
+  ~HtsThreadPool();
+
+  // Disable assignment/copy operations
+  HtsThreadPool(const HtsThreadPool& other) = delete;
+  HtsThreadPool& operator=(const HtsThreadPool&) = delete;
+
+  // Attaches this pool to fp. Returns a non-OK status if htslib refuses, e.g.
+  // because fp is neither BGZF-compressed nor CRAM.
+  ::nucleus::Status AttachTo(htsFile* fp);
+
+  int num_threads() const { return num_threads_; }
+
+  // Direct access to the underlying htslib pool, for APIs (e.g. BGZF) that
+  // take an hts_tpool rather than an htsFile.
+  hts_tpool* pool() { return pool_.pool; }
+
+ private:
+  HtsThreadPool(hts_tpool* pool, int num_threads);
+
+  // The htslib pool descriptor passed to hts_set_thread_pool. qsize is left at
+  // 0 so htslib picks its default queue depth.
+  htsThreadPool pool_;
+  const int num_threads_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_HTS_THREAD_POOL_H_
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of in_memory_read_index.h
+#include "third_party/nucleus/io/in_memory_read_index.h"
+
+#include <algorithm>
+
+#include "third_party/nucleus/util/utils.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+
+void InMemoryReadIndex::Replace(const std::vector<const Read*>& reads) {
+  reads_ = reads;
+  by_contig_.clear();
+
+  // Computing a read's end walks its cigar, so do it once per read.
+  struct Entry {
+    int64 start;
+    int64 end;
+    int index;
+  };
+  std::map<string, std::vector<Entry>> entries;
+  for (int i = 0; i < static_cast<int>(reads.size()); ++i) {
+    const Read& read = *reads[i];
+    entries[AlignedContig(read)].push_back({ReadStart(read), ReadEnd(read), i});
+  }
+
+  for (auto& [contig_name, contig_entries] : entries) {
+    std::stable_sort(contig_entries.begin(), contig_entries.end(),
+                     [](const Entry& a, const Entry& b) {
+                       return a.start < b.start;
+                     });
+    Contig& contig = by_contig_[contig_name];
+    contig.starts.reserve(contig_entries.size());
+    contig.ends.reserve(contig_entries.size());
+    contig.max_ends.reserve(contig_entries.size());
+    contig.indices.reserve(contig_entries.size());
+    for (const Entry& entry : contig_entries) {
+      contig.starts.push_back(entry.start);
+      contig.ends.push_back(entry.end);
+      contig.max_ends.push_back(contig.max_ends.empty()
+                                    ? entry.end
+                                    : std::max(contig.max_ends.back(),
+                                               entry.end));
+      contig.indices.push_back(entry.index);
+    }
+  }
+}
+
+void InMemoryReadIndex::ReplacePython(
+    const std::vector<ConstProtoPtr<const Read>>& reads) {
+  std::vector<const Read*> unwrapped;
+  unwrapped.reserve(reads.size());
+  for (const auto& read : reads) {
+    unwrapped.push_back(read.p_);
+  }
+  Replace(unwrapped);
+}
+
+std::vector<int> InMemoryReadIndex::Query(const Range& range) const {
+  std::vector<int> overlapping;
+  auto it = by_contig_.find(range.reference_name());
+  if (it == by_contig_.end()) return overlapping;
+  const Contig& contig = it->second;
+
+  // Reads from end on start at or after the end of range.
+  const size_t end =
+      std::lower_bound(contig.starts.begin(), contig.starts.end(),
+                       range.end()) -
+      contig.starts.begin();
+  // Reads before begin all end at or before the start of range.
+  const size_t begin =
+      std::upper_bound(contig.max_ends.begin(), contig.max_ends.begin() + end,
+                       range.start()) -
+      contig.max_ends.begin();
+  for (size_t i = begin; i < end; ++i) {
+    if (contig.ends[i] > range.start()) {
+      overlapping.push_back(contig.indices[i]);
+    }
+  }
+  std::sort(overlapping.begin(), overlapping.end());
+  return overlapping;
+}
+
+std::vector<const Read*> InMemoryReadIndex::QueryReads(
+    const Range& range) const {
+  std::vector<const Read*> overlapping;
+  for (int index : Query(range)) {
+    overlapping.push_back(reads_[index]);
+  }
+  return overlapping;
+}
+
+}  // namespace nucleus
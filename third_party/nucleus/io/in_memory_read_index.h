@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_IN_MEMORY_READ_INDEX_H_
+#define THIRD_PARTY_NUCLEUS_IO_IN_MEMORY_READ_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+#include "third_party/nucleus/util/proto_ptr.h"
+
+namespace nucleus {
+
+// An overlap index over a set of reads held in memory, such as the reads of
+// one make_examples region, which are queried many times (per candidate, per
+// realignment window, per phasing region) before being replaced.
+//
+// The index does not own or copy the reads; it stores each read's aligned
+// interval and its position in the list it was built from. Reads are sorted by
+// start within each contig, alongside a running maximum of their ends, so a
+// query finds the first read that can reach the region and the first read
+// that starts past it with two binary searches, and then only scans reads
+// that start within that window: O(log N + k) for k overlapping reads when
+// read lengths are similar.
+class InMemoryReadIndex {
+ public:
+  InMemoryReadIndex() = default;
+
+  // Disable copy and assignment operations.
+  InMemoryReadIndex(const InMemoryReadIndex& other) = delete;
+  InMemoryReadIndex& operator=(const InMemoryReadIndex&) = delete;
+
+  // Replaces the indexed reads with reads. The reads must outlive the index,
+  // or at least every call to QueryReads().
+  void Replace(const std::vector<const nucleus::genomics::v1::Read*>& reads);
+  void ReplacePython(
+      const std::vector<
+          nucleus::ConstProtoPtr<const nucleus::genomics::v1::Read>>& reads);
+
+  // Returns the positions, in the list passed to Replace(), of the reads that
+  // overlap range, in increasing order. A read overlaps range under the same
+  // rules as ReadOverlapsRegion().
+  std::vector<int> Query(const nucleus::genomics::v1::Range& range) const;
+  std::vector<int> QueryPython(
+      const nucleus::ConstProtoPtr<const nucleus::genomics::v1::Range>&
+          range_wrapped) const {
+    return Query(*range_wrapped.p_);
+  }
+
+  // Returns the reads that overlap range, in the order passed to Replace().
+  std::vector<const nucleus::genomics::v1::Read*> QueryReads(
+      const nucleus::genomics::v1::Range& range) const;
+
+  // Number of indexed reads.
+  int size() const { return reads_.size(); }
+
+ private:
+  // The reads aligned to one contig, sorted by start. max_ends[i] is the
+  // largest end among reads [0, i], so it is non-decreasing.
+  struct Contig {
+    std::vector<int64> starts;
+    std::vector<int64> ends;
+    std::vector<int64> max_ends;
+    std::vector<int> indices;
+  };
+
+  std::map<string, Contig> by_contig_;
+  std::vector<const nucleus::genomics::v1::Read*> reads_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_IN_MEMORY_READ_INDEX_H_
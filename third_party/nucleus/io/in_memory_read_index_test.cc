@@ -0,0 +1,113 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/io/in_memory_read_index.h"
+
+#include <vector>
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+using std::vector;
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::IsEmpty;
+
+class InMemoryReadIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Deliberately out of order, with a long deletion in the fourth read.
+    reads_ = {
+        MakeRead("chr1", 30, "ACGTA", {"5M"}),              // [30, 35)
+        MakeRead("chr1", 10, "ACGTA", {"5M"}),              // [10, 15)
+        MakeRead("chr2", 10, "ACGTA", {"5M"}),              // [10, 15)
+        MakeRead("chr1", 5, "ACGTA", {"2M", "40D", "3M"}),  // [5, 50)
+        MakeRead("chr1", 20, "ACGTA", {"2S", "3M"}),        // [20, 23)
+    };
+    for (const Read& read : reads_) {
+      read_ptrs_.push_back(&read);
+    }
+    index_.Replace(read_ptrs_);
+  }
+
+  // Returns the positions of the reads overlapping range, found by brute
+  // force with ReadOverlapsRegion.
+  vector<int> Expected(const Range& range) const {
+    vector<int> expected;
+    for (int i = 0; i < static_cast<int>(reads_.size()); ++i) {
+      if (ReadOverlapsRegion(reads_[i], range)) expected.push_back(i);
+    }
+    return expected;
+  }
+
+  vector<Read> reads_;
+  vector<const Read*> read_ptrs_;
+  InMemoryReadIndex index_;
+};
+
+TEST_F(InMemoryReadIndexTest, QueriesMatchReadOverlapsRegion) {
+  EXPECT_EQ(5, index_.size());
+  for (const string& contig : {"chr1", "chr2", "chr3"}) {
+    for (int start = 0; start < 60; ++start) {
+      for (int end = start; end < 60; ++end) {
+        Range range = MakeRange(contig, start, end);
+        EXPECT_THAT(index_.Query(range), ElementsAreArray(Expected(range)))
+            << contig << ":" << start << "-" << end;
+      }
+    }
+  }
+}
+
+TEST_F(InMemoryReadIndexTest, QueryReadsReturnsReadsInInputOrder) {
+  EXPECT_THAT(index_.QueryReads(MakeRange("chr1", 12, 31)),
+              ElementsAre(&reads_[0], &reads_[1], &reads_[3], &reads_[4]));
+  EXPECT_THAT(index_.QueryReads(MakeRange("chr1", 50, 100)), IsEmpty());
+}
+
+TEST_F(InMemoryReadIndexTest, ReplaceDropsPreviousReads) {
+  vector<Read> reads = {MakeRead("chr3", 100, "ACGTA", {"5M"})};
+  index_.Replace({&reads[0]});
+  EXPECT_EQ(1, index_.size());
+  EXPECT_THAT(index_.Query(MakeRange("chr1", 0, 100)), IsEmpty());
+  EXPECT_THAT(index_.Query(MakeRange("chr3", 104, 105)), ElementsAre(0));
+}
+
+}  // namespace nucleus
@@ -32,6 +32,9 @@
 
 #include "third_party/nucleus/io/merge_variants.h"
 
+#include <thread>  // NOLINT
+
+#include "absl/strings/match.h"
 #include "third_party/nucleus/io/reference.h"
 #include "third_party/nucleus/io/variant_reader.h"
 #include "third_party/nucleus/protos/struct.pb.h"
@@ -58,7 +61,8 @@ std::unique_ptr<Variant> CreateRecordFromTemplate(const Variant& t, int start,
     range.set_reference_name(v->reference_name());
     range.set_start(start);
     range.set_end(start + 1);
-    *v->mutable_reference_bases() = ref.GetBases(range).ValueOrDie();
+    const ReferenceBases bases = ref.GetBasesView(range).ValueOrDie();
+    v->set_reference_bases(bases.bases().data(), bases.size());
   }
   return v;
 }
@@ -105,25 +109,22 @@ void MergeAndWriteVariantsAndNonVariants(
     const std::vector<std::string>& non_variant_file_paths,
     const std::string& fasta_path, const std::string& vcf_out_path,
     const std::string& gvcf_out_path,
-    const nucleus::genomics::v1::VcfHeader& header, bool process_somatic) {
+    const nucleus::genomics::v1::VcfHeader& header, bool process_somatic,
+    const nucleus::genomics::v1::VcfWriterOptions& writer_options) {
   // Create VCF and gVCF writers
-  nucleus::genomics::v1::VcfWriterOptions writer_options;
-  writer_options.set_round_qual_values(true);
-  auto writer_or_status =
-      nucleus::VcfWriter::ToFile(vcf_out_path, header, writer_options);
-  if (!writer_or_status.ok()) {
-    LOG(ERROR) << "opening writer failed" << writer_or_status.error_message();
-  }
-  std::unique_ptr<VcfWriter> vcf_writer =
-      std::move(writer_or_status.ValueOrDie());
-
-  writer_or_status =
-      nucleus::VcfWriter::ToFile(gvcf_out_path, header, writer_options);
-  if (!writer_or_status.ok()) {
-    LOG(ERROR) << "opening writer failed" << writer_or_status.error_message();
-  }
-  std::unique_ptr<VcfWriter> gvcf_writer =
-      std::move(writer_or_status.ValueOrDie());
+  auto open_writer = [&](const std::string& path) {
+    nucleus::genomics::v1::VcfWriterOptions options = writer_options;
+    options.set_round_qual_values(true);
+    options.set_write_index(writer_options.write_index() &&
+                            absl::EndsWith(path, ".gz"));
+    auto writer_or_status = nucleus::VcfWriter::ToFile(path, header, options);
+    if (!writer_or_status.ok()) {
+      LOG(ERROR) << "opening writer failed" << writer_or_status.error_message();
+    }
+    return std::move(writer_or_status.ValueOrDie());
+  };
+  std::unique_ptr<VcfWriter> vcf_writer = open_writer(vcf_out_path);
+  std::unique_ptr<VcfWriter> gvcf_writer = open_writer(gvcf_out_path);
 
   // Create fasta reader
   std::unique_ptr<IndexedFastaReader> fasta_reader =
@@ -138,12 +139,16 @@ void MergeAndWriteVariantsAndNonVariants(
   }
 
   // Create reader for variants
-  std::unique_ptr<VariantReader> variant_reader =
-      VariantReader::Open(variant_file_path, "", contig_index_map);
+  std::unique_ptr<VariantReader> variant_reader = VariantReader::Open(
+      variant_file_path, "", contig_index_map, kPrefetchedRecords);
 
-  // Create reader for non_variants
+  // Create reader for non_variants. Every prefetching shard takes a thread, so
+  // shards are only prefetched when there are no more of them than cores.
+  const bool prefetch_shards =
+      non_variant_file_paths.size() <= std::thread::hardware_concurrency();
   std::unique_ptr<ShardedVariantReader> non_variant_reader =
-      ShardedVariantReader::Open(non_variant_file_paths, contig_index_map);
+      ShardedVariantReader::Open(non_variant_file_paths, contig_index_map,
+                                 prefetch_shards ? kPrefetchedRecords : 0);
 
   MergeAndWriteVariantsAndNonVariants(
       only_keep_pass, variant_reader.get(), non_variant_reader.get(),
@@ -57,13 +57,19 @@ void TransfromToGvcf(Variant* variant);
 // modifies the input variant to mimic this transformation of GL -> PL -> GL.
 void ZeroScaleGl(Variant* variant);
 
+// Writes the merged VCF and gVCF to vcf_out_path and gvcf_out_path. QUALs are
+// always rounded; the remaining writer_options (e.g. compression threads) are
+// applied to both outputs, and write_index is honored only for outputs ending
+// in ".gz".
 void MergeAndWriteVariantsAndNonVariants(
     bool only_keep_pass, const std::string& variant_file_path,
     const std::vector<std::string>& non_variant_file_paths,
     const std::string& fasta_path, const std::string& vcf_out_path,
     const std::string& gvcf_out_path,
     const nucleus::genomics::v1::VcfHeader& header,
-    bool process_somatic = false);
+    bool process_somatic = false,
+    const nucleus::genomics::v1::VcfWriterOptions& writer_options =
+        nucleus::genomics::v1::VcfWriterOptions());
 
 void MergeAndWriteVariantsAndNonVariants(
     bool only_keep_pass, VariantReader* variant_reader,
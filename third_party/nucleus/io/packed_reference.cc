@@ -0,0 +1,454 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/io/packed_reference.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "absl/log/check.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "third_party/nucleus/util/utils.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::ContigInfo;
+using nucleus::genomics::v1::FastaReaderOptions;
+using nucleus::genomics::v1::Range;
+
+namespace {
+
+constexpr char kMagic[] = "NUCPACK\x01";
+constexpr size_t kMagicLength = sizeof(kMagic) - 1;
+
+// The bases stored in the packed array, indexed by their 2-bit code.
+constexpr char kBases[] = "ACGT";
+
+// Returns the 2-bit code of base, or -1 if base must be stored as a run.
+int BaseCode(char base) {
+  switch (base) {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default: return -1;
+  }
+}
+
+// Maps each packed byte to the four bases it holds.
+using DecodeTable = std::array<std::array<char, 4>, 256>;
+
+const DecodeTable& GetDecodeTable() {
+  static const DecodeTable* const table = [] {
+    auto* t = new DecodeTable;
+    for (int byte = 0; byte < 256; ++byte) {
+      for (int i = 0; i < 4; ++i) {
+        (*t)[byte][i] = kBases[(byte >> (2 * i)) & 3];
+      }
+    }
+    return t;
+  }();
+  return *table;
+}
+
+// Writes the bases [start, end) of the contig packed at packed into out.
+void DecodeBases(const uint8* packed, int64 start, int64 end, char* out) {
+  int64 i = start;
+  for (; i < end && i % 4 != 0; ++i) {
+    *out++ = kBases[(packed[i / 4] >> (2 * (i % 4))) & 3];
+  }
+  // The bulk of the range decodes a whole byte, four bases, per lookup.
+  const DecodeTable& table = GetDecodeTable();
+  for (const uint8* byte = packed + i / 4; i + 4 <= end; i += 4, out += 4) {
+    memcpy(out, table[*byte++].data(), 4);
+  }
+  for (; i < end; ++i) {
+    *out++ = kBases[(packed[i / 4] >> (2 * (i % 4))) & 3];
+  }
+}
+
+void AppendInt64(int64 value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(const string& value, string* out) {
+  AppendInt64(value.size(), out);
+  out->append(value);
+}
+
+// Reads the fields of a file written by PackedFastaReader::Write().
+class FieldReader {
+ public:
+  FieldReader(const char* data, size_t size)
+      : pos_(data), end_(data + size) {}
+
+  bool ReadInt64(int64* value) {
+    if (end_ - pos_ < static_cast<int64>(sizeof(*value))) return false;
+    memcpy(value, pos_, sizeof(*value));
+    pos_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadString(string* value) {
+    int64 length;
+    if (!ReadInt64(&length) || length < 0 || length > end_ - pos_) {
+      return false;
+    }
+    value->assign(pos_, length);
+    pos_ += length;
+    return true;
+  }
+
+  const char* pos() const { return pos_; }
+  int64 remaining() const { return end_ - pos_; }
+
+ private:
+  const char* pos_;
+  const char* end_;
+};
+
+}  // namespace
+
+// Iterable class for traversing all contigs of a PackedFastaReader.
+class PackedFastaReaderIterable : public GenomeReferenceRecordIterable {
+ public:
+  // Advance to the next record.
+  StatusOr<bool> Next(GenomeReferenceRecord* out) override;
+
+  // Constructor is invoked via PackedFastaReader::Iterate.
+  explicit PackedFastaReaderIterable(const PackedFastaReader* reader)
+      : Iterable(reader) {}
+
+ private:
+  size_t pos_ = 0;
+};
+
+StatusOr<bool> PackedFastaReaderIterable::Next(GenomeReferenceRecord* out) {
+  NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
+  const PackedFastaReader* reader =
+      static_cast<const PackedFastaReader*>(reader_);
+  if (pos_ >= reader->Contigs().size()) return false;
+  DCHECK_NE(nullptr, out) << "FASTA record cannot be null";
+  const ContigInfo& contig = reader->Contigs()[pos_];
+  StatusOr<string> bases =
+      reader->GetBases(MakeRange(contig.name(), 0, contig.n_bases()));
+  NUCLEUS_RETURN_IF_ERROR(bases.status());
+  out->first = contig.name();
+  out->second = std::move(bases.ValueOrDie());
+  pos_++;
+  return true;
+}
+
+PackedFastaReader::PackedFastaReader(const FastaReaderOptions& options)
+    : options_(options) {}
+
+PackedFastaReader::~PackedFastaReader() {}
+
+StatusOr<std::unique_ptr<PackedFastaReader>> PackedFastaReader::FromFasta(
+    const string& fasta_path, const string& fai_path,
+    const FastaReaderOptions& options) {
+  // Read the true case so that the soft-masking can be recorded, and skip the
+  // cache as every base is read exactly once.
+  FastaReaderOptions fasta_options = options;
+  fasta_options.set_keep_true_case(true);
+  StatusOr<std::unique_ptr<IndexedFastaReader>> fasta =
+      IndexedFastaReader::FromFile(fasta_path, fai_path, fasta_options, 0);
+  NUCLEUS_RETURN_IF_ERROR(fasta.status());
+  return FromReference(*fasta.ValueOrDie(), options);
+}
+
+StatusOr<std::unique_ptr<PackedFastaReader>> PackedFastaReader::FromReference(
+    const GenomeReference& reference, const FastaReaderOptions& options) {
+  std::unique_ptr<PackedFastaReader> packed(new PackedFastaReader(options));
+  for (const ContigInfo& contig : reference.Contigs()) {
+    StatusOr<string> bases =
+        reference.GetBases(MakeRange(contig.name(), 0, contig.n_bases()));
+    NUCLEUS_RETURN_IF_ERROR(bases.status());
+    packed->AddContig(contig, bases.ValueOrDie());
+  }
+  packed->packed_ = reinterpret_cast<const uint8*>(packed->owned_bases_.data());
+  packed->packed_bytes_ = packed->owned_bases_.size();
+  return std::move(packed);
+}
+
+StatusOr<std::unique_ptr<PackedFastaReader>> PackedFastaReader::FromFile(
+    const string& packed_path, const FastaReaderOptions& options) {
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  tensorflow::Status s = tensorflow::Env::Default()
+      ->NewReadOnlyMemoryRegionFromFile(packed_path, &region);
+  if (!s.ok()) {
+    return ::nucleus::NotFound(
+        absl::StrCat("Could not map ", packed_path, ": ", s.ToString()));
+  }
+  std::unique_ptr<PackedFastaReader> packed(new PackedFastaReader(options));
+  ::nucleus::Status parsed = packed->Parse(
+      static_cast<const char*>(region->data()), region->length());
+  if (!parsed.ok()) {
+    return ::nucleus::DataLoss(absl::StrCat("Malformed packed reference ",
+                                            packed_path, ": ",
+                                            parsed.error_message()));
+  }
+  packed->region_ = std::move(region);
+  return std::move(packed);
+}
+
+void PackedFastaReader::AddContig(const ContigInfo& info,
+                                  const string& bases) {
+  const auto extend = [](std::vector<Run>* runs, int64 pos, char base) {
+    if (!runs->empty() && runs->back().end == pos &&
+        runs->back().base == base) {
+      ++runs->back().end;
+    } else {
+      runs->push_back({pos, pos + 1, base});
+    }
+  };
+
+  PackedContig contig;
+  contig.offset = owned_bases_.size();
+  const int64 n_bases = bases.size();
+  owned_bases_.resize(contig.offset + (n_bases + 3) / 4, '\0');
+  uint8* packed = reinterpret_cast<uint8*>(&owned_bases_[contig.offset]);
+  for (int64 i = 0; i < n_bases; ++i) {
+    const char base = absl::ascii_toupper(bases[i]);
+    if (base != bases[i]) extend(&contig.masked, i, '\0');
+    const int code = BaseCode(base);
+    if (code < 0) {
+      extend(&contig.ambiguous, i, base);
+    } else {
+      packed[i / 4] |= code << (2 * (i % 4));
+    }
+  }
+
+  contig_index_[info.name()] = contigs_.size();
+  contigs_.push_back(info);
+  contigs_.back().set_n_bases(n_bases);
+  contigs_.back().set_pos_in_fasta(contigs_.size() - 1);
+  packed_contigs_.push_back(std::move(contig));
+}
+
+// A packed reference file is:
+//   magic
+//   int64 number of contigs, then for each contig:
+//     string name, string description, int64 n_bases, int64 offset,
+//     int64 number of ambiguous runs, then (int64 start, int64 end, int64 base)
+//       for each,
+//     int64 number of masked runs, then (int64 start, int64 end) for each
+//   int64 number of packed bytes, then the packed bytes
+// where strings are an int64 length followed by their bytes.
+::nucleus::Status PackedFastaReader::Write(const string& path) const {
+  if (packed_ == nullptr) {
+    return ::nucleus::FailedPrecondition(
+        "can't write a closed PackedFastaReader object.");
+  }
+  string header(kMagic, kMagicLength);
+  AppendInt64(contigs_.size(), &header);
+  for (size_t i = 0; i < contigs_.size(); ++i) {
+    const PackedContig& contig = packed_contigs_[i];
+    AppendString(contigs_[i].name(), &header);
+    AppendString(contigs_[i].description(), &header);
+    AppendInt64(contigs_[i].n_bases(), &header);
+    AppendInt64(contig.offset, &header);
+    AppendInt64(contig.ambiguous.size(), &header);
+    for (const Run& run : contig.ambiguous) {
+      AppendInt64(run.start, &header);
+      AppendInt64(run.end, &header);
+      AppendInt64(run.base, &header);
+    }
+    AppendInt64(contig.masked.size(), &header);
+    for (const Run& run : contig.masked) {
+      AppendInt64(run.start, &header);
+      AppendInt64(run.end, &header);
+    }
+  }
+  AppendInt64(packed_bytes_, &header);
+
+  // The packed bases are written directly rather than copied into one big
+  // string with the header.
+  std::unique_ptr<tensorflow::WritableFile> file;
+  tensorflow::Status s = tensorflow::Env::Default()->NewWritableFile(path,
+                                                                     &file);
+  if (s.ok()) s = file->Append(header);
+  if (s.ok()) {
+    s = file->Append(tensorflow::StringPiece(
+        reinterpret_cast<const char*>(packed_), packed_bytes_));
+  }
+  if (s.ok()) s = file->Close();
+  if (!s.ok()) {
+    return ::nucleus::Unknown(absl::StrCat(
+        "Failed to write packed reference ", path, ": ", s.ToString()));
+  }
+  return ::nucleus::Status();
+}
+
+::nucleus::Status PackedFastaReader::Parse(const char* data, size_t size) {
+  if (size < kMagicLength || memcmp(data, kMagic, kMagicLength) != 0) {
+    return ::nucleus::DataLoss("bad magic number");
+  }
+  FieldReader reader(data + kMagicLength, size - kMagicLength);
+  int64 n_contigs;
+  if (!reader.ReadInt64(&n_contigs) || n_contigs < 0) {
+    return ::nucleus::DataLoss("bad number of contigs");
+  }
+  for (int64 i = 0; i < n_contigs; ++i) {
+    ContigInfo info;
+    PackedContig contig;
+    string name, description;
+    int64 n_bases, n_ambiguous, n_masked;
+    if (!reader.ReadString(&name) || !reader.ReadString(&description) ||
+        !reader.ReadInt64(&n_bases) || !reader.ReadInt64(&contig.offset) ||
+        !reader.ReadInt64(&n_ambiguous) || n_bases < 0 || n_ambiguous < 0) {
+      return ::nucleus::DataLoss(absl::StrCat("truncated contig ", i));
+    }
+    for (int64 j = 0; j < n_ambiguous; ++j) {
+      Run run;
+      int64 base;
+      if (!reader.ReadInt64(&run.start) || !reader.ReadInt64(&run.end) ||
+          !reader.ReadInt64(&base)) {
+        return ::nucleus::DataLoss(absl::StrCat("truncated contig ", name));
+      }
+      run.base = static_cast<char>(base);
+      contig.ambiguous.push_back(run);
+    }
+    if (!reader.ReadInt64(&n_masked) || n_masked < 0) {
+      return ::nucleus::DataLoss(absl::StrCat("truncated contig ", name));
+    }
+    for (int64 j = 0; j < n_masked; ++j) {
+      Run run = {0, 0, '\0'};
+      if (!reader.ReadInt64(&run.start) || !reader.ReadInt64(&run.end)) {
+        return ::nucleus::DataLoss(absl::StrCat("truncated contig ", name));
+      }
+      contig.masked.push_back(run);
+    }
+    // Runs must be sorted, disjoint and within the contig.
+    for (const std::vector<Run>* runs : {&contig.ambiguous, &contig.masked}) {
+      int64 prev_end = 0;
+      for (const Run& run : *runs) {
+        if (run.start < prev_end || run.start >= run.end ||
+            run.end > n_bases) {
+          return ::nucleus::DataLoss(
+              absl::StrCat("bad runs for contig ", name));
+        }
+        prev_end = run.end;
+      }
+    }
+    info.set_name(name);
+    info.set_description(description);
+    info.set_n_bases(n_bases);
+    info.set_pos_in_fasta(i);
+    contig_index_[name] = contigs_.size();
+    contigs_.push_back(std::move(info));
+    packed_contigs_.push_back(std::move(contig));
+  }
+
+  if (!reader.ReadInt64(&packed_bytes_) ||
+      packed_bytes_ != reader.remaining()) {
+    return ::nucleus::DataLoss("bad number of packed bytes");
+  }
+  for (size_t i = 0; i < contigs_.size(); ++i) {
+    const int64 offset = packed_contigs_[i].offset;
+    if (offset < 0 ||
+        offset + (contigs_[i].n_bases() + 3) / 4 > packed_bytes_) {
+      return ::nucleus::DataLoss(
+          absl::StrCat("bad offset for contig ", contigs_[i].name()));
+    }
+  }
+  packed_ = reinterpret_cast<const uint8*>(reader.pos());
+  return ::nucleus::Status();
+}
+
+StatusOr<string> PackedFastaReader::GetBases(const Range& range) const {
+  if (packed_ == nullptr) {
+    return ::nucleus::FailedPrecondition(
+        "can't read from closed PackedFastaReader object.");
+  }
+  if (!IsValidInterval(range))
+    return ::nucleus::InvalidArgument(
+        absl::StrCat("Invalid interval: ", range.ShortDebugString()));
+
+  const PackedContig& contig =
+      packed_contigs_[contig_index_.at(range.reference_name())];
+  const int64 start = range.start();
+  const int64 end = range.end();
+  string bases(end - start, '\0');
+  DecodeBases(packed_ + contig.offset, start, end, &bases[0]);
+
+  // Returns the first of the sorted runs that ends after start.
+  const auto first_run = [start](const std::vector<Run>& runs) {
+    return std::partition_point(
+        runs.begin(), runs.end(),
+        [start](const Run& run) { return run.end <= start; });
+  };
+  for (auto run = first_run(contig.ambiguous);
+       run != contig.ambiguous.end() && run->start < end; ++run) {
+    const int64 run_start = std::max(run->start, start);
+    const int64 run_end = std::min(run->end, end);
+    std::fill(bases.begin() + (run_start - start),
+              bases.begin() + (run_end - start), run->base);
+  }
+  if (options_.keep_true_case()) {
+    for (auto run = first_run(contig.masked);
+         run != contig.masked.end() && run->start < end; ++run) {
+      const int64 run_start = std::max(run->start, start);
+      const int64 run_end = std::min(run->end, end);
+      for (int64 i = run_start; i < run_end; ++i) {
+        bases[i - start] = absl::ascii_tolower(bases[i - start]);
+      }
+    }
+  }
+  return bases;
+}
+
+StatusOr<std::shared_ptr<GenomeReferenceRecordIterable>>
+PackedFastaReader::Iterate() const {
+  return StatusOr<std::shared_ptr<GenomeReferenceRecordIterable>>(
+      MakeIterable<PackedFastaReaderIterable>(this));
+}
+
+::nucleus::Status PackedFastaReader::Close() {
+  if (packed_ == nullptr) {
+    return ::nucleus::FailedPrecondition("PackedFastaReader already closed");
+  }
+  packed_ = nullptr;
+  owned_bases_ = string();
+  region_.reset();
+  return ::nucleus::Status();
+}
+
+}  // namespace nucleus
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_PACKED_REFERENCE_H_
+#define THIRD_PARTY_NUCLEUS_IO_PACKED_REFERENCE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "third_party/nucleus/io/reference.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/fasta.pb.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reference.pb.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace tensorflow {
+class ReadOnlyMemoryRegion;
+}  // namespace tensorflow
+
+namespace nucleus {
+
+// A GenomeReference holding a whole genome in memory, packed at two bits per
+// base.
+//
+// A/C/G/T are stored in the packed array. Everything else (N and the other
+// IUPAC codes) is stored as runs of identical bases in a small sidecar, as is
+// the soft-masking (lower case) of the original FASTA, which is only applied
+// to returned bases if the options ask for keep_true_case. GRCh38 packs into
+// ~780MB plus a few MB of runs, a quarter of its size as text, and
+// GetBases() only has to decode the requested interval.
+//
+// A PackedFastaReader can be built from any FASTA, and saved with Write() so
+// that later processes load it with FromFile(), which maps the file read-only
+// instead of parsing the FASTA again. Concurrent processes mapping the same
+// file share its pages. Files are written in host byte order.
+//
+// All const methods are safe to call concurrently.
+class PackedFastaReader : public GenomeReference {
+ public:
+  // Packs all of the contigs of the indexed FASTA fasta_path. The options
+  // control the returned bases as for an IndexedFastaReader.
+  static StatusOr<std::unique_ptr<PackedFastaReader>> FromFasta(
+      const string& fasta_path, const string& fai_path,
+      const nucleus::genomics::v1::FastaReaderOptions& options);
+
+  // Packs all of the contigs of reference. Soft-masking is only recorded if
+  // reference returns true case bases.
+  static StatusOr<std::unique_ptr<PackedFastaReader>> FromReference(
+      const GenomeReference& reference,
+      const nucleus::genomics::v1::FastaReaderOptions& options);
+
+  // Maps a file written by Write().
+  static StatusOr<std::unique_ptr<PackedFastaReader>> FromFile(
+      const string& packed_path,
+      const nucleus::genomics::v1::FastaReaderOptions& options);
+
+  ~PackedFastaReader() override;
+
+  // Disable copy and assignment operations
+  PackedFastaReader(const PackedFastaReader& other) = delete;
+  PackedFastaReader& operator=(const PackedFastaReader&) = delete;
+
+  // Writes this reference to path, to be loaded again with FromFile().
+  ::nucleus::Status Write(const string& path) const;
+
+  const std::vector<nucleus::genomics::v1::ContigInfo>& Contigs()
+      const override {
+    return contigs_;
+  }
+
+  StatusOr<string> GetBases(
+      const nucleus::genomics::v1::Range& range) const override;
+
+  StatusOr<std::shared_ptr<GenomeReferenceRecordIterable>> Iterate()
+      const override;
+
+  ::nucleus::Status Close() override;
+
+  // Get the options controlling the behavior of this reader.
+  const nucleus::genomics::v1::FastaReaderOptions& Options() const {
+    return options_;
+  }
+
+  // Returns the number of bytes used by the packed bases.
+  int64 PackedBytes() const { return packed_bytes_; }
+
+ private:
+  // A run of bases [start, end) on a contig that are all the same base. For
+  // soft-masked runs base is unused.
+  struct Run {
+    int64 start;
+    int64 end;
+    char base;
+  };
+
+  struct PackedContig {
+    // Offset of the contig's first base in the packed bases.
+    int64 offset;
+    std::vector<Run> ambiguous;
+    std::vector<Run> masked;
+  };
+
+  // Must use one of the static factory methods.
+  explicit PackedFastaReader(
+      const nucleus::genomics::v1::FastaReaderOptions& options);
+
+  // Packs bases as the next contig of this reference, described by info.
+  void AddContig(const nucleus::genomics::v1::ContigInfo& info,
+                 const string& bases);
+
+  // Sets up the contigs and packed bases of this reader from the contents
+  // of a file written by Write(), which must stay alive while this reader is.
+  ::nucleus::Status Parse(const char* data, size_t size);
+
+  const nucleus::genomics::v1::FastaReaderOptions options_;
+
+  std::vector<nucleus::genomics::v1::ContigInfo> contigs_;
+  std::vector<PackedContig> packed_contigs_;
+  std::unordered_map<string, int> contig_index_;
+
+  // The packed bases, in contig order, each contig starting at a byte
+  // boundary: base i of a contig is in bits [2 * (i % 4), 2 * (i % 4) + 2)
+  // of byte offset + i / 4. They live in either owned_bases_ or region_.
+  const uint8* packed_ = nullptr;
+  int64 packed_bytes_ = 0;
+  string owned_bases_;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_PACKED_REFERENCE_H_
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/io/packed_reference.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/reference.h"
+#include "third_party/nucleus/protos/fasta.pb.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+#include "third_party/nucleus/core/status_matchers.h"
+
+namespace nucleus {
+
+using absl::StrCat;
+using nucleus::genomics::v1::ContigInfo;
+using nucleus::genomics::v1::FastaReaderOptions;
+using nucleus::genomics::v1::ReferenceSequence;
+using ::testing::Not;
+
+namespace {
+
+constexpr char kFastaFilename[] = "test.fasta";
+
+FastaReaderOptions TrueCaseOptions(bool keep_true_case) {
+  FastaReaderOptions options;
+  options.set_keep_true_case(keep_true_case);
+  return options;
+}
+
+std::unique_ptr<IndexedFastaReader> OpenFasta(bool keep_true_case) {
+  const string fasta = GetTestData(kFastaFilename);
+  return std::move(IndexedFastaReader::FromFile(fasta, StrCat(fasta, ".fai"),
+                                                TrueCaseOptions(keep_true_case))
+                       .ValueOrDie());
+}
+
+std::unique_ptr<PackedFastaReader> PackFasta(bool keep_true_case) {
+  const string fasta = GetTestData(kFastaFilename);
+  return std::move(PackedFastaReader::FromFasta(fasta, StrCat(fasta, ".fai"),
+                                                TrueCaseOptions(keep_true_case))
+                       .ValueOrDie());
+}
+
+// Checks that packed returns the same bases as expected for every interval
+// of up to 12 bases, and for every whole contig.
+void ExpectSameBases(const GenomeReference& expected,
+                     const GenomeReference& packed) {
+  ASSERT_EQ(expected.ContigNames(), packed.ContigNames());
+  for (const ContigInfo& contig : expected.Contigs()) {
+    EXPECT_EQ(packed.Contig(contig.name()).ValueOrDie()->n_bases(),
+              contig.n_bases());
+    for (int64 start = 0; start < contig.n_bases(); ++start) {
+      for (int64 end = start;
+           end <= std::min(start + 12, contig.n_bases()); ++end) {
+        const auto range = MakeRange(contig.name(), start, end);
+        EXPECT_EQ(packed.GetBases(range).ValueOrDie(),
+                  expected.GetBases(range).ValueOrDie())
+            << range.ShortDebugString();
+      }
+    }
+    const auto range = MakeRange(contig.name(), 0, contig.n_bases());
+    EXPECT_EQ(packed.GetBases(range).ValueOrDie(),
+              expected.GetBases(range).ValueOrDie());
+  }
+}
+
+}  // namespace
+
+TEST(PackedFastaReaderTest, MatchesIndexedFastaReader) {
+  for (bool keep_true_case : {false, true}) {
+    ExpectSameBases(*OpenFasta(keep_true_case), *PackFasta(keep_true_case));
+  }
+}
+
+TEST(PackedFastaReaderTest, PacksAmbiguousAndMaskedRuns) {
+  const string bases = "NNACGTRYKMacgtnNNnACGTACGTAAggNN";
+  ContigInfo contig;
+  contig.set_name("chr1");
+  contig.set_n_bases(bases.size());
+  ReferenceSequence seq;
+  seq.mutable_region()->set_reference_name("chr1");
+  seq.mutable_region()->set_end(bases.size());
+  seq.set_bases(bases);
+  std::unique_ptr<InMemoryFastaReader> expected =
+      std::move(InMemoryFastaReader::Create({contig}, {seq}).ValueOrDie());
+
+  std::unique_ptr<PackedFastaReader> packed = std::move(
+      PackedFastaReader::FromReference(*expected, TrueCaseOptions(true))
+          .ValueOrDie());
+  ExpectSameBases(*expected, *packed);
+  EXPECT_EQ(packed->PackedBytes(), (bases.size() + 3) / 4);
+
+  std::unique_ptr<PackedFastaReader> upper = std::move(
+      PackedFastaReader::FromReference(*expected, TrueCaseOptions(false))
+          .ValueOrDie());
+  EXPECT_EQ(upper->GetBases(MakeRange("chr1", 8, 20)).ValueOrDie(),
+            "KMACGTNNNNAC");
+}
+
+TEST(PackedFastaReaderTest, WriteAndMapRoundTrip) {
+  const string path = MakeTempFile("packed_reference_test.nucpack");
+  ASSERT_THAT(PackFasta(true)->Write(path), IsOK());
+
+  for (bool keep_true_case : {false, true}) {
+    StatusOr<std::unique_ptr<PackedFastaReader>> mapped =
+        PackedFastaReader::FromFile(path, TrueCaseOptions(keep_true_case));
+    ASSERT_THAT(mapped, IsOK());
+    ExpectSameBases(*OpenFasta(keep_true_case), *mapped.ValueOrDie());
+    EXPECT_EQ(mapped.ValueOrDie()->Contig("chr2").ValueOrDie()->description(),
+              "multi-word description is here");
+  }
+}
+
+TEST(PackedFastaReaderTest, RejectsMalformedFiles) {
+  const string packed_path = MakeTempFile("packed_reference_test.full");
+  ASSERT_THAT(PackFasta(false)->Write(packed_path), IsOK());
+  string contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                           packed_path, &contents));
+
+  // Not a packed reference at all, and a truncated one.
+  for (const string& bad : {string("not a packed reference"),
+                            contents.substr(0, contents.size() - 1)}) {
+    const string path = MakeTempFile("packed_reference_test.bad");
+    TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                              path, bad));
+    EXPECT_THAT(PackedFastaReader::FromFile(path, FastaReaderOptions()),
+                IsNotOKWithCodeAndMessage(absl::StatusCode::kDataLoss,
+                                          "Malformed packed reference"));
+  }
+  EXPECT_THAT(PackedFastaReader::FromFile(
+                  MakeTempFile("packed_reference_test.missing"),
+                  FastaReaderOptions()),
+              Not(IsOK()));
+}
+
+TEST(PackedFastaReaderTest, IteratesOverContigs) {
+  auto packed = PackFasta(false);
+  std::vector<GenomeReferenceRecord> records =
+      as_vector(packed->Iterate().ValueOrDie());
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records[0].first, "chrM");
+  EXPECT_EQ(records[2].second,
+            OpenFasta(false)->GetBases(MakeRange("chr2", 0, 121)).ValueOrDie());
+}
+
+TEST(PackedFastaReaderTest, InvalidQueriesAndClosedReaderFail) {
+  auto packed = PackFasta(false);
+  EXPECT_THAT(packed->GetBases(MakeRange("chr3", 0, 1)), Not(IsOK()));
+  EXPECT_THAT(packed->GetBases(MakeRange("chrM", 10, 1000)), Not(IsOK()));
+  ASSERT_THAT(packed->Close(), IsOK());
+  EXPECT_THAT(packed->GetBases(MakeRange("chrM", 0, 10)),
+              IsNotOKWithCodeAndMessage(
+                  absl::StatusCode::kFailedPrecondition,
+                  "can't read from closed PackedFastaReader object"));
+}
+
+}  // namespace nucleus
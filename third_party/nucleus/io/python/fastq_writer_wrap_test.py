@@ -90,6 +90,23 @@ class WrapFastqWriterTest(parameterized.TestCase):
     with epath.Path(out_fname).open('r') as f:
       self.assertEqual(f.readlines(), self.expected_fastq_content)
 
+  def test_writing_batches(self):
+    batch = fastq.FastqBatch()
+    with fastq.NativeFastqReader(
+        test_utils.genomics_core_testdata('test_reads.fastq')) as reader:
+      reader.read_batch(batch, 3)
+      self.assertEqual(batch.size(), 3)
+      out_fname = test_utils.test_tmpfile('batches.fastq')
+      with fastq.NativeFastqWriter(out_fname) as writer:
+        writer.write_batch(batch)
+        # The last batch is short, since the file has only one more record.
+        reader.read_batch(batch, 3)
+        self.assertEqual(batch.size(), 1)
+        writer.write_batch(batch)
+
+    with epath.Path(out_fname).open('r') as f:
+      self.assertEqual(f.readlines(), self.expected_fastq_content)
+
   def test_context_manager(self):
     with self.writer:
       # Writing within the context manager succeeds.
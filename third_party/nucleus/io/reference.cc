@@ -36,6 +36,7 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <memory>
 #include <utility>
 
 #include "absl/strings/ascii.h"
@@ -47,6 +48,7 @@
 #include "third_party/nucleus/protos/fasta.pb.h"
 #include "third_party/nucleus/protos/range.pb.h"
 #include "third_party/nucleus/protos/reference.pb.h"
+#include "third_party/nucleus/util/tracing.h"
 #include "third_party/nucleus/util/utils.h"
 #include "third_party/nucleus/core/status.h"
 #include "third_party/nucleus/core/statusor.h"
@@ -90,6 +92,13 @@ StatusOr<const nucleus::genomics::v1::ContigInfo*> GenomeReference::Contig(
   return ::nucleus::NotFound(absl::StrCat("Unknown contig ", contig_name));
 }
 
+StatusOr<ReferenceBases> GenomeReference::GetBasesView(
+    const Range& range) const {
+  StatusOr<string> bases = GetBases(range);
+  NUCLEUS_RETURN_IF_ERROR(bases.status());
+  return ReferenceBases(std::move(bases.ValueOrDie()));
+}
+
 // Note that start and end are 0-based, and end is exclusive. So end
 // can go up to the number of bases on contig.
 bool GenomeReference::IsValidInterval(const Range& range) const {
@@ -108,6 +117,14 @@ bool GenomeReference::IsValidInterval(const Range& range) const {
 // ###########################################################################
 
 namespace {
+
+// Number of independently locked shards of the IndexedFastaReader block cache.
+constexpr int kCacheShards = 8;
+
+// Tracing counters for IndexedFastaReader block cache lookups.
+constexpr char kTraceCacheHits[] = "reference cache hits";
+constexpr char kTraceCacheMisses[] = "reference cache misses";
+
 // Gets information about the contigs from the fai index faidx.
 std::vector<nucleus::genomics::v1::ContigInfo> ExtractContigsFromFai(
     const faidx_t* faidx) {
@@ -170,9 +187,15 @@ IndexedFastaReader::IndexedFastaReader(
       faidx_(faidx),
       options_(options),
       contigs_(ExtractContigsFromFai(faidx)),
-      cache_size_bases_(cache_size_bases),
-      small_read_cache_(),
-      cached_range_() {}
+      cache_size_bases_(cache_size_bases) {
+  if (cache_size_bases_ > 0) {
+    const int cache_blocks = options.cache_blocks() > 0
+                                 ? options.cache_blocks()
+                                 : INDEXED_FASTA_READER_DEFAULT_CACHE_BLOCKS;
+    cache_ = std::make_unique<ShardedLruCache<std::pair<string, int64>, string>>(
+        cache_blocks, std::min(cache_blocks, kCacheShards));
+  }
+}
 
 IndexedFastaReader::~IndexedFastaReader() {
   if (faidx_) {
@@ -195,30 +218,86 @@ StatusOr<string> IndexedFastaReader::GetBases(const Range& range) const {
     return string("");
   }
 
-  bool use_cache = (cache_size_bases_ > 0) &&
-                   (range.end() - range.start() <= cache_size_bases_);
-  Range range_to_fetch;
-
-  if (use_cache) {
-    if (cached_range_ && RangeContains(*cached_range_, range)) {
-      // Get from cache!
-      string result = small_read_cache_.substr(
-          range.start() - cached_range_->start(), range.end() - range.start());
-      return result;
-    } else {
-      // Prepare to fetch a sizeable chunk from the FASTA.
-      int64 contig_n_bases =
-          Contig(range.reference_name()).ValueOrDie()->n_bases();
-      range_to_fetch = MakeRange(
-          range.reference_name(), range.start(),
-          std::min(static_cast<int64>(range.start() + cache_size_bases_),
-                   contig_n_bases));
-      CHECK(IsValidInterval(range_to_fetch));
-    }
-  } else {
-    range_to_fetch = range;
+  if (cache_ == nullptr || range.end() - range.start() > cache_size_bases_) {
+    ++cache_misses_;
+    TraceCount(kTraceCacheMisses);
+    return FetchBases(range);
+  }
+
+  // A range no longer than a block spans at most two blocks.
+  const int64 contig_n_bases =
+      Contig(range.reference_name()).ValueOrDie()->n_bases();
+  const int64 first_block = range.start() / cache_size_bases_;
+  const int64 last_block = (range.end() - 1) / cache_size_bases_;
+  bool hit = true;
+  string result;
+  result.reserve(range.end() - range.start());
+  for (int64 block = first_block; block <= last_block; ++block) {
+    StatusOr<std::shared_ptr<const string>> bases_or =
+        GetBlock(range.reference_name(), contig_n_bases, block, &hit);
+    NUCLEUS_RETURN_IF_ERROR(bases_or.status());
+    const string& bases = *bases_or.ValueOrDie();
+    const int64 block_start = block * cache_size_bases_;
+    const int64 start = std::max(range.start(), block_start);
+    const int64 end = std::min(range.end(), block_start + cache_size_bases_);
+    result.append(bases, start - block_start, end - start);
+  }
+  ++(hit ? cache_hits_ : cache_misses_);
+  TraceCount(hit ? kTraceCacheHits : kTraceCacheMisses);
+  return result;
+}
+
+StatusOr<ReferenceBases> IndexedFastaReader::GetBasesView(
+    const Range& range) const {
+  // Empty, invalid and multi-block ranges, and reads from a closed reader,
+  // are left to GetBases to copy or report.
+  if (faidx_ == nullptr || cache_ == nullptr ||
+      range.start() >= range.end() || !IsValidInterval(range) ||
+      range.start() / cache_size_bases_ !=
+          (range.end() - 1) / cache_size_bases_) {
+    return GenomeReference::GetBasesView(range);
   }
+  const int64 contig_n_bases =
+      Contig(range.reference_name()).ValueOrDie()->n_bases();
+  const int64 block = range.start() / cache_size_bases_;
+  bool hit = true;
+  StatusOr<std::shared_ptr<const string>> block_or =
+      GetBlock(range.reference_name(), contig_n_bases, block, &hit);
+  NUCLEUS_RETURN_IF_ERROR(block_or.status());
+  ++(hit ? cache_hits_ : cache_misses_);
+  TraceCount(hit ? kTraceCacheHits : kTraceCacheMisses);
+  std::shared_ptr<const string> bases = std::move(block_or.ValueOrDie());
+  const absl::string_view view = absl::string_view(*bases).substr(
+      range.start() - block * cache_size_bases_, range.end() - range.start());
+  return ReferenceBases(std::move(bases), view);
+}
 
+StatusOr<std::shared_ptr<const string>> IndexedFastaReader::GetBlock(
+    const string& contig_name, int64 contig_n_bases, int64 block,
+    bool* hit) const {
+  const std::pair<string, int64> key(contig_name, block);
+  std::shared_ptr<const string> bases = cache_->Lookup(key);
+  if (bases != nullptr) return bases;
+
+  *hit = false;
+  const int64 block_start = block * cache_size_bases_;
+  const Range block_range = MakeRange(
+      contig_name, block_start,
+      std::min(block_start + cache_size_bases_, contig_n_bases));
+  StatusOr<string> fetched = FetchBases(block_range);
+  NUCLEUS_RETURN_IF_ERROR(fetched.status());
+  if (fetched.ValueOrDie().size() !=
+      static_cast<size_t>(block_range.end() - block_range.start())) {
+    return ::nucleus::DataLoss(absl::StrCat(
+        "Fetched the wrong number of bases for ",
+        block_range.ShortDebugString()));
+  }
+  // If another thread cached this block in the meantime, its copy is used.
+  return cache_->Insert(
+      key, std::make_shared<const string>(std::move(fetched.ValueOrDie())));
+}
+
+StatusOr<string> IndexedFastaReader::FetchBases(const Range& range) const {
   // According to htslib docs, faidx_fetch_seq c_name is the contig name,
   // start is the first base (zero-based) to include and end is the last base
   // (zero-based) to include. Len is an output variable returning the length
@@ -226,24 +305,25 @@ StatusOr<string> IndexedFastaReader::GetBases(const Range& range) const {
   // The returned pointer must be freed. We need to subtract one from our end
   // since end is exclusive in GenomeReference but faidx has an inclusive one.
   int len;
-  char* bases =
-      faidx_fetch_seq(faidx_, range_to_fetch.reference_name().c_str(),
-                      range_to_fetch.start(), range_to_fetch.end() - 1, &len);
-  if (len <= 0)
+  char* bases;
+  {
+    absl::MutexLock lock(&faidx_mutex_);
+    if (faidx_ == nullptr) {
+      return ::nucleus::FailedPrecondition(
+          "can't read from closed IndexedFastaReader object.");
+    }
+    bases = faidx_fetch_seq(faidx_, range.reference_name().c_str(),
+                            range.start(), range.end() - 1, &len);
+  }
+  if (len <= 0) {
+    free(bases);
     return ::nucleus::InvalidArgument(
         absl::StrCat("Couldn't fetch bases for ", range.ShortDebugString()));
-  string result(bases);
-  if (!options_.keep_true_case()) {
-    absl::AsciiStrToUpper(&result);
   }
+  string result(bases, len);
   free(bases);
-
-  if (use_cache) {
-    // Update cache.
-    small_read_cache_ = result;
-    cached_range_ = range_to_fetch;
-    // Return the requested substring.
-    result = small_read_cache_.substr(0, range.end() - range.start());
+  if (!options_.keep_true_case()) {
+    absl::AsciiStrToUpper(&result);
   }
   return result;
 }
@@ -258,9 +338,11 @@ IndexedFastaReader::Iterate() const {
   if (faidx_ == nullptr) {
     return ::nucleus::FailedPrecondition("IndexedFastaReader already closed");
   } else {
+    absl::MutexLock lock(&faidx_mutex_);
     fai_destroy(faidx_);
     faidx_ = nullptr;
   }
+  if (cache_ != nullptr) cache_->Clear();
   return ::nucleus::Status();
 }
 
@@ -384,7 +466,8 @@ StatusOr<bool> UnindexedFastaReaderIterable::Next(GenomeReferenceRecord* out) {
   bool eof = false;
   while (true) {
     // Read one line.
-    StatusOr<string> line = fasta_reader->text_reader_->ReadLine();
+    StatusOr<absl::string_view> line =
+        fasta_reader->text_reader_->ReadLineView();
     if (!line.ok()) {
       if (::nucleus::IsOutOfRange(line.status())) {
         eof = true;
@@ -392,11 +475,11 @@ StatusOr<bool> UnindexedFastaReaderIterable::Next(GenomeReferenceRecord* out) {
       }
       return ::nucleus::DataLoss("Failed to parse FASTA");
     }
-    std::string l = line.ValueOrDie();
+    absl::string_view l = line.ValueOrDie();
 
     if (l.empty()) continue;
     // Check if the line is a header or a sequence.
-    if (l.at(0) == '>') {
+    if (l[0] == '>') {
       absl::string_view parsed_name = GetNameInHeaderLine(l);
       if (out->first.empty()) {
         out->first = string(parsed_name);
@@ -409,8 +492,12 @@ StatusOr<bool> UnindexedFastaReaderIterable::Next(GenomeReferenceRecord* out) {
     if (out->first.empty()) {
       return ::nucleus::DataLoss("Name not found in FASTA");
     }
-    out->second.append(
-        absl::AsciiStrToUpper(absl::StripTrailingAsciiWhitespace(l)));
+    // Append the bases and uppercase them in place.
+    const size_t appended_from = out->second.size();
+    absl::string_view bases = absl::StripTrailingAsciiWhitespace(l);
+    out->second.append(bases.data(), bases.size());
+    std::transform(out->second.begin() + appended_from, out->second.end(),
+                   out->second.begin() + appended_from, absl::ascii_toupper);
   }
   if (eof && out->first.empty()) {
     // No more records.
@@ -499,6 +586,13 @@ InMemoryFastaReader::Iterate() const {
 }
 
 StatusOr<string> InMemoryFastaReader::GetBases(const Range& range) const {
+  StatusOr<ReferenceBases> bases = GetBasesView(range);
+  NUCLEUS_RETURN_IF_ERROR(bases.status());
+  return bases.ValueOrDie().ToString();
+}
+
+StatusOr<ReferenceBases> InMemoryFastaReader::GetBasesView(
+    const Range& range) const {
   if (!IsValidInterval(range))
     return ::nucleus::InvalidArgument(
         absl::StrCat("Invalid interval: ", range.ShortDebugString()));
@@ -514,7 +608,8 @@ StatusOr<string> InMemoryFastaReader::GetBases(const Range& range) const {
   }
   const int64 pos = range.start() - seq.region().start();
   const int64 len = range.end() - range.start();
-  return seq.bases().substr(pos, len);
+  return ReferenceBases(nullptr,
+                        absl::string_view(seq.bases()).substr(pos, len));
 }
 
 StatusOr<bool> FastaFullFileIterable::Next(GenomeReferenceRecord* out) {
@@ -57,13 +57,15 @@
 #ifndef THIRD_PARTY_NUCLEUS_IO_REFERENCE_H_
 #define THIRD_PARTY_NUCLEUS_IO_REFERENCE_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include "absl/types/optional.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "htslib/faidx.h"
 #include "third_party/nucleus/io/reader_base.h"
 #include "third_party/nucleus/io/text_reader.h"
@@ -71,18 +73,51 @@
 #include "third_party/nucleus/protos/fasta.pb.h"
 #include "third_party/nucleus/protos/range.pb.h"
 #include "third_party/nucleus/protos/reference.pb.h"
+#include "third_party/nucleus/util/sharded_lru_cache.h"
 #include "third_party/nucleus/core/status.h"
 #include "third_party/nucleus/core/statusor.h"
 
 namespace nucleus {
 
 constexpr int INDEXED_FASTA_READER_DEFAULT_CACHE_SIZE = 64 * 1024;
+constexpr int INDEXED_FASTA_READER_DEFAULT_CACHE_BLOCKS = 64;
 
 // Alias for the abstract base class for FASTA record iterables, which
 // corresponds to (name, sequence) pairs.
 using GenomeReferenceRecord = std::pair<string, string>;
 using GenomeReferenceRecordIterable = Iterable<GenomeReferenceRecord>;
 
+// The bases of an interval of a reference genome, as returned by
+// GenomeReference::GetBasesView().
+//
+// bases() is a view of memory that this object keeps alive (for example an
+// immutable cached block of an IndexedFastaReader), so getting the bases of a
+// small interval doesn't need to allocate or copy. Copies of a ReferenceBases
+// share the same memory. A ReferenceBases without an owner views memory owned
+// by the GenomeReference that returned it and is only valid while that
+// reader is.
+class ReferenceBases {
+ public:
+  ReferenceBases() {}
+
+  // Holds bases itself.
+  explicit ReferenceBases(string bases)
+      : owner_(std::make_shared<const string>(std::move(bases))),
+        bases_(*owner_) {}
+
+  // Views bases, which live in memory kept alive by owner.
+  ReferenceBases(std::shared_ptr<const string> owner, absl::string_view bases)
+      : owner_(std::move(owner)), bases_(bases) {}
+
+  absl::string_view bases() const { return bases_; }
+  size_t size() const { return bases_.size(); }
+  string ToString() const { return string(bases_); }
+
+ private:
+  std::shared_ptr<const string> owner_;
+  absl::string_view bases_;
+};
+
 class GenomeReference : public Reader {
  public:
   GenomeReference(const GenomeReference&) = delete;
@@ -121,6 +156,12 @@ class GenomeReference : public Reader {
   virtual StatusOr<string> GetBases(
       const nucleus::genomics::v1::Range& range) const = 0;
 
+  // Same as GetBases, but returns the bases without copying them out of the
+  // reader's storage whenever possible. Prefer this in performance-sensitive
+  // code. The default implementation wraps the result of GetBases.
+  virtual StatusOr<ReferenceBases> GetBasesView(
+      const nucleus::genomics::v1::Range& range) const;
+
   // Gets all of the FASTA records in this file in order.
   //
   // The specific parsing, filtering, etc behavior is determined by the options
@@ -181,11 +222,16 @@ class IndexedFastaReader : public GenomeReference {
   // htslib currently assumes that the FAI file is named fasta_path + '.fai',
   // so that file must exist and be readable by htslib.
   //
-  // We maintain a single entry cache of the bases from the last FASTA fetch, to
-  // reduce the number of file reads, which can be quite costly for remote
-  // filesystems.  64K is the default block size for htslib faidx fetches, so
-  // there is no penalty to rounding up all small access sizes to 64K.  The
-  // cache can be disabled using `cache_size=0`.
+  // We maintain an LRU cache of fixed-size, aligned blocks of bases from
+  // previous FASTA fetches, to reduce the number of file reads, which can be
+  // quite costly for remote filesystems.  64K is the default block size for
+  // htslib faidx fetches, so there is no penalty to rounding up all small
+  // access sizes to 64K blocks.  Up to options.cache_blocks() blocks (default
+  // INDEXED_FASTA_READER_DEFAULT_CACHE_BLOCKS) are kept, so interleaved
+  // queries to a few distinct loci all hit the cache.  The cache can be
+  // disabled using `cache_size=0`.
+  //
+  // GetBases() is thread-safe: one reader can be shared by several threads.
   static StatusOr<std::unique_ptr<IndexedFastaReader>> FromFile(
       const string& fasta_path, const string& fai_path,
       const nucleus::genomics::v1::FastaReaderOptions& options,
@@ -208,11 +254,21 @@ class IndexedFastaReader : public GenomeReference {
   StatusOr<string> GetBases(
       const nucleus::genomics::v1::Range& range) const override;
 
+  // Ranges that fall within a single cache block are returned as a view of
+  // that block; others are copied as by GetBases.
+  StatusOr<ReferenceBases> GetBasesView(
+      const nucleus::genomics::v1::Range& range) const override;
+
   // Get the options controlling the behavior of this FastaReader.
   const nucleus::genomics::v1::FastaReaderOptions& Options() const {
     return options_;
   }
 
+  // Number of GetBases() calls served entirely from the block cache, and
+  // number that needed to read from the FASTA file.
+  int64 CacheHits() const { return cache_hits_.load(); }
+  int64 CacheMisses() const { return cache_misses_.load(); }
+
   StatusOr<std::shared_ptr<GenomeReferenceRecordIterable>> Iterate()
       const override;
 
@@ -243,15 +299,30 @@ class IndexedFastaReader : public GenomeReference {
   // contigs used by this BAM file.
   const std::vector<nucleus::genomics::v1::ContigInfo> contigs_;
 
-  // Size, in bases, of the read cache.
+  // Fetches the bases of range from the FASTA, upper-casing them unless the
+  // options say otherwise.
+  StatusOr<string> FetchBases(const nucleus::genomics::v1::Range& range) const;
+
+  // Returns the cache block of contig_name with the given index, fetching and
+  // caching it if needed. *hit is cleared if the block had to be fetched.
+  StatusOr<std::shared_ptr<const string>> GetBlock(const string& contig_name,
+                                                   int64 contig_n_bases,
+                                                   int64 block,
+                                                   bool* hit) const;
+
+  // Size, in bases, of each cached block. Blocks start at multiples of this.
   const int cache_size_bases_;
 
-  // Cache of the last "small" read from the FASTA (<= kFastaCacheSize).
-  mutable string small_read_cache_;
+  // Blocks of bases keyed by (contig name, block index), or nullptr if caching
+  // is disabled.
+  std::unique_ptr<ShardedLruCache<std::pair<string, int64>, string>> cache_;
+
+  // htslib's faidx_t reads through a single shared file handle, so fetches
+  // are serialized.
+  mutable absl::Mutex faidx_mutex_;
 
-  // The range that is held in the cache, or "empty" if there is no range cached
-  // yet.  Range must be <= kFastaCacheSize in length.
-  mutable absl::optional<nucleus::genomics::v1::Range> cached_range_;
+  mutable std::atomic<int64> cache_hits_{0};
+  mutable std::atomic<int64> cache_misses_{0};
 };
 
 // A FASTA reader that is not backed by a htslib FAI index.
@@ -354,6 +425,10 @@ class InMemoryFastaReader : public GenomeReference {
   StatusOr<string> GetBases(
       const nucleus::genomics::v1::Range& range) const override;
 
+  // Returns a view of the in-memory sequence, valid as long as this reader.
+  StatusOr<ReferenceBases> GetBasesView(
+      const nucleus::genomics::v1::Range& range) const override;
+
   StatusOr<std::shared_ptr<GenomeReferenceRecordIterable>> Iterate()
       const override;
 
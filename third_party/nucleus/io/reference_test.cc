@@ -32,9 +32,12 @@
 
 #include "third_party/nucleus/io/reference.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include <gmock/gmock-generated-matchers.h>
 #include <gmock/gmock-matchers.h>
@@ -167,6 +170,11 @@ void CheckGetBases(const GenomeReference& ref,
   StatusOr<string> query = ref.GetBases(MakeRange(chrom, start, end));
   ASSERT_THAT(query, IsOK());
   EXPECT_THAT(query.ValueOrDie(), expected_bases);
+
+  StatusOr<ReferenceBases> view =
+      ref.GetBasesView(MakeRange(chrom, start, end));
+  ASSERT_THAT(view, IsOK());
+  EXPECT_EQ(view.ValueOrDie().bases(), expected_bases);
 }
 
 
@@ -238,6 +246,10 @@ static std::unique_ptr<GenomeReference> JustLoadFai(const string& fasta,
 INSTANTIATE_TEST_CASE_P(GRT1, GenomeReferenceTest,
                         ::testing::Values(make_pair(&JustLoadFai, 0)));
 
+// Test with a cache of tiny blocks, so most queries span two blocks.
+INSTANTIATE_TEST_CASE_P(GRT2, GenomeReferenceTest,
+                        ::testing::Values(make_pair(&JustLoadFai, 5)));
+
 // Test with a large cache.
 INSTANTIATE_TEST_CASE_P(GRT3, GenomeReferenceTest,
                         ::testing::Values(make_pair(&JustLoadFai, 64 * 1024)));
@@ -261,6 +273,71 @@ TEST(IndexedFastaReaderTest, WriteAfterCloseIsntOK) {
                   "can't read from closed IndexedFastaReader object"));
 }
 
+TEST(IndexedFastaReaderTest, InterleavedQueriesHitTheCache) {
+  StatusOr<std::unique_ptr<IndexedFastaReader>> reader_or =
+      IndexedFastaReader::FromFile(TestFastaPath(),
+                                   StrCat(TestFastaPath(), ".fai"),
+                                   nucleus::genomics::v1::FastaReaderOptions(),
+                                   16);
+  ASSERT_THAT(reader_or.status(), IsOK());
+  const IndexedFastaReader& reader = *reader_or.ValueOrDie();
+
+  EXPECT_EQ(reader.GetBases(MakeRange("chrM", 0, 4)).ValueOrDie(), "GATC");
+  EXPECT_EQ(reader.GetBases(MakeRange("chr1", 0, 4)).ValueOrDie(), "ACCA");
+  EXPECT_EQ(reader.CacheMisses(), 2);
+  // Both blocks stay cached, so alternating between them only hits.
+  EXPECT_EQ(reader.GetBases(MakeRange("chrM", 4, 8)).ValueOrDie(), "ACAG");
+  EXPECT_EQ(reader.GetBases(MakeRange("chr1", 4, 8)).ValueOrDie(), "CCAT");
+  EXPECT_EQ(reader.CacheHits(), 2);
+  EXPECT_EQ(reader.CacheMisses(), 2);
+  // Spanning into the next block needs one more fetch.
+  EXPECT_EQ(reader.GetBases(MakeRange("chrM", 14, 18)).ValueOrDie(), "CACC");
+  EXPECT_EQ(reader.CacheMisses(), 3);
+}
+
+TEST(IndexedFastaReaderTest, BasesViewOutlivesTheCache) {
+  auto reader = JustLoadFai(TestFastaPath(), 16);
+  StatusOr<ReferenceBases> view =
+      reader->GetBasesView(MakeRange("chrM", 2, 6));
+  ASSERT_THAT(view, IsOK());
+  // A copy of a view shares the cached block rather than copying the bases.
+  const ReferenceBases copy = view.ValueOrDie();
+  EXPECT_EQ(copy.bases().data(), view.ValueOrDie().bases().data());
+  // Closing the reader drops its cache, but not the block held by the view.
+  ASSERT_THAT(reader->Close(), IsOK());
+  EXPECT_EQ(copy.bases(), "TCAC");
+}
+
+TEST(IndexedFastaReaderTest, ConcurrentGetBasesAreConsistent) {
+  auto uncached = JustLoadFai(TestFastaPath(), 0);
+  auto shared = JustLoadFai(TestFastaPath(), 8);
+  std::vector<nucleus::genomics::v1::Range> ranges;
+  for (const string& contig : {"chrM", "chr1", "chr2"}) {
+    for (int start = 0; start < 60; start += 3) {
+      ranges.push_back(MakeRange(contig, start, start + 1 + start % 8));
+    }
+  }
+  std::vector<string> expected;
+  for (const auto& range : ranges) {
+    expected.push_back(uncached->GetBases(range).ValueOrDie());
+  }
+
+  std::vector<std::thread> threads;
+  std::atomic<int> n_mismatches(0);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i) {
+        const size_t j = (i * 7 + t) % ranges.size();
+        if (shared->GetBases(ranges[j]).ValueOrDie() != expected[j]) {
+          ++n_mismatches;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(n_mismatches, 0);
+}
+
 TEST(IndexedFastaReaderTest, TestTrueCase) {
   auto reader = LoadWithCaseOption(TestFastaPath(), true);
   auto iterator = reader->Iterate().ValueOrDie();
@@ -405,6 +482,20 @@ void CreateTestSeq(std::vector<genomics::v1::ContigInfo>* contigs,
 
 }  // namespace
 
+TEST(InMemoryFastaReaderTest, GetBasesViewMatchesGetBases) {
+  std::vector<genomics::v1::ContigInfo> contigs(1);
+  std::vector<genomics::v1::ReferenceSequence> seqs(1);
+  CreateTestSeq(&contigs, &seqs, "Chr1", 0, 10, 15, "AATTC");
+  contigs[0].set_n_bases(20);
+  std::unique_ptr<InMemoryFastaReader> reader =
+      std::move(InMemoryFastaReader::Create(contigs, seqs).ValueOrDie());
+
+  const auto range = MakeRange("Chr1", 11, 14);
+  EXPECT_EQ(reader->GetBasesView(range).ValueOrDie().bases(), "ATT");
+  EXPECT_EQ(reader->GetBases(range).ValueOrDie(), "ATT");
+  EXPECT_THAT(reader->GetBasesView(MakeRange("Chr1", 5, 11)), Not(IsOK()));
+}
+
 TEST(InMemoryFastaReaderTest, TestIterate) {
   int kNum = 3;
   std::vector<genomics::v1::ContigInfo> contigs(kNum);
@@ -130,6 +130,8 @@ from __future__ import print_function
 
 from third_party.nucleus.io import genomics_reader
 from third_party.nucleus.io import genomics_writer
+from third_party.nucleus.io.python import in_memory_read_index
+from third_party.nucleus.io.python import sam_read_prefetcher
 from third_party.nucleus.io.python import sam_reader
 from third_party.nucleus.io.python import sam_writer
 from third_party.nucleus.protos import reads_pb2
@@ -154,7 +156,12 @@ class NativeSamReader(genomics_reader.GenomicsReader):
                downsample_fraction=None,
                random_seed=None,
                use_original_base_quality_scores=False,
-               aux_fields_to_keep=None):
+               aux_fields_to_keep=None,
+               num_decompression_threads=None,
+               max_depth=None,
+               max_depth_window_size=None,
+               share_cram_reference=False,
+               read_cache_dir=None):
     """Initializes a NativeSamReader.
 
     Args:
@@ -188,6 +195,27 @@ class NativeSamReader(genomics_reader.GenomicsReader):
       aux_fields_to_keep: None or list[str]. If None, we keep all aux fields if
         they are parsed. If set, we only keep the aux fields with the names in
         this list.
+      num_decompression_threads: int or None. If a positive int, BGZF
+        decompression of BAM files (and decoding of CRAM files) is done by a
+        pool of this many htslib threads. The pool is shared by every reader in
+        the process using the same number of threads. If None or zero, decoding
+        happens on the calling thread.
+      max_depth: int or None. If a positive int, reads are deterministically
+        downsampled as they are decoded so that the average coverage of every
+        window of max_depth_window_size bp does not exceed max_depth. If None
+        or zero, depth is not capped.
+      max_depth_window_size: int or None. Window size, in bp, over which
+        max_depth is enforced. If None or zero, a default of 100 is used.
+      share_cram_reference: optional bool, defaulting to False. If True and
+        input_path is a CRAM file decoded with ref_path, the reference
+        sequences are shared with every other reader in the process using the
+        same ref_path rather than loaded by this reader alone.
+      read_cache_dir: str or None. If set, an existing local directory in which
+        query_batch() caches reads in fixed genomic bins, keyed by this file,
+        the options above and the bin. Readers created later with the same
+        file and options load the bins their regions overlap instead of
+        decoding them again. Ignored if downsample_fraction or max_depth is
+        set.
 
     Raises:
       ValueError: If downsample_fraction is not None and not in the interval
@@ -224,18 +252,24 @@ class NativeSamReader(genomics_reader.GenomicsReader):
         # Fixed random seed produced with 'od -vAn -N4 -tu4 < /dev/urandom'.
         random_seed = 2928130004
 
+      self._input_path = input_path
+      self._ref_path = ref_path or ''
+      self._options = reads_pb2.SamReaderOptions(
+          read_requirements=read_requirements,
+          aux_field_handling=aux_field_handling,
+          aux_fields_to_keep=aux_fields_to_keep,
+          hts_block_size=(hts_block_size or 0),
+          downsample_fraction=downsample_fraction,
+          random_seed=random_seed,
+          use_original_base_quality_scores=use_original_base_quality_scores,
+          num_decompression_threads=(num_decompression_threads or 0),
+          max_depth=(max_depth or 0),
+          max_depth_window_size=(max_depth_window_size or 0),
+          share_cram_reference=share_cram_reference,
+          read_cache_dir=(read_cache_dir or ''))
       self._reader = sam_reader.SamReader.from_file(
-          input_path.encode('utf8'),
-          ref_path.encode('utf8') if ref_path is not None else '',
-          reads_pb2.SamReaderOptions(
-              read_requirements=read_requirements,
-              aux_field_handling=aux_field_handling,
-              aux_fields_to_keep=aux_fields_to_keep,
-              hts_block_size=(hts_block_size or 0),
-              downsample_fraction=downsample_fraction,
-              random_seed=random_seed,
-              use_original_base_quality_scores=use_original_base_quality_scores)
-      )
+          self._input_path.encode('utf8'), self._ref_path.encode('utf8'),
+          self._options)
 
       self.header = self._reader.header
 
@@ -249,7 +283,105 @@ class NativeSamReader(genomics_reader.GenomicsReader):
     """Returns an iterator for going through the reads in the region."""
     return self._reader.query(region)
 
+  def query_batch(self, regions):
+    """Returns a list of all reads overlapping any of the regions.
+
+    All reads are fetched and converted in a single native call, and reads
+    overlapping more than one region are only returned once.
+
+    Args:
+      regions: list[nucleus.genomics.v1.Range]. The query regions.
+
+    Returns:
+      list[nucleus.genomics.v1.Read], in file order.
+    """
+    if not hasattr(self._reader, 'query_batch'):
+      # tfbam readers only support single-region queries.
+      reads = []
+      for i, region in enumerate(regions):
+        reads.extend(
+            read
+            for read in self._reader.query(region)
+            if not any(
+                utils.read_overlaps_region(read, r) for r in regions[:i]
+            )
+        )
+      return reads
+    return self._reader.query_batch(regions)
+
+  def estimate_bytes(self, regions):
+    """Estimates the size of the reads of each region from the index alone.
+
+    Args:
+      regions: list[nucleus.genomics.v1.Range]. The regions to estimate.
+
+    Returns:
+      list[int]. For each region, the number of compressed bytes a query of
+      that region would read. Raises for CRAM inputs.
+    """
+    return self._reader.estimate_bytes(regions)
+
+  def prefetch(self, regions, max_regions_ahead=2, max_buffered_bytes=0):
+    """Returns a reader that loads the reads of regions in the background.
+
+    Args:
+      regions: list[nucleus.genomics.v1.Range]. The regions that will be
+        queried, in the order they will be queried.
+      max_regions_ahead: int. The maximum number of regions loaded ahead of the
+        one currently being queried.
+      max_buffered_bytes: int. Soft cap on the memory held by loaded but not
+        yet queried reads. If <= 0, only max_regions_ahead applies.
+
+    Returns:
+      A PrefetchingSamReader wrapping this reader, or this reader itself if it
+      reads a tfbam file or downsamples reads.
+    """
+    if not hasattr(self._reader, 'query_batch'):
+      return self
+    if self._options.downsample_fraction:
+      # The reads kept by downsampling depend on every read drawn from the
+      # reader before them, so all queries must go through one reader.
+      return self
+    prefetcher = sam_read_prefetcher.SamReadPrefetcher.create(
+        self._input_path.encode('utf8'), self._ref_path.encode('utf8'),
+        self._options, regions, max_regions_ahead, max_buffered_bytes)
+    return PrefetchingSamReader(self, prefetcher)
+
+  def __exit__(self, exit_type, exit_value, exit_traceback):
+    self._reader.__exit__(exit_type, exit_value, exit_traceback)
+
+
+class PrefetchingSamReader(genomics_reader.GenomicsReader):
+  """A NativeSamReader whose region queries are served by a prefetcher.
+
+  Queries for the regions given to NativeSamReader.prefetch(), issued in that
+  order, return reads that were loaded on a background thread while the caller
+  was processing earlier regions. Any other query is passed through to the
+  wrapped reader. The reads returned are the same either way.
+  """
+
+  def __init__(self, reader, prefetcher):
+    super(PrefetchingSamReader, self).__init__()
+    self._reader = reader
+    self._prefetcher = prefetcher
+    self.header = reader.header
+
+  def iterate(self):
+    return self._reader.iterate()
+
+  def query(self, region):
+    if self._prefetcher.is_pending(region):
+      return iter(self._prefetcher.fetch(region))
+    return self._reader.query(region)
+
+  def query_batch(self, regions):
+    if len(regions) == 1 and self._prefetcher.is_pending(regions[0]):
+      return self._prefetcher.fetch(regions[0])
+    return self._reader.query_batch(regions)
+
   def __exit__(self, exit_type, exit_value, exit_traceback):
+    # Dropping the prefetcher stops its background thread.
+    self._prefetcher = None
     self._reader.__exit__(exit_type, exit_value, exit_traceback)
 
 
@@ -259,6 +391,26 @@ class SamReader(genomics_reader.DispatchingGenomicsReader):
   def _native_reader(self, input_path, **kwargs):
     return NativeSamReader(input_path, **kwargs)
 
+  def query_batch(self, regions):
+    if isinstance(self._reader, NativeSamReader):
+      return self._reader.query_batch(regions)
+    # TFRecord files have no index to query, so scan them for the reads
+    # overlapping any of the regions.
+    return [
+        read
+        for read in self._reader.iterate()
+        if any(utils.read_overlaps_region(read, region) for region in regions)
+    ]
+
+  def estimate_bytes(self, regions):
+    return self._reader.estimate_bytes(regions)
+
+  def prefetch(self, regions, max_regions_ahead=2, max_buffered_bytes=0):
+    if not isinstance(self._reader, NativeSamReader):
+      # Only native files are prefetched; other readers are queried directly.
+      return self
+    return self._reader.prefetch(regions, max_regions_ahead, max_buffered_bytes)
+
   def _record_proto(self):
     return reads_pb2.Read
 
@@ -310,12 +462,23 @@ class InMemorySamReader(object):
   """
 
   def __init__(self, reads, is_sorted=False):
+    self._index = in_memory_read_index.InMemoryReadIndex()
     self.replace_reads(reads, is_sorted=is_sorted)
 
   def replace_reads(self, reads, is_sorted=False):
-    """Replace the reads stored by this reader."""
-    self.reads = reads
+    """Replace the reads stored by this reader.
+
+    The reads are indexed by their aligned interval in C++ so that each query
+    costs O(log N + k) rather than a scan of all N reads.
+
+    Args:
+      reads: list[nucleus.genomics.v1.Read]. The reads to store. They must not
+        be modified while stored in this reader.
+      is_sorted: bool, True if reads are sorted.
+    """
+    self.reads = list(reads)
     self.is_sorted = is_sorted
+    self._index.replace(self.reads)
 
   def iterate(self):
     """Iterate over all records in the reads.
@@ -332,8 +495,10 @@ class InMemorySamReader(object):
       region: nucleus.genomics.v1.Range. The query region.
 
     Returns:
-      An iterator over nucleus.genomics.v1.Read protos.
+      An iterator over nucleus.genomics.v1.Read protos. The region is looked
+      up immediately, so replacing the reads afterwards does not change what
+      the iterator yields.
     """
-    # TODO: Add a faster query version for sorted reads.
-    return (
-        read for read in self.reads if utils.read_overlaps_region(read, region))
+    reads = self.reads
+    idx = self._index.query(region)
+    return (reads[i] for i in idx)
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of sam_read_cache.h
+#include "third_party/nucleus/io/sam_read_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Read;
+using nucleus::genomics::v1::SamReaderOptions;
+
+namespace {
+
+// Every entry file starts with this magic string.
+constexpr char kMagic[] = "NUCLEUS_SAM_READ_CACHE_2";
+constexpr size_t kMagicLength = sizeof(kMagic) - 1;
+
+// Serialized reads are grouped into blocks of roughly this many bytes before
+// compression.
+constexpr size_t kBlockSize = 1 << 20;
+
+// Number of leading bytes of the reads file included in its checksum.
+constexpr size_t kChecksumBytes = 64 * 1024;
+
+// An entry is kMagic followed by blocks, each one introduced by a codec byte,
+// and terminated by a kEndOfEntry byte followed by the number of reads.
+// Blocks store their uncompressed and stored sizes and then the stored bytes.
+// Uncompressed, a block is a series of serialized Reads each prefixed by the
+// start and end of its span and by its length.
+enum BlockCodec : char {
+  kUncompressed = 0,
+  kSnappy = 1,
+  kEndOfEntry = 2,
+};
+
+void AppendUint32(uint32 value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendInt64(int64 value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ConsumeValue(absl::string_view* in, T* value) {
+  if (in->size() < sizeof(*value)) return false;
+  memcpy(value, in->data(), sizeof(*value));
+  in->remove_prefix(sizeof(*value));
+  return true;
+}
+
+bool ConsumeBytes(absl::string_view* in, size_t n, absl::string_view* out) {
+  if (in->size() < n) return false;
+  *out = in->substr(0, n);
+  in->remove_prefix(n);
+  return true;
+}
+
+// Appends the block holding the serialized reads in raw to out.
+void AppendBlock(const string& raw, string* out) {
+  string compressed;
+  const bool use_snappy =
+      tensorflow::port::Snappy_Compress(raw.data(), raw.size(), &compressed) &&
+      compressed.size() < raw.size();
+  const string& stored = use_snappy ? compressed : raw;
+  out->push_back(use_snappy ? kSnappy : kUncompressed);
+  AppendUint32(raw.size(), out);
+  AppendUint32(stored.size(), out);
+  out->append(stored);
+}
+
+// Parses the reads of an uncompressed block and appends them to bin.
+bool ParseBlock(absl::string_view block, SamReadCache::Bin* bin) {
+  while (!block.empty()) {
+    int64 start, end;
+    uint32 length;
+    absl::string_view serialized;
+    if (!ConsumeValue(&block, &start) || !ConsumeValue(&block, &end) ||
+        !ConsumeValue(&block, &length) ||
+        !ConsumeBytes(&block, length, &serialized)) {
+      return false;
+    }
+    bin->spans.emplace_back(start, end);
+    bin->reads.emplace_back();
+    if (!bin->reads.back().ParseFromArray(serialized.data(),
+                                          serialized.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses a whole entry file into bin.
+bool ParseEntry(absl::string_view data, SamReadCache::Bin* bin) {
+  absl::string_view magic;
+  if (!ConsumeBytes(&data, kMagicLength, &magic) ||
+      magic != absl::string_view(kMagic, kMagicLength)) {
+    return false;
+  }
+  string uncompressed;
+  while (!data.empty()) {
+    const char codec = data.front();
+    data.remove_prefix(1);
+    if (codec == kEndOfEntry) {
+      uint32 n_reads;
+      return ConsumeValue(&data, &n_reads) && data.empty() &&
+             n_reads == bin->reads.size();
+    }
+    uint32 raw_size, stored_size;
+    absl::string_view stored;
+    if (!ConsumeValue(&data, &raw_size) ||
+        !ConsumeValue(&data, &stored_size) ||
+        !ConsumeBytes(&data, stored_size, &stored)) {
+      return false;
+    }
+    if (codec == kUncompressed) {
+      if (stored_size != raw_size || !ParseBlock(stored, bin)) return false;
+    } else if (codec == kSnappy) {
+      size_t length;
+      if (!tensorflow::port::Snappy_GetUncompressedLength(
+              stored.data(), stored.size(), &length) ||
+          length != raw_size) {
+        return false;
+      }
+      uncompressed.resize(length);
+      if (!tensorflow::port::Snappy_Uncompress(stored.data(), stored.size(),
+                                              &uncompressed[0]) ||
+          !ParseBlock(uncompressed, bin)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  // Missing end of entry marker.
+  return false;
+}
+
+// Returns a string identifying the current contents of the file at path
+// without reading all of it.
+StatusOr<string> FileIdentity(const string& path) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  tensorflow::FileStatistics stat;
+  tensorflow::Status s = env->Stat(path, &stat);
+  if (!s.ok()) {
+    return ::nucleus::NotFound(
+        absl::StrCat("Could not stat ", path, ": ", s.ToString()));
+  }
+  std::unique_ptr<tensorflow::RandomAccessFile> file;
+  s = env->NewRandomAccessFile(path, &file);
+  if (!s.ok()) {
+    return ::nucleus::NotFound(
+        absl::StrCat("Could not open ", path, ": ", s.ToString()));
+  }
+  const size_t n = std::min<size_t>(kChecksumBytes, stat.length);
+  string scratch(n, '\0');
+  tensorflow::StringPiece prefix;
+  s = file->Read(0, n, &prefix, &scratch[0]);
+  if (!s.ok() && prefix.size() != n) {
+    return ::nucleus::DataLoss(
+        absl::StrCat("Could not read ", path, ": ", s.ToString()));
+  }
+  return absl::StrCat(stat.length, ":", stat.mtime_nsec, ":",
+                      tensorflow::Fingerprint64(prefix));
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<SamReadCache>> SamReadCache::Create(
+    const string& cache_dir, const string& reads_path,
+    const SamReaderOptions& options) {
+  if (options.downsample_fraction() != 0.0) {
+    // The reads kept depend on the sampler state left by earlier queries, so
+    // a bin's reads are not a function of the key.
+    return ::nucleus::InvalidArgument(
+        "Reads cannot be cached when downsample_fraction is set");
+  }
+  if (options.max_depth() > 0) {
+    // The cap starts afresh with every query, so the reads of a region would
+    // depend on the bins it is assembled from.
+    return ::nucleus::InvalidArgument(
+        "Reads cannot be cached when max_depth is set");
+  }
+  tensorflow::Status s = tensorflow::Env::Default()->IsDirectory(cache_dir);
+  if (!s.ok()) {
+    return ::nucleus::NotFound(absl::StrCat(
+        "Read cache directory ", cache_dir, " is unusable: ", s.ToString()));
+  }
+  StatusOr<string> identity = FileIdentity(reads_path);
+  NUCLEUS_RETURN_IF_ERROR(identity.status());
+
+  // Options that only affect how fast reads are produced are not part of the
+  // key.
+  SamReaderOptions key_options = options;
+  key_options.clear_hts_block_size();
+  key_options.clear_num_decompression_threads();
+  key_options.clear_share_cram_reference();
+  key_options.clear_read_cache_dir();
+  const uint64 fingerprint = tensorflow::Fingerprint64(absl::StrCat(
+      identity.ValueOrDie(), "\n", key_options.SerializeAsString()));
+  return std::unique_ptr<SamReadCache>(
+      new SamReadCache(cache_dir, fingerprint));
+}
+
+SamReadCache::SamReadCache(const string& cache_dir, uint64 fingerprint)
+    : cache_dir_(cache_dir), fingerprint_(fingerprint) {}
+
+string SamReadCache::EntryPath(const string& contig, int64 bin) const {
+  // Contig names may hold characters that don't belong in file names.
+  return tensorflow::io::JoinPath(
+      cache_dir_,
+      absl::StrCat(absl::Hex(fingerprint_, absl::kZeroPad16), "-",
+                   absl::Hex(tensorflow::Fingerprint64(contig),
+                             absl::kZeroPad16),
+                   "-", bin, ".reads"));
+}
+
+std::shared_ptr<const SamReadCache::Bin> SamReadCache::Lookup(
+    const string& contig, int64 bin) const {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (last_reads_ != nullptr && last_bin_ == bin && last_contig_ == contig) {
+      return last_reads_;
+    }
+  }
+  const string path = EntryPath(contig, bin);
+  tensorflow::Env* env = tensorflow::Env::Default();
+  if (!env->FileExists(path).ok()) return nullptr;
+
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  tensorflow::Status s = env->NewReadOnlyMemoryRegionFromFile(path, &region);
+  if (!s.ok()) {
+    LOG(WARNING) << "Could not map read cache entry " << path << ": " << s;
+    return nullptr;
+  }
+  auto cached = std::make_shared<Bin>();
+  if (!ParseEntry(absl::string_view(static_cast<const char*>(region->data()),
+                                    region->length()),
+                  cached.get())) {
+    LOG(WARNING) << "Ignoring corrupt read cache entry " << path;
+    return nullptr;
+  }
+  Remember(contig, bin, cached);
+  return cached;
+}
+
+::nucleus::Status SamReadCache::Store(const string& contig, int64 bin,
+                                      std::shared_ptr<const Bin> reads) const {
+  CHECK(reads != nullptr);
+  CHECK_EQ(reads->reads.size(), reads->spans.size());
+  string contents(kMagic, kMagicLength);
+  string block;
+  for (size_t i = 0; i < reads->reads.size(); ++i) {
+    const string serialized = reads->reads[i].SerializeAsString();
+    AppendInt64(reads->spans[i].first, &block);
+    AppendInt64(reads->spans[i].second, &block);
+    AppendUint32(serialized.size(), &block);
+    block.append(serialized);
+    if (block.size() >= kBlockSize) {
+      AppendBlock(block, &contents);
+      block.clear();
+    }
+  }
+  if (!block.empty()) AppendBlock(block, &contents);
+  contents.push_back(kEndOfEntry);
+  AppendUint32(reads->reads.size(), &contents);
+  Remember(contig, bin, std::move(reads));
+
+  // Write to a private temporary file first so that concurrent readers only
+  // ever see complete entries.
+  const string path = EntryPath(contig, bin);
+  const string tmp_path = absl::StrCat(
+      path, ".tmp.", absl::Hex(tensorflow::random::New64(), absl::kZeroPad16));
+  tensorflow::Env* env = tensorflow::Env::Default();
+  tensorflow::Status s = tensorflow::WriteStringToFile(env, tmp_path, contents);
+  if (s.ok()) s = env->RenameFile(tmp_path, path);
+  if (!s.ok()) {
+    env->DeleteFile(tmp_path).IgnoreError();
+    return ::nucleus::Unknown(absl::StrCat(
+        "Failed to write read cache entry ", path, ": ", s.ToString()));
+  }
+  return ::nucleus::Status();
+}
+
+void SamReadCache::Remember(const string& contig, int64 bin,
+                            std::shared_ptr<const Bin> reads) const {
+  absl::MutexLock lock(&mutex_);
+  last_contig_ = contig;
+  last_bin_ = bin;
+  last_reads_ = std::move(reads);
+}
+
+}  // namespace nucleus
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_SAM_READ_CACHE_H_
+#define THIRD_PARTY_NUCLEUS_IO_SAM_READ_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace nucleus {
+
+// A local, on-disk cache of the reads a SamReader returns for fixed genomic
+// bins.
+//
+// Workflows such as candidate sweep followed by example generation, or
+// DeepTrio's per-sample passes, query the same parts of the same file several
+// times. Each pass pays for BGZF inflation, htslib decoding, filtering and
+// conversion to Read protos again. A SamReadCache stores the final,
+// already-filtered reads of each kBinSize bp bin of the genome in a sidecar
+// file. SamReader::QueryBatch assembles the reads of any set of regions from
+// the bins they overlap, so a later pass hits the cache even if it partitions
+// the genome differently, as the calling pass does after a candidate sweep.
+//
+// Each entry is one file in cache_dir named after a fingerprint of:
+//   * the identity of the reads file (its size, modification time and a
+//     checksum of its first 64KiB, which hold the BGZF-compressed header),
+//   * the SamReaderOptions that determine which reads are returned and how
+//     they are parsed (read_requirements, aux field handling, ...), and
+//   * the contig and index of the bin.
+// Changing any of these therefore never serves stale reads.
+//
+// The first pass decodes whole bins, so it reads somewhat more than its
+// queries need, and the entries together hold about one more copy of the
+// filtered reads. Shards that miss the same bin at the same time may both fill
+// it; the entries they write are identical.
+//
+// Entries are written to a temporary file and renamed into place, so readers
+// never observe partial entries. Entry files hold the serialized reads in
+// Snappy-compressed blocks and are read through a read-only memory mapping.
+// Files are written in host byte order, which is fine for a local cache but
+// means cache directories should not be shared between architectures.
+//
+// All methods are safe to call concurrently, including from multiple
+// processes sharing cache_dir.
+class SamReadCache {
+ public:
+  // Width in bp of the bins the cache is keyed on.
+  static constexpr int64 kBinSize = 10000;
+
+  // The reads a query of one bin returns, in file order. spans[i] is the
+  // reference interval [start, end) that queries match reads[i] against.
+  struct Bin {
+    std::vector<nucleus::genomics::v1::Read> reads;
+    std::vector<std::pair<int64, int64>> spans;
+  };
+
+  // Creates a cache for reads from reads_path read with options, stored in
+  // the existing directory cache_dir. Fails if options downsample the reads
+  // or cap their depth, since then the reads returned for a region depend on
+  // the queries made before it or on where the query starts.
+  static StatusOr<std::unique_ptr<SamReadCache>> Create(
+      const string& cache_dir, const string& reads_path,
+      const nucleus::genomics::v1::SamReaderOptions& options);
+
+  // Looks up the reads cached for bin number bin of contig, or returns
+  // nullptr if there is no valid entry. The bin last looked up or stored is
+  // kept in memory, so consecutive queries within a bin parse it only once.
+  // Unreadable or corrupt entries are logged and treated as misses.
+  std::shared_ptr<const Bin> Lookup(const string& contig, int64 bin) const;
+
+  // Stores reads as the entry for bin number bin of contig, replacing any
+  // existing entry.
+  ::nucleus::Status Store(const string& contig, int64 bin,
+                          std::shared_ptr<const Bin> reads) const;
+
+  // Returns the path of the entry file for bin number bin of contig, which may
+  // not exist.
+  string EntryPath(const string& contig, int64 bin) const;
+
+  // Disable assignment/copy operations
+  SamReadCache(const SamReadCache& other) = delete;
+  SamReadCache& operator=(const SamReadCache&) = delete;
+
+ private:
+  SamReadCache(const string& cache_dir, uint64 fingerprint);
+
+  // Makes reads the bin kept in memory.
+  void Remember(const string& contig, int64 bin,
+                std::shared_ptr<const Bin> reads) const;
+
+  const string cache_dir_;
+  // Fingerprint of the reads file identity and the relevant options.
+  const uint64 fingerprint_;
+
+  mutable absl::Mutex mutex_;
+  // The bin last looked up or stored, or nullptr.
+  mutable string last_contig_ ABSL_GUARDED_BY(mutex_);
+  mutable int64 last_bin_ ABSL_GUARDED_BY(mutex_) = -1;
+  mutable std::shared_ptr<const Bin> last_reads_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_SAM_READ_CACHE_H_
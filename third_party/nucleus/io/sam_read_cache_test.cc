@@ -0,0 +1,227 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/io/sam_read_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/testing/protocol-buffer-matchers.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+#include "third_party/nucleus/core/status_matchers.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+using nucleus::genomics::v1::SamReaderOptions;
+using std::vector;
+using ::testing::IsEmpty;
+using ::testing::Not;
+using ::testing::Pointwise;
+using ::testing::SizeIs;
+
+constexpr char kBamTestFilename[] = "test.bam";
+
+class SamReadCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    bam_ = GetTestData(kBamTestFilename);
+    cache_dir_ = MakeTempFile(
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    TF_CHECK_OK(tensorflow::Env::Default()->RecursivelyCreateDir(cache_dir_));
+    std::unique_ptr<SamReader> reader =
+        std::move(SamReader::FromFile(bam_, SamReaderOptions()).ValueOrDie());
+    const vector<Read> reads =
+        as_vector(reader->Query(MakeRange("chr20", 9999999, 10000100)));
+    ASSERT_THAT(reads, SizeIs(106));
+    bin_ = std::make_shared<SamReadCache::Bin>();
+    for (const Read& read : reads) {
+      bin_->reads.push_back(read);
+      bin_->spans.emplace_back(read.alignment().position().position(),
+                               ReadEnd(read));
+    }
+  }
+
+  std::unique_ptr<SamReadCache> MakeCache(const SamReaderOptions& options) {
+    return std::move(
+        SamReadCache::Create(cache_dir_, bam_, options).ValueOrDie());
+  }
+
+  // Returns QueryBatch(regions) of a reader of bam_ with options.
+  vector<Read> QueryBatch(const SamReaderOptions& options,
+                          const vector<Range>& regions) {
+    std::unique_ptr<SamReader> reader =
+        std::move(SamReader::FromFile(bam_, options).ValueOrDie());
+    StatusOr<vector<Read>> reads = reader->QueryBatch(regions);
+    TF_CHECK_OK(reads.status());
+    return reads.ValueOrDie();
+  }
+
+  string bam_;
+  string cache_dir_;
+  std::shared_ptr<SamReadCache::Bin> bin_;
+};
+
+TEST_F(SamReadCacheTest, StoreThenLookup) {
+  std::unique_ptr<SamReadCache> cache = MakeCache(SamReaderOptions());
+  EXPECT_EQ(cache->Lookup("chr20", 1000), nullptr);
+
+  ASSERT_THAT(cache->Store("chr20", 1000, bin_), IsOK());
+  std::shared_ptr<const SamReadCache::Bin> cached =
+      cache->Lookup("chr20", 1000);
+  ASSERT_NE(cached, nullptr);
+  EXPECT_THAT(cached->reads, Pointwise(EqualsProto(), bin_->reads));
+  EXPECT_EQ(cached->spans, bin_->spans);
+
+  // A different cache object for the same file and options reads the entry.
+  cached = MakeCache(SamReaderOptions())->Lookup("chr20", 1000);
+  ASSERT_NE(cached, nullptr);
+  EXPECT_THAT(cached->reads, Pointwise(EqualsProto(), bin_->reads));
+  EXPECT_EQ(cached->spans, bin_->spans);
+
+  // Empty entries are valid too.
+  ASSERT_THAT(cache->Store("chr20", 0, std::make_shared<SamReadCache::Bin>()),
+              IsOK());
+  cached = MakeCache(SamReaderOptions())->Lookup("chr20", 0);
+  ASSERT_NE(cached, nullptr);
+  EXPECT_THAT(cached->reads, IsEmpty());
+}
+
+TEST_F(SamReadCacheTest, EntriesAreKeyedByOptionsAndBins) {
+  SamReaderOptions options;
+  const string path = MakeCache(options)->EntryPath("chr20", 1000);
+  EXPECT_NE(path, MakeCache(options)->EntryPath("chr20", 1001));
+  EXPECT_NE(path, MakeCache(options)->EntryPath("chr21", 1000));
+
+  // Options that change which reads are returned change the key...
+  options.mutable_read_requirements()->set_min_mapping_quality(10);
+  EXPECT_NE(path, MakeCache(options)->EntryPath("chr20", 1000));
+
+  // ... but performance-only options do not.
+  options.clear_read_requirements();
+  options.set_num_decompression_threads(4);
+  options.set_hts_block_size(1 << 20);
+  options.set_read_cache_dir(cache_dir_);
+  EXPECT_EQ(path, MakeCache(options)->EntryPath("chr20", 1000));
+
+  options.set_max_depth(10);
+  EXPECT_THAT(SamReadCache::Create(cache_dir_, bam_, options).status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kInvalidArgument,
+                                        "max_depth"));
+  options.clear_max_depth();
+  options.set_downsample_fraction(0.5);
+  EXPECT_THAT(SamReadCache::Create(cache_dir_, bam_, options).status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kInvalidArgument,
+                                        "downsample_fraction"));
+}
+
+TEST_F(SamReadCacheTest, CorruptEntriesAreMisses) {
+  ASSERT_THAT(MakeCache(SamReaderOptions())->Store("chr20", 1000, bin_),
+              IsOK());
+  std::unique_ptr<SamReadCache> cache = MakeCache(SamReaderOptions());
+  const string path = cache->EntryPath("chr20", 1000);
+  string contents;
+  TF_CHECK_OK(
+      tensorflow::ReadFileToString(tensorflow::Env::Default(), path, &contents));
+  // Truncate the entry.
+  TF_CHECK_OK(tensorflow::WriteStringToFile(
+      tensorflow::Env::Default(), path,
+      contents.substr(0, contents.size() / 2)));
+  EXPECT_EQ(cache->Lookup("chr20", 1000), nullptr);
+}
+
+TEST_F(SamReadCacheTest, SamReaderQueryBatchUsesCache) {
+  SamReaderOptions cached_options;
+  cached_options.set_read_cache_dir(cache_dir_);
+  // The region spans the boundary of bins 999 and 1000.
+  const vector<Range> regions = {MakeRange("chr20", 9999999, 10000100)};
+  const vector<Read> expected = QueryBatch(SamReaderOptions(), regions);
+  EXPECT_THAT(QueryBatch(cached_options, regions),
+              Pointwise(EqualsProto(), expected));
+
+  // The first QueryBatch populated both bins.
+  std::unique_ptr<SamReadCache> cache = MakeCache(cached_options);
+  EXPECT_NE(cache->Lookup("chr20", 999), nullptr);
+  ASSERT_NE(cache->Lookup("chr20", 1000), nullptr);
+
+  // Subsequent queries are served from the cache rather than the BAM.
+  auto subset = std::make_shared<SamReadCache::Bin>(
+      *cache->Lookup("chr20", 1000));
+  subset->reads.resize(3);
+  subset->spans.resize(3);
+  ASSERT_THAT(cache->Store("chr20", 1000, subset), IsOK());
+  const vector<Range> in_bin = {MakeRange("chr20", 10000000, 10000100)};
+  EXPECT_THAT(QueryBatch(cached_options, in_bin),
+              Pointwise(EqualsProto(), subset->reads));
+}
+
+TEST_F(SamReadCacheTest, QueriesWithOtherRegionsHitTheCache) {
+  SamReaderOptions cached_options;
+  cached_options.set_read_cache_dir(cache_dir_);
+  QueryBatch(cached_options, {MakeRange("chr20", 9990000, 10010000)});
+  vector<string> entries;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetChildren(cache_dir_, &entries));
+  // Bins 999 and 1000.
+  EXPECT_THAT(entries, SizeIs(2));
+
+  // Regions partitioned differently from the first pass are assembled from the
+  // same bins, returning each read once and in file order.
+  for (const vector<Range>& regions : vector<vector<Range>>{
+           {MakeRange("chr20", 10000000, 10000100)},
+           {MakeRange("chr20", 9999950, 10000050)},
+           {MakeRange("chr20", 10000020, 10000040),
+            MakeRange("chr20", 9999990, 10000000),
+            MakeRange("chr20", 10000060, 10000080)},
+       }) {
+    const vector<Read> expected = QueryBatch(SamReaderOptions(), regions);
+    EXPECT_THAT(expected, Not(IsEmpty()));
+    EXPECT_THAT(QueryBatch(cached_options, regions),
+                Pointwise(EqualsProto(), expected));
+  }
+  // No further bins had to be read.
+  entries.clear();
+  TF_CHECK_OK(tensorflow::Env::Default()->GetChildren(cache_dir_, &entries));
+  EXPECT_THAT(entries, SizeIs(2));
+}
+
+}  // namespace nucleus
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of sam_read_prefetcher.h
+#include "third_party/nucleus/io/sam_read_prefetcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+using nucleus::genomics::v1::SamReaderOptions;
+
+StatusOr<std::unique_ptr<SamReadPrefetcher>> SamReadPrefetcher::Create(
+    const string& reads_path, const string& ref_path,
+    const SamReaderOptions& options, const std::vector<Range>& regions,
+    int max_regions_ahead, int64 max_buffered_bytes) {
+  if (max_regions_ahead <= 0) {
+    return ::nucleus::InvalidArgument(
+        absl::StrCat("max_regions_ahead must be positive, got ",
+                     max_regions_ahead));
+  }
+  StatusOr<std::unique_ptr<SamReader>> reader_or =
+      SamReader::FromFile(reads_path, ref_path, options);
+  NUCLEUS_RETURN_IF_ERROR(reader_or.status());
+  return std::unique_ptr<SamReadPrefetcher>(
+      new SamReadPrefetcher(std::move(reader_or.ValueOrDie()), regions,
+                            max_regions_ahead, max_buffered_bytes));
+}
+
+SamReadPrefetcher::SamReadPrefetcher(std::unique_ptr<SamReader> reader,
+                                     const std::vector<Range>& regions,
+                                     int max_regions_ahead,
+                                     int64 max_buffered_bytes)
+    : reader_(std::move(reader)),
+      regions_(regions),
+      max_regions_ahead_(max_regions_ahead),
+      max_buffered_bytes_(max_buffered_bytes) {
+  for (int i = 0; i < regions_.size(); ++i) {
+    region_indices_.emplace(
+        std::make_tuple(regions_[i].reference_name(), regions_[i].start(),
+                        regions_[i].end()),
+        i);
+  }
+  thread_ = std::thread(&SamReadPrefetcher::Run, this);
+}
+
+SamReadPrefetcher::~SamReadPrefetcher() {
+  {
+    absl::MutexLock lock(&mutex_);
+    cancelled_ = true;
+  }
+  thread_.join();
+}
+
+bool SamReadPrefetcher::CanLoad() const {
+  if (cancelled_) return true;
+  if (loaded_.empty()) return true;
+  return loaded_.size() < max_regions_ahead_ &&
+         (max_buffered_bytes_ <= 0 || buffered_bytes_ < max_buffered_bytes_);
+}
+
+bool SamReadPrefetcher::RequestedIsLoaded() const {
+  return !loaded_.empty() && loaded_.front().index >= requested_;
+}
+
+void SamReadPrefetcher::Run() {
+  while (true) {
+    int index;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &SamReadPrefetcher::CanLoad));
+      // Never load a region Fetch() has already skipped past.
+      next_to_load_ = std::max(next_to_load_, requested_);
+      if (cancelled_ || next_to_load_ >= regions_.size()) return;
+      index = next_to_load_++;
+    }
+
+    LoadedRegion loaded;
+    loaded.index = index;
+    loaded.n_bytes = 0;
+    StatusOr<std::vector<Read>> reads_or =
+        reader_->QueryBatch({regions_[index]});
+    loaded.status = reads_or.status();
+    if (reads_or.ok()) {
+      loaded.reads = std::move(reads_or.ValueOrDie());
+      for (const Read& read : loaded.reads) {
+        loaded.n_bytes += read.ByteSizeLong();
+      }
+    }
+
+    absl::MutexLock lock(&mutex_);
+    if (index >= requested_) {
+      buffered_bytes_ += loaded.n_bytes;
+      loaded_.push_back(std::move(loaded));
+    }
+  }
+}
+
+int SamReadPrefetcher::PendingIndex(const Range& region) const {
+  auto it = region_indices_.find(std::make_tuple(
+      region.reference_name(), region.start(), region.end()));
+  if (it == region_indices_.end() || it->second <= requested_) return -1;
+  return it->second;
+}
+
+bool SamReadPrefetcher::IsPending(const Range& region) const {
+  absl::MutexLock lock(&mutex_);
+  return PendingIndex(region) >= 0;
+}
+
+StatusOr<std::vector<Read>> SamReadPrefetcher::Fetch(const Range& region) {
+  absl::MutexLock lock(&mutex_);
+  const int index = PendingIndex(region);
+  if (index < 0) {
+    return ::nucleus::NotFound(absl::StrCat(
+        "Region ", region.ShortDebugString(), " is not scheduled for prefetch"));
+  }
+  requested_ = index;
+  // Drop regions the caller skipped over, which also makes room for the
+  // background thread to move on to the requested one.
+  while (!loaded_.empty() && loaded_.front().index < requested_) {
+    buffered_bytes_ -= loaded_.front().n_bytes;
+    loaded_.pop_front();
+  }
+  mutex_.Await(absl::Condition(this, &SamReadPrefetcher::RequestedIsLoaded));
+  LoadedRegion loaded = std::move(loaded_.front());
+  loaded_.pop_front();
+  buffered_bytes_ -= loaded.n_bytes;
+  CHECK_EQ(loaded.index, requested_);
+  NUCLEUS_RETURN_IF_ERROR(loaded.status);
+  return std::move(loaded.reads);
+}
+
+}  // namespace nucleus
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_IO_SAM_READ_PREFETCHER_H_
+#define THIRD_PARTY_NUCLEUS_IO_SAM_READ_PREFETCHER_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <tuple>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/protos/reads.pb.h"
+#include "third_party/nucleus/core/status.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace nucleus {
+
+// Loads the reads of an ordered list of regions ahead of time.
+//
+// A SamReadPrefetcher owns its own SamReader and a background thread that walks
+// the regions in order, fetching each one with SamReader::QueryBatch while the
+// caller is still busy with an earlier region. This hides read I/O and
+// decompression latency behind the caller's processing without changing which
+// reads are returned, or in what order: the background reader sees exactly the
+// sequence of queries a synchronous reader would.
+//
+// At most max_regions_ahead loaded regions are buffered. Loading also pauses
+// once the buffered reads exceed max_buffered_bytes (measured as serialized
+// proto size), although at least one region is always buffered so that a
+// single huge region cannot stall the pipeline.
+//
+// Fetch() is not thread-safe and should be called from a single thread.
+class SamReadPrefetcher {
+ public:
+  // Creates a prefetcher reading from reads_path (see SamReader::FromFile for
+  // the meaning of ref_path and options) that immediately starts loading
+  // regions in the background. regions should be distinct.
+  static StatusOr<std::unique_ptr<SamReadPrefetcher>> Create(
+      const string& reads_path, const string& ref_path,
+      const nucleus::genomics::v1::SamReaderOptions& options,
+      const std::vector<nucleus::genomics::v1::Range>& regions,
+      int max_regions_ahead, int64 max_buffered_bytes);
+
+  // Stops the background thread, discarding any loaded but unfetched regions.
+  ~SamReadPrefetcher();
+
+  // Disable assignment/copy operations
+  SamReadPrefetcher(const SamReadPrefetcher& other) = delete;
+  SamReadPrefetcher& operator=(const SamReadPrefetcher&) = delete;
+
+  // Returns the reads overlapping region, blocking until they are loaded.
+  //
+  // region must be one of the regions given at construction that comes after
+  // every previously fetched region; regions skipped over are dropped. Returns
+  // a NotFound status otherwise, in which case the caller should query region
+  // through a regular SamReader instead.
+  StatusOr<std::vector<nucleus::genomics::v1::Read>> Fetch(
+      const nucleus::genomics::v1::Range& region);
+
+  // Returns true if Fetch(region) would be served by this prefetcher.
+  bool IsPending(const nucleus::genomics::v1::Range& region) const;
+
+  // Returns the header of the underlying reader.
+  const nucleus::genomics::v1::SamHeader& Header() const {
+    return reader_->Header();
+  }
+
+ private:
+  // Reads loaded by the background thread for regions_[index].
+  struct LoadedRegion {
+    int index;
+    ::nucleus::Status status;
+    std::vector<nucleus::genomics::v1::Read> reads;
+    int64 n_bytes;
+  };
+
+  SamReadPrefetcher(std::unique_ptr<SamReader> reader,
+                    const std::vector<nucleus::genomics::v1::Range>& regions,
+                    int max_regions_ahead, int64 max_buffered_bytes);
+
+  // Body of the background thread.
+  void Run();
+
+  // True if the background thread may load another region.
+  bool CanLoad() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the index of region in regions_ if it can still be fetched, or -1.
+  int PendingIndex(const nucleus::genomics::v1::Range& region) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // True if the region requested by Fetch() is at the front of loaded_.
+  bool RequestedIsLoaded() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::unique_ptr<SamReader> reader_;
+  const std::vector<nucleus::genomics::v1::Range> regions_;
+  const int max_regions_ahead_;
+  const int64 max_buffered_bytes_;
+
+  // Index into regions_ of each region, keyed by (reference_name, start, end).
+  std::map<std::tuple<string, int64, int64>, int> region_indices_;
+
+  mutable absl::Mutex mutex_;
+  // Regions loaded but not yet fetched, in increasing index order.
+  std::deque<LoadedRegion> loaded_ ABSL_GUARDED_BY(mutex_);
+  // Sum of n_bytes over loaded_.
+  int64 buffered_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Index of the next region the background thread will load.
+  int next_to_load_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Index of the region most recently requested by Fetch(), or -1.
+  int requested_ ABSL_GUARDED_BY(mutex_) = -1;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+
+  std::thread thread_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_IO_SAM_READ_PREFETCHER_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/io/sam_read_prefetcher.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/sam_reader.h"
+#include "third_party/nucleus/testing/protocol-buffer-matchers.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+#include "third_party/nucleus/core/status_matchers.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using nucleus::genomics::v1::Read;
+using nucleus::genomics::v1::SamReaderOptions;
+using std::vector;
+using ::testing::IsEmpty;
+using ::testing::Pointwise;
+using ::testing::SizeIs;
+
+constexpr char kBamTestFilename[] = "test.bam";
+
+class SamReadPrefetcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    regions_ = {MakeRange("chr20", 9999999, 10000000),
+                MakeRange("chr20", 10000000, 10000050),
+                MakeRange("chr20", 10000050, 10000100),
+                MakeRange("chr20", 999999, 2000000)};
+    std::unique_ptr<SamReader> reader = std::move(
+        SamReader::FromFile(GetTestData(kBamTestFilename), SamReaderOptions())
+            .ValueOrDie());
+    for (const Range& region : regions_) {
+      expected_.push_back(as_vector(reader->Query(region)));
+    }
+  }
+
+  std::unique_ptr<SamReadPrefetcher> MakePrefetcher(int max_regions_ahead,
+                                                    int64 max_buffered_bytes) {
+    return std::move(SamReadPrefetcher::Create(
+                         GetTestData(kBamTestFilename), "", SamReaderOptions(),
+                         regions_, max_regions_ahead, max_buffered_bytes)
+                         .ValueOrDie());
+  }
+
+  vector<Range> regions_;
+  vector<vector<Read>> expected_;
+};
+
+TEST_F(SamReadPrefetcherTest, FetchesMatchQueries) {
+  for (int64 max_buffered_bytes : {0, 1}) {
+    std::unique_ptr<SamReadPrefetcher> prefetcher =
+        MakePrefetcher(2, max_buffered_bytes);
+    for (int i = 0; i < regions_.size(); ++i) {
+      EXPECT_TRUE(prefetcher->IsPending(regions_[i]));
+      StatusOr<vector<Read>> reads = prefetcher->Fetch(regions_[i]);
+      ASSERT_THAT(reads.status(), IsOK());
+      EXPECT_THAT(reads.ValueOrDie(), Pointwise(EqualsProto(), expected_[i]));
+      EXPECT_FALSE(prefetcher->IsPending(regions_[i]));
+    }
+  }
+}
+
+TEST_F(SamReadPrefetcherTest, SkippedRegionsAreDropped) {
+  std::unique_ptr<SamReadPrefetcher> prefetcher = MakePrefetcher(1, 0);
+  StatusOr<vector<Read>> reads = prefetcher->Fetch(regions_[2]);
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), Pointwise(EqualsProto(), expected_[2]));
+  // Regions before the last fetched one can no longer be fetched.
+  EXPECT_FALSE(prefetcher->IsPending(regions_[0]));
+  EXPECT_THAT(prefetcher->Fetch(regions_[1]).status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kNotFound,
+                                        "not scheduled for prefetch"));
+  reads = prefetcher->Fetch(regions_[3]);
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), IsEmpty());
+}
+
+TEST_F(SamReadPrefetcherTest, UnscheduledRegionIsNotFound) {
+  std::unique_ptr<SamReadPrefetcher> prefetcher = MakePrefetcher(2, 0);
+  const Range unscheduled = MakeRange("chr20", 9999999, 10000100);
+  EXPECT_FALSE(prefetcher->IsPending(unscheduled));
+  EXPECT_THAT(prefetcher->Fetch(unscheduled).status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kNotFound,
+                                        "not scheduled for prefetch"));
+  // A failed fetch doesn't disturb the schedule.
+  StatusOr<vector<Read>> reads = prefetcher->Fetch(regions_[0]);
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), SizeIs(45));
+}
+
+TEST_F(SamReadPrefetcherTest, DestroyWithPendingRegions) {
+  std::unique_ptr<SamReadPrefetcher> prefetcher = MakePrefetcher(2, 0);
+  EXPECT_THAT(prefetcher->Fetch(regions_[0]).status(), IsOK());
+  prefetcher.reset();
+}
+
+TEST_F(SamReadPrefetcherTest, RejectsNonPositiveLookahead) {
+  EXPECT_THAT(SamReadPrefetcher::Create(GetTestData(kBamTestFilename), "",
+                                        SamReaderOptions(), regions_, 0, 0)
+                  .status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kInvalidArgument,
+                                        "max_regions_ahead"));
+}
+
+}  // namespace nucleus
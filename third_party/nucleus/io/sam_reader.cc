@@ -35,8 +35,11 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <algorithm>
+#include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <utility>
@@ -78,7 +81,8 @@ using google::protobuf::RepeatedField;
 
 namespace {
 
-inline constexpr char kOQ[] = "OQ";
+// Window size used by max_depth when max_depth_window_size is not set.
+constexpr int64 kDefaultMaxDepthWindowSize = 100;
 
 bool FileTypeIsIndexable(htsFormat format) {
   return format.format == bam || format.format == cram;
@@ -218,6 +222,30 @@ bool PartialReadSatisfiesRequirements(
           !read.supplementary_alignment());
 }
 
+// Same as sam_reader_internal::ReadSatisfiesRequirements(), but on a raw
+// htslib record, so without the cost of converting it to a Read.
+bool RecordSatisfiesRequirements(
+    const bam1_t& record,
+    const nucleus::genomics::v1::ReadRequirements& requirements) {
+  const bam1_core_t& c = record.core;
+  const bool aligned = !(c.flag & BAM_FUNMAP);
+  const bool paired = c.flag & BAM_FPAIRED;
+  const bool has_mate_position =
+      paired && !(c.flag & BAM_FMUNMAP) && c.mtid >= 0;
+  return (requirements.keep_duplicates() || !(c.flag & BAM_FDUP)) &&
+         (requirements.keep_failed_vendor_quality_checks() ||
+          !(c.flag & BAM_FQCFAIL)) &&
+         (requirements.keep_secondary_alignments() ||
+          !(c.flag & BAM_FSECONDARY)) &&
+         (requirements.keep_supplementary_alignments() ||
+          !(c.flag & BAM_FSUPPLEMENTARY)) &&
+         (requirements.keep_unaligned() || aligned) &&
+         (requirements.keep_improperly_placed() || !paired ||
+          (c.flag & BAM_FPROPER_PAIR) || !has_mate_position || !aligned ||
+          c.tid == c.mtid) &&
+         (!aligned || c.qual >= requirements.min_mapping_quality());
+}
+
 }  // namespace
 
 namespace sam_reader_internal {
@@ -268,6 +296,11 @@ static inline bool StartsWith(const string& query, const char prefix[],
   return query.compare(0, prefix_len, prefix) == 0;
 }
 
+// Returns the two-character aux tag starting at s as a string.
+static inline string AuxTagName(const uint8_t* s) {
+  return string(reinterpret_cast<const char*>(s), 2);
+}
+
 // Parses out the aux tag attributes of a SAM record.
 //
 // From https://samtools.github.io/hts-specs/SAMv1.pdf
@@ -294,9 +327,13 @@ static inline bool StartsWith(const string& query, const char prefix[],
 // (unsigned 8-bit integer), int16 t, uint16 t, int32 t, uint32 t and float,
 // respectively.
 //
+// Only tags in tags_to_keep are decoded into read_message's info map; all other
+// tags are skipped over without allocating anything.
+//
 // Args:
 //   b: The htslib bam record we will parse aux fields from.
 //   option: Controls how aux fields are parsed.
+//   tags_to_keep: The tags to store, compiled from option.aux_fields_to_keep.
 //   read_message: Destination for parsed aux fields.
 //
 // Returns:
@@ -304,11 +341,11 @@ static inline bool StartsWith(const string& query, const char prefix[],
 //   otherwise will contain an error_message describing the problem.
 ::nucleus::Status ParseAuxFields(const bam1_t* b,
                                  const SamReaderOptions& options,
+                                 const AuxTagSet& tags_to_keep,
                                  Read* read_message) {
   if (options.aux_field_handling() != SamReaderOptions::PARSE_ALL_AUX_FIELDS) {
     return ::nucleus::Status();
   }
-  const auto& aux_fields_to_keep = options.aux_fields_to_keep();
 
   uint8_t* s = bam_get_aux(b);
   const uint8_t* end = b->data + b->l_data;
@@ -316,11 +353,10 @@ static inline bool StartsWith(const string& query, const char prefix[],
     // Each block is encoded like (each element is a byte):
     // [tag char 1, tag char 2, type byte, ...]
     // where the ... contents depends on the 2-character tag and type.
-    const string tag = string(reinterpret_cast<char*>(s), 2);
-    bool include_tag =
-        (aux_fields_to_keep.empty() ||
-         std::find(aux_fields_to_keep.begin(), aux_fields_to_keep.end(), tag) !=
-             aux_fields_to_keep.end());
+    const uint8_t* tag_start = s;
+    const bool include_tag = tags_to_keep.Contains(tag_start);
+    // Only materialize the tag name for tags we store.
+    const string tag = include_tag ? AuxTagName(tag_start) : string();
     s += 2;
     const uint8_t type = *s++;
     switch (type) {
@@ -342,19 +378,21 @@ static inline bool StartsWith(const string& query, const char prefix[],
       case 'i': {
         const int size = HtslibAuxSize(type);
         if (size < 0 || end - s < size)
-          return ::nucleus::DataLoss("Malformed tag " + tag);
-        errno = 0;
-        const int value = bam_aux2i(s - 1);
-        if (value == 0 && errno == EINVAL)
-          return ::nucleus::DataLoss("Malformed tag " + tag);
-        if (include_tag) SetInfoField(tag, value, read_message);
+          return ::nucleus::DataLoss("Malformed tag " + AuxTagName(tag_start));
+        if (include_tag) {
+          errno = 0;
+          const int value = bam_aux2i(s - 1);
+          if (value == 0 && errno == EINVAL)
+            return ::nucleus::DataLoss("Malformed tag " + tag);
+          SetInfoField(tag, value, read_message);
+        }
         s += size;
       } break;
       // A 4-byte floating point.
       case 'f': {
-        if (end - s < 4) return ::nucleus::DataLoss("Malformed tag " + tag);
-        const float value = le_to_float(s);
-        if (include_tag) SetInfoField(tag, value, read_message);
+        if (end - s < 4)
+          return ::nucleus::DataLoss("Malformed tag " + AuxTagName(tag_start));
+        if (include_tag) SetInfoField(tag, le_to_float(s), read_message);
         s += 4;
       } break;
       // Z and H are null-terminated strings.
@@ -363,7 +401,8 @@ static inline bool StartsWith(const string& query, const char prefix[],
         char* value = reinterpret_cast<char*>(s);
         for (; s < end && *s; ++s) {
         }  // Loop to the end.
-        if (s >= end) return ::nucleus::DataLoss("Malformed tag " + tag);
+        if (s >= end)
+          return ::nucleus::DataLoss("Malformed tag " + AuxTagName(tag_start));
         s++;
         // The H hex tag is not really used and likely deprecated (see:
         // https://sourceforge.net/p/samtools/mailman/message/28274509/
@@ -375,15 +414,26 @@ static inline bool StartsWith(const string& query, const char prefix[],
         const uint8_t sub_type = *s++;
         const int element_size = HtslibAuxSize(sub_type);
         if (element_size < 0)
-          return ::nucleus::DataLoss("element_size == 0 for tag " + tag);
+          return ::nucleus::DataLoss("element_size == 0 for tag " +
+                                     AuxTagName(tag_start));
         // Prevents us from reading off the end of our buffer with le_to_u32.
         if (end - s < 4)
-          return ::nucleus::DataLoss("data too short for tag " + tag);
+          return ::nucleus::DataLoss("data too short for tag " +
+                                     AuxTagName(tag_start));
         const int n_elements = le_to_u32(s);
         if (n_elements == 0) return ::nucleus::DataLoss("n_elements is zero");
         // We need to skip 4 bytes for n_elements int that occurs before the
         // array.
         s += 4;
+        if (n_elements < 0 ||
+            end - s < static_cast<int64>(n_elements) * element_size)
+          return ::nucleus::DataLoss("data too short for tag " +
+                                     AuxTagName(tag_start));
+        if (!include_tag) {
+          // Jump over arrays we don't keep rather than decoding them.
+          s += n_elements * element_size;
+          break;
+        }
         if (sub_type == 'c') {
           std::vector<int8_t> all_values;
           for (int i = 0; i < n_elements; i++) {
@@ -460,7 +510,7 @@ static inline bool StartsWith(const string& query, const char prefix[],
         }
       } break;
       default: {
-        return ::nucleus::DataLoss("Unknown tag " + tag);
+        return ::nucleus::DataLoss("Unknown tag " + AuxTagName(tag_start));
       }
     }
   }
@@ -475,16 +525,13 @@ static inline bool StartsWith(const string& query, const char prefix[],
                                        const SamReaderOptions& options,
                                        Read* read_message) {
   const bam1_core_t* c = &b->core;
-  // Use optional "OQ" tag.
+  // Use optional "OQ" tag, read straight from the record.
   if (options.use_original_base_quality_scores()) {
-    const auto& info = read_message->info();
-    auto info_it = info.find(kOQ);
-    if (info_it != read_message->info().end() &&
-        !info_it->second.values().empty()) {
+    string_view oq;
+    if (GetOriginalQualityTag(b, &oq)) {
       RepeatedField<int32>* quality = read_message->mutable_aligned_quality();
-      quality->Reserve(c->l_qseq);
-      const auto& oq_tag_value = *(info_it->second.values().begin());
-      for (char c : oq_tag_value.string_value()) {
+      quality->Reserve(oq.size());
+      for (char c : oq) {
         quality->Add(reinterpret_cast<int>(c - 33));
       }
       return ::nucleus::Status();
@@ -513,6 +560,7 @@ static inline bool StartsWith(const string& query, const char prefix[],
 // expensive in long reads.
 ::nucleus::Status ConvertToPb(const bam_hdr_t* h, const bam1_t* b,
                               const SamReaderOptions& options,
+                              const AuxTagSet& aux_tags_to_keep,
                               Read* read_message) {
   CHECK(h != nullptr) << "BAM header cannot be null";
   CHECK(b != nullptr) << "BAM record cannot be null";
@@ -595,7 +643,8 @@ static inline bool StartsWith(const string& query, const char prefix[],
   }
 
   // Parse out our read aux fields.
-  ::nucleus::Status status = ParseAuxFields(b, options, read_message);
+  ::nucleus::Status status =
+      ParseAuxFields(b, options, aux_tags_to_keep, read_message);
   if (!status.ok()) {
     // Not thread safe.
     static int counter = 0;
@@ -605,8 +654,6 @@ static inline bool StartsWith(const string& query, const char prefix[],
     }
   }
 
-  // aligned_quality may be read from aux field "OQ", therefore
-  // AssignAlignedQuality function should be called after ParseAuxFields.
   status = AssignAlignedQuality(b, options, read_message);
   if (!status.ok()) {
     LOG(WARNING) << "Could not read base quality scores " << bam_get_qname(b)
@@ -626,6 +673,13 @@ class SamIterableBase : public SamIterable {
   // Advance to the next record.
   StatusOr<bool> Next(nucleus::genomics::v1::Read* out) override;
 
+  // Like Next(), but returns the raw record instead of converting it, or
+  // nullptr at the end. The record is overwritten by the next call.
+  StatusOr<const bam1_t*> NextRecord();
+
+  // The record behind the Read last returned by Next().
+  const bam1_t& record() const { return *bam1_; }
+
   // Base class constructor. Intializes common attrubutes.
   SamIterableBase(const SamReader* reader, htsFile* fp, bam_hdr_t* header);
   ~SamIterableBase() override;
@@ -634,6 +688,18 @@ class SamIterableBase : public SamIterable {
   htsFile* fp_;
   bam_hdr_t* header_;
   bam1_t* bam1_;
+  // Enforces options.max_depth() over the reads returned by this iterable, or
+  // nullptr if depth is not capped.
+  std::unique_ptr<DepthCappedSampler> depth_sampler_;
+  // True if options.downsample_fraction() is set.
+  bool downsampling_ = false;
+
+ private:
+  // Returns true if depth_sampler_ can keep the current record.
+  bool CanKeepUnderDepthCap() {
+    return depth_sampler_->CanKeep(bam1_->core.tid, bam1_->core.pos,
+                                   bam_endpos(bam1_));
+  }
 };
 
 // Iterable class for traversing all BAM records in the file.
@@ -663,23 +729,36 @@ class SamQueryIterable : public SamIterableBase {
 };
 
 SamReader::SamReader(const string& reads_path, const SamReaderOptions& options,
-                     htsFile* fp, bam_hdr_t* header, hts_idx_t* idx)
+                     htsFile* fp, bam_hdr_t* header, hts_idx_t* idx,
+                     std::shared_ptr<HtsThreadPool> thread_pool,
+                     std::shared_ptr<CramReferenceCache> reference_cache)
     : options_(options),
       fp_(fp),
       header_(header),
       idx_(idx),
-      sampler_(options.downsample_fraction(), options.random_seed()) {
+      sampler_(options.downsample_fraction(), options.random_seed()),
+      aux_tags_to_keep_(options.aux_fields_to_keep()),
+      thread_pool_(std::move(thread_pool)),
+      reference_cache_(std::move(reference_cache)) {
+  if (!options.read_cache_dir().empty() &&
+      options.downsample_fraction() == 0.0) {
+    StatusOr<std::unique_ptr<SamReadCache>> read_cache =
+        SamReadCache::Create(options.read_cache_dir(), reads_path, options);
+    if (read_cache.ok()) {
+      read_cache_ = std::move(read_cache.ValueOrDie());
+    } else {
+      LOG(WARNING) << read_cache.status() << "; not caching reads of "
+                   << reads_path;
+    }
+  }
   CHECK(fp != nullptr) << "pointer to SAM/BAM cannot be null";
   CHECK(header_ != nullptr) << "pointer to header cannot be null";
   CHECK(options.aux_field_handling() ||
         !options.use_original_base_quality_scores())
       << "aux_field_handling must be true if use_original_quality_scores is "
          "set to true";
-  bool oq_is_included = (options.aux_fields_to_keep().empty() ||
-                         std::find(options.aux_fields_to_keep().begin(),
-                                   options.aux_fields_to_keep().end(),
-                                   kOQ) != options.aux_fields_to_keep().end());
-  CHECK(oq_is_included || !options.use_original_base_quality_scores())
+  CHECK(aux_tags_to_keep_.Contains(kOriginalQualityAuxTag) ||
+        !options.use_original_base_quality_scores())
       << "aux_fields_to_keep must contain OQ or be empty (which means "
       << "including everything) if use_original_quality_scores is set to true.";
 
@@ -722,6 +801,14 @@ SamReader::SamReader(const string& reads_path, const SamReaderOptions& options,
 StatusOr<std::unique_ptr<SamReader>> SamReader::FromFile(
     const string& reads_path, const string& ref_path,
     const SamReaderOptions& options) {
+  return FromFile(reads_path, ref_path, options,
+                  HtsThreadPool::Shared(options.num_decompression_threads()));
+}
+
+StatusOr<std::unique_ptr<SamReader>> SamReader::FromFile(
+    const string& reads_path, const string& ref_path,
+    const SamReaderOptions& options,
+    std::shared_ptr<HtsThreadPool> thread_pool) {
   // Validate that we support the requested read requirements.
   if (options.has_read_requirements() &&
       options.read_requirements().min_base_quality_mode() !=
@@ -767,8 +854,26 @@ StatusOr<std::unique_ptr<SamReader>> SamReader::FromFile(
   // If we are decoding a CRAM file and the user wants to override the path to
   // the reference FASTA used to decode the CRAM, set the CRAM_OPT_REFERENCE
   // in htslib.
+  // If requested, the reference sequences are instead shared with every other
+  // CRAM reader of this process decoding against the same reference.
+  std::shared_ptr<CramReferenceCache> reference_cache;
   if (fp->format.format == cram) {
-    if (!ref_path.empty()) {
+    if (!ref_path.empty() && options.share_cram_reference()) {
+      StatusOr<std::shared_ptr<CramReferenceCache>> cache_or =
+          CramReferenceCache::Shared(reads_path, ref_path, header);
+      ::nucleus::Status status = cache_or.status();
+      if (status.ok()) status = cache_or.ValueOrDie()->AttachTo(fp);
+      if (status.ok()) {
+        LOG(INFO) << "Sharing CRAM reference '" << ref_path << "'";
+        reference_cache = cache_or.ValueOrDie();
+      } else {
+        LOG(WARNING) << status << "; loading CRAM reference " << ref_path
+                     << " for " << reads_path << " only";
+      }
+    }
+    if (reference_cache != nullptr) {
+      // Already decoding against the shared reference.
+    } else if (!ref_path.empty()) {
       LOG(INFO) << "Setting CRAM reference path to '" << ref_path << "'";
       if (cram_set_option(fp->fp.cram, CRAM_OPT_REFERENCE, ref_path.c_str())) {
         return ::nucleus::Unknown(absl::StrCat(
@@ -781,8 +886,24 @@ StatusOr<std::unique_ptr<SamReader>> SamReader::FromFile(
     }
   }
 
+  // Only BAM and CRAM have block-level work worth handing to other threads;
+  // text SAM is parsed line by line on the calling thread.
+  if (thread_pool != nullptr) {
+    if (FileTypeIsIndexable(fp->format)) {
+      ::nucleus::Status status = thread_pool->AttachTo(fp);
+      if (!status.ok()) {
+        LOG(WARNING) << status << "; decoding " << reads_path
+                     << " on the calling thread";
+        thread_pool = nullptr;
+      }
+    } else {
+      thread_pool = nullptr;
+    }
+  }
+
   return std::unique_ptr<SamReader>(
-      new SamReader(reads_path, options, fp, header, idx));
+      new SamReader(reads_path, options, fp, header, idx,
+                    std::move(thread_pool), std::move(reference_cache)));
 }
 
 SamReader::~SamReader() {
@@ -807,6 +928,12 @@ bool SamReader::KeepRead(const nucleus::genomics::v1::Read& read) const {
          (options_.downsample_fraction() == 0.0 || sampler_.Keep());
 }
 
+bool SamReader::KeepRecord(const bam1_t& record) const {
+  return (!options_.has_read_requirements() ||
+          RecordSatisfiesRequirements(record, options_.read_requirements())) &&
+         (options_.downsample_fraction() == 0.0 || sampler_.Keep());
+}
+
 StatusOr<std::shared_ptr<SamIterable>> SamReader::Iterate() const {
   if (fp_ == nullptr)
     return ::nucleus::FailedPrecondition("Cannot Iterate a closed SamReader.");
@@ -842,6 +969,266 @@ StatusOr<std::shared_ptr<SamIterable>> SamReader::Query(
       MakeIterable<SamQueryIterable>(this, fp_, header_, iter));
 }
 
+namespace {
+
+// Groups the non-empty regions by contig, sorts them and merges overlapping and
+// abutting ones. Contigs are keyed by tid, so iterating over the result follows
+// the contig order of the header and walks the file front to back.
+StatusOr<std::map<int, vector<hts_pair_pos_t>>> MergeRegionsByTid(
+    bam_hdr_t* header, const vector<Range>& regions) {
+  std::map<int, vector<hts_pair_pos_t>> intervals_by_tid;
+  for (const Range& region : regions) {
+    const int tid = bam_name2id(header, region.reference_name().c_str());
+    if (tid < 0) {
+      return ::nucleus::NotFound(
+          absl::StrCat("Unknown reference_name ", region.ShortDebugString()));
+    }
+    if (region.start() >= region.end()) continue;
+    intervals_by_tid[tid].push_back({region.start(), region.end()});
+  }
+  for (auto& tid_and_intervals : intervals_by_tid) {
+    vector<hts_pair_pos_t>& intervals = tid_and_intervals.second;
+    std::sort(intervals.begin(), intervals.end(),
+              [](const hts_pair_pos_t& a, const hts_pair_pos_t& b) {
+                return a.beg < b.beg;
+              });
+    // Merge overlapping and abutting intervals.
+    int n_merged = 0;
+    for (const hts_pair_pos_t& interval : intervals) {
+      if (n_merged > 0 && interval.beg <= intervals[n_merged - 1].end) {
+        intervals[n_merged - 1].end =
+            std::max(intervals[n_merged - 1].end, interval.end);
+      } else {
+        intervals[n_merged++] = interval;
+      }
+    }
+    intervals.resize(n_merged);
+  }
+  return intervals_by_tid;
+}
+
+}  // namespace
+
+StatusOr<std::shared_ptr<SamIterable>> SamReader::QueryMultiple(
+    const vector<Range>& regions) const {
+  if (fp_ == nullptr)
+    return ::nucleus::FailedPrecondition("Cannot Query a closed SamReader.");
+  if (!HasIndex()) {
+    return ::nucleus::FailedPrecondition("Cannot query without an index");
+  }
+
+  StatusOr<std::map<int, vector<hts_pair_pos_t>>> intervals_by_tid_or =
+      MergeRegionsByTid(header_, regions);
+  NUCLEUS_RETURN_IF_ERROR(intervals_by_tid_or.status());
+  const std::map<int, vector<hts_pair_pos_t>>& intervals_by_tid =
+      intervals_by_tid_or.ValueOrDie();
+  if (intervals_by_tid.empty()) {
+    return ::nucleus::InvalidArgument(
+        "QueryMultiple requires at least one non-empty region");
+  }
+
+  // The region list is owned, and eventually free()d, by the htslib iterator,
+  // so it has to be allocated with malloc.
+  const int n_regs = intervals_by_tid.size();
+  auto* reglist =
+      static_cast<hts_reglist_t*>(calloc(n_regs, sizeof(hts_reglist_t)));
+  int i = 0;
+  for (const auto& tid_and_intervals : intervals_by_tid) {
+    const vector<hts_pair_pos_t>& intervals = tid_and_intervals.second;
+    hts_reglist_t& reg = reglist[i++];
+    reg.reg = header_->target_name[tid_and_intervals.first];
+    reg.tid = tid_and_intervals.first;
+    reg.count = intervals.size();
+    reg.intervals = static_cast<hts_pair_pos_t*>(
+        malloc(intervals.size() * sizeof(hts_pair_pos_t)));
+    std::copy(intervals.begin(), intervals.end(), reg.intervals);
+    reg.min_beg = intervals.front().beg;
+    reg.max_end = intervals.back().end;
+  }
+
+  hts_itr_t* iter = sam_itr_regions(idx_, header_, reglist, n_regs);
+  if (iter == nullptr) {
+    return ::nucleus::NotFound(
+        absl::StrCat("Failed to create a multi-region iterator over ",
+                     regions.size(), " regions"));
+  }
+
+  return StatusOr<std::shared_ptr<SamIterable>>(
+      MakeIterable<SamQueryIterable>(this, fp_, header_, iter));
+}
+
+::nucleus::Status SamReader::VisitRecords(
+    const Range& region,
+    const std::function<void(const bam1_t& record)>& visitor) const {
+  StatusOr<std::shared_ptr<SamIterable>> iterable_or = Query(region);
+  NUCLEUS_RETURN_IF_ERROR(iterable_or.status());
+  std::shared_ptr<SamIterable> iterable = iterable_or.ValueOrDie();
+  if (iterable == nullptr) {
+    return ::nucleus::FailedPrecondition(
+        "Cannot VisitRecords while another iterable is alive.");
+  }
+  // Query() always returns a SamQueryIterable.
+  auto* records = static_cast<SamIterableBase*>(iterable.get());
+  while (true) {
+    StatusOr<const bam1_t*> record = records->NextRecord();
+    NUCLEUS_RETURN_IF_ERROR(record.status());
+    if (record.ValueOrDie() == nullptr) break;
+    visitor(*record.ValueOrDie());
+  }
+  return iterable->Release();
+}
+
+StatusOr<vector<int64>> SamReader::EstimateBytes(
+    const vector<Range>& regions) const {
+  if (fp_ == nullptr) {
+    return ::nucleus::FailedPrecondition(
+        "Cannot EstimateBytes of a closed SamReader.");
+  }
+  if (!HasIndex()) {
+    return ::nucleus::FailedPrecondition("Cannot estimate without an index");
+  }
+  if (fp_->format.format == cram) {
+    return ::nucleus::Unimplemented("EstimateBytes does not support CRAM");
+  }
+
+  vector<int64> estimates;
+  estimates.reserve(regions.size());
+  for (const Range& region : regions) {
+    const int tid = bam_name2id(header_, region.reference_name().c_str());
+    if (tid < 0) {
+      return ::nucleus::NotFound(
+          absl::StrCat("Unknown reference_name ", region.ShortDebugString()));
+    }
+    int64 bytes = 0;
+    if (region.start() < region.end()) {
+      hts_itr_t* iter =
+          sam_itr_queryi(idx_, tid, region.start(), region.end());
+      if (iter == nullptr) {
+        return ::nucleus::NotFound(
+            absl::StrCat("region '", region.ShortDebugString(),
+                         "' specifies an unknown reference interval"));
+      }
+      // Each chunk spans the virtual offsets [u, v), whose upper 48 bits are
+      // the file offset of the BGZF block.
+      for (int i = 0; i < iter->n_off; ++i) {
+        bytes += (iter->off[i].v >> 16) - (iter->off[i].u >> 16);
+      }
+      hts_itr_destroy(iter);
+    }
+    estimates.push_back(bytes);
+  }
+  return estimates;
+}
+
+StatusOr<vector<Read>> SamReader::QueryBatch(
+    const vector<Range>& regions) const {
+  if (std::none_of(regions.begin(), regions.end(), [](const Range& region) {
+        return region.start() < region.end();
+      })) {
+    return vector<Read>();
+  }
+  if (read_cache_ != nullptr) {
+    return QueryBatchFromCache(regions);
+  }
+  vector<Read> reads;
+  StatusOr<std::shared_ptr<SamIterable>> iterable_or = QueryMultiple(regions);
+  NUCLEUS_RETURN_IF_ERROR(iterable_or.status());
+  std::shared_ptr<SamIterable> iterable = iterable_or.ValueOrDie();
+  if (iterable == nullptr) {
+    return ::nucleus::FailedPrecondition(
+        "Cannot QueryBatch while another iterable is alive.");
+  }
+
+  while (true) {
+    reads.emplace_back();
+    StatusOr<bool> has_next = iterable->Next(&reads.back());
+    NUCLEUS_RETURN_IF_ERROR(has_next.status());
+    if (!has_next.ValueOrDie()) break;
+  }
+  reads.pop_back();
+  NUCLEUS_RETURN_IF_ERROR(iterable->Release());
+  return reads;
+}
+
+StatusOr<vector<Read>> SamReader::QueryBatchFromCache(
+    const vector<Range>& regions) const {
+  if (fp_ == nullptr)
+    return ::nucleus::FailedPrecondition("Cannot Query a closed SamReader.");
+  StatusOr<std::map<int, vector<hts_pair_pos_t>>> intervals_by_tid =
+      MergeRegionsByTid(header_, regions);
+  NUCLEUS_RETURN_IF_ERROR(intervals_by_tid.status());
+
+  // Return the reads overlapping each interval in file order, and every read
+  // once: a read is taken from the first bin of the interval that holds it,
+  // and is skipped if it overlaps the previous interval too.
+  constexpr int64 kBinSize = SamReadCache::kBinSize;
+  vector<Read> reads;
+  for (const auto& tid_and_intervals : intervals_by_tid.ValueOrDie()) {
+    int64 previous_end = std::numeric_limits<int64>::min();
+    for (const hts_pair_pos_t& interval : tid_and_intervals.second) {
+      const int64 first_bin = interval.beg / kBinSize;
+      for (int64 bin = first_bin; bin * kBinSize < interval.end; ++bin) {
+        StatusOr<std::shared_ptr<const SamReadCache::Bin>> cached =
+            CachedBin(tid_and_intervals.first, bin);
+        NUCLEUS_RETURN_IF_ERROR(cached.status());
+        const SamReadCache::Bin& bin_reads = *cached.ValueOrDie();
+        const int64 min_start =
+            bin == first_bin ? previous_end : bin * kBinSize;
+        for (size_t i = 0; i < bin_reads.reads.size(); ++i) {
+          const int64 start = bin_reads.spans[i].first;
+          const int64 end = bin_reads.spans[i].second;
+          if (start >= min_start && start < interval.end &&
+              end > interval.beg) {
+            reads.push_back(bin_reads.reads[i]);
+          }
+        }
+      }
+      previous_end = interval.end;
+    }
+  }
+  return reads;
+}
+
+StatusOr<std::shared_ptr<const SamReadCache::Bin>> SamReader::CachedBin(
+    int tid, int64 bin) const {
+  const string contig = header_->target_name[tid];
+  std::shared_ptr<const SamReadCache::Bin> cached =
+      read_cache_->Lookup(contig, bin);
+  if (cached != nullptr) return cached;
+
+  auto bin_reads = std::make_shared<SamReadCache::Bin>();
+  const int64 start = bin * SamReadCache::kBinSize;
+  const int64 end = std::min<int64>(start + SamReadCache::kBinSize,
+                                    header_->target_len[tid]);
+  if (start < end) {
+    StatusOr<std::shared_ptr<SamIterable>> iterable_or =
+        QueryMultiple({MakeRange(contig, start, end)});
+    NUCLEUS_RETURN_IF_ERROR(iterable_or.status());
+    std::shared_ptr<SamIterable> iterable = iterable_or.ValueOrDie();
+    if (iterable == nullptr) {
+      return ::nucleus::FailedPrecondition(
+          "Cannot QueryBatch while another iterable is alive.");
+    }
+    // Query iterables are all SamIterableBases, whose current record gives
+    // the span of the last read.
+    auto* records = static_cast<SamIterableBase*>(iterable.get());
+    while (true) {
+      bin_reads->reads.emplace_back();
+      StatusOr<bool> has_next = records->Next(&bin_reads->reads.back());
+      NUCLEUS_RETURN_IF_ERROR(has_next.status());
+      if (!has_next.ValueOrDie()) break;
+      bin_reads->spans.emplace_back(records->record().core.pos,
+                                    bam_endpos(&records->record()));
+    }
+    bin_reads->reads.pop_back();
+    NUCLEUS_RETURN_IF_ERROR(iterable->Release());
+  }
+  // A failure to cache only costs the next pass some time.
+  ::nucleus::Status status = read_cache_->Store(contig, bin, bin_reads);
+  if (!status.ok()) LOG(WARNING) << status;
+  return std::shared_ptr<const SamReadCache::Bin>(std::move(bin_reads));
+}
+
 ::nucleus::Status SamReader::Close() {
   if (HasIndex()) {
     hts_idx_destroy(idx_);
@@ -851,6 +1238,10 @@ StatusOr<std::shared_ptr<SamIterable>> SamReader::Query(
   header_ = nullptr;
   int retval = hts_close(fp_);
   fp_ = nullptr;
+  // The pool and reference cache may only be released once no htsFile refers
+  // to them anymore.
+  thread_pool_ = nullptr;
+  reference_cache_ = nullptr;
   if (retval < 0) {
     return ::nucleus::Internal("hts_close() failed");
   } else {
@@ -864,28 +1255,82 @@ StatusOr<bool> SamIterableBase::Next(Read* out) {
   NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
   // Keep reading until "reader_->KeepRead(.)"
   const SamReader* sam_reader = static_cast<const SamReader*>(reader_);
-  do {
+  while (true) {
     int code = next_sam_record();
     if (code == -1) {
       return false;
     } else if (code < -1) {
       return ::nucleus::DataLoss("Failed to parse SAM record");
     }
+    // Unplaced reads have no coverage to cap.
+    const bool capped = depth_sampler_ != nullptr && bam1_->core.tid >= 0;
+    // The cap only depends on the reads kept so far, so without downsampling
+    // reads that would not fit can be dropped before paying for their
+    // conversion. With downsampling, every read that meets the requirements
+    // must still draw from the sampler, so the cap is checked afterwards.
+    if (capped && !downsampling_ && !CanKeepUnderDepthCap()) {
+      continue;
+    }
     // Convert to proto.
     ::nucleus::Status status =
-        ConvertToPb(header_, bam1_, sam_reader->options(), out);
+        ConvertToPb(header_, bam1_, sam_reader->options(),
+                    sam_reader->aux_tags_to_keep(), out);
     if (status.code() == absl::StatusCode::kAborted) {
       // "ABORT" from ConvertToPb means requirements were not met.
       continue;
     }
     NUCLEUS_RETURN_IF_ERROR(status);
-  } while (!sam_reader->KeepRead(*out));
-  return true;
+    if (!sam_reader->KeepRead(*out)) {
+      continue;
+    }
+    if (capped) {
+      if (downsampling_ && !CanKeepUnderDepthCap()) {
+        continue;
+      }
+      depth_sampler_->Add(bam1_->core.tid, bam1_->core.pos,
+                          bam_endpos(bam1_));
+    }
+    return true;
+  }
+}
+
+StatusOr<const bam1_t*> SamIterableBase::NextRecord() {
+  NUCLEUS_RETURN_IF_ERROR(CheckIsAlive());
+  const SamReader* sam_reader = static_cast<const SamReader*>(reader_);
+  while (true) {
+    int code = next_sam_record();
+    if (code == -1) {
+      return static_cast<const bam1_t*>(nullptr);
+    } else if (code < -1) {
+      return ::nucleus::DataLoss("Failed to parse SAM record");
+    }
+    if (!sam_reader->KeepRecord(*bam1_)) {
+      continue;
+    }
+    const bool capped = depth_sampler_ != nullptr && bam1_->core.tid >= 0;
+    if (capped) {
+      if (!CanKeepUnderDepthCap()) {
+        continue;
+      }
+      depth_sampler_->Add(bam1_->core.tid, bam1_->core.pos,
+                          bam_endpos(bam1_));
+    }
+    return static_cast<const bam1_t*>(bam1_);
+  }
 }
 
 SamIterableBase::SamIterableBase(const SamReader* reader, htsFile* fp,
                                  bam_hdr_t* header)
-    : Iterable(reader), fp_(fp), header_(header), bam1_(bam_init1()) {}
+    : Iterable(reader), fp_(fp), header_(header), bam1_(bam_init1()) {
+  const SamReaderOptions& options = reader->options();
+  downsampling_ = options.downsample_fraction() != 0.0;
+  if (options.max_depth() > 0) {
+    depth_sampler_ = std::make_unique<DepthCappedSampler>(
+        options.max_depth(), options.max_depth_window_size() > 0
+                                 ? options.max_depth_window_size()
+                                 : kDefaultMaxDepthWindowSize);
+  }
+}
 
 SamIterableBase::~SamIterableBase() { bam_destroy1(bam1_); }
 
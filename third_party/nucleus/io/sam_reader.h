@@ -33,12 +33,18 @@
 #ifndef THIRD_PARTY_NUCLEUS_IO_SAM_READER_H_
 #define THIRD_PARTY_NUCLEUS_IO_SAM_READER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "htslib/hts.h"
 #include "htslib/sam.h"
+#include "third_party/nucleus/io/cram_reference_cache.h"
+#include "third_party/nucleus/io/hts_thread_pool.h"
 #include "third_party/nucleus/io/reader_base.h"
+#include "third_party/nucleus/io/sam_read_cache.h"
+#include "third_party/nucleus/io/sam_utils.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/range.pb.h"
 #include "third_party/nucleus/protos/reads.pb.h"
@@ -98,12 +104,31 @@ class SamReader : public Reader {
   // extension) + '.bai'; if the index is not found, attempts to Query will
   // fail.
   //
+  // If options.share_cram_reference() is set, ref_path is not "" and the file
+  // is CRAM, the reference sequences are decoded through the process-wide
+  // CramReferenceCache for ref_path instead of being loaded by this reader
+  // alone, so multiple CRAM readers (e.g. one per sample) load each contig
+  // once.
+  //
+  // If options.num_decompression_threads() > 0 and the file is BAM or CRAM,
+  // BGZF inflation / CRAM decoding is offloaded to the process-wide
+  // HtsThreadPool of that size, shared with every other reader asking for the
+  // same number of threads.
+  //
   // Returns a StatusOr that is OK if the SamReader could be successfully
   // created or an error code indicating the error that occurred.
   static StatusOr<std::unique_ptr<SamReader>> FromFile(
       const string& reads_path, const string& ref_path,
       const nucleus::genomics::v1::SamReaderOptions& options);
 
+  // Same as above, but decodes using the explicitly provided thread_pool
+  // instead of the process-wide one. thread_pool may be nullptr, in which case
+  // decoding is single-threaded regardless of options.
+  static StatusOr<std::unique_ptr<SamReader>> FromFile(
+      const string& reads_path, const string& ref_path,
+      const nucleus::genomics::v1::SamReaderOptions& options,
+      std::shared_ptr<HtsThreadPool> thread_pool);
+
   static StatusOr<std::unique_ptr<SamReader>> FromFile(
       const string& reads_path,
       const nucleus::genomics::v1::SamReaderOptions& options) {
@@ -144,6 +169,53 @@ class SamReader : public Reader {
   StatusOr<std::shared_ptr<SamIterable>> Query(
       const nucleus::genomics::v1::Range& region) const;
 
+  // Gets all of the reads that overlap any bases in any of regions.
+  //
+  // Unlike calling Query() once per region, this uses a single htslib
+  // multi-region iterator: regions are sorted and merged, BGZF blocks (or CRAM
+  // containers) shared by adjacent regions are only seeked to and decoded
+  // once, and a read overlapping several regions is returned exactly once.
+  // Reads are returned in file order.
+  //
+  // The same preconditions as Query() apply: an index must have been loaded
+  // and every region must name a known reference sequence. Like Query(), this
+  // fails if another iterable on this reader is still alive.
+  StatusOr<std::shared_ptr<SamIterable>> QueryMultiple(
+      const std::vector<nucleus::genomics::v1::Range>& regions) const;
+
+  // Convenience wrapper around QueryMultiple() that materializes all of the
+  // reads at once, so that callers (notably Python) cross into native code
+  // once per batch of regions instead of once per read.
+  //
+  // If options.read_cache_dir() is set, the reads are assembled from the
+  // SamReadCache bins the regions overlap, and bins missing from the cache are
+  // read from the file and stored.
+  StatusOr<std::vector<nucleus::genomics::v1::Read>> QueryBatch(
+      const std::vector<nucleus::genomics::v1::Range>& regions) const;
+
+  // Calls visitor on every raw htslib record overlapping region that Query()
+  // would return, in file order, without converting them to Read protos. This
+  // is for native callers that only look at a few fields of each read (e.g.
+  // its CIGAR and bases) and can't afford the conversion. The record is only
+  // valid during the call. Aux fields are not parsed, so reads are not
+  // filtered on them.
+  //
+  // The same preconditions as Query() apply.
+  ::nucleus::Status VisitRecords(
+      const nucleus::genomics::v1::Range& region,
+      const std::function<void(const bam1_t& record)>& visitor) const;
+
+  // Estimates, from the index alone, the number of compressed bytes of this
+  // file that Query() would read for each of regions. No reads are decoded, so
+  // this is a cheap proxy for the read depth of every region. The index maps
+  // reads to 16 kb bins, so small neighboring regions get similar estimates.
+  //
+  // An index must have been loaded and every region must name a known
+  // reference sequence. Returns Unimplemented for CRAM files, whose index does
+  // not map regions to BGZF offsets.
+  StatusOr<std::vector<int64>> EstimateBytes(
+      const std::vector<nucleus::genomics::v1::Range>& regions) const;
+
   // Returns True if this SamReader loaded an index file.
   bool HasIndex() const { return idx_ != nullptr; }
 
@@ -157,10 +229,17 @@ class SamReader : public Reader {
 
   bool KeepRead(const nucleus::genomics::v1::Read& read) const;
 
+  // Same as KeepRead(), but on a raw htslib record.
+  bool KeepRecord(const bam1_t& record) const;
+
   const nucleus::genomics::v1::SamReaderOptions& options() const {
     return options_;
   }
 
+  // The aux tags stored in each Read's info map, compiled once from
+  // options().aux_fields_to_keep().
+  const AuxTagSet& aux_tags_to_keep() const { return aux_tags_to_keep_; }
+
   // Returns a SamHeader message representing the structured header information.
   const nucleus::genomics::v1::SamHeader& Header() const { return sam_header_; }
 
@@ -169,7 +248,18 @@ class SamReader : public Reader {
   // file.
   SamReader(const string& reads_path,
             const nucleus::genomics::v1::SamReaderOptions& options, htsFile* fp,
-            bam_hdr_t* header, hts_idx_t* idx);
+            bam_hdr_t* header, hts_idx_t* idx,
+            std::shared_ptr<HtsThreadPool> thread_pool,
+            std::shared_ptr<CramReferenceCache> reference_cache);
+
+  // QueryBatch() through read_cache_.
+  StatusOr<std::vector<nucleus::genomics::v1::Read>> QueryBatchFromCache(
+      const std::vector<nucleus::genomics::v1::Range>& regions) const;
+
+  // Returns bin number bin of contig tid from read_cache_, reading it from the
+  // file and storing it first if it is not cached yet.
+  StatusOr<std::shared_ptr<const SamReadCache::Bin>> CachedBin(
+      int tid, int64 bin) const;
 
   // Our options that control the behavior of this class.
   const nucleus::genomics::v1::SamReaderOptions options_;
@@ -190,6 +280,20 @@ class SamReader : public Reader {
 
   // For downsampling reads.
   mutable FractionalSampler sampler_;
+
+  // Compiled form of options_.aux_fields_to_keep().
+  const AuxTagSet aux_tags_to_keep_;
+
+  // The htslib thread pool attached to fp_, or nullptr if decoding is
+  // single-threaded. Must be released only after fp_ is closed.
+  std::shared_ptr<HtsThreadPool> thread_pool_;
+
+  // The shared CRAM reference fp_ decodes against, or nullptr if fp_ is not
+  // CRAM or has its own reference. Must be released only after fp_ is closed.
+  std::shared_ptr<CramReferenceCache> reference_cache_;
+
+  // Sidecar cache used by QueryBatch, or nullptr if reads are not cached.
+  std::unique_ptr<SamReadCache> read_cache_;
 };
 
 namespace sam_reader_internal {
@@ -32,6 +32,7 @@
 
 #include "third_party/nucleus/io/sam_reader.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -41,6 +42,7 @@
 #include <gmock/gmock-more-matchers.h>
 
 #include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/cram_reference_cache.h"
 #include "third_party/nucleus/io/sam_writer.h"
 #include "third_party/nucleus/testing/protocol-buffer-matchers.h"
 #include "third_party/nucleus/testing/test_utils.h"
@@ -61,6 +63,7 @@ using nucleus::proto::Partially;
 using std::vector;
 using ::testing::IsEmpty;
 using ::testing::Key;
+using ::testing::Not;
 using ::testing::Pointwise;
 using ::testing::SizeIs;
 using ::testing::UnorderedElementsAre;
@@ -285,6 +288,75 @@ TEST(SamReaderTest, TestMatePosition) {
   TF_CHECK_OK(tensorflow::Env::Default()->DeleteFile(output_filename));
 }
 
+TEST(SamReaderTest, TestMultithreadedDecompressionMatchesSingleThreaded) {
+  std::unique_ptr<SamReader> reader = std::move(
+      SamReader::FromFile(GetTestData(kBamTestFilename), SamReaderOptions())
+          .ValueOrDie());
+  std::vector<Read> expected = as_vector(reader->Iterate());
+
+  SamReaderOptions options;
+  options.set_num_decompression_threads(2);
+  std::unique_ptr<SamReader> threaded_reader1 = std::move(
+      SamReader::FromFile(GetTestData(kBamTestFilename), options).ValueOrDie());
+  std::unique_ptr<SamReader> threaded_reader2 = std::move(
+      SamReader::FromFile(GetTestData(kBamTestFilename), options).ValueOrDie());
+  EXPECT_THAT(as_vector(threaded_reader1->Iterate()),
+              Pointwise(EqualsProto(), expected));
+  EXPECT_THAT(as_vector(threaded_reader2->Query(
+                  MakeRange("chr20", 9999999, 10000100))),
+              Pointwise(EqualsProto(), expected));
+}
+
+TEST(SamReaderTest, TestThreadPoolIsSharedAcrossReaders) {
+  std::shared_ptr<HtsThreadPool> pool = HtsThreadPool::Shared(2);
+  ASSERT_NE(pool, nullptr);
+  EXPECT_EQ(pool, HtsThreadPool::Shared(2));
+  EXPECT_NE(pool, HtsThreadPool::Shared(3));
+  EXPECT_EQ(HtsThreadPool::Shared(0), nullptr);
+}
+
+TEST(SamReaderTest, TestSharedCramReferenceMatchesPrivateReference) {
+  const string cram = GetTestData("test_cram.embed_ref_0_version_3.0.cram");
+  const string ref = GetTestData("test.fasta");
+  SamReaderOptions options;
+  std::vector<Read> expected = as_vector(
+      SamReader::FromFile(cram, ref, options).ValueOrDie()->Iterate());
+  ASSERT_THAT(expected, Not(IsEmpty()));
+
+  options.set_share_cram_reference(true);
+  std::unique_ptr<SamReader> reader1 =
+      std::move(SamReader::FromFile(cram, ref, options).ValueOrDie());
+  std::unique_ptr<SamReader> reader2 =
+      std::move(SamReader::FromFile(cram, ref, options).ValueOrDie());
+  EXPECT_THAT(as_vector(reader1->Iterate()),
+              Pointwise(EqualsProto(), expected));
+  // The shared reference outlives the reader that created it.
+  ASSERT_THAT(reader1->Close(), IsOK());
+  EXPECT_THAT(as_vector(reader2->Iterate()),
+              Pointwise(EqualsProto(), expected));
+  ASSERT_THAT(reader2->Close(), IsOK());
+}
+
+TEST(SamReaderTest, TestCramReferenceCacheIsSharedAcrossReaders) {
+  const string cram = GetTestData("test_cram.embed_ref_0_version_3.0.cram");
+  const string ref = GetTestData("test.fasta");
+  bam_hdr_t* header = bam_hdr_init();
+  StatusOr<std::shared_ptr<CramReferenceCache>> cache1 =
+      CramReferenceCache::Shared(cram, ref, header);
+  StatusOr<std::shared_ptr<CramReferenceCache>> cache2 =
+      CramReferenceCache::Shared(cram, ref, header);
+  bam_hdr_destroy(header);
+  ASSERT_THAT(cache1.status(), IsOK());
+  ASSERT_THAT(cache2.status(), IsOK());
+  EXPECT_EQ(cache1.ValueOrDie(), cache2.ValueOrDie());
+
+  // Only CRAM files can be decoded against a shared reference.
+  EXPECT_THAT(CramReferenceCache::Create(GetTestData(kBamTestFilename), ref)
+                  .status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kInvalidArgument,
+                                        "is not a CRAM file"));
+}
+
 class SamReaderQueryTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -388,6 +460,130 @@ TEST_F(SamReaderQueryTest, ThatRangeIsExactlyCorrect) {
 //       1 37
 //     104 60
 */
+TEST_F(SamReaderQueryTest, QueryBatchMatchesQuery) {
+  std::vector<Read> expected =
+      as_vector(reader_->Query(MakeRange("chr20", 9999999, 10000100)));
+  // Overlapping and abutting regions are merged, so every read is returned
+  // exactly once.
+  StatusOr<std::vector<Read>> reads = reader_->QueryBatch(
+      {MakeRange("chr20", 10000050, 10000100),
+       MakeRange("chr20", 9999999, 10000000),
+       MakeRange("chr20", 10000000, 10000060)});
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), Pointwise(EqualsProto(), expected));
+
+  // Queries that cover no reads yield an empty batch.
+  reads = reader_->QueryBatch({MakeRange("chr20", 999999, 2000000)});
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), IsEmpty());
+  reads = reader_->QueryBatch({});
+  ASSERT_THAT(reads.status(), IsOK());
+  EXPECT_THAT(reads.ValueOrDie(), IsEmpty());
+}
+
+TEST_F(SamReaderQueryTest, QueryBatchFailsOnUnknownContig) {
+  EXPECT_THAT(reader_->QueryBatch({MakeRange("chr20", 9999999, 10000100),
+                                   MakeRange("XXX", 1, 100)})
+                  .status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kNotFound,
+                                        "Unknown reference_name"));
+}
+
+TEST_F(SamReaderQueryTest, VisitRecordsMatchesQuery) {
+  // Read requirements are applied to raw records as well.
+  options_.mutable_read_requirements()->set_min_mapping_quality(10);
+  RecreateReader();
+  const Range range = MakeRange("chr20", 9999999, 10000100);
+  std::vector<Read> expected = as_vector(reader_->Query(range));
+  ASSERT_THAT(expected, Not(IsEmpty()));
+  ASSERT_THAT(expected, SizeIs(::testing::Lt(106)));
+
+  std::vector<string> names;
+  ASSERT_THAT(reader_->VisitRecords(range,
+                                    [&names](const bam1_t& record) {
+                                      names.push_back(bam_get_qname(&record));
+                                    }),
+              IsOK());
+  ASSERT_THAT(names, SizeIs(expected.size()));
+  for (size_t i = 0; i < names.size(); ++i) {
+    EXPECT_EQ(names[i], expected[i].fragment_name());
+  }
+
+  EXPECT_THAT(
+      reader_->VisitRecords(MakeRange("XXX", 1, 100), [](const bam1_t&) {}),
+      IsNotOKWithCodeAndMessage(absl::StatusCode::kNotFound,
+                                "Unknown reference_name"));
+}
+
+TEST_F(SamReaderQueryTest, EstimateBytesGrowsWithReads) {
+  StatusOr<std::vector<int64>> estimates = reader_->EstimateBytes(
+      {MakeRange("chr20", 10000000, 10016384),
+       MakeRange("chr20", 10000000, 11000000),
+       MakeRange("chr20", 1000000, 2000000),
+       MakeRange("chr20", 10000000, 10000000)});
+  ASSERT_THAT(estimates.status(), IsOK());
+  ASSERT_THAT(estimates.ValueOrDie(), SizeIs(4));
+  EXPECT_GT(estimates.ValueOrDie()[0], 0);
+  EXPECT_GT(estimates.ValueOrDie()[1], estimates.ValueOrDie()[0]);
+  // Neither a region without reads nor an empty region has any bytes.
+  EXPECT_EQ(estimates.ValueOrDie()[2], 0);
+  EXPECT_EQ(estimates.ValueOrDie()[3], 0);
+
+  EXPECT_THAT(reader_->EstimateBytes({MakeRange("XXX", 1, 100)}).status(),
+              IsNotOKWithCodeAndMessage(absl::StatusCode::kNotFound,
+                                        "Unknown reference_name"));
+}
+
+TEST_F(SamReaderQueryTest, MaxDepthCapsCoverageDeterministically) {
+  const Range range = MakeRange("chr20", 9999999, 10000100);
+  std::vector<Read> all_reads = as_vector(reader_->Query(range));
+  ASSERT_THAT(all_reads, SizeIs(106));
+
+  // A cap well above the depth of the data keeps every read.
+  options_.set_max_depth(1000);
+  RecreateReader();
+  EXPECT_THAT(as_vector(reader_->Query(range)),
+              Pointwise(EqualsProto(), all_reads));
+
+  // A low cap keeps the reads that come first in each window.
+  options_.set_max_depth(5);
+  options_.set_max_depth_window_size(50);
+  RecreateReader();
+  std::vector<Read> capped = as_vector(reader_->Query(range));
+  EXPECT_THAT(capped, Not(IsEmpty()));
+  EXPECT_LT(capped.size(), all_reads.size());
+  EXPECT_EQ(capped.front().fragment_name(), all_reads.front().fragment_name());
+
+  // Each iterable starts with fresh coverage, so repeated queries agree.
+  EXPECT_THAT(as_vector(reader_->Query(range)),
+              Pointwise(EqualsProto(), capped));
+}
+
+TEST_F(SamReaderQueryTest, MaxDepthAppliesAfterDownsampling) {
+  const Range range = MakeRange("chr20", 9999999, 10000100);
+  options_.set_downsample_fraction(0.5);
+  RecreateReader();
+  std::vector<Read> downsampled = as_vector(reader_->Query(range));
+
+  // The cap only removes reads from those downsampling keeps; it doesn't
+  // change which reads downsampling keeps.
+  options_.set_max_depth(5);
+  options_.set_max_depth_window_size(50);
+  RecreateReader();
+  std::vector<Read> capped = as_vector(reader_->Query(range));
+  EXPECT_THAT(capped, Not(IsEmpty()));
+  EXPECT_LT(capped.size(), downsampled.size());
+  auto next = downsampled.begin();
+  for (const Read& read : capped) {
+    next = std::find_if(next, downsampled.end(), [&read](const Read& kept) {
+      return kept.fragment_name() == read.fragment_name() &&
+             kept.read_number() == read.read_number();
+    });
+    ASSERT_TRUE(next != downsampled.end()) << read.fragment_name();
+    ++next;
+  }
+}
+
 TEST_F(SamReaderQueryTest, QueriedRespectsReadRequirements) {
   Range range = MakeRange("chr20", 9999999, 10000100);
 
@@ -82,6 +82,92 @@ class SamReaderTests(parameterized.TestCase):
         with reader.query(interval) as iterable:
           self.assertEqual(test_utils.iterable_len(iterable), n_expected)
 
+  def test_bam_query_with_decompression_threads(self):
+    reader = sam.SamReader(
+        test_utils.genomics_core_testdata('test.bam'),
+        num_decompression_threads=2)
+    expected = [(ranges.parse_literal('chr20:10,000,000-10,000,100'), 106),
+                (ranges.parse_literal('chr20:10,000,000-10,000,000'), 45)]
+    with reader:
+      for interval, n_expected in expected:
+        with reader.query(interval) as iterable:
+          self.assertEqual(test_utils.iterable_len(iterable), n_expected)
+
+  def test_bam_query_batch(self):
+    reader = sam.SamReader(test_utils.genomics_core_testdata('test.bam'))
+    with reader:
+      # The first region is contained in the second, so the batch must not
+      # return any read twice.
+      reads = reader.query_batch([
+          ranges.parse_literal('chr20:10,000,000-10,000,000'),
+          ranges.parse_literal('chr20:10,000,000-10,000,100'),
+      ])
+      self.assertLen(reads, 106)
+      self.assertEqual(
+          reads, list(reader.query(
+              ranges.parse_literal('chr20:10,000,000-10,000,100'))))
+
+  def test_bam_prefetch(self):
+    regions = [
+        ranges.parse_literal('chr20:10,000,000-10,000,000'),
+        ranges.parse_literal('chr20:10,000,001-10,000,050'),
+        ranges.parse_literal('chr20:10,000,051-10,000,100'),
+    ]
+    with sam.SamReader(test_utils.genomics_core_testdata('test.bam')) as reader:
+      expected = [reader.query_batch([region]) for region in regions]
+    with sam.SamReader(test_utils.genomics_core_testdata('test.bam')) as reader:
+      prefetching_reader = reader.prefetch(regions, max_regions_ahead=2)
+      # Out-of-schedule queries are passed through to the wrapped reader.
+      self.assertLen(
+          prefetching_reader.query_batch(
+              [ranges.parse_literal('chr20:10,000,000-10,000,100')]), 106)
+      for region, expected_reads in zip(regions, expected):
+        self.assertEqual(prefetching_reader.query_batch([region]),
+                         expected_reads)
+
+  def test_bam_prefetch_with_downsampling(self):
+    regions = [
+        ranges.parse_literal('chr20:10,000,000-10,000,050'),
+        ranges.parse_literal('chr20:10,000,051-10,000,100'),
+    ]
+    # An out-of-schedule query between the prefetched ones.
+    padded_region = ranges.parse_literal('chr20:10,000,000-10,000,100')
+
+    def query_all(reader):
+      return [
+          reader.query_batch([regions[0]]),
+          reader.query_batch([padded_region]),
+          reader.query_batch([regions[1]]),
+      ]
+
+    path = test_utils.genomics_core_testdata('test.bam')
+    with sam.SamReader(path, downsample_fraction=0.5) as reader:
+      expected = query_all(reader)
+    with sam.SamReader(path, downsample_fraction=0.5) as reader:
+      self.assertEqual(query_all(reader.prefetch(regions)), expected)
+
+  def test_tfrecord_query_batch(self):
+    regions = [
+        ranges.parse_literal('chr1:10,050-10,060'),
+        ranges.parse_literal('chr1:10,035-10,040'),
+        ranges.parse_literal('chr20:10,018,151-10,018,151'),
+    ]
+    with sam.SamReader(
+        test_utils.genomics_core_testdata('test.sam.golden.tfrecord')
+    ) as reader:
+      # TFRecord files are scanned, so reads come back once and in file order.
+      self.assertEqual(
+          [read.fragment_name for read in reader.query_batch(regions)],
+          [
+              'NS500473:5:H17BCBGXX:4:11609:2859:12884',
+              'NS500473:5:H17BCBGXX:4:21602:7085:9423',
+              'NS500473:5:H17BCBGXX:4:23610:15768:10251',
+              'K8Y7U:03996:03425',
+          ],
+      )
+      # There is nothing to prefetch from, so the reader is used as is.
+      self.assertIs(reader.prefetch(regions), reader)
+
   def test_sam_query_alternate_index_name(self):
     reader = sam.SamReader(
         test_utils.genomics_core_testdata('test_alternate_index.bam'))
@@ -378,5 +464,38 @@ class ReadWriterTests(parameterized.TestCase):
       self.assertEqual(original_records, list(new_reader.iterate()))
 
 
+class InMemorySamReaderTests(absltest.TestCase):
+
+  def test_query_matches_read_overlaps(self):
+    reads = [
+        test_utils.make_read('ACGTA', start=30, cigar='5M', chrom='chr1'),
+        test_utils.make_read('ACGTA', start=10, cigar='5M', chrom='chr1'),
+        test_utils.make_read('ACGTA', start=10, cigar='5M', chrom='chr2'),
+        test_utils.make_read('ACGTA', start=5, cigar='2M40D3M', chrom='chr1'),
+    ]
+    reader = sam.InMemorySamReader(reads)
+    self.assertEqual(reads, list(reader.iterate()))
+    self.assertEqual([reads[0], reads[1], reads[3]],
+                     list(reader.query(ranges.make_range('chr1', 12, 31))))
+    self.assertEqual([reads[3]],
+                     list(reader.query(ranges.make_range('chr1', 40, 41))))
+    self.assertEqual([], list(reader.query(ranges.make_range('chr3', 0, 100))))
+
+    reader.replace_reads(reads[2:3])
+    self.assertEqual([reads[2]],
+                     list(reader.query(ranges.make_range('chr2', 0, 100))))
+    self.assertEqual([], list(reader.query(ranges.make_range('chr1', 0, 100))))
+
+  def test_query_is_unaffected_by_later_replace_reads(self):
+    reads = [
+        test_utils.make_read('ACGTA', start=10, cigar='5M', chrom='chr1'),
+        test_utils.make_read('ACGTA', start=20, cigar='5M', chrom='chr1'),
+    ]
+    reader = sam.InMemorySamReader(reads)
+    pending = reader.query(ranges.make_range('chr1', 0, 100))
+    reader.replace_reads(reads[1:])
+    self.assertEqual(reads, list(pending))
+
+
 if __name__ == '__main__':
   absltest.main()
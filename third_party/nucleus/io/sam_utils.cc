@@ -31,6 +31,8 @@
 
 #include "third_party/nucleus/io/sam_utils.h"
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "htslib/sam.h"
 
 namespace nucleus {
@@ -111,4 +113,55 @@ const genomics::v1::CigarUnit_Operation kHtslibCigarToProto[] = {
     genomics::v1::CigarUnit::OPERATION_UNSPECIFIED,
 };
 
+const char kHaplotypeAuxTag[] = "HP";
+const char kOriginalQualityAuxTag[] = "OQ";
+const char kBaseModificationsAuxTag[] = "MM";
+const char kBaseModificationProbabilitiesAuxTag[] = "ML";
+
+namespace {
+
+// bam_aux_get takes a non-const record even though it doesn't modify it.
+uint8_t* AuxGet(const bam1_t* b, const char tag[]) {
+  return bam_aux_get(const_cast<bam1_t*>(b), tag);
+}
+
+}  // namespace
+
+bool GetHaplotypeTag(const bam1_t* b, int* haplotype) {
+  const uint8_t* aux = AuxGet(b, kHaplotypeAuxTag);
+  if (aux == nullptr) return false;
+  switch (*aux) {
+    case 'c':
+    case 'C':
+    case 's':
+    case 'S':
+    case 'i':
+    case 'I':
+      *haplotype = bam_aux2i(aux);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool GetOriginalQualityTag(const bam1_t* b, absl::string_view* qualities) {
+  const uint8_t* aux = AuxGet(b, kOriginalQualityAuxTag);
+  if (aux == nullptr || *aux != 'Z') return false;
+  *qualities = bam_aux2Z(aux);
+  return true;
+}
+
+bool GetBaseModificationTags(const bam1_t* b,
+                             absl::string_view* modifications,
+                             absl::Span<const uint8>* probabilities) {
+  const uint8_t* mm = AuxGet(b, kBaseModificationsAuxTag);
+  if (mm == nullptr || *mm != 'Z') return false;
+  const uint8_t* ml = AuxGet(b, kBaseModificationProbabilitiesAuxTag);
+  // B arrays are laid out as 'B', subtype, uint32 count, then the elements.
+  if (ml == nullptr || ml[0] != 'B' || ml[1] != 'C') return false;
+  *modifications = bam_aux2Z(mm);
+  *probabilities = absl::Span<const uint8>(ml + 6, bam_auxB_len(ml));
+  return true;
+}
+
 }  // namespace nucleus
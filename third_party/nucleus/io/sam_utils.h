@@ -32,6 +32,11 @@
 #ifndef THIRD_PARTY_NUCLEUS_IO_SAM_UTILS_H_
 #define THIRD_PARTY_NUCLEUS_IO_SAM_UTILS_H_
 
+#include <bitset>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "htslib/sam.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/cigar.pb.h"
 
@@ -86,6 +91,69 @@ extern const int kProtoToHtslibCigar[];
 // values.
 extern const genomics::v1::CigarUnit_Operation kHtslibCigarToProto[];
 
+// Aux field tags that have typed accessors below.
+extern const char kHaplotypeAuxTag[];
+extern const char kOriginalQualityAuxTag[];
+extern const char kBaseModificationsAuxTag[];
+extern const char kBaseModificationProbabilitiesAuxTag[];
+
+// A set of two-character SAM aux field tags, compiled into a 64K-entry bitset
+// indexed by the two tag bytes so that membership is a single bit test instead
+// of string comparisons.
+class AuxTagSet {
+ public:
+  // Creates a set containing every possible tag.
+  AuxTagSet() : contains_all_(true) {}
+
+  // Creates a set containing exactly the given tags, or every possible tag if
+  // tags is empty (matching the semantics of
+  // SamReaderOptions.aux_fields_to_keep). Strings that are not two characters
+  // long can never match a tag and are ignored.
+  template <typename StringContainer>
+  explicit AuxTagSet(const StringContainer& tags)
+      : contains_all_(tags.empty()) {
+    for (absl::string_view tag : tags) {
+      if (tag.size() == 2) bits_.set(Index(tag[0], tag[1]));
+    }
+  }
+
+  // Returns true if the tag starting at the first two bytes of tag is in this
+  // set. tag typically points into the aux data of a bam1_t.
+  bool Contains(const uint8* tag) const {
+    return contains_all_ || bits_.test(Index(tag[0], tag[1]));
+  }
+
+  bool Contains(absl::string_view tag) const {
+    return tag.size() == 2 &&
+           Contains(reinterpret_cast<const uint8*>(tag.data()));
+  }
+
+ private:
+  static int Index(uint8 c1, uint8 c2) { return (c1 << 8) | c2; }
+
+  bool contains_all_;
+  std::bitset<1 << 16> bits_;
+};
+
+// Typed, zero-copy accessors for the aux fields DeepVariant pipelines use,
+// reading straight from the aux data of a bam1_t without converting the record
+// to a Read proto. Each returns false, leaving its outputs untouched, if the
+// tag is absent or doesn't have the type the SAM tag spec prescribes. Returned
+// views point into b and are valid until b is modified or reused.
+
+// Reads the integer HP (haplotype) tag.
+bool GetHaplotypeTag(const bam1_t* b, int* haplotype);
+
+// Reads the OQ (original base qualities) tag, a Phred+33 string with one
+// character per base.
+bool GetOriginalQualityTag(const bam1_t* b, absl::string_view* qualities);
+
+// Reads the MM (base modifications) string tag and the ML (modification
+// probabilities) uint8 array tag. Both must be present.
+bool GetBaseModificationTags(const bam1_t* b,
+                             absl::string_view* modifications,
+                             absl::Span<const uint8>* probabilities);
+
 }  // namespace nucleus
 
 #endif  // THIRD_PARTY_NUCLEUS_IO_SAM_UTILS_H_
@@ -32,6 +32,9 @@
 
 #include "third_party/nucleus/io/sam_utils.h"
 
+#include <string>
+#include <vector>
+
 #include <gmock/gmock-generated-matchers.h>
 #include <gmock/gmock-matchers.h>
 #include <gmock/gmock-more-matchers.h>
@@ -45,6 +48,7 @@ namespace nucleus {
 using genomics::v1::CigarUnit;
 using genomics::v1::CigarUnit_Operation_Operation_MAX;
 using genomics::v1::CigarUnit_Operation_Operation_MIN;
+using ::testing::ElementsAre;
 
 TEST(SamUtilsTest, Conversion) {
   for (int i = CigarUnit_Operation_Operation_MIN;
@@ -67,4 +71,81 @@ TEST(SamUtilsTest, ProtoConversion) {
   EXPECT_EQ(kProtoToHtslibCigar[CigarUnit::OPERATION_UNSPECIFIED], BAM_CBACK);
 }
 
+TEST(AuxTagSetTest, EmptyTagListContainsEverything) {
+  const AuxTagSet tags(std::vector<std::string>{});
+  EXPECT_TRUE(tags.Contains("HP"));
+  EXPECT_TRUE(tags.Contains("zz"));
+  EXPECT_TRUE(AuxTagSet().Contains("OQ"));
+}
+
+TEST(AuxTagSetTest, ContainsOnlyListedTags) {
+  const AuxTagSet tags(std::vector<std::string>{"HP", "OQ", "toolong", ""});
+  EXPECT_TRUE(tags.Contains("HP"));
+  EXPECT_TRUE(tags.Contains("OQ"));
+  EXPECT_FALSE(tags.Contains("PH"));
+  EXPECT_FALSE(tags.Contains("MM"));
+  EXPECT_FALSE(tags.Contains("to"));
+  EXPECT_FALSE(tags.Contains("H"));
+  const uint8 raw_tag[] = {'H', 'P', 'i'};
+  EXPECT_TRUE(tags.Contains(raw_tag));
+}
+
+class AuxAccessorTest : public ::testing::Test {
+ protected:
+  void SetUp() override { b_ = bam_init1(); }
+  void TearDown() override { bam_destroy1(b_); }
+
+  bam1_t* b_;
+};
+
+TEST_F(AuxAccessorTest, MissingTags) {
+  int hp = -1;
+  absl::string_view oq;
+  absl::string_view mm;
+  absl::Span<const uint8> ml;
+  EXPECT_FALSE(GetHaplotypeTag(b_, &hp));
+  EXPECT_EQ(hp, -1);
+  EXPECT_FALSE(GetOriginalQualityTag(b_, &oq));
+  EXPECT_FALSE(GetBaseModificationTags(b_, &mm, &ml));
+}
+
+TEST_F(AuxAccessorTest, ReadsTypedTags) {
+  const uint8_t hp = 2;
+  ASSERT_EQ(bam_aux_append(b_, "HP", 'C', sizeof(hp), &hp), 0);
+  const char oq[] = "II#";
+  ASSERT_EQ(bam_aux_append(b_, "OQ", 'Z', sizeof(oq),
+                           reinterpret_cast<const uint8_t*>(oq)),
+            0);
+  const char mm[] = "C+m,0,1;";
+  ASSERT_EQ(bam_aux_append(b_, "MM", 'Z', sizeof(mm),
+                           reinterpret_cast<const uint8_t*>(mm)),
+            0);
+  const uint8_t ml[] = {10, 250};
+  ASSERT_EQ(bam_aux_update_array(b_, "ML", 'C', 2,
+                                 const_cast<uint8_t*>(ml)),
+            0);
+
+  int hp_value;
+  ASSERT_TRUE(GetHaplotypeTag(b_, &hp_value));
+  EXPECT_EQ(hp_value, 2);
+  absl::string_view oq_value;
+  ASSERT_TRUE(GetOriginalQualityTag(b_, &oq_value));
+  EXPECT_EQ(oq_value, "II#");
+  absl::string_view mm_value;
+  absl::Span<const uint8> ml_values;
+  ASSERT_TRUE(GetBaseModificationTags(b_, &mm_value, &ml_values));
+  EXPECT_EQ(mm_value, "C+m,0,1;");
+  EXPECT_THAT(ml_values, ElementsAre(10, 250));
+}
+
+TEST_F(AuxAccessorTest, WrongTypeIsRejected) {
+  const char hp[] = "1";
+  ASSERT_EQ(bam_aux_append(b_, "HP", 'Z', sizeof(hp),
+                           reinterpret_cast<const uint8_t*>(hp)),
+            0);
+  int hp_value = -1;
+  EXPECT_FALSE(GetHaplotypeTag(b_, &hp_value));
+  EXPECT_EQ(hp_value, -1);
+}
+
 }  // namespace nucleus
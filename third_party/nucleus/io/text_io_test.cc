@@ -35,6 +35,8 @@
 #include <utility>
 
 #include "tensorflow/core/platform/test.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "third_party/nucleus/io/text_reader.h"
 #include "third_party/nucleus/io/text_writer.h"
 #include "third_party/nucleus/platform/types.h"
@@ -176,4 +178,43 @@ TEST(TextReaderTest, ReadsCompressedFile) {
 }
 
 
+// Tests that line views handle lines longer than the read buffer, DOS line
+// endings, empty lines and a missing final newline.
+TEST(TextReaderTest, ReadsLineViews) {
+  const string long_line(3 << 20, 'x');
+  string path = MakeTempFileWithContents(
+      "line-views.txt", absl::StrCat("a\n\n", long_line, "\nb\r\nlast"));
+  const auto reader = std::move(TextReader::FromFile(path).ValueOrDie());
+
+  for (absl::string_view expected : {absl::string_view("a"),
+                                     absl::string_view(""),
+                                     absl::string_view(long_line),
+                                     absl::string_view("b"),
+                                     absl::string_view("last")}) {
+    StatusOr<absl::string_view> rv = reader->ReadLineView();
+    ASSERT_TRUE(rv.ok());
+    EXPECT_EQ(rv.ValueOrDie(), expected);
+  }
+  EXPECT_TRUE(::nucleus::IsOutOfRange(reader->ReadLineView().status()));
+}
+
+// Tests that BGZF input decompressed on a thread pool reads back in order.
+TEST(TextReaderTest, ReadsCompressedFileWithThreads) {
+  string path = MakeTempFile("many-lines.txt.gz");
+  {
+    const auto writer = std::move(TextWriter::ToFile(path).ValueOrDie());
+    for (int i = 0; i < 100000; ++i) {
+      ASSERT_EQ(::nucleus::Status(), writer->Write(absl::StrCat(i, "\n")));
+    }
+  }
+
+  const auto reader = std::move(TextReader::FromFile(path, 2).ValueOrDie());
+  for (int i = 0; i < 100000; ++i) {
+    StatusOr<absl::string_view> rv = reader->ReadLineView();
+    ASSERT_TRUE(rv.ok());
+    ASSERT_EQ(rv.ValueOrDie(), absl::StrCat(i));
+  }
+  EXPECT_TRUE(::nucleus::IsOutOfRange(reader->ReadLineView().status()));
+}
+
 }  // namespace nucleus
@@ -33,16 +33,35 @@
 #include "third_party/nucleus/io/text_reader.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <utility>
 
+#include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "htslib/bgzf.h"
+#include "htslib/hfile.h"
 #include "third_party/nucleus/io/hts_path.h"
 #include "third_party/nucleus/core/status.h"
 
 namespace nucleus {
 
-StatusOr<std::unique_ptr<TextReader>> TextReader::FromFile(const string& path) {
+namespace {
+
+// Initial size of the read buffer. Lines longer than this grow the buffer.
+constexpr size_t kReadChunkSize = 1 << 20;
+
+// Drops the '\r' of a DOS line ending, as hts_getline does for BGZF input.
+absl::string_view StripCarriageReturn(absl::string_view line) {
+  if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+  return line;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<TextReader>> TextReader::FromFile(const string& path,
+                                                           int num_threads) {
   htsFile* fp = hts_open_x(path, "r");
 
   if (fp == nullptr) {
@@ -50,10 +69,22 @@ StatusOr<std::unique_ptr<TextReader>> TextReader::FromFile(const string& path) {
         absl::StrCat("Could not open ", path,
                      ". The file might not exist, or the format "
                      "detected by htslib might be incorrect."));
-  } else {
-    auto reader = absl::WrapUnique(new TextReader(fp));
-    return std::move(reader);
   }
+
+  // Only BGZF, not plain gzip, can be inflated a block at a time in parallel.
+  std::shared_ptr<HtsThreadPool> thread_pool;
+  if (fp->format.compression == bgzf) {
+    thread_pool = HtsThreadPool::Shared(num_threads);
+  }
+  if (thread_pool != nullptr) {
+    ::nucleus::Status status = thread_pool->AttachTo(fp);
+    if (!status.ok()) {
+      LOG(WARNING) << status << "; decompressing " << path
+                   << " on the calling thread";
+      thread_pool = nullptr;
+    }
+  }
+  return absl::WrapUnique(new TextReader(fp, std::move(thread_pool)));
 }
 
 TextReader::~TextReader() {
@@ -63,26 +94,58 @@ TextReader::~TextReader() {
 }
 
 StatusOr<string> TextReader::ReadLine() {
-  ::nucleus::Status status;
-  string line;
-  kstring_t k_line = {0, 0, nullptr};
-
-  int ret = hts_getline(hts_file_, '\n', &k_line);
-  if (ret == -1) {
-    status = ::nucleus::OutOfRange("EOF");
-  } else if (ret < 0) {
-    status = ::nucleus::DataLoss("Failed to read text line");
+  StatusOr<absl::string_view> line = ReadLineView();
+  NUCLEUS_RETURN_IF_ERROR(line.status());
+  return string(line.ValueOrDie());
+}
+
+StatusOr<absl::string_view> TextReader::ReadLineView() {
+  while (true) {
+    const char* begin = buffer_.data() + pos_;
+    const char* newline =
+        static_cast<const char*>(memchr(begin, '\n', end_ - pos_));
+    if (newline != nullptr) {
+      pos_ += newline - begin + 1;
+      return StripCarriageReturn(absl::string_view(begin, newline - begin));
+    }
+    if (eof_) {
+      if (pos_ == end_) {
+        return ::nucleus::OutOfRange("EOF");
+      }
+      // The last line of a file without a trailing newline.
+      absl::string_view line(begin, end_ - pos_);
+      pos_ = end_;
+      return StripCarriageReturn(line);
+    }
+    NUCLEUS_RETURN_IF_ERROR(FillBuffer());
   }
+}
 
-  if (k_line.s) {
-    line = std::string(k_line.s);
-    free(k_line.s);
+::nucleus::Status TextReader::FillBuffer() {
+  if (!hts_file_) {
+    return ::nucleus::FailedPrecondition("Cannot read from a closed file");
   }
-  if (status.ok()) {
-    return line;
-  } else {
-    return status;
+  if (pos_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + pos_, end_ - pos_);
+    end_ -= pos_;
+    pos_ = 0;
   }
+  if (end_ == buffer_.size()) {
+    buffer_.resize(buffer_.size() * 2);
+  }
+  char* dest = buffer_.data() + end_;
+  const size_t capacity = buffer_.size() - end_;
+  const ssize_t n = hts_file_->is_bgzf
+                        ? bgzf_read(hts_file_->fp.bgzf, dest, capacity)
+                        : hread(hts_file_->fp.hfile, dest, capacity);
+  if (n < 0) {
+    return ::nucleus::DataLoss("Failed to read text line");
+  }
+  if (n == 0) {
+    eof_ = true;
+  }
+  end_ += n;
+  return ::nucleus::Status();
 }
 
 ::nucleus::Status TextReader::Close() {
@@ -92,6 +155,7 @@ StatusOr<string> TextReader::ReadLine() {
   }
   int hts_ok = hts_close(hts_file_);
   hts_file_ = nullptr;
+  thread_pool_ = nullptr;
   if (hts_ok < 0) {
     return ::nucleus::Internal(
         absl::StrCat("hts_close() failed with return code ", hts_ok));
@@ -99,7 +163,11 @@ StatusOr<string> TextReader::ReadLine() {
   return ::nucleus::Status();
 }
 
-TextReader::TextReader(htsFile* hts_file) : hts_file_(hts_file) {
+TextReader::TextReader(htsFile* hts_file,
+                       std::shared_ptr<HtsThreadPool> thread_pool)
+    : hts_file_(hts_file),
+      thread_pool_(std::move(thread_pool)),
+      buffer_(kReadChunkSize) {
   CHECK(hts_file_ != nullptr);
 }
 
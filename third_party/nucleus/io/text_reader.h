@@ -35,9 +35,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
 #include "htslib/hts.h"
+#include "third_party/nucleus/io/hts_thread_pool.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/core/statusor.h"
 #include "third_party/nucleus/core/status.h"
@@ -46,11 +49,18 @@ namespace nucleus {
 
 
 // The TextReader class allows reading text from a (possibly compressed) file.
+//
+// The file is read in large chunks, and lines are handed out as views into the
+// current chunk, so that callers can parse fields in place without allocating
+// a string per line.
 class TextReader {
  public:
   // Factory method to construct a TextReader.
   // File compression is determined from file magic (contents), not filename.
-  static StatusOr<std::unique_ptr<TextReader>> FromFile(const string& path);
+  // If num_threads > 0 and the file is BGZF-compressed, blocks are decompressed
+  // ahead of time on a shared pool of that many htslib threads.
+  static StatusOr<std::unique_ptr<TextReader>> FromFile(const string& path,
+                                                        int num_threads = 0);
 
   // Destructor; closes the file, if it's still open.
   ~TextReader();
@@ -62,15 +72,34 @@ class TextReader {
   //  - otherwise, an appropriate error Status.
   StatusOr<string> ReadLine();
 
+  // Like ReadLine(), but returns a view of the line that is only valid until
+  // the next call to ReadLine(), ReadLineView() or Close().
+  StatusOr<absl::string_view> ReadLineView();
+
   // Explicitly closes the underlying file stream.
   ::nucleus::Status Close();
 
  private:
   // Private constructor.
-  TextReader(htsFile* hts_file);
+  TextReader(htsFile* hts_file, std::shared_ptr<HtsThreadPool> thread_pool);
+
+  // Moves the unread part of buffer_ to its front and reads more of the file
+  // after it, growing buffer_ if it holds a single partial line.
+  ::nucleus::Status FillBuffer();
 
   // Underlying htslib file stream.
   htsFile* hts_file_;
+  // Decompression threads attached to hts_file_, if any. Released only after
+  // hts_file_ is closed.
+  std::shared_ptr<HtsThreadPool> thread_pool_;
+
+  // Chunk of the file's (decompressed) contents. buffer_[pos_, end_) has not
+  // been returned yet.
+  std::vector<char> buffer_;
+  size_t pos_ = 0;
+  size_t end_ = 0;
+  // True once the end of the file has been read into buffer_.
+  bool eof_ = false;
 };
 
 
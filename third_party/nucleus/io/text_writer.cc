@@ -39,8 +39,10 @@
 
 #include <utility>
 
+#include "absl/log/log.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "htslib/bgzf.h"
 #include "htslib/hfile.h"
 #include "third_party/nucleus/io/hts_path.h"
@@ -50,17 +52,17 @@ namespace {
 // Write a string to an htslib file handle (compressed or not).
 // Parallels hts_getline; oddly, no function like this is exposed by
 // htslib.
-::nucleus::Status hts_write(htsFile* hts_file, const char* str) {
-  ssize_t str_len = strlen(str);
+::nucleus::Status hts_write(htsFile* hts_file, absl::string_view str) {
+  ssize_t str_len = str.size();
   ssize_t bytes_written;
 
   switch (hts_file->format.compression) {
     case no_compression:
-      bytes_written = hwrite(hts_file->fp.hfile, str, str_len);
+      bytes_written = hwrite(hts_file->fp.hfile, str.data(), str_len);
       break;
     case gzip:  // FALLTHROUGH_INTENDED
     case bgzf:
-      bytes_written = bgzf_write(hts_file->fp.bgzf, str, str_len);
+      bytes_written = bgzf_write(hts_file->fp.bgzf, str.data(), str_len);
       break;
     default:
       return ::nucleus::FailedPrecondition(
@@ -78,26 +80,42 @@ namespace {
 namespace nucleus {
 
 StatusOr<std::unique_ptr<TextWriter>> TextWriter::ToFile(
-    const string& path, CompressionPolicy compression) {
+    const string& path, CompressionPolicy compression, int num_threads) {
   const char* mode = compression == COMPRESS ? "wb" : "w";
   htsFile* fp = hts_open_x(path, mode);
 
   if (fp == nullptr) {
     return ::nucleus::Unknown(
         absl::StrCat("Could not open file for writing: ", path));
-  } else {
-    auto writer = absl::WrapUnique(new TextWriter(fp));
-    return std::move(writer);
   }
+
+  // "wb" writes BGZF, whose blocks can be deflated in parallel.
+  std::shared_ptr<HtsThreadPool> thread_pool;
+  if (compression == COMPRESS) {
+    thread_pool = HtsThreadPool::Shared(num_threads);
+  }
+  if (thread_pool != nullptr) {
+    ::nucleus::Status status = thread_pool->AttachTo(fp);
+    if (!status.ok()) {
+      LOG(WARNING) << status << "; compressing " << path
+                   << " on the calling thread";
+      thread_pool = nullptr;
+    }
+  }
+  auto writer = absl::WrapUnique(new TextWriter(fp, std::move(thread_pool)));
+  return std::move(writer);
 }
 
-StatusOr<std::unique_ptr<TextWriter>> TextWriter::ToFile(const string& path) {
+StatusOr<std::unique_ptr<TextWriter>> TextWriter::ToFile(const string& path,
+                                                         int num_threads) {
   CompressionPolicy should_compress =
       (absl::EndsWith(path, ".gz") ? COMPRESS : NO_COMPRESS);
-  return ToFile(path, should_compress);
+  return ToFile(path, should_compress, num_threads);
 }
 
-TextWriter::TextWriter(htsFile* hts_file) : hts_file_(hts_file) {
+TextWriter::TextWriter(htsFile* hts_file,
+                       std::shared_ptr<HtsThreadPool> thread_pool)
+    : hts_file_(hts_file), thread_pool_(std::move(thread_pool)) {
   CHECK(hts_file_ != nullptr);
 }
 
@@ -107,11 +125,11 @@ TextWriter::~TextWriter() {
   }
 }
 
-::nucleus::Status TextWriter::Write(const string& text) {
+::nucleus::Status TextWriter::Write(absl::string_view text) {
   if (hts_file_ == nullptr) {
     return ::nucleus::FailedPrecondition("Cannot write to a closed TextWriter");
   }
-  return hts_write(hts_file_, text.c_str());
+  return hts_write(hts_file_, text);
 }
 
 ::nucleus::Status TextWriter::Close() {
@@ -121,6 +139,7 @@ TextWriter::~TextWriter() {
   }
   int hts_ok = hts_close(hts_file_);
   hts_file_ = nullptr;
+  thread_pool_ = nullptr;
   if (hts_ok < 0) {
     return ::nucleus::Internal(
         absl::StrCat("hts_close() failed with return code ", hts_ok));
@@ -36,7 +36,9 @@
 #include <memory>
 #include <string>
 
+#include "absl/strings/string_view.h"
 #include "htslib/hts.h"
+#include "third_party/nucleus/io/hts_thread_pool.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/core/status.h"
 #include "third_party/nucleus/core/statusor.h"
@@ -54,27 +56,34 @@ class TextWriter {
 
  public:
   // Factory function allowing explicit choice of whether to use compression.
+  // If num_threads > 0 and compression is on, BGZF blocks are compressed on a
+  // shared pool of that many htslib threads.
   static StatusOr<std::unique_ptr<TextWriter>> ToFile(
-      const string& path, CompressionPolicy compression);
+      const string& path, CompressionPolicy compression, int num_threads = 0);
 
   // Factory function that uses compression if the filename ends in ".gz".
-  static StatusOr<std::unique_ptr<TextWriter>> ToFile(const string& path);
+  static StatusOr<std::unique_ptr<TextWriter>> ToFile(const string& path,
+                                                      int num_threads = 0);
 
   // Destructor; closes the stream if still open.
   ~TextWriter();
 
   // Write a string to the file stream.
-  ::nucleus::Status Write(const string& text);
+  ::nucleus::Status Write(absl::string_view text);
 
   // Close the underlying file stream.
   ::nucleus::Status Close();
 
  private:
   // Private constructor.
-  TextWriter(htsFile* hts_file);
+  TextWriter(htsFile* hts_file, std::shared_ptr<HtsThreadPool> thread_pool);
 
   // Underlying htslib file stream.
   htsFile* hts_file_;
+
+  // Compression threads attached to hts_file_, if any. Released only after
+  // hts_file_ is closed.
+  std::shared_ptr<HtsThreadPool> thread_pool_;
 };
 
 }  // namespace nucleus
@@ -33,17 +33,43 @@
 #include "third_party/nucleus/io/tfrecord_reader.h"
 
 #include <memory>
+#include <utility>
 
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/buffered_inputstream.h"
+#include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/zlib_inputstream.h"
 
 namespace nucleus {
 
+namespace {
+
+// Each record is framed as
+//   uint64 length
+//   uint32 masked crc of length
+//   byte   data[length]
+//   uint32 masked crc of data
+constexpr size_t kHeaderSize = sizeof(tensorflow::uint64) +
+                               sizeof(tensorflow::uint32);
+constexpr size_t kFooterSize = sizeof(tensorflow::uint32);
+
+bool ChecksumMatches(const char* data, size_t n, const char* masked_crc) {
+  return tensorflow::crc32c::Unmask(tensorflow::core::DecodeFixed32(
+             masked_crc)) == tensorflow::crc32c::Value(data, n);
+}
+
+}  // namespace
+
 TFRecordReader::TFRecordReader() {}
 
 std::unique_ptr<TFRecordReader> TFRecordReader::New(
-    const std::string& filename, const std::string& compression_type) {
+    const std::string& filename, const std::string& compression_type,
+    bool verify_checksums) {
   std::unique_ptr<tensorflow::RandomAccessFile> file;
   tensorflow::Status s =
       tensorflow::Env::Default()->NewRandomAccessFile(filename, &file);
@@ -53,15 +79,27 @@ std::unique_ptr<TFRecordReader> TFRecordReader::New(
   }
 
   auto reader = absl::WrapUnique<TFRecordReader>(new TFRecordReader);
-  reader->offset_ = 0;
+  reader->verify_checksums_ = verify_checksums;
   reader->file_ = std::move(file);
 
   tensorflow::io::RecordReaderOptions options =
       tensorflow::io::RecordReaderOptions::CreateRecordReaderOptions(
           compression_type);
   options.buffer_size = 16 * 1024 * 1024;
-  reader->reader_ = std::make_unique<tensorflow::io::RecordReader>(
-      reader->file_.get(), options);
+  auto file_stream = std::make_unique<tensorflow::io::RandomAccessInputStream>(
+      reader->file_.get());
+  if (options.compression_type ==
+      tensorflow::io::RecordReaderOptions::ZLIB_COMPRESSION) {
+    reader->input_stream_ = std::make_unique<tensorflow::io::ZlibInputStream>(
+        file_stream.release(), options.zlib_options.input_buffer_size,
+        options.zlib_options.output_buffer_size, options.zlib_options,
+        /*owns_input_stream=*/true);
+  } else {
+    reader->input_stream_ =
+        std::make_unique<tensorflow::io::BufferedInputStream>(
+            file_stream.release(), options.buffer_size,
+            /*owns_input_stream=*/true);
+  }
 
   return reader;
 }
@@ -69,18 +107,74 @@ std::unique_ptr<TFRecordReader> TFRecordReader::New(
 TFRecordReader::~TFRecordReader() {
 }
 
+tensorflow::Status TFRecordReader::ReadRecord(tensorflow::tstring* record) {
+  tensorflow::Status header_status =
+      input_stream_->ReadNBytes(kHeaderSize, &framing_);
+  if (tensorflow::errors::IsOutOfRange(header_status) && !framing_.empty()) {
+    // Only a clean end of file, with no bytes of a header, ends the records.
+    return tensorflow::errors::DataLoss("truncated record length");
+  }
+  TF_RETURN_IF_ERROR(header_status);
+  if (verify_checksums_ &&
+      !ChecksumMatches(framing_.data(), sizeof(tensorflow::uint64),
+                       framing_.data() + sizeof(tensorflow::uint64))) {
+    return tensorflow::errors::DataLoss("corrupted record length");
+  }
+  const tensorflow::uint64 length =
+      tensorflow::core::DecodeFixed64(framing_.data());
+
+  tensorflow::Status s = input_stream_->ReadNBytes(length, record);
+  if (s.ok()) {
+    s = input_stream_->ReadNBytes(kFooterSize, &framing_);
+  }
+  if (tensorflow::errors::IsOutOfRange(s)) {
+    // The header was complete, so the file ends in the middle of a record.
+    return tensorflow::errors::DataLoss("truncated record");
+  }
+  TF_RETURN_IF_ERROR(s);
+  if (verify_checksums_ &&
+      !ChecksumMatches(record->data(), record->size(), framing_.data())) {
+    return tensorflow::errors::DataLoss("corrupted record data");
+  }
+  return tensorflow::Status();
+}
+
 bool TFRecordReader::GetNext() {
-  if (reader_ == nullptr) {
+  if (input_stream_ == nullptr) {
     return false;
   }
 
-  tensorflow::Status s = reader_->ReadRecord(&offset_, &record_);
-
+  tensorflow::Status s = ReadRecord(&record_);
+  if (!s.ok() && !tensorflow::errors::IsOutOfRange(s)) {
+    LOG(ERROR) << s;
+  }
   return s.ok();
 }
 
+std::vector<absl::string_view> TFRecordReader::ReadBatch(int max_records) {
+  std::vector<absl::string_view> records;
+  if (input_stream_ == nullptr || max_records <= 0) {
+    return records;
+  }
+  if (batch_.size() < static_cast<size_t>(max_records)) {
+    batch_.resize(max_records);
+  }
+  records.reserve(max_records);
+  for (int i = 0; i < max_records; ++i) {
+    tensorflow::Status s = ReadRecord(&batch_[i]);
+    if (!s.ok()) {
+      if (!tensorflow::errors::IsOutOfRange(s)) {
+        LOG(ERROR) << s;
+      }
+      break;
+    }
+    records.emplace_back(batch_[i].data(), batch_[i].size());
+  }
+  return records;
+}
+
 void TFRecordReader::Close() {
-  reader_ = nullptr;
+  input_stream_ = nullptr;
   file_ = nullptr;
 }
 
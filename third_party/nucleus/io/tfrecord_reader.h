@@ -35,9 +35,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/strings/string_view.h"
 #include "third_party/nucleus/platform/types.h"
-#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/io/inputstream_interface.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/tstring.h"
 #include "tensorflow/core/platform/types.h"
@@ -48,13 +51,21 @@ namespace nucleus {
 // for Python.  Loosely based on tensorflow/python/lib/io/py_record_reader.h
 // An instance of this class is NOT safe for concurrent access by multiple
 // threads.
+//
+// Records are read into buffers owned by the reader and can be accessed
+// without copying through record_view() and ReadBatch(), so that protos can be
+// parsed directly from them.
 class TFRecordReader {
  public:
   // Create a TFRecordReader.
   // Valid compression_types are "ZLIB", "GZIP", or "" (for none).
+  // If verify_checksums is false, the CRCs of the record lengths and contents
+  // are not checked. This should only be used for trusted, local files such as
+  // intermediates written by the same pipeline.
   // Returns nullptr on failure.
   static std::unique_ptr<TFRecordReader> New(
-      const std::string& filename, const std::string& compression_type);
+      const std::string& filename, const std::string& compression_type,
+      bool verify_checksums = true);
 
   ~TFRecordReader();
 
@@ -63,7 +74,18 @@ class TFRecordReader {
 
   // Return the current record contents.  Only valid after GetNext()
   // has returned true.
-  tensorflow::tstring record() const { return record_; }
+  const tensorflow::tstring& record() const { return record_; }
+
+  // Returns a view of the current record contents, valid until the next call
+  // to GetNext() or ReadBatch(). Only valid after GetNext() has returned true.
+  absl::string_view record_view() const {
+    return absl::string_view(record_.data(), record_.size());
+  }
+
+  // Reads up to max_records records and returns views of their contents, which
+  // stay valid until the next call to GetNext() or ReadBatch(). Fewer records
+  // are returned only at the end of the file or on error.
+  std::vector<absl::string_view> ReadBatch(int max_records);
 
   // Close the file and release its resources.
   void Close();
@@ -75,13 +97,21 @@ class TFRecordReader {
  private:
   TFRecordReader();
 
-  tensorflow::uint64 offset_;
+  // Reads the next record into *record. Returns an OutOfRange status at the
+  // end of the file, and DataLoss if the file ends within a record.
+  tensorflow::Status ReadRecord(tensorflow::tstring* record);
+
+  bool verify_checksums_ = true;
 
-  // |reader_| has a non-owning pointer on |file_|, so destruct it first.
+  // |input_stream_| has a non-owning pointer on |file_|, so destruct it first.
   std::unique_ptr<tensorflow::RandomAccessFile> file_;
-  std::unique_ptr<tensorflow::io::RecordReader> reader_;
+  std::unique_ptr<tensorflow::io::InputStreamInterface> input_stream_;
 
+  // Scratch space for record headers and footers.
+  tensorflow::tstring framing_;
   tensorflow::tstring record_;
+  // One buffer per record of the last ReadBatch() call, reused across calls.
+  std::vector<tensorflow::tstring> batch_;
 };
 
 }  // namespace nucleus
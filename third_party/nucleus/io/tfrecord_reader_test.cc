@@ -32,9 +32,17 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "third_party/nucleus/io/tfrecord_reader.h"
 
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/io/tfrecord_writer.h"
 #include "third_party/nucleus/protos/variants.pb.h"
 #include "third_party/nucleus/testing/test_utils.h"
 
@@ -58,6 +66,85 @@ TEST(TFRecordReaderTest, Simple) {
 }
 
 
+TEST(TFRecordReaderTest, RecordViewParsesWithoutCopy) {
+  std::unique_ptr<TFRecordReader> reader = TFRecordReader::New(
+      GetTestData("test_likelihoods.vcf.golden.tfrecord"), "");
+  ASSERT_NE(reader, nullptr);
+  ASSERT_TRUE(reader->GetNext());
+
+  absl::string_view view = reader->record_view();
+  EXPECT_EQ(reader->record().data(), view.data());
+  nucleus::genomics::v1::Variant v;
+  ASSERT_TRUE(v.ParseFromArray(view.data(), view.size()));
+  EXPECT_EQ("Chr1", v.reference_name());
+}
+
+TEST(TFRecordReaderTest, ReadBatch) {
+  const std::string path = MakeTempFile("read_batch.tfrecord.gz");
+  std::unique_ptr<TFRecordWriter> writer = TFRecordWriter::New(path, "GZIP");
+  for (const char* record : {"a", "bb", "", "dddd", "eeeee"}) {
+    ASSERT_TRUE(writer->WriteRecord(record));
+  }
+  ASSERT_TRUE(writer->Close());
+
+  std::unique_ptr<TFRecordReader> reader = TFRecordReader::New(path, "GZIP");
+  ASSERT_NE(reader, nullptr);
+  EXPECT_THAT(reader->ReadBatch(2), testing::ElementsAre("a", "bb"));
+  EXPECT_THAT(reader->ReadBatch(2), testing::ElementsAre("", "dddd"));
+  EXPECT_THAT(reader->ReadBatch(2), testing::ElementsAre("eeeee"));
+  EXPECT_THAT(reader->ReadBatch(2), testing::IsEmpty());
+  EXPECT_FALSE(reader->GetNext());
+}
+
+TEST(TFRecordReaderTest, SkipsChecksumsOnlyWhenAsked) {
+  const std::string path = MakeTempFile("corrupted.tfrecord");
+  std::unique_ptr<TFRecordWriter> writer = TFRecordWriter::New(path, "");
+  ASSERT_TRUE(writer->WriteRecord("payload"));
+  ASSERT_TRUE(writer->Close());
+
+  // Flip the first byte of the record contents, which follow the 12-byte
+  // length header.
+  std::string contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(), path,
+                                           &contents));
+  contents[12] = 'P';
+  TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(), path,
+                                            contents));
+
+  std::unique_ptr<TFRecordReader> verifying = TFRecordReader::New(path, "");
+  ASSERT_NE(verifying, nullptr);
+  EXPECT_FALSE(verifying->GetNext());
+
+  std::unique_ptr<TFRecordReader> trusting =
+      TFRecordReader::New(path, "", /*verify_checksums=*/false);
+  ASSERT_NE(trusting, nullptr);
+  ASSERT_TRUE(trusting->GetNext());
+  EXPECT_EQ("Payload", trusting->record_view());
+}
+
+TEST(TFRecordReaderTest, StopsAtTruncatedRecordLength) {
+  const std::string path = MakeTempFile("truncated.tfrecord");
+  std::unique_ptr<TFRecordWriter> writer = TFRecordWriter::New(path, "");
+  ASSERT_TRUE(writer->WriteRecord("first"));
+  ASSERT_TRUE(writer->WriteRecord("second"));
+  ASSERT_TRUE(writer->Close());
+
+  // Keep the first record (12-byte header, 5 bytes of data and a 4-byte
+  // footer) and only part of the second record's header.
+  std::string contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(), path,
+                                           &contents));
+  contents.resize(12 + 5 + 4 + 6);
+  TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(), path,
+                                            contents));
+
+  std::unique_ptr<TFRecordReader> reader = TFRecordReader::New(path, "");
+  ASSERT_NE(reader, nullptr);
+  ASSERT_TRUE(reader->GetNext());
+  EXPECT_EQ("first", reader->record_view());
+  EXPECT_FALSE(reader->GetNext());
+}
+
 TEST(TFRecordReaderTest, NotFound) {
   std::unique_ptr<TFRecordReader> reader =
       TFRecordReader::New(GetTestData("not_found.tfrecord"), "");
@@ -34,6 +34,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <utility>
 
 #include "absl/log/check.h"
 #include "absl/strings/match.h"
@@ -66,13 +67,31 @@ IndexedVariant EmptyIndexedVariant() {
 
 VariantReader::VariantReader(
     std::unique_ptr<TFRecordReader> internal_reader,
-    absl::flat_hash_map<std::string, uint32_t>& contig_index_map)
+    absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+    int prefetched_records)
     : internal_reader_(std::move(internal_reader)),
-      contig_index_map_(contig_index_map) {}
+      contig_index_map_(contig_index_map),
+      prefetched_records_(prefetched_records),
+      current_(EmptyIndexedVariant()) {
+  if (prefetched_records_ > 0) {
+    thread_ = std::thread(&VariantReader::Prefetch, this);
+  }
+}
+
+VariantReader::~VariantReader() {
+  if (thread_.joinable()) {
+    {
+      absl::MutexLock lock(&mutex_);
+      cancelled_ = true;
+    }
+    thread_.join();
+  }
+}
 
 std::unique_ptr<VariantReader> VariantReader::Open(
     const std::string& filename, std::string_view compression_type,
-    absl::flat_hash_map<std::string, uint32_t>& contig_index_map) {
+    absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+    int prefetched_records) {
   std::string compression(compression_type);
   if (compression_type == kAutoDetectCompression) {
     compression = "";
@@ -82,15 +101,64 @@ std::unique_ptr<VariantReader> VariantReader::Open(
   }
 
   return std::make_unique<VariantReader>(
-      TFRecordReader::New(filename, compression), contig_index_map);
+      TFRecordReader::New(filename, compression), contig_index_map,
+      prefetched_records);
+}
+
+bool VariantReader::CanPrefetch() const {
+  return cancelled_ ||
+         prefetched_.size() < static_cast<size_t>(prefetched_records_);
+}
+
+bool VariantReader::HasPrefetched() const {
+  return exhausted_ || !prefetched_.empty();
+}
+
+void VariantReader::Prefetch() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &VariantReader::CanPrefetch));
+      if (cancelled_) return;
+    }
+    // internal_reader_ is only touched by this thread once it is started.
+    if (!internal_reader_->GetNext()) {
+      absl::MutexLock lock(&mutex_);
+      exhausted_ = true;
+      return;
+    }
+    IndexedVariant variant = ParseRecord();
+
+    absl::MutexLock lock(&mutex_);
+    prefetched_.push_back(std::move(variant));
+  }
 }
 
-bool VariantReader::GetNext() { return internal_reader_->GetNext(); }
+bool VariantReader::GetNext() {
+  if (prefetched_records_ <= 0) {
+    return internal_reader_->GetNext();
+  }
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &VariantReader::HasPrefetched));
+  if (prefetched_.empty()) {
+    return false;
+  }
+  current_ = std::move(prefetched_.front());
+  prefetched_.pop_front();
+  return true;
+}
 
 // Return the current record contents.  Only valid after GetNext()
 // has returned true.
 IndexedVariant VariantReader::ReadRecord() {
-  tensorflow::tstring data = internal_reader_->record();
+  if (prefetched_records_ > 0) {
+    return std::move(current_);
+  }
+  return ParseRecord();
+}
+
+IndexedVariant VariantReader::ParseRecord() {
+  absl::string_view data = internal_reader_->record_view();
   std::unique_ptr<Variant> proto = std::make_unique<Variant>();
   CHECK(proto->ParseFromArray(data.data(), data.length()))
       << "Failed to parse proto";
@@ -116,12 +184,14 @@ ShardedVariantReader::ShardedVariantReader(
 
 std::unique_ptr<ShardedVariantReader> ShardedVariantReader::Open(
     const std::vector<std::string>& shard_paths,
-    absl::flat_hash_map<std::string, uint32_t>& contig_index_map) {
+    absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+    int prefetched_records_per_shard) {
   std::vector<std::unique_ptr<VariantReader>> shard_readers;
   shard_readers.reserve(shard_paths.size());
   for (const auto& path : shard_paths) {
-    shard_readers.emplace_back(
-        VariantReader::Open(path, kAutoDetectCompression, contig_index_map));
+    shard_readers.emplace_back(VariantReader::Open(
+        path, kAutoDetectCompression, contig_index_map,
+        prefetched_records_per_shard));
   }
 
   return std::make_unique<ShardedVariantReader>(std::move(shard_readers));
@@ -34,12 +34,15 @@
 #define THIRD_PARTY_NUCLEUS_IO_VARIANT_READER_H_
 
 #include <cstdint>
+#include <deque>
 #include <limits>
 #include <memory>
 #include <queue>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "third_party/nucleus/io/tfrecord_reader.h"
 #include "third_party/nucleus/protos/variants.pb.h"
 
@@ -47,6 +50,10 @@ namespace nucleus {
 
 constexpr std::string_view kAutoDetectCompression = "AUTO";
 
+// A good number of parsed records for a prefetching VariantReader to decode
+// ahead of its caller.
+constexpr int kPrefetchedRecords = 256;
+
 using nucleus::genomics::v1::Variant;
 
 // Holds a pointer to the Variant proto, and the index the contig it belongs to.
@@ -67,20 +74,36 @@ IndexedVariant EmptyIndexedVariant();
 // Note: This is intended for a specific use case within DeepVariant, where both
 // the Variant and the index of the contig are always used together.
 // If you need a more general use case, consider using TFRecordReader directly.
+//
+// If prefetched_records > 0, a background thread reads, decompresses and
+// parses up to that many records ahead of the caller, so that GetNext() only
+// has to take an already parsed record off a queue. The records and their order
+// are the same as when reading synchronously.
 class VariantReader {
  public:
   // Internal constructor, `Open` should generally be used instead.
   VariantReader(std::unique_ptr<TFRecordReader> internal_reader,
-                absl::flat_hash_map<std::string, uint32_t>& contig_index_map);
+                absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+                int prefetched_records = 0);
+
+  // Stops the background thread, if any.
+  ~VariantReader();
+
+  // Disable assignment/copy operations
+  VariantReader(const VariantReader& other) = delete;
+  VariantReader& operator=(const VariantReader&) = delete;
 
   // Creates a reader for the given file.
   // `compression_type` can be either "" (for no compression), "GZIP", or "AUTO"
   // (for auto detection by filename suffix).
   // `contig_index_map` should be a mapping between Variant reference names and
   // their index within the sorted contigs.
+  // `prefetched_records` is the number of records to decode in the background,
+  // or 0 to decode each record in GetNext().
   static std::unique_ptr<VariantReader> Open(
       const std::string& filename, std::string_view compression_type,
-      absl::flat_hash_map<std::string, uint32_t>& contig_index_map);
+      absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+      int prefetched_records = 0);
 
   IndexedVariant GetAndReadNext();
 
@@ -88,12 +111,35 @@ class VariantReader {
   bool GetNext();
 
   // Returns the current Variant and contig index.
-  // Only valid after GetNext() has returned true.
+  // Only valid after GetNext() has returned true. When prefetching, the record
+  // is moved out, so it can be read only once per GetNext().
   IndexedVariant ReadRecord();
 
  private:
+  // Parses the record internal_reader_ is positioned at.
+  IndexedVariant ParseRecord();
+
+  // Body of the background thread.
+  void Prefetch();
+
+  // Conditions for the background thread and GetNext() to stop waiting.
+  bool CanPrefetch() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool HasPrefetched() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   std::unique_ptr<TFRecordReader> internal_reader_;
   absl::flat_hash_map<std::string, uint32_t> contig_index_map_;
+  const int prefetched_records_;
+
+  absl::Mutex mutex_;
+  // Records parsed by the background thread but not yet returned by GetNext().
+  std::deque<IndexedVariant> prefetched_ ABSL_GUARDED_BY(mutex_);
+  // True once the background thread has read the last record.
+  bool exhausted_ ABSL_GUARDED_BY(mutex_) = false;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  // The record most recently returned by GetNext() when prefetching.
+  IndexedVariant current_;
+
+  std::thread thread_;
 };
 
 struct VariantFromShard {
@@ -135,9 +181,14 @@ class ShardedVariantReader {
   // `compression_type` can be either "" (for no compression), "GZIP", or "AUTO"
   // (for auto detection by filename suffix). `contig_index_map` should be a
   // mapping between reference names and their index within the sorted contigs.
+  // If `prefetched_records_per_shard` > 0, each shard is decoded on its own
+  // background thread, up to that many records ahead of the merge. That is one
+  // thread per shard, so callers should only enable it for a bounded number of
+  // shards. By default all shards are decoded on the calling thread.
   static std::unique_ptr<ShardedVariantReader> Open(
       const std::vector<std::string>& shard_paths,
-      absl::flat_hash_map<std::string, uint32_t>& contig_index_map);
+      absl::flat_hash_map<std::string, uint32_t>& contig_index_map,
+      int prefetched_records_per_shard = 0);
 
   IndexedVariant GetAndReadNext();
 
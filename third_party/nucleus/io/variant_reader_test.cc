@@ -33,6 +33,7 @@
 #include "third_party/nucleus/io/variant_reader.h"
 
 #include <string>
+#include <vector>
 
 #include <gmock/gmock-generated-matchers.h>
 #include <gmock/gmock-matchers.h>
@@ -197,4 +198,51 @@ TEST(IndexedReaderTest, ReturnsContigIndex) {
   EXPECT_THAT(reader->GetAndReadNext().contig_map_index, 2);
 }
 
+TEST(IndexedReaderTest, PrefetchingMatchesSynchronousReads) {
+  std::vector<std::string> paths;
+  for (int shard = 0; shard < 3; ++shard) {
+    paths.push_back(absl::StrCat(getenv("TEST_TMPDIR"), "/", "prefetch_",
+                                 shard, ".gz"));
+    auto writer = nucleus::TFRecordWriter::New(paths.back(), "GZIP");
+    for (int start = shard; start < 300; start += 3) {
+      writer->WriteRecord(VariantStr("ref_a", start, start + 1));
+    }
+    writer->Close();
+  }
+
+  absl::flat_hash_map<std::string, uint32_t> contig_index_map = {{"ref_a", 0}};
+  // A queue much shorter than each shard forces the decode threads to wait on
+  // the merge.
+  auto prefetching =
+      nucleus::ShardedVariantReader::Open(paths, contig_index_map, 2);
+  auto synchronous =
+      nucleus::ShardedVariantReader::Open(paths, contig_index_map);
+  for (int start = 0; start < 300; ++start) {
+    nucleus::IndexedVariant expected = synchronous->GetAndReadNext();
+    ASSERT_THAT(expected.variant,
+                Pointee(EqualsProto(VariantProto("ref_a", start, start + 1))));
+    EXPECT_THAT(prefetching->GetAndReadNext().variant,
+                Pointee(EqualsProto(*expected.variant)));
+  }
+  EXPECT_EQ(prefetching->GetAndReadNext().variant, nullptr);
+  EXPECT_EQ(synchronous->GetAndReadNext().variant, nullptr);
+}
+
+TEST(IndexedReaderTest, DestroysPrefetchingReaderBeforeEnd) {
+  std::string path_a = absl::StrCat(getenv("TEST_TMPDIR"), "/", "unread.gz");
+  auto writer_a = nucleus::TFRecordWriter::New(path_a, "GZIP");
+  for (int start = 0; start < 100; ++start) {
+    writer_a->WriteRecord(VariantStr("ref_a", start));
+  }
+  writer_a->Close();
+
+  absl::flat_hash_map<std::string, uint32_t> contig_index_map = {{"ref_a", 0}};
+  auto reader = nucleus::VariantReader::Open(
+      path_a, nucleus::kAutoDetectCompression, contig_index_map, 4);
+  EXPECT_THAT(reader->GetAndReadNext().variant,
+              Pointee(EqualsProto(VariantProto("ref_a", 0))));
+  // The background thread is blocked on a full queue and must still stop.
+  reader.reset();
+}
+
 }  // namespace
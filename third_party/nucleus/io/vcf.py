@@ -253,7 +253,10 @@ class NativeVcfWriter(genomics_writer.GenomicsWriter):
                excluded_info_fields=None,
                excluded_format_fields=None,
                retrieve_gl_and_pl_from_info_map=False,
-               exclude_header=False):
+               exclude_header=False,
+               num_compression_threads=0,
+               write_index=False,
+               index_min_shift=0):
     """Initializer for NativeVcfWriter.
 
     Args:
@@ -272,6 +275,12 @@ class NativeVcfWriter(genomics_writer.GenomicsWriter):
         fields are retrieved from the VariantCall.info map rather than from the
         top-level value in the VariantCall.genotype_likelihood field.
       exclude_header: bool. If True, write a headerless VCF.
+      num_compression_threads: int. Number of threads used to compress BGZF
+        output. 0 compresses on the calling thread.
+      write_index: bool. If True, build a tabix (or CSI) index while writing
+        instead of in a separate pass. Requires a .gz output_path.
+      index_min_shift: int. If > 0, write a CSI index with this min_shift
+        rather than a tabix index.
     """
     super(NativeVcfWriter, self).__init__()
 
@@ -283,6 +292,9 @@ class NativeVcfWriter(genomics_writer.GenomicsWriter):
         excluded_format_fields=excluded_format_fields,
         retrieve_gl_and_pl_from_info_map=retrieve_gl_and_pl_from_info_map,
         exclude_header=exclude_header,
+        num_compression_threads=num_compression_threads,
+        write_index=write_index,
+        index_min_shift=index_min_shift,
     )
     self._writer = vcf_writer.VcfWriter.to_file(output_path, header,
                                                 writer_options)
@@ -308,7 +320,10 @@ class VcfWriter(genomics_writer.DispatchingGenomicsWriter):
                      excluded_info_fields=None,
                      excluded_format_fields=None,
                      retrieve_gl_and_pl_from_info_map=False,
-                     exclude_header=False):
+                     exclude_header=False,
+                     num_compression_threads=0,
+                     write_index=False,
+                     index_min_shift=0):
     return NativeVcfWriter(
         output_path,
         header=header,
@@ -316,7 +331,10 @@ class VcfWriter(genomics_writer.DispatchingGenomicsWriter):
         excluded_info_fields=excluded_info_fields,
         excluded_format_fields=excluded_format_fields,
         retrieve_gl_and_pl_from_info_map=retrieve_gl_and_pl_from_info_map,
-        exclude_header=exclude_header)
+        exclude_header=exclude_header,
+        num_compression_threads=num_compression_threads,
+        write_index=write_index,
+        index_min_shift=index_min_shift)
 
   def _post_init_hook(self):
     # Initialize field_access_cache.  If we are dispatching to a
@@ -1056,6 +1056,73 @@ char* uppercase_allele(char* s) {
   return ::nucleus::Status();
 }
 
+VcfRecordView::VcfRecordView(const bcf_hdr_t *h) : h_(h) {}
+
+VcfRecordView::~VcfRecordView() { free(gt_arr_); }
+
+void VcfRecordView::Reset(bcf1_t *v) {
+  v_ = v;
+  alleles_unpacked_ = false;
+  n_gts_ = -1;
+}
+
+absl::string_view VcfRecordView::ReferenceName() const {
+  return bcf_hdr_id2name(h_, v_->rid);
+}
+
+void VcfRecordView::UnpackAlleles() const {
+  if (alleles_unpacked_) return;
+  bcf_unpack(v_, BCF_UN_STR);
+  for (int i = 0; i < v_->n_allele; ++i) {
+    uppercase_allele(v_->d.allele[i]);
+  }
+  alleles_unpacked_ = true;
+}
+
+absl::string_view VcfRecordView::Id() const {
+  UnpackAlleles();
+  if (v_->d.id == nullptr || strcmp(v_->d.id, ".") == 0) return "";
+  return v_->d.id;
+}
+
+absl::string_view VcfRecordView::ReferenceBases() const {
+  UnpackAlleles();
+  return v_->n_allele > 0 ? v_->d.allele[0] : "";
+}
+
+int VcfRecordView::NumAlternateBases() const {
+  return v_->n_allele > 0 ? v_->n_allele - 1 : 0;
+}
+
+absl::string_view VcfRecordView::AlternateBases(int i) const {
+  CHECK_GE(i, 0);
+  CHECK_LT(i, NumAlternateBases());
+  UnpackAlleles();
+  return v_->d.allele[i + 1];
+}
+
+StatusOr<absl::Span<const int>> VcfRecordView::Genotype(int sample) const {
+  CHECK_GE(sample, 0);
+  CHECK_LT(sample, NumSamples());
+  if (n_gts_ < 0) {
+    // bcf_get_genotypes only reallocates gt_arr_ if it is too small.
+    n_gts_ = bcf_get_genotypes(h_, v_, &gt_arr_, &gt_arr_size_);
+    if (n_gts_ < 0) {
+      n_gts_ = -1;
+      return ::nucleus::DataLoss("Couldn't parse genotypes");
+    }
+  }
+  const int max_ploidy = n_gts_ / v_->n_sample;
+  genotype_.clear();
+  for (int j = 0; j < max_ploidy; j++) {
+    const int gt_idx = gt_arr_[sample * max_ploidy + j];
+    // Check whether this sample has smaller ploidy.
+    if (gt_idx == bcf_int32_vector_end) break;
+    genotype_.push_back(bcf_gt_allele(gt_idx));
+  }
+  return absl::Span<const int>(genotype_);
+}
+
 ::nucleus::Status VcfRecordConverter::ConvertFromPb(
     const nucleus::genomics::v1::Variant& variant_message, const bcf_hdr_t& h,
     bcf1_t* v) const {
@@ -36,6 +36,8 @@
 #include <string>
 #include <vector>
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "htslib/vcf.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/variants.pb.h"
@@ -317,6 +319,60 @@ class VcfRecordConverter {
   bool gl_and_pl_in_info_map_;
 };
 
+// A lightweight view of a VCF record parsed by htslib, for callers that only
+// need a few fields of each record rather than a whole Variant proto.
+//
+// Fields are decoded from the bcf1_t when first asked for, following the same
+// conventions as VcfRecordConverter::ConvertToPb: start and end are 0-based,
+// alleles are uppercased (except symbolic ones like <*>) and missing genotype
+// alleles are -1. Nothing is copied: strings point into the record, which is
+// modified in place, and genotypes into a scratch buffer that is reused from
+// record to record. They are only valid until the view is Reset.
+class VcfRecordView {
+ public:
+  explicit VcfRecordView(const bcf_hdr_t *h);
+  ~VcfRecordView();
+
+  // Disable copy or assignment
+  VcfRecordView(const VcfRecordView &other) = delete;
+  VcfRecordView &operator=(const VcfRecordView &) = delete;
+
+  // Makes this a view of the record v.
+  void Reset(bcf1_t *v);
+
+  absl::string_view ReferenceName() const;
+  int64 Start() const { return v_->pos; }
+  int64 End() const { return v_->pos + v_->rlen; }
+
+  // The ID column, with names separated by ';', or "" if it is missing.
+  absl::string_view Id() const;
+
+  absl::string_view ReferenceBases() const;
+  int NumAlternateBases() const;
+  absl::string_view AlternateBases(int i) const;
+
+  int NumSamples() const { return v_->n_sample; }
+
+  // Returns the genotype of the sample-th sample.
+  StatusOr<absl::Span<const int>> Genotype(int sample) const;
+
+ private:
+  // Unpacks the ID and alleles of the record and uppercases the alleles.
+  void UnpackAlleles() const;
+
+  const bcf_hdr_t *h_;
+  bcf1_t *v_ = nullptr;
+  mutable bool alleles_unpacked_ = false;
+
+  // The GT values of all samples, as returned by bcf_get_genotypes, and their
+  // number, or -1 if they haven't been read yet for this record.
+  mutable int32_t *gt_arr_ = nullptr;
+  mutable int gt_arr_size_ = 0;
+  mutable int n_gts_ = -1;
+  // The decoded genotype last returned by Genotype().
+  mutable std::vector<int> genotype_;
+};
+
 }  // namespace nucleus
 
 #endif  // THIRD_PARTY_NUCLEUS_IO_VCF_CONVERSION_H_
@@ -182,12 +182,15 @@ VcfReader::VcfReader(const string& vcf_filepath,
       fp_(fp),
       header_(header),
       idx_(idx),
-      bcf1_(bcf_init()) {
+      bcf1_(bcf_init()),
+      view_line_({0, 0, nullptr}),
+      view_(std::make_unique<VcfRecordView>(header)) {
   NativeHeaderUpdated();
 }
 
 VcfReader::~VcfReader() {
   bcf_destroy(bcf1_);
+  free(view_line_.s);
   if (fp_) {
     // We cannot return a value from the destructor, so the best we can do is
     // CHECK-fail if the Close() wasn't successful.
@@ -202,8 +205,8 @@ StatusOr<std::shared_ptr<VariantIterable>> VcfReader::Iterate() {
       MakeIterable<VcfFullFileIterable>(this, fp_, header_));
 }
 
-StatusOr<std::shared_ptr<VariantIterable>> VcfReader::Query(
-    const Range& region) {
+::nucleus::Status VcfReader::QueryIterator(const Range& region,
+                                           hts_itr_t** iter) const {
   if (fp_ == nullptr)
     return ::nucleus::FailedPrecondition("Cannot Query a closed VcfReader.");
   if (!HasIndex()) {
@@ -221,23 +224,52 @@ StatusOr<std::shared_ptr<VariantIterable>> VcfReader::Query(
 
   // Get the tid (index of reference_name in our tabix index),
   const int tid = tbx_name2id(idx_, reference_name);
-  hts_itr_t* iter = nullptr;
+  *iter = nullptr;
   if (tid >= 0) {
     // Note that query is 0-based inclusive on start and exclusive on end,
     // matching exactly the logic of our Range.
-    iter = tbx_itr_queryi(idx_, tid, region.start(), region.end());
-    if (iter == nullptr) {
+    *iter = tbx_itr_queryi(idx_, tid, region.start(), region.end());
+    if (*iter == nullptr) {
       return ::nucleus::NotFound(
           absl::StrCat("region '", region.ShortDebugString(),
                        "' returned an invalid hts_itr_queryi result"));
     }
   }  // implicit else case:
   // The chromosome isn't reflected in the tabix index (meaning, no
-  // variant records) => return an *empty* iterable by leaving iter empty.
+  // variant records) => leave iter empty.
+  return ::nucleus::Status();
+}
+
+StatusOr<std::shared_ptr<VariantIterable>> VcfReader::Query(
+    const Range& region) {
+  hts_itr_t* iter;
+  NUCLEUS_RETURN_IF_ERROR(QueryIterator(region, &iter));
+  // An empty iter makes an *empty* iterable.
   return StatusOr<std::shared_ptr<VariantIterable>>(
       MakeIterable<VcfQueryIterable>(this, fp_, header_, idx_, iter));
 }
 
+::nucleus::Status VcfReader::QueryViews(
+    const Range& region,
+    const std::function<bool(const VcfRecordView&)>& visit) {
+  hts_itr_t* iter;
+  NUCLEUS_RETURN_IF_ERROR(QueryIterator(region, &iter));
+  if (iter == nullptr) return ::nucleus::Status();
+
+  ::nucleus::Status status;
+  while (tbx_itr_next(fp_, idx_, iter, &view_line_) >= 0) {
+    if (vcf_parse1(&view_line_, header_, bcf1_) < 0) {
+      status = ::nucleus::DataLoss(
+          absl::StrCat("Failed to parse VCF record: ", view_line_.s));
+      break;
+    }
+    view_->Reset(bcf1_);
+    if (!visit(*view_)) break;
+  }
+  hts_itr_destroy(iter);
+  return status;
+}
+
 ::nucleus::Status VcfReader::FromString(const absl::string_view& vcf_line,
                                         nucleus::genomics::v1::Variant* v) {
   size_t len = vcf_line.length();
@@ -33,11 +33,13 @@
 #ifndef THIRD_PARTY_NUCLEUS_IO_VCF_READER_H_
 #define THIRD_PARTY_NUCLEUS_IO_VCF_READER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 
 #include "absl/strings/string_view.h"
 #include "htslib/hts.h"
+#include "htslib/kstring.h"
 #include "htslib/sam.h"
 #include "htslib/tbx.h"
 #include "htslib/vcf.h"
@@ -136,6 +138,17 @@ class VcfReader : public Reader {
   StatusOr<std::shared_ptr<VariantIterable>> Query(
       const nucleus::genomics::v1::Range& region);
 
+  // Same as Query, but rather than converting each record into a Variant,
+  // calls visit with a VcfRecordView of each record overlapping region, in
+  // order, until visit returns false. Callers that only need a few fields,
+  // such as the position, alleles and genotypes, avoid building protos this
+  // way. The view is only valid during the call to visit.
+  //
+  // Must not be called while an iterable from Iterate or Query is in use.
+  ::nucleus::Status QueryViews(
+      const nucleus::genomics::v1::Range& region,
+      const std::function<bool(const VcfRecordView&)>& visit);
+
   // Parses vcf_line and puts the result into v.
   ::nucleus::Status FromString(const absl::string_view& vcf_line,
                                nucleus::genomics::v1::Variant* v);
@@ -179,6 +192,11 @@ class VcfReader : public Reader {
       const string& vcf_filepath,
       const nucleus::genomics::v1::VcfReaderOptions& options, bcf_hdr_t* h);
 
+  // Checks that region can be queried, and sets iter to an iterator over the
+  // records overlapping it, or to nullptr if there are none.
+  ::nucleus::Status QueryIterator(const nucleus::genomics::v1::Range& region,
+                                  hts_itr_t** iter) const;
+
   // Helper method to update other member variables when |header_| is changed.
   // This can happen during initialization or when a new header field is
   // encountered while reading.
@@ -207,8 +225,13 @@ class VcfReader : public Reader {
   // Object for converting VCF records to to Variant proto.
   VcfRecordConverter record_converter_;
 
-  // htslib's representation of a parsed vcf line.  Only used by FromString.
+  // htslib's representation of a parsed vcf line.  Only used by FromString
+  // and QueryViews.
   bcf1_t* bcf1_;
+
+  // The line buffer and view reused by QueryViews.
+  kstring_t view_line_;
+  std::unique_ptr<VcfRecordView> view_;
 };
 
 }  // namespace nucleus
@@ -41,6 +41,7 @@
 #include <gmock/gmock-matchers.h>
 #include <gmock/gmock-more-matchers.h>
 
+#include "absl/strings/str_join.h"
 #include "tensorflow/core/platform/test.h"
 #include "third_party/nucleus/protos/struct.pb.h"
 #include "third_party/nucleus/protos/variants.pb.h"
@@ -451,6 +452,48 @@ TEST_F(VcfWithSamplesReaderTest, QueryRangesIsCorrect) {
               SizeIs(0));
 }
 
+TEST_F(VcfWithSamplesReaderTest, QueryViewsMatchesQuery) {
+  const auto region = MakeRange("chr1", 0, CHR1_SIZE);
+  const vector<Variant> expected = as_vector(reader_->Query(region));
+  size_t i = 0;
+  ASSERT_THAT(
+      reader_->QueryViews(region, [&](const VcfRecordView& view) {
+        if (i >= expected.size()) return false;
+        const Variant& v = expected[i++];
+        EXPECT_EQ(view.ReferenceName(), v.reference_name());
+        EXPECT_EQ(view.Start(), v.start());
+        EXPECT_EQ(view.End(), v.end());
+        EXPECT_EQ(view.Id(), absl::StrJoin(v.names(), ";"));
+        EXPECT_EQ(view.ReferenceBases(), v.reference_bases());
+        EXPECT_EQ(view.NumAlternateBases(), v.alternate_bases_size());
+        for (int j = 0; j < view.NumAlternateBases(); ++j) {
+          EXPECT_EQ(view.AlternateBases(j), v.alternate_bases(j));
+        }
+        EXPECT_EQ(view.NumSamples(), v.calls_size());
+        for (int j = 0; j < view.NumSamples(); ++j) {
+          EXPECT_THAT(view.Genotype(j).ValueOrDie(),
+                      ::testing::ElementsAreArray(v.calls(j).genotype()));
+        }
+        return true;
+      }),
+      IsOK());
+  EXPECT_EQ(i, expected.size());
+}
+
+TEST_F(VcfWithSamplesReaderTest, QueryViewsStopsWhenAsked) {
+  int n_visited = 0;
+  EXPECT_THAT(reader_->QueryViews(MakeRange("chr1", 0, CHR1_SIZE),
+                                  [&](const VcfRecordView&) {
+                                    return ++n_visited < 3;
+                                  }),
+              IsOK());
+  EXPECT_EQ(n_visited, 3);
+  // Unknown contigs fail as they do for Query.
+  EXPECT_THAT(reader_->QueryViews(MakeRange("chr0", 0, 10),
+                                  [](const VcfRecordView&) { return true; }),
+              Not(IsOK()));
+}
+
 TEST_F(VcfWithSamplesReaderTest, WholeChromosomeQueries) {
   // Test a bunch of misc. queries.
   EXPECT_THAT(as_vector(reader_->Query(MakeRange("chr1", 0, CHR1_SIZE))),
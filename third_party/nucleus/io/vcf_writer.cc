@@ -40,12 +40,15 @@
 #include <vector>
 
 #include "absl/log/check.h"
+#include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "htslib/hts.h"
 #include "htslib/sam.h"
 #include "third_party/nucleus/core/status.h"
 #include "third_party/nucleus/io/hts_path.h"
+#include "third_party/nucleus/io/hts_thread_pool.h"
 #include "third_party/nucleus/io/vcf_conversion.h"
 #include "third_party/nucleus/protos/reference.pb.h"
 #include "third_party/nucleus/protos/variants.pb.h"
@@ -65,6 +68,10 @@ constexpr char kBCFOpenModeUncompressed[] = "wbu";
 constexpr char kOpenModeCompressed[] = "wz";
 constexpr char kOpenModeUncompressed[] = "w";
 
+// The min_shift of CSI indices unless the options ask for another one. This is
+// the default of bcftools index and htslib's tabix.
+constexpr int kDefaultCsiMinShift = 14;
+
 // RAII wrapper on top of bcf1_t* to always perform cleanup.
 class BCFRecord {
  public:
@@ -91,21 +98,53 @@ StatusOr<std::unique_ptr<VcfWriter>> VcfWriter::ToFile(
     const string& variants_path, const nucleus::genomics::v1::VcfHeader& header,
     const nucleus::genomics::v1::VcfWriterOptions& options) {
   const char* const open_mode = GetOpenMode(variants_path);
+  const bool is_bgzf = EndsWith(variants_path, ".gz");
+  if (options.write_index() && (!is_bgzf || options.exclude_header())) {
+    return ::nucleus::InvalidArgument(absl::StrCat(
+        "Can only index BGZF-compressed output with a header, not ",
+        variants_path));
+  }
   htsFile* fp = hts_open_x(variants_path, open_mode);
   if (fp == nullptr) {
     return ::nucleus::Unknown(
         absl ::StrCat("Could not open variants_path: ", variants_path));
   }
 
-  auto writer = absl::WrapUnique(new VcfWriter(header, options, fp));
+  // Only BGZF output has block-level compression to hand to other threads.
+  std::shared_ptr<HtsThreadPool> thread_pool;
+  if (is_bgzf) {
+    thread_pool = HtsThreadPool::Shared(options.num_compression_threads());
+  }
+  if (thread_pool != nullptr) {
+    ::nucleus::Status status = thread_pool->AttachTo(fp);
+    if (!status.ok()) {
+      LOG(WARNING) << status << "; compressing " << variants_path
+                   << " on the calling thread";
+      thread_pool = nullptr;
+    }
+  }
+
+  auto writer = absl::WrapUnique(
+      new VcfWriter(header, options, fp, std::move(thread_pool)));
   NUCLEUS_RETURN_IF_ERROR(writer->WriteHeader());
+  if (options.write_index()) {
+    // BCF can only be indexed with CSI.
+    const bool csi = options.index_min_shift() > 0 ||
+                     EndsWith(variants_path, ".bcf.gz");
+    NUCLEUS_RETURN_IF_ERROR(writer->InitIndex(
+        absl::StrCat(variants_path, csi ? ".csi" : ".tbi"),
+        csi ? (options.index_min_shift() > 0 ? options.index_min_shift()
+                                             : kDefaultCsiMinShift)
+            : 0));
+  }
   return std::move(writer);
 }
 
 VcfWriter::VcfWriter(const nucleus::genomics::v1::VcfHeader& header,
                      const nucleus::genomics::v1::VcfWriterOptions& options,
-                     htsFile* fp)
+                     htsFile* fp, std::shared_ptr<HtsThreadPool> thread_pool)
     : fp_(fp),
+      thread_pool_(std::move(thread_pool)),
       options_(options),
       vcf_header_(header),
       record_converter_(
@@ -130,6 +169,16 @@ VcfWriter::VcfWriter(const nucleus::genomics::v1::VcfHeader& header,
   return ::nucleus::Status();
 }
 
+::nucleus::Status VcfWriter::InitIndex(const string& index_path,
+                                       int min_shift) {
+  if (bcf_idx_init(fp_, header_, min_shift, index_path.c_str()) != 0) {
+    return ::nucleus::Unknown(
+        absl::StrCat("Failed to start building index ", index_path));
+  }
+  writing_index_ = true;
+  return ::nucleus::Status();
+}
+
 VcfWriter::~VcfWriter() {
   if (fp_) {
     // There's nothing we can do but assert fail if there's an error during
@@ -200,8 +249,17 @@ void SetVariantGenotype(const std::array<int, 2> genotype,
   if (fp_ == nullptr)
     return ::nucleus::FailedPrecondition(
         "Cannot close an already closed VcfWriter");
+  if (writing_index_) {
+    // Flushes the output and writes the index built while writing it.
+    if (bcf_idx_save(fp_) < 0) {
+      return ::nucleus::Unknown("bcf_idx_save call failed");
+    }
+    writing_index_ = false;
+  }
   if (hts_close(fp_) < 0) return ::nucleus::Unknown("hts_close call failed");
   fp_ = nullptr;
+  // The pool may only be released once no htsFile refers to it anymore.
+  thread_pool_ = nullptr;
   bcf_hdr_destroy(header_);
   header_ = nullptr;
   return ::nucleus::Status();
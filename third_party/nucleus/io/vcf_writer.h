@@ -39,6 +39,7 @@
 #include "htslib/hts.h"
 #include "htslib/sam.h"
 #include "htslib/vcf.h"
+#include "third_party/nucleus/io/hts_thread_pool.h"
 #include "third_party/nucleus/io/vcf_conversion.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/range.pb.h"
@@ -109,13 +110,25 @@ class VcfWriter {
  private:
   VcfWriter(const nucleus::genomics::v1::VcfHeader& header,
             const nucleus::genomics::v1::VcfWriterOptions& options,
-            htsFile* fp);
+            htsFile* fp, std::shared_ptr<HtsThreadPool> thread_pool);
 
   ::nucleus::Status WriteHeader();
 
+  // Starts building the index of the output, to be saved to index_path, with
+  // min_shift as in bcf_idx_init. Must be called after the header is written
+  // and before any record is.
+  ::nucleus::Status InitIndex(const string& index_path, int min_shift);
+
   // A pointer to the htslib file used to write the VCF data.
   htsFile* fp_;
 
+  // The htslib thread pool compressing the output, or nullptr if it is
+  // compressed on the calling thread. Released after fp_ is closed.
+  std::shared_ptr<HtsThreadPool> thread_pool_;
+
+  // True if an index is being built as the output is written.
+  bool writing_index_ = false;
+
   // The options controlling the behavior of this VcfWriter.
   const nucleus::genomics::v1::VcfWriterOptions options_;
 
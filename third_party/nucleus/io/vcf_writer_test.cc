@@ -44,6 +44,7 @@
 
 #include "tensorflow/core/platform/test.h"
 #include "third_party/nucleus/core/status_matchers.h"
+#include "third_party/nucleus/io/vcf_reader.h"
 #include "third_party/nucleus/platform/types.h"
 #include "third_party/nucleus/protos/reference.pb.h"
 #include "third_party/nucleus/protos/variants.pb.h"
@@ -108,7 +109,8 @@ std::unique_ptr<VcfWriter> MakeDogVcfWriter(
     const string& fname, const bool round_qual, const bool include_gl = true,
     const std::vector<string>& excluded_infos = {},
     const std::vector<string>& excluded_formats = {},
-    bool exclude_header = false) {
+    bool exclude_header = false,
+    nucleus::genomics::v1::VcfWriterOptions writer_options = {}) {
   nucleus::genomics::v1::VcfHeader header;
   // FILTERs. Note that the PASS filter automatically gets added even though it
   // is not present here.
@@ -220,7 +222,6 @@ std::unique_ptr<VcfWriter> MakeDogVcfWriter(
   header.mutable_sample_names()->Add("Fido");
   header.mutable_sample_names()->Add("Spot");
 
-  nucleus::genomics::v1::VcfWriterOptions writer_options;
   if (round_qual) {
     writer_options.set_round_qual_values(true);
   }
@@ -701,6 +702,65 @@ TEST(VcfWriterTest, WritesGzippedVCF) {
               "VCF writer should be able to writed gzipped output");
 }
 
+// Writes two records to an indexed, multi-threaded BGZF writer and checks
+// that the index produced alongside the output supports region queries.
+void WriteAndQueryIndexedVcf(const string& output_filename,
+                             const string& index_filename,
+                             int index_min_shift) {
+  nucleus::genomics::v1::VcfWriterOptions writer_options;
+  writer_options.set_num_compression_threads(2);
+  writer_options.set_write_index(true);
+  writer_options.set_index_min_shift(index_min_shift);
+  auto writer = MakeDogVcfWriter(output_filename, false, true, {}, {}, false,
+                                 writer_options);
+
+  Variant v1 = MakeVariant({"DogSNP1"}, "Chr1", 20, 21, "A", {"T"});
+  *v1.add_calls() = MakeVariantCall("Fido", {0, 1});
+  *v1.add_calls() = MakeVariantCall("Spot", {0, 0});
+  ASSERT_THAT(writer->Write(v1), IsOK());
+  Variant v2 = MakeVariant({}, "Chr2", 10, 11, "C", {"G"});
+  *v2.add_calls() = MakeVariantCall("Fido", {0, 0});
+  *v2.add_calls() = MakeVariantCall("Spot", {0, 1});
+  ASSERT_THAT(writer->Write(v2), IsOK());
+  ASSERT_THAT(writer->Close(), IsOK());
+
+  string vcf_contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                           output_filename, &vcf_contents));
+  EXPECT_TRUE(IsGzipped(vcf_contents));
+  EXPECT_THAT(tensorflow::Env::Default()->FileExists(index_filename), IsOK());
+
+  auto reader = std::move(
+      VcfReader::FromFile(output_filename,
+                          nucleus::genomics::v1::VcfReaderOptions())
+          .ValueOrDie());
+  std::vector<Variant> chr2 =
+      as_vector(reader->Query(MakeRange("Chr2", 0, 25)));
+  ASSERT_EQ(1, chr2.size());
+  EXPECT_EQ(10, chr2[0].start());
+}
+
+TEST(VcfWriterTest, WritesTabixIndexWhileCompressing) {
+  string output_filename = MakeTempFile("writes_indexed_vcf.vcf.gz");
+  WriteAndQueryIndexedVcf(output_filename, output_filename + ".tbi", 0);
+}
+
+TEST(VcfWriterTest, WritesCsiIndexWhileCompressing) {
+  string output_filename = MakeTempFile("writes_csi_indexed_vcf.vcf.gz");
+  WriteAndQueryIndexedVcf(output_filename, output_filename + ".csi", 14);
+}
+
+TEST(VcfWriterTest, RejectsIndexForUncompressedOutput) {
+  nucleus::genomics::v1::VcfWriterOptions writer_options;
+  writer_options.set_write_index(true);
+  EXPECT_THAT(VcfWriter::ToFile(MakeTempFile("unindexable.vcf"),
+                                nucleus::genomics::v1::VcfHeader(),
+                                writer_options),
+              IsNotOKWithCodeAndMessage(
+                  absl::StatusCode::kInvalidArgument,
+                  "Can only index BGZF-compressed output"));
+}
+
 TEST(VcfWriterTest, HandlesRedefinedPL) {
   string output_filename = MakeTempFile("redefined_pl.vcf");
   nucleus::genomics::v1::VcfHeader header;
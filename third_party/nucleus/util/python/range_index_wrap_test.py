@@ -0,0 +1,92 @@
+# Copyright 2018 Google LLC.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+#    contributors may be used to endorse or promote products derived from this
+#    software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+"""Tests for RangeIndex CLIF python wrappers."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from absl.testing import absltest
+
+from third_party.nucleus.testing import test_utils
+from third_party.nucleus.util import ranges
+from third_party.nucleus.util.python import range_index
+
+
+class RangeIndexWrapTest(absltest.TestCase):
+
+  def setUp(self):
+    super().setUp()
+    self.index = range_index.RangeIndex.from_ranges([
+        ranges.make_range('chr1', 10, 20),
+        ranges.make_range('chr1', 15, 30),
+        ranges.make_range('chr2', 0, 5),
+    ])
+
+  def test_merges_ranges(self):
+    self.assertEqual(2, self.index.size())
+    self.assertEqual(25, self.index.total_bases())
+    self.assertEqual(
+        [ranges.make_range('chr1', 10, 30), ranges.make_range('chr2', 0, 5)],
+        self.index.to_ranges())
+
+  def test_overlaps(self):
+    self.assertTrue(self.index.overlaps('chr1', 10))
+    self.assertFalse(self.index.overlaps('chr1', 30))
+    self.assertTrue(
+        self.index.overlaps_range(ranges.make_range('chr1', 29, 40)))
+    self.assertFalse(self.index.envelops(ranges.make_range('chr1', 29, 40)))
+    self.assertEqual([True, False],
+                     self.index.overlaps_each([
+                         ranges.make_range('chr2', 4, 10),
+                         ranges.make_range('chr3', 4, 10)
+                     ]))
+
+  def test_set_operations(self):
+    other = range_index.RangeIndex.from_ranges(
+        [ranges.make_range('chr1', 20, 40)])
+    self.assertEqual([ranges.make_range('chr1', 20, 30)],
+                     self.index.intersection(other).to_ranges())
+    self.assertEqual(
+        [ranges.make_range('chr1', 10, 20), ranges.make_range('chr2', 0, 5)],
+        self.index.difference(other).to_ranges())
+    self.assertEqual(
+        [ranges.make_range('chr1', 10, 40), ranges.make_range('chr2', 0, 5)],
+        self.index.union(other).to_ranges())
+
+  def test_from_bed(self):
+    index = range_index.RangeIndex.from_bed(test_utils.genomics_core_testdata(
+        'test.bed'))
+    self.assertEqual(4, index.size())
+    self.assertEqual([ranges.make_range('chr2', 20, 30)],
+                     index.query(ranges.make_range('chr2', 25, 35)))
+
+
+if __name__ == '__main__':
+  absltest.main()
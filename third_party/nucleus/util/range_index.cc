@@ -0,0 +1,281 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of range_index.h
+#include "third_party/nucleus/util/range_index.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "third_party/nucleus/io/bed_reader.h"
+#include "third_party/nucleus/protos/bed.pb.h"
+#include "third_party/nucleus/util/utils.h"
+#include "third_party/nucleus/core/status.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::BedReaderOptions;
+using nucleus::genomics::v1::BedRecord;
+using nucleus::genomics::v1::Range;
+
+namespace {
+
+// Returns the index of the first interval ending after pos, which is the only
+// interval that can contain pos, or the first one after it.
+template <typename Intervals>
+size_t FirstEndingAfter(const Intervals& intervals, int64 pos) {
+  return std::upper_bound(intervals.ends.begin(), intervals.ends.end(), pos) -
+         intervals.ends.begin();
+}
+
+}  // namespace
+
+std::unique_ptr<RangeIndex> RangeIndex::FromRanges(
+    const std::vector<Range>& ranges) {
+  std::map<string, std::vector<std::pair<int64, int64>>> by_contig;
+  for (const Range& range : ranges) {
+    if (range.start() < range.end()) {
+      by_contig[range.reference_name()].emplace_back(range.start(),
+                                                     range.end());
+    }
+  }
+
+  auto index = std::unique_ptr<RangeIndex>(new RangeIndex());
+  for (auto& [chrom, intervals] : by_contig) {
+    std::sort(intervals.begin(), intervals.end());
+    Intervals merged;
+    for (const auto& [start, end] : intervals) {
+      if (!merged.ends.empty() && start <= merged.ends.back()) {
+        merged.ends.back() = std::max(merged.ends.back(), end);
+      } else {
+        merged.starts.push_back(start);
+        merged.ends.push_back(end);
+      }
+    }
+    index->AddContig(chrom, std::move(merged));
+  }
+  return index;
+}
+
+StatusOr<std::unique_ptr<RangeIndex>> RangeIndex::FromBed(
+    const string& bed_path) {
+  StatusOr<std::unique_ptr<BedReader>> reader_or =
+      BedReader::FromFile(bed_path, BedReaderOptions());
+  NUCLEUS_RETURN_IF_ERROR(reader_or.status());
+  StatusOr<std::shared_ptr<BedIterable>> iterable_or =
+      reader_or.ValueOrDie()->Iterate();
+  NUCLEUS_RETURN_IF_ERROR(iterable_or.status());
+
+  std::vector<Range> ranges;
+  for (const StatusOr<BedRecord*> record_or : iterable_or.ValueOrDie()) {
+    NUCLEUS_RETURN_IF_ERROR(record_or.status());
+    const BedRecord& record = *record_or.ValueOrDie();
+    ranges.push_back(
+        MakeRange(record.reference_name(), record.start(), record.end()));
+  }
+  return FromRanges(ranges);
+}
+
+void RangeIndex::AddContig(const string& chrom, Intervals intervals) {
+  if (intervals.starts.empty()) return;
+  size_ += intervals.starts.size();
+  by_contig_.emplace(chrom, std::move(intervals));
+}
+
+const RangeIndex::Intervals* RangeIndex::ForContig(const string& chrom) const {
+  auto it = by_contig_.find(chrom);
+  return it == by_contig_.end() ? nullptr : &it->second;
+}
+
+bool RangeIndex::Overlaps(const string& chrom, int64 pos) const {
+  const Intervals* intervals = ForContig(chrom);
+  if (intervals == nullptr) return false;
+  const size_t i = FirstEndingAfter(*intervals, pos);
+  return i < intervals->starts.size() && intervals->starts[i] <= pos;
+}
+
+bool RangeIndex::OverlapsRange(const Range& range) const {
+  const Intervals* intervals = ForContig(range.reference_name());
+  if (intervals == nullptr) return false;
+  const size_t i = FirstEndingAfter(*intervals, range.start());
+  return i < intervals->starts.size() && intervals->starts[i] < range.end();
+}
+
+bool RangeIndex::Envelops(const Range& range) const {
+  const Intervals* intervals = ForContig(range.reference_name());
+  if (intervals == nullptr) return false;
+  const size_t i = FirstEndingAfter(*intervals, range.start());
+  return i < intervals->starts.size() &&
+         intervals->starts[i] <= range.start() &&
+         intervals->ends[i] >= range.end();
+}
+
+std::vector<bool> RangeIndex::OverlapsEach(
+    const std::vector<Range>& ranges) const {
+  std::vector<bool> overlaps;
+  overlaps.reserve(ranges.size());
+  for (const Range& range : ranges) {
+    overlaps.push_back(OverlapsRange(range));
+  }
+  return overlaps;
+}
+
+std::vector<Range> RangeIndex::Query(const Range& range) const {
+  std::vector<Range> overlapping;
+  const Intervals* intervals = ForContig(range.reference_name());
+  if (intervals == nullptr) return overlapping;
+  for (size_t i = FirstEndingAfter(*intervals, range.start());
+       i < intervals->starts.size() && intervals->starts[i] < range.end();
+       ++i) {
+    overlapping.push_back(MakeRange(range.reference_name(),
+                                    intervals->starts[i], intervals->ends[i]));
+  }
+  return overlapping;
+}
+
+std::unique_ptr<RangeIndex> RangeIndex::Union(const RangeIndex& other) const {
+  auto result = std::unique_ptr<RangeIndex>(new RangeIndex());
+  for (const auto& [chrom, b] : other.by_contig_) {
+    if (ForContig(chrom) == nullptr) result->AddContig(chrom, b);
+  }
+  for (const auto& [chrom, a] : by_contig_) {
+    const Intervals* b = other.ForContig(chrom);
+    if (b == nullptr) {
+      result->AddContig(chrom, a);
+      continue;
+    }
+    Intervals merged;
+    size_t i = 0, j = 0;
+    while (i < a.starts.size() || j < b->starts.size()) {
+      // Take whichever interval starts first and merge it into the last one
+      // if they overlap or are adjacent.
+      const bool from_a = j == b->starts.size() ||
+                          (i < a.starts.size() && a.starts[i] < b->starts[j]);
+      const int64 start = from_a ? a.starts[i] : b->starts[j];
+      const int64 end = from_a ? a.ends[i++] : b->ends[j++];
+      if (!merged.ends.empty() && start <= merged.ends.back()) {
+        merged.ends.back() = std::max(merged.ends.back(), end);
+      } else {
+        merged.starts.push_back(start);
+        merged.ends.push_back(end);
+      }
+    }
+    result->AddContig(chrom, std::move(merged));
+  }
+  return result;
+}
+
+std::unique_ptr<RangeIndex> RangeIndex::Intersection(
+    const RangeIndex& other) const {
+  auto result = std::unique_ptr<RangeIndex>(new RangeIndex());
+  for (const auto& [chrom, a] : by_contig_) {
+    const Intervals* b = other.ForContig(chrom);
+    if (b == nullptr) continue;
+    Intervals common;
+    size_t i = 0, j = 0;
+    while (i < a.starts.size() && j < b->starts.size()) {
+      const int64 start = std::max(a.starts[i], b->starts[j]);
+      const int64 end = std::min(a.ends[i], b->ends[j]);
+      if (start < end) {
+        common.starts.push_back(start);
+        common.ends.push_back(end);
+      }
+      // Advance whichever interval ends first; the other may overlap more.
+      if (a.ends[i] < b->ends[j]) {
+        ++i;
+      } else {
+        ++j;
+      }
+    }
+    result->AddContig(chrom, std::move(common));
+  }
+  return result;
+}
+
+std::unique_ptr<RangeIndex> RangeIndex::Difference(
+    const RangeIndex& other) const {
+  auto result = std::unique_ptr<RangeIndex>(new RangeIndex());
+  for (const auto& [chrom, a] : by_contig_) {
+    const Intervals* b = other.ForContig(chrom);
+    if (b == nullptr) {
+      result->AddContig(chrom, a);
+      continue;
+    }
+    Intervals remaining;
+    size_t j = 0;
+    for (size_t i = 0; i < a.starts.size(); ++i) {
+      int64 start = a.starts[i];
+      const int64 end = a.ends[i];
+      // Skip the intervals of other that end before this one starts.
+      while (j < b->starts.size() && b->ends[j] <= start) ++j;
+      // Cut out each interval of other that overlaps this one. The last one
+      // may extend into the next interval of this index, so j stays on it.
+      for (size_t k = j; k < b->starts.size() && b->starts[k] < end; ++k) {
+        if (b->starts[k] > start) {
+          remaining.starts.push_back(start);
+          remaining.ends.push_back(b->starts[k]);
+        }
+        start = std::max(start, b->ends[k]);
+      }
+      if (start < end) {
+        remaining.starts.push_back(start);
+        remaining.ends.push_back(end);
+      }
+    }
+    result->AddContig(chrom, std::move(remaining));
+  }
+  return result;
+}
+
+std::vector<Range> RangeIndex::ToRanges() const {
+  std::vector<Range> ranges;
+  ranges.reserve(size_);
+  for (const auto& [chrom, intervals] : by_contig_) {
+    for (size_t i = 0; i < intervals.starts.size(); ++i) {
+      ranges.push_back(
+          MakeRange(chrom, intervals.starts[i], intervals.ends[i]));
+    }
+  }
+  return ranges;
+}
+
+int64 RangeIndex::TotalBases() const {
+  int64 total = 0;
+  for (const auto& [chrom, intervals] : by_contig_) {
+    for (size_t i = 0; i < intervals.starts.size(); ++i) {
+      total += intervals.ends[i] - intervals.starts[i];
+    }
+  }
+  return total;
+}
+
+}  // namespace nucleus
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_UTIL_RANGE_INDEX_H_
+#define THIRD_PARTY_NUCLEUS_UTIL_RANGE_INDEX_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/protos/range.pb.h"
+#include "third_party/nucleus/core/statusor.h"
+
+namespace nucleus {
+
+// An immutable index over a set of genomic intervals, for fast overlap queries
+// and set operations over millions of intervals (e.g. the confident regions of
+// a truth set, or calling regions built from BED files).
+//
+// Like ranges.RangeSet in Python, the index holds the union of the intervals
+// it is built from: overlapping and adjacent intervals are merged. The merged
+// intervals of each contig are stored as two parallel sorted arrays of starts
+// and ends, so overlap queries are binary searches and intersection and
+// subtraction are linear merges.
+//
+// All const methods are safe to call concurrently.
+class RangeIndex {
+ public:
+  // Creates an index over ranges, which may be in any order. Empty ranges are
+  // ignored.
+  static std::unique_ptr<RangeIndex> FromRanges(
+      const std::vector<nucleus::genomics::v1::Range>& ranges);
+
+  // Creates an index over the intervals of the BED file at bed_path.
+  static StatusOr<std::unique_ptr<RangeIndex>> FromBed(const string& bed_path);
+
+  // Disable copy and assignment operations
+  RangeIndex(const RangeIndex& other) = delete;
+  RangeIndex& operator=(const RangeIndex&) = delete;
+
+  // Returns true if chrom:pos is in any interval.
+  bool Overlaps(const string& chrom, int64 pos) const;
+
+  // Returns true if any base of range is in an interval.
+  bool OverlapsRange(const nucleus::genomics::v1::Range& range) const;
+
+  // Returns true if a single interval contains all of range. An empty range
+  // is enveloped if its start is in an interval.
+  bool Envelops(const nucleus::genomics::v1::Range& range) const;
+
+  // Returns OverlapsRange() for each of ranges.
+  std::vector<bool> OverlapsEach(
+      const std::vector<nucleus::genomics::v1::Range>& ranges) const;
+
+  // Returns the (merged) intervals that overlap range, in order.
+  std::vector<nucleus::genomics::v1::Range> Query(
+      const nucleus::genomics::v1::Range& range) const;
+
+  // Returns the bases in this index, other or both.
+  std::unique_ptr<RangeIndex> Union(const RangeIndex& other) const;
+
+  // Returns the bases in both this index and other.
+  std::unique_ptr<RangeIndex> Intersection(const RangeIndex& other) const;
+
+  // Returns the bases in this index that are not in other.
+  std::unique_ptr<RangeIndex> Difference(const RangeIndex& other) const;
+
+  // Returns all intervals, sorted by contig name and then position.
+  std::vector<nucleus::genomics::v1::Range> ToRanges() const;
+
+  // Number of (merged) intervals.
+  int64 size() const { return size_; }
+
+  // Number of bases covered by the intervals.
+  int64 TotalBases() const;
+
+ private:
+  // The merged intervals of one contig: [starts[i], ends[i]) are disjoint,
+  // non-adjacent and sorted, so both arrays are strictly increasing.
+  struct Intervals {
+    std::vector<int64> starts;
+    std::vector<int64> ends;
+  };
+
+  RangeIndex() = default;
+
+  // Returns the intervals on chrom, or nullptr if there are none.
+  const Intervals* ForContig(const string& chrom) const;
+
+  // Adds the intervals of a contig, dropping it if empty.
+  void AddContig(const string& chrom, Intervals intervals);
+
+  std::map<string, Intervals> by_contig_;
+  int64 size_ = 0;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_UTIL_RANGE_INDEX_H_
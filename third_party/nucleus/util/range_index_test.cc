@@ -0,0 +1,196 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/util/range_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/test.h"
+#include "third_party/nucleus/testing/protocol-buffer-matchers.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/util/utils.h"
+
+namespace nucleus {
+
+using nucleus::genomics::v1::Range;
+using std::vector;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Pointwise;
+
+constexpr char kBedFilename[] = "test.bed";
+
+TEST(RangeIndexTest, MergesOverlappingAndAdjacentRanges) {
+  auto index = RangeIndex::FromRanges({
+      MakeRange("chr2", 30, 40),
+      MakeRange("chr1", 10, 20),
+      MakeRange("chr1", 15, 25),
+      MakeRange("chr1", 25, 30),
+      MakeRange("chr1", 50, 60),
+      MakeRange("chr1", 70, 70),
+  });
+
+  vector<Range> expected = {MakeRange("chr1", 10, 30),
+                            MakeRange("chr1", 50, 60),
+                            MakeRange("chr2", 30, 40)};
+  EXPECT_THAT(index->ToRanges(), Pointwise(EqualsProto(), expected));
+  EXPECT_EQ(3, index->size());
+  EXPECT_EQ(40, index->TotalBases());
+}
+
+TEST(RangeIndexTest, Overlaps) {
+  auto index = RangeIndex::FromRanges(
+      {MakeRange("chr1", 10, 20), MakeRange("chr1", 30, 40)});
+
+  EXPECT_FALSE(index->Overlaps("chr1", 9));
+  EXPECT_TRUE(index->Overlaps("chr1", 10));
+  EXPECT_TRUE(index->Overlaps("chr1", 19));
+  EXPECT_FALSE(index->Overlaps("chr1", 20));
+  EXPECT_TRUE(index->Overlaps("chr1", 30));
+  EXPECT_FALSE(index->Overlaps("chr1", 40));
+  EXPECT_FALSE(index->Overlaps("chr2", 15));
+
+  EXPECT_TRUE(index->OverlapsRange(MakeRange("chr1", 0, 11)));
+  EXPECT_FALSE(index->OverlapsRange(MakeRange("chr1", 0, 10)));
+  EXPECT_FALSE(index->OverlapsRange(MakeRange("chr1", 20, 30)));
+  EXPECT_TRUE(index->OverlapsRange(MakeRange("chr1", 19, 31)));
+  EXPECT_FALSE(index->OverlapsRange(MakeRange("chr2", 0, 100)));
+
+  EXPECT_THAT(index->OverlapsEach({MakeRange("chr1", 5, 15),
+                                   MakeRange("chr1", 20, 30),
+                                   MakeRange("chr1", 39, 50)}),
+              ElementsAre(true, false, true));
+}
+
+TEST(RangeIndexTest, Envelops) {
+  auto index = RangeIndex::FromRanges(
+      {MakeRange("chr1", 10, 20), MakeRange("chr1", 30, 40)});
+
+  EXPECT_TRUE(index->Envelops(MakeRange("chr1", 10, 20)));
+  EXPECT_TRUE(index->Envelops(MakeRange("chr1", 12, 15)));
+  EXPECT_FALSE(index->Envelops(MakeRange("chr1", 9, 15)));
+  EXPECT_FALSE(index->Envelops(MakeRange("chr1", 15, 35)));
+  EXPECT_TRUE(index->Envelops(MakeRange("chr1", 15, 15)));
+  EXPECT_FALSE(index->Envelops(MakeRange("chr1", 20, 20)));
+  EXPECT_FALSE(index->Envelops(MakeRange("chr2", 12, 15)));
+}
+
+TEST(RangeIndexTest, Query) {
+  auto index = RangeIndex::FromRanges({MakeRange("chr1", 10, 20),
+                                       MakeRange("chr1", 30, 40),
+                                       MakeRange("chr1", 50, 60)});
+
+  vector<Range> expected = {MakeRange("chr1", 10, 20),
+                            MakeRange("chr1", 30, 40)};
+  EXPECT_THAT(index->Query(MakeRange("chr1", 15, 31)),
+              Pointwise(EqualsProto(), expected));
+  EXPECT_THAT(index->Query(MakeRange("chr1", 40, 50)), IsEmpty());
+  EXPECT_THAT(index->Query(MakeRange("chr2", 0, 100)), IsEmpty());
+}
+
+TEST(RangeIndexTest, Union) {
+  auto a = RangeIndex::FromRanges({MakeRange("chr1", 10, 50),
+                                   MakeRange("chr1", 60, 70),
+                                   MakeRange("chr2", 0, 10)});
+  auto b = RangeIndex::FromRanges({MakeRange("chr1", 0, 15),
+                                   MakeRange("chr1", 50, 55),
+                                   MakeRange("chr1", 80, 90),
+                                   MakeRange("chr3", 0, 10)});
+
+  vector<Range> expected = {
+      MakeRange("chr1", 0, 55), MakeRange("chr1", 60, 70),
+      MakeRange("chr1", 80, 90), MakeRange("chr2", 0, 10),
+      MakeRange("chr3", 0, 10)};
+  EXPECT_THAT(a->Union(*b)->ToRanges(), Pointwise(EqualsProto(), expected));
+  EXPECT_THAT(b->Union(*a)->ToRanges(), Pointwise(EqualsProto(), expected));
+  EXPECT_EQ(a->Union(*b)->size(), 5);
+}
+
+TEST(RangeIndexTest, Intersection) {
+  auto a = RangeIndex::FromRanges({MakeRange("chr1", 10, 50),
+                                   MakeRange("chr1", 60, 70),
+                                   MakeRange("chr2", 0, 10)});
+  auto b = RangeIndex::FromRanges({MakeRange("chr1", 0, 15),
+                                   MakeRange("chr1", 20, 30),
+                                   MakeRange("chr1", 45, 65),
+                                   MakeRange("chr3", 0, 10)});
+
+  vector<Range> expected = {
+      MakeRange("chr1", 10, 15), MakeRange("chr1", 20, 30),
+      MakeRange("chr1", 45, 50), MakeRange("chr1", 60, 65)};
+  EXPECT_THAT(a->Intersection(*b)->ToRanges(),
+              Pointwise(EqualsProto(), expected));
+  EXPECT_THAT(b->Intersection(*a)->ToRanges(),
+              Pointwise(EqualsProto(), expected));
+}
+
+TEST(RangeIndexTest, Difference) {
+  auto a = RangeIndex::FromRanges({MakeRange("chr1", 10, 50),
+                                   MakeRange("chr1", 60, 70),
+                                   MakeRange("chr2", 0, 10)});
+  auto b = RangeIndex::FromRanges({MakeRange("chr1", 0, 15),
+                                   MakeRange("chr1", 20, 30),
+                                   MakeRange("chr1", 45, 65),
+                                   MakeRange("chr3", 0, 10)});
+
+  vector<Range> a_minus_b = {
+      MakeRange("chr1", 15, 20), MakeRange("chr1", 30, 45),
+      MakeRange("chr1", 65, 70), MakeRange("chr2", 0, 10)};
+  EXPECT_THAT(a->Difference(*b)->ToRanges(),
+              Pointwise(EqualsProto(), a_minus_b));
+
+  vector<Range> b_minus_a = {MakeRange("chr1", 0, 10),
+                             MakeRange("chr3", 0, 10)};
+  EXPECT_THAT(b->Difference(*a)->ToRanges(),
+              Pointwise(EqualsProto(), b_minus_a));
+  EXPECT_EQ(0, a->Difference(*a)->size());
+}
+
+TEST(RangeIndexTest, FromBed) {
+  auto index = RangeIndex::FromBed(GetTestData(kBedFilename)).ValueOrDie();
+
+  vector<Range> expected = {
+      MakeRange("chr1", 1, 10), MakeRange("chr2", 20, 30),
+      MakeRange("chr2", 40, 60), MakeRange("chr3", 80, 90)};
+  EXPECT_THAT(index->ToRanges(), Pointwise(EqualsProto(), expected));
+}
+
+TEST(RangeIndexTest, FromBedFailsOnMissingFile) {
+  EXPECT_FALSE(RangeIndex::FromBed("/this/path/does/not/exist.bed").ok());
+}
+
+}  // namespace nucleus
@@ -46,6 +46,7 @@ from third_party.nucleus.protos import position_pb2
 from third_party.nucleus.protos import range_pb2
 from third_party.nucleus.protos import reference_pb2
 from third_party.nucleus.protos import variants_pb2
+from third_party.nucleus.util.python import range_index
 
 
 # Regular expressions for matching literal chr:start-stop strings.
@@ -376,6 +377,72 @@ class RangeSet(object):
       return any(ov.begin <= start and ov.end >= end for ov in overlap_set)
 
 
+class IndexedRangeSet(object):
+  """A read-only RangeSet backed by the C++ RangeIndex.
+
+  Supports the lookups the labelers make against confident regions, without
+  building a Python intervaltree for every interval of a large BED file.
+  """
+
+  def __init__(self, index: range_index.RangeIndex):
+    self._index = index
+
+  @classmethod
+  def from_bed(cls, source: str) -> 'IndexedRangeSet':
+    """Creates an IndexedRangeSet containing the intervals from source."""
+    return cls(range_index.RangeIndex.from_bed(source))
+
+  def __iter__(self):
+    """Iterates over the merged ranges, sorted by chromosome name then start."""
+    return iter(self._index.to_ranges())
+
+  def __len__(self):
+    return self._index.size()
+
+  def __bool__(self):
+    return self._index.size() > 0
+
+  def variant_overlaps(self, variant: variants_pb2.Variant,
+                       empty_set_return_value: bool = True):
+    """Returns True if the variant's range overlaps with any in this set."""
+    if not self:
+      return empty_set_return_value
+    else:
+      return self.overlaps(variant.reference_name, variant.start)
+
+  def overlaps(self, chrom: str, pos: int):
+    """Returns True if chr:pos overlaps with any range in this set."""
+    return self._index.overlaps(chrom, pos)
+
+  def envelops(self, chrom, start, end):
+    """Returns True iff some range in this set envelops the range."""
+    return self._index.envelops(make_range(chrom, start, end))
+
+
+def index_from_regions(regions, contig_map=None) -> range_index.RangeIndex:
+  """Parses `regions` like from_regions into a RangeIndex.
+
+  BED files are read directly by RangeIndex.from_bed; all other regions are
+  parsed with from_regions.
+
+  Args:
+    regions: iterable[str]. The region literals and files to index.
+    contig_map: An optional dictionary mapping from contig names to ContigInfo
+      protobufs, as in from_regions.
+
+  Returns:
+    A RangeIndex of the union of all of the regions.
+  """
+  regions = list(regions)
+  beds = [r for r in regions if _get_parser_for_file(r) is bed_parser]
+  others = [r for r in regions if _get_parser_for_file(r) is not bed_parser]
+  index = range_index.RangeIndex.from_ranges(
+      list(from_regions(others, contig_map=contig_map)))
+  for bed_path in beds:
+    index = index.union(range_index.RangeIndex.from_bed(bed_path))
+  return index
+
+
 def make_position(chrom, position, reverse_strand=False):
   """Returns a nucleus.genomics.v1.Position.
 
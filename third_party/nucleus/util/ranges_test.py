@@ -300,6 +300,26 @@ class RangesTests(parameterized.TestCase):
 
     self.assertEqual(list(ranges.from_regions(regions)), expected)
 
+  def test_index_from_regions(self):
+    regions = ['chr1:10-20', test_utils.genomics_core_testdata('test.bed')]
+    self.assertEqual(
+        list(ranges.RangeSet.from_regions(regions)),
+        ranges.index_from_regions(regions).to_ranges())
+
+  def test_indexed_range_set(self):
+    source = test_utils.genomics_core_testdata('test.bed')
+    range_set = ranges.RangeSet.from_bed(source)
+    indexed = ranges.IndexedRangeSet.from_bed(source)
+    self.assertEqual(list(range_set), list(indexed))
+    self.assertLen(indexed, 4)
+    for pos in range(0, 100):
+      self.assertEqual(
+          range_set.overlaps('chr2', pos), indexed.overlaps('chr2', pos))
+    self.assertTrue(indexed.envelops('chr2', 40, 60))
+    self.assertFalse(indexed.envelops('chr2', 25, 45))
+    variant = test_utils.make_variant(chrom='chr3', start=85)
+    self.assertTrue(indexed.variant_overlaps(variant))
+
   @parameterized.parameters(
       # Intersection with 1, 2, 3 identical RangeSets produces the original set.
       ([['1:1-10']], ['1:1-10']),
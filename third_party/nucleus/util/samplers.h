@@ -33,6 +33,8 @@
 #ifndef THIRD_PARTY_NUCLEUS_UTIL_SAMPLERS_H_
 #define THIRD_PARTY_NUCLEUS_UTIL_SAMPLERS_H_
 
+#include <algorithm>
+#include <deque>
 #include <random>
 
 #include "absl/log/check.h"
@@ -78,6 +80,101 @@ class FractionalSampler {
   mutable std::uniform_real_distribution<> uniform_;
 };
 
+// Helper class for capping the depth of coverage of a coordinate-sorted stream
+// of intervals, such as reads.
+//
+// The genome is divided into fixed-size windows and a running count of the
+// bases covered by kept intervals is maintained for the windows at and ahead
+// of the current position. An interval can be kept as long as adding it leaves
+// the average depth of every window it overlaps at or below max_depth, so no
+// window exceeds the cap however long the intervals are. Unlike random
+// sampling, the decisions only depend on the order of the intervals, so the
+// same input always yields the same output, and memory use is bounded by the
+// number of windows spanned by a single interval rather than by the depth of
+// the data.
+//
+// Usage:
+//
+// DepthCappedSampler sampler(100 /* max_depth */, 100 /* window_size */);
+// for (const Interval& i : intervals) {
+//   if (sampler.CanKeep(i.contig, i.start, i.end) && ...) {
+//     sampler.Add(i.contig, i.start, i.end);
+//     ...
+//   }
+// }
+//
+class DepthCappedSampler {
+ public:
+  DepthCappedSampler(int max_depth, int64 window_size)
+      : window_size_(window_size),
+        max_bases_per_window_(static_cast<int64>(max_depth) * window_size) {
+    CHECK_GT(max_depth, 0) << "max_depth must be positive";
+    CHECK_GT(window_size, 0) << "window_size must be positive";
+  }
+
+  // Returns true if the interval [start, end) on contig can be kept without
+  // pushing any window it overlaps over the depth cap. Empty intervals count as
+  // covering one base. Intervals must be presented sorted by start within a
+  // contig; moving to another contig or backwards starts over.
+  bool CanKeep(int contig, int64 start, int64 end) {
+    const int64 window = start / window_size_;
+    if (contig != contig_ || window < first_window_) {
+      contig_ = contig;
+      first_window_ = window;
+      bases_.clear();
+    }
+    // Windows before the current one can no longer be affected.
+    const int64 n_done =
+        std::min(window - first_window_, static_cast<int64>(bases_.size()));
+    bases_.erase(bases_.begin(), bases_.begin() + n_done);
+    first_window_ = window;
+
+    end = std::max(end, start + 1);
+    const int64 last_window = std::min(
+        (end - 1) / window_size_,
+        first_window_ + static_cast<int64>(bases_.size()) - 1);
+    for (int64 w = window; w <= last_window; ++w) {
+      if (bases_[w - first_window_] + Overlap(w, start, end) >
+          max_bases_per_window_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Records the interval [start, end) on contig as kept. Must be called right
+  // after CanKeep(contig, start, end) returned true.
+  void Add(int contig, int64 start, int64 end) {
+    CHECK_EQ(contig, contig_);
+    CHECK_GE(start / window_size_, first_window_);
+    end = std::max(end, start + 1);
+    const int64 last_window = (end - 1) / window_size_;
+    if (last_window - first_window_ >= static_cast<int64>(bases_.size())) {
+      bases_.resize(last_window - first_window_ + 1, 0);
+    }
+    for (int64 w = start / window_size_; w <= last_window; ++w) {
+      bases_[w - first_window_] += Overlap(w, start, end);
+    }
+  }
+
+ private:
+  // Returns the number of bases of [start, end) that fall in window w.
+  int64 Overlap(int64 w, int64 start, int64 end) const {
+    return std::min(end, (w + 1) * window_size_) -
+           std::max(start, w * window_size_);
+  }
+
+  const int64 window_size_;
+  const int64 max_bases_per_window_;
+  // The contig of the most recent interval, or -1 before the first one.
+  int contig_ = -1;
+  // Index of the window corresponding to bases_.front().
+  int64 first_window_ = 0;
+  // Number of bases covered by kept intervals in each window starting at
+  // first_window_.
+  std::deque<int64> bases_;
+};
+
 }  // namespace nucleus
 
 #endif  // THIRD_PARTY_NUCLEUS_UTIL_SAMPLERS_H_
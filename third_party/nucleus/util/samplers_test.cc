@@ -65,4 +65,48 @@ TEST_P(FractionalSamplerTest, TestFractionalSampler) {
 INSTANTIATE_TEST_CASE_P(FractionalSamplerTest1, FractionalSamplerTest,
                         ::testing::Values(0.9, 0.1, 0.01, 0.05));
 
+TEST(DepthCappedSamplerTest, CapsDepthPerWindow) {
+  // 100 reads of length 10 all starting at position 0 in a window of size 10:
+  // only enough reads to reach depth 5 are kept.
+  DepthCappedSampler sampler(5, 10);
+  int n_kept = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (sampler.CanKeep(0, 0, 10)) {
+      sampler.Add(0, 0, 10);
+      ++n_kept;
+    }
+  }
+  EXPECT_EQ(n_kept, 5);
+
+  // The next window is already half covered by reads from the previous one.
+  DepthCappedSampler spanning(4, 10);
+  n_kept = 0;
+  for (int start : {5, 5, 5, 5, 10, 10, 10, 10}) {
+    if (spanning.CanKeep(0, start, start + 10)) {
+      spanning.Add(0, start, start + 10);
+      ++n_kept;
+    }
+  }
+  EXPECT_EQ(n_kept, 6);
+}
+
+TEST(DepthCappedSamplerTest, ChecksEveryWindowAnIntervalSpans) {
+  DepthCappedSampler sampler(1, 10);
+  ASSERT_TRUE(sampler.CanKeep(0, 2, 20));
+  sampler.Add(0, 2, 20);
+  // Window 0 still has room, but window 1 is full.
+  EXPECT_FALSE(sampler.CanKeep(0, 9, 12));
+  EXPECT_TRUE(sampler.CanKeep(0, 9, 10));
+  // Empty intervals count as covering one base.
+  EXPECT_FALSE(sampler.CanKeep(0, 12, 12));
+}
+
+TEST(DepthCappedSamplerTest, ResetsOnNewContig) {
+  DepthCappedSampler sampler(1, 100);
+  ASSERT_TRUE(sampler.CanKeep(0, 0, 150));
+  sampler.Add(0, 0, 150);
+  EXPECT_FALSE(sampler.CanKeep(0, 60, 160));
+  EXPECT_TRUE(sampler.CanKeep(1, 60, 160));
+}
+
 }  // namespace nucleus
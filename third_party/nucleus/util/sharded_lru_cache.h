@@ -0,0 +1,150 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_UTIL_SHARDED_LRU_CACHE_H_
+#define THIRD_PARTY_NUCLEUS_UTIL_SHARDED_LRU_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/log/check.h"
+#include "absl/synchronization/mutex.h"
+
+namespace nucleus {
+
+// A thread-safe least-recently-used cache of immutable values.
+//
+// Keys are spread over num_shards independently locked shards by their hash,
+// so concurrent lookups of different keys rarely contend. Each shard evicts
+// its own least recently used entry once it holds more than
+// ceil(capacity / num_shards) entries.
+//
+// Values are handed out as std::shared_ptr<const Value>, so a value stays
+// valid for as long as a caller holds on to it, even if it has been evicted
+// in the meantime.
+template <class Key, class Value, class Hash = absl::Hash<Key>>
+class ShardedLruCache {
+ public:
+  ShardedLruCache(size_t capacity, int num_shards) {
+    CHECK_GT(capacity, 0) << "capacity must be positive";
+    CHECK_GT(num_shards, 0) << "num_shards must be positive";
+    const size_t shard_capacity = (capacity + num_shards - 1) / num_shards;
+    for (int i = 0; i < num_shards; ++i) {
+      shards_.push_back(std::make_unique<Shard>(shard_capacity));
+    }
+  }
+
+  ShardedLruCache(const ShardedLruCache& other) = delete;
+  ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+  // Returns the value cached for key, marking it as most recently used, or
+  // nullptr if there is none.
+  std::shared_ptr<const Value> Lookup(const Key& key) {
+    Shard& shard = ShardFor(key);
+    absl::MutexLock lock(&shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) return nullptr;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->second;
+  }
+
+  // Caches value for key and returns the value now cached for key. If another
+  // thread inserted a value for key first, that value is kept and returned.
+  std::shared_ptr<const Value> Insert(const Key& key,
+                                      std::shared_ptr<const Value> value) {
+    Shard& shard = ShardFor(key);
+    absl::MutexLock lock(&shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      return it->second->second;
+    }
+    shard.entries.emplace_front(key, std::move(value));
+    shard.index.emplace(key, shard.entries.begin());
+    if (shard.entries.size() > shard.capacity) {
+      shard.index.erase(shard.entries.back().first);
+      shard.entries.pop_back();
+    }
+    return shard.entries.front().second;
+  }
+
+  // Removes all entries.
+  void Clear() {
+    for (auto& shard : shards_) {
+      absl::MutexLock lock(&shard->mutex);
+      shard->index.clear();
+      shard->entries.clear();
+    }
+  }
+
+  // Returns the number of cached entries.
+  size_t size() const {
+    size_t n = 0;
+    for (const auto& shard : shards_) {
+      absl::MutexLock lock(&shard->mutex);
+      n += shard->entries.size();
+    }
+    return n;
+  }
+
+ private:
+  struct Shard {
+    explicit Shard(size_t capacity) : capacity(capacity) {}
+
+    const size_t capacity;
+    mutable absl::Mutex mutex;
+    // Most recently used first.
+    std::list<std::pair<Key, std::shared_ptr<const Value>>> entries
+        ABSL_GUARDED_BY(mutex);
+    std::unordered_map<
+        Key,
+        typename std::list<
+            std::pair<Key, std::shared_ptr<const Value>>>::iterator,
+        Hash>
+        index ABSL_GUARDED_BY(mutex);
+  };
+
+  Shard& ShardFor(const Key& key) {
+    return *shards_[Hash()(key) % shards_.size()];
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_UTIL_SHARDED_LRU_CACHE_H_
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Implementation of tracing.h
+#include "third_party/nucleus/util/tracing.h"
+
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+
+namespace nucleus {
+
+namespace tracing_internal {
+std::atomic<bool> enabled{false};
+}  // namespace tracing_internal
+
+namespace {
+
+// Events beyond this many are dropped, so that leaving events on for a whole
+// genome cannot exhaust memory.
+constexpr size_t kMaxTraceEvents = 10 * 1000 * 1000;
+
+std::atomic<bool> record_events{false};
+
+struct TraceEvent {
+  string name;
+  int64 start_us;
+  int64 duration_us;
+  int thread_id;
+};
+
+// What one thread has recorded since its region began.
+struct ThreadTrace {
+  explicit ThreadTrace(int id) : thread_id(id) {}
+
+  int thread_id;
+  string region;
+  absl::Time region_start = absl::InfinitePast();
+  // std::less<> allows lookups by string_view without building a string.
+  std::map<string, double, std::less<>> totals;
+  std::vector<TraceEvent> events;
+};
+
+ThreadTrace& CurrentThreadTrace() {
+  static std::atomic<int> next_thread_id{1};
+  thread_local ThreadTrace trace(next_thread_id++);
+  return trace;
+}
+
+void AddToTotal(absl::string_view name, double value, ThreadTrace* trace) {
+  auto it = trace->totals.find(name);
+  if (it == trace->totals.end()) {
+    it = trace->totals.emplace(string(name), 0.0).first;
+  }
+  it->second += value;
+}
+
+void AddEvent(absl::string_view name, absl::Time start, absl::Time end,
+              ThreadTrace* trace) {
+  trace->events.push_back(TraceEvent{string(name), absl::ToUnixMicros(start),
+                                     absl::ToInt64Microseconds(end - start),
+                                     trace->thread_id});
+}
+
+// Events of all regions ended so far.
+ABSL_CONST_INIT absl::Mutex events_mutex(absl::kConstInit);
+std::vector<TraceEvent>* collected_events ABSL_GUARDED_BY(events_mutex) =
+    nullptr;
+
+// Returns s quoted as a JSON string.
+string JsonString(absl::string_view s) {
+  string quoted = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      absl::StrAppend(&quoted, "\\", string(1, c));
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppend(&quoted, " ");
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+}  // namespace
+
+void EnableTracing(bool events) {
+  record_events.store(events, std::memory_order_relaxed);
+  tracing_internal::enabled.store(true, std::memory_order_relaxed);
+}
+
+void DisableTracing() {
+  tracing_internal::enabled.store(false, std::memory_order_relaxed);
+}
+
+void TraceCount(absl::string_view name, int64 n) {
+  if (!TracingEnabled()) return;
+  AddToTotal(name, n, &CurrentThreadTrace());
+}
+
+void TraceDuration(absl::string_view name, absl::Time start, absl::Time end) {
+  if (!TracingEnabled()) return;
+  ThreadTrace& trace = CurrentThreadTrace();
+  AddToTotal(name, absl::ToDoubleSeconds(end - start), &trace);
+  if (record_events.load(std::memory_order_relaxed)) {
+    AddEvent(name, start, end, &trace);
+  }
+}
+
+void SetTraceThreadId(int thread_id) {
+  CurrentThreadTrace().thread_id = thread_id;
+}
+
+void BeginTraceRegion(absl::string_view name) {
+  ThreadTrace& trace = CurrentThreadTrace();
+  trace.totals.clear();
+  trace.events.clear();
+  trace.region = string(name);
+  trace.region_start = absl::Now();
+}
+
+std::map<string, double> EndTraceRegion() {
+  ThreadTrace& trace = CurrentThreadTrace();
+  std::map<string, double> totals;
+  if (TracingEnabled()) {
+    totals.insert(trace.totals.begin(), trace.totals.end());
+    if (record_events.load(std::memory_order_relaxed)) {
+      if (trace.region_start != absl::InfinitePast()) {
+        AddEvent(trace.region, trace.region_start, absl::Now(), &trace);
+      }
+      absl::MutexLock lock(&events_mutex);
+      if (collected_events == nullptr) {
+        collected_events = new std::vector<TraceEvent>();
+      }
+      for (TraceEvent& event : trace.events) {
+        if (collected_events->size() >= kMaxTraceEvents) break;
+        collected_events->push_back(std::move(event));
+      }
+    }
+  }
+  trace.totals.clear();
+  trace.events.clear();
+  trace.region.clear();
+  trace.region_start = absl::InfinitePast();
+  return totals;
+}
+
+::nucleus::Status WriteChromeTrace(const string& path, int thread_id) {
+  string json = "{\"traceEvents\":[";
+  {
+    absl::MutexLock lock(&events_mutex);
+    if (collected_events != nullptr) {
+      bool first = true;
+      for (const TraceEvent& event : *collected_events) {
+        if (thread_id != 0 && event.thread_id != thread_id) continue;
+        absl::StrAppend(&json, first ? "\n" : ",\n", "{\"name\":",
+                        JsonString(event.name), ",\"ph\":\"X\",\"ts\":",
+                        event.start_us, ",\"dur\":", event.duration_us,
+                        ",\"pid\":0,\"tid\":", event.thread_id, "}");
+        first = false;
+      }
+    }
+  }
+  absl::StrAppend(&json, "\n]}\n");
+
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return ::nucleus::Unknown(absl::StrCat("Could not open ", path));
+  }
+  const bool written =
+      std::fwrite(json.data(), 1, json.size(), file) == json.size();
+  if (std::fclose(file) != 0 || !written) {
+    return ::nucleus::Unknown(absl::StrCat("Could not write ", path));
+  }
+  return ::nucleus::Status();
+}
+
+}  // namespace nucleus
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THIRD_PARTY_NUCLEUS_UTIL_TRACING_H_
+#define THIRD_PARTY_NUCLEUS_UTIL_TRACING_H_
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "third_party/nucleus/platform/types.h"
+#include "third_party/nucleus/core/status.h"
+
+// Lightweight stage timing and counters for native code.
+//
+// Instrumented code adds to named counters with TraceCount() and times scopes
+// with ScopedTraceTimer. Both go to a thread-local aggregate, so they take no
+// locks. Tracing is off by default; while it is off each call costs one
+// relaxed atomic load.
+//
+// A driver brackets the work for one region on one thread with
+// BeginTraceRegion() and EndTraceRegion(). The latter returns what was
+// recorded on that thread in between: timer totals in seconds and counter
+// totals, keyed by name. If tracing was enabled with record_events, each timed
+// scope is also kept as an event and can be written out with
+// WriteChromeTrace() for chrome://tracing or Perfetto.
+//
+//   void Realign(...) {
+//     ScopedTraceTimer timer("realign");
+//     ...
+//     TraceCount("realigned reads", reads.size());
+//   }
+
+namespace nucleus {
+
+namespace tracing_internal {
+extern std::atomic<bool> enabled;
+}  // namespace tracing_internal
+
+// Turns tracing on for all threads. If record_events, timed scopes are also
+// kept as individual events for WriteChromeTrace().
+void EnableTracing(bool record_events);
+
+// Turns tracing off. Aggregates and events recorded so far are kept.
+void DisableTracing();
+
+inline bool TracingEnabled() {
+  return tracing_internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Adds n to the counter name on this thread.
+void TraceCount(absl::string_view name, int64 n = 1);
+
+// Adds the time from start to end to the timer name on this thread.
+void TraceDuration(absl::string_view name, absl::Time start, absl::Time end);
+
+// Times its own lifetime under name. name must outlive the timer.
+class ScopedTraceTimer {
+ public:
+  explicit ScopedTraceTimer(absl::string_view name)
+      : name_(name),
+        start_(TracingEnabled() ? absl::Now() : absl::InfinitePast()) {}
+
+  ~ScopedTraceTimer() {
+    if (start_ != absl::InfinitePast()) {
+      TraceDuration(name_, start_, absl::Now());
+    }
+  }
+
+  // Disable copy and assignment operations.
+  ScopedTraceTimer(const ScopedTraceTimer& other) = delete;
+  ScopedTraceTimer& operator=(const ScopedTraceTimer&) = delete;
+
+ private:
+  const absl::string_view name_;
+  const absl::Time start_;
+};
+
+// Sets the id that the events recorded on this thread carry from now on, so
+// that a pool can tag the events of each of its workers. Threads are otherwise
+// numbered from 1 in the order they first trace.
+void SetTraceThreadId(int thread_id);
+
+// Clears this thread's aggregates and starts a region called name.
+void BeginTraceRegion(absl::string_view name);
+
+// Ends the region started by BeginTraceRegion() on this thread and returns
+// its timer totals, in seconds, and counter totals. Its events, if recorded,
+// are handed to WriteChromeTrace(), along with one event spanning the whole
+// region. Returns an empty map if tracing is disabled.
+std::map<string, double> EndTraceRegion();
+
+// Writes the events of every region ended so far to the local file path as
+// Chrome trace-event JSON. Events of threads that never call EndTraceRegion()
+// are not included. If thread_id is not 0, only the events carrying that id
+// are written.
+::nucleus::Status WriteChromeTrace(const string& path, int thread_id = 0);
+
+}  // namespace nucleus
+
+#endif  // THIRD_PARTY_NUCLEUS_UTIL_TRACING_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2023 Google LLC.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "third_party/nucleus/util/tracing.h"
+
+#include <map>
+#include <string>
+#include <thread>  // NOLINT
+
+#include <gmock/gmock-generated-matchers.h>
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock-more-matchers.h>
+
+#include "tensorflow/core/platform/test.h"
+#include "absl/time/time.h"
+#include "third_party/nucleus/testing/test_utils.h"
+#include "third_party/nucleus/core/status_matchers.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace nucleus {
+
+using ::testing::DoubleEq;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+class TracingTest : public ::testing::Test {
+ protected:
+  void TearDown() override { DisableTracing(); }
+};
+
+TEST_F(TracingTest, RecordsNothingWhenDisabled) {
+  BeginTraceRegion("chr1:1-100");
+  TraceCount("reads");
+  { ScopedTraceTimer timer("stage"); }
+  EXPECT_THAT(EndTraceRegion(), IsEmpty());
+}
+
+TEST_F(TracingTest, AggregatesCountersAndTimersPerRegion) {
+  EnableTracing(/*record_events=*/false);
+  BeginTraceRegion("chr1:1-100");
+  TraceCount("reads");
+  TraceCount("reads", 4);
+  const absl::Time start = absl::FromUnixSeconds(10);
+  TraceDuration("stage", start, start + absl::Milliseconds(250));
+  TraceDuration("stage", start, start + absl::Milliseconds(250));
+  EXPECT_THAT(EndTraceRegion(),
+              UnorderedElementsAre(Pair("reads", DoubleEq(5)),
+                                   Pair("stage", DoubleEq(0.5))));
+
+  // A new region starts from zero.
+  BeginTraceRegion("chr1:101-200");
+  TraceCount("candidates");
+  EXPECT_THAT(EndTraceRegion(),
+              UnorderedElementsAre(Pair("candidates", DoubleEq(1))));
+}
+
+TEST_F(TracingTest, KeepsThreadsApart) {
+  EnableTracing(/*record_events=*/false);
+  BeginTraceRegion("chr1:1-100");
+  TraceCount("main");
+  std::map<string, double> other_totals;
+  std::thread other([&other_totals] {
+    BeginTraceRegion("chr2:1-100");
+    TraceCount("other", 2);
+    other_totals = EndTraceRegion();
+  });
+  other.join();
+  EXPECT_THAT(EndTraceRegion(),
+              UnorderedElementsAre(Pair("main", DoubleEq(1))));
+  EXPECT_THAT(other_totals, UnorderedElementsAre(Pair("other", DoubleEq(2))));
+}
+
+TEST_F(TracingTest, WritesChromeTrace) {
+  EnableTracing(/*record_events=*/true);
+  BeginTraceRegion("chr1:1-100");
+  { ScopedTraceTimer timer("make \"pileups\""); }
+  EndTraceRegion();
+
+  const string path = MakeTempFile("trace.json");
+  ASSERT_THAT(WriteChromeTrace(path), IsOK());
+  string contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(), path,
+                                           &contents));
+  EXPECT_THAT(contents, HasSubstr("{\"traceEvents\":["));
+  EXPECT_THAT(contents, HasSubstr("\"name\":\"make \\\"pileups\\\"\""));
+  EXPECT_THAT(contents, HasSubstr("\"name\":\"chr1:1-100\",\"ph\":\"X\""));
+}
+
+TEST_F(TracingTest, WritesChromeTraceOfOneThread) {
+  EnableTracing(/*record_events=*/true);
+  std::thread worker([] {
+    SetTraceThreadId(7);
+    BeginTraceRegion("chr2:1-100");
+    { ScopedTraceTimer timer("realign"); }
+    EndTraceRegion();
+  });
+  worker.join();
+  BeginTraceRegion("chr1:1-100");
+  EndTraceRegion();
+
+  const string path = MakeTempFile("worker_trace.json");
+  ASSERT_THAT(WriteChromeTrace(path, /*thread_id=*/7), IsOK());
+  string contents;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(), path,
+                                           &contents));
+  EXPECT_THAT(contents, HasSubstr("\"name\":\"realign\""));
+  EXPECT_THAT(contents, HasSubstr("\"name\":\"chr2:1-100\""));
+  EXPECT_THAT(contents, HasSubstr("\"tid\":7}"));
+  EXPECT_THAT(contents, Not(HasSubstr("chr1:1-100")));
+}
+
+}  // namespace nucleus